@@ -28,6 +28,7 @@
 #include "arch/io/disk/conflict_resolving.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "backtrace.hpp"
 #include "config/args.hpp"
 #include "do_on_thread.hpp"
@@ -53,14 +54,43 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         file_io_backend_t io_backend,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
         accounter(batch_factor),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
         outstanding_txn(0)
     {
+        /* Set up the backend, which pops operations off the queue and runs them. */
+        std::function<void(pool_diskmgr_t::action_t *)> backend_done_fun =
+            std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
+#if USE_IO_URING
+        if (io_backend == file_io_backend_t::io_uring_desired) {
+            if (uring_diskmgr_t::is_supported()) {
+                uring_backend.init(new uring_diskmgr_t(
+                    queue, backend_stats.producer, max_concurrent_io_requests));
+                uring_backend->done_fun = backend_done_fun;
+            } else {
+                logWRN("This kernel doesn't support io_uring.  Falling back to the "
+                       "thread pool I/O backend.");
+            }
+        }
+        if (!uring_backend.has()) {
+            pool_backend.init(new pool_diskmgr_t(
+                queue, backend_stats.producer, max_concurrent_io_requests));
+            pool_backend->done_fun = backend_done_fun;
+        }
+#else
+        if (io_backend == file_io_backend_t::io_uring_desired) {
+            logWRN("io_uring is not available on this platform.  Falling back to the "
+                   "thread pool I/O backend.");
+        }
+        pool_backend.init(new pool_diskmgr_t(
+            queue, backend_stats.producer, max_concurrent_io_requests));
+        pool_backend->done_fun = backend_done_fun;
+#endif
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
@@ -70,7 +100,6 @@ public:
                                                  &accounter, ph::_1);
 
         /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, ph::_1);
         accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
                                        &conflict_resolver, ph::_1);
@@ -84,6 +113,14 @@ public:
                 outstanding_txn);
     }
 
+    bool uses_io_uring() const {
+#if USE_IO_URING
+        return uring_backend.has();
+#else
+        return false;
+#endif
+    }
+
     void *create_account(int pri, int outstanding_requests_limit) {
         return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
     }
@@ -196,7 +233,12 @@ private:
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    /* Exactly one of these is set, depending on the `file_io_backend_t` that was
+    requested and on whether the kernel supports io_uring. */
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+#if USE_IO_URING
+    scoped_ptr_t<uring_diskmgr_t> uring_backend;
+#endif
 
 
     intptr_t outstanding_txn;
@@ -205,17 +247,21 @@ private:
 };
 
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               file_io_backend_t io_backend)
     : direct_io_mode(_direct_io_mode),
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       io_backend,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
 
 file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct_io_mode; }
 
+bool io_backender_t::uses_io_uring() const { return diskmgr->uses_io_uring(); }
+
 
 /* Disk file object */
 
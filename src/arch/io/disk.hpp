@@ -29,10 +29,14 @@ public:
     // stops us from specifying this on a file-by-file basis, but right now there's no desire for
     // that.  See https://github.com/rethinkdb/rethinkdb/issues/97#issuecomment-19778177 .
     io_backender_t(file_direct_io_mode_t direct_io_mode,
-                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS);
+                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                   file_io_backend_t io_backend = file_io_backend_t::pool);
     ~io_backender_t();
     linux_disk_manager_t *get_diskmgr_ptr() { return diskmgr.get(); }
     file_direct_io_mode_t get_direct_io_mode() const;
+    // Whether I/O goes through io_uring, which it only does if `io_uring_desired` was
+    // passed to the constructor and the kernel supports it.
+    bool uses_io_uring() const;
 
 protected:
     const file_direct_io_mode_t direct_io_mode;
@@ -0,0 +1,296 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "logger.hpp"
+
+// The kernel refuses rings with more than 32768 entries, and we don't want to pin
+// that much memory anyway.  Deeper queues just wait for a free slot.
+const unsigned int MAX_URING_ENTRIES = 4096;
+
+// How many blocker threads to use for operations that can't go through the ring.
+// These are rare (resizes, the occasional short read or write), so keep it small.
+const int URING_FALLBACK_THREADS = 2;
+
+// How long to wait before trying again to submit when the kernel is out of
+// resources and there's nothing in flight whose completion would get us back.
+const int64_t URING_RETRY_INTERVAL_MS = 1;
+
+static int sys_io_uring_setup(unsigned int entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(fd_t ring_fd, unsigned int to_submit,
+                              unsigned int min_complete, unsigned int flags) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                   nullptr, 0);
+}
+
+static int sys_io_uring_register(fd_t ring_fd, unsigned int opcode, const void *arg,
+                                 unsigned int nr_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static void *map_ring(fd_t ring_fd, size_t size, off_t offset) {
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    guarantee_err(ptr != MAP_FAILED, "Could not map io_uring memory");
+    return ptr;
+}
+
+static unsigned int *ring_field(void *ring_ptr, uint32_t offset) {
+    return reinterpret_cast<unsigned int *>(static_cast<char *>(ring_ptr) + offset);
+}
+
+struct uring_diskmgr_t::fallback_job_t : public blocker_pool_t::job_t {
+    fallback_job_t(uring_diskmgr_t *_parent, action_t *_action)
+        : parent(_parent), action(_action) { }
+
+    void run() {
+        action->run();
+    }
+
+    void done() {
+        uring_diskmgr_t *p = parent;
+        action_t *a = action;
+        delete this;
+        p->finish(a);
+    }
+
+    uring_diskmgr_t *parent;
+    action_t *action;
+};
+
+bool uring_diskmgr_t::is_supported() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = sys_io_uring_setup(1, &params);
+    if (fd < 0) {
+        return false;
+    }
+    int res = close(fd);
+    guarantee_err(res == 0, "Could not close io_uring file descriptor");
+    return true;
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source,
+                                 int max_concurrent_io_requests)
+    : queue(_queue),
+      source(_source),
+      queue_depth(blocker_pool_queue_depth(max_concurrent_io_requests)),
+      n_pending(0),
+      n_in_ring(0),
+      n_prepared(0),
+      retry_timer(nullptr),
+      fallback_pool(URING_FALLBACK_THREADS, _queue) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    unsigned int entries = std::min<unsigned int>(queue_depth, MAX_URING_ENTRIES);
+    ring_fd = sys_io_uring_setup(entries, &params);
+    guarantee_err(ring_fd >= 0, "Could not set up io_uring");
+    sq_entries = params.sq_entries;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        cq_ring_size = sq_ring_size;
+    }
+    sq_ring_ptr = map_ring(ring_fd, sq_ring_size, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ptr = sq_ring_ptr;
+    } else {
+        cq_ring_ptr = map_ring(ring_fd, cq_ring_size, IORING_OFF_CQ_RING);
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(map_ring(ring_fd, sqes_size, IORING_OFF_SQES));
+
+    sq_head = ring_field(sq_ring_ptr, params.sq_off.head);
+    sq_tail = ring_field(sq_ring_ptr, params.sq_off.tail);
+    sq_ring_mask = ring_field(sq_ring_ptr, params.sq_off.ring_mask);
+    sq_array = ring_field(sq_ring_ptr, params.sq_off.array);
+
+    cq_head = ring_field(cq_ring_ptr, params.cq_off.head);
+    cq_tail = ring_field(cq_ring_ptr, params.cq_off.tail);
+    cq_ring_mask = ring_field(cq_ring_ptr, params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(
+        static_cast<char *>(cq_ring_ptr) + params.cq_off.cqes);
+
+    int notify_fd = completion_event.get_notify_fd();
+    int res = sys_io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &notify_fd, 1);
+    guarantee_err(res == 0, "Could not register eventfd with io_uring");
+    queue->watch_event(&completion_event, this);
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    assert_thread();
+    rassert(n_pending == 0);
+    if (retry_timer != nullptr) {
+        cancel_timer(retry_timer);
+    }
+    source->available->unset_callback();
+    queue->forget_event(&completion_event, this);
+
+    int res = munmap(sqes, sqes_size);
+    guarantee_err(res == 0, "Could not unmap io_uring memory");
+    if (cq_ring_ptr != sq_ring_ptr) {
+        res = munmap(cq_ring_ptr, cq_ring_size);
+        guarantee_err(res == 0, "Could not unmap io_uring memory");
+    }
+    res = munmap(sq_ring_ptr, sq_ring_size);
+    guarantee_err(res == 0, "Could not unmap io_uring memory");
+    res = close(ring_fd);
+    guarantee_err(res == 0, "Could not close io_uring file descriptor");
+}
+
+void uring_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+void uring_diskmgr_t::pump() {
+    assert_thread();
+    while (source->available->get() && n_pending < queue_depth
+           && n_in_ring < sq_entries) {
+        action_t *a = source->pop();
+        n_pending++;
+        if (!prepare_sqe(a)) {
+            run_in_fallback(a);
+        }
+    }
+    submit_prepared();
+}
+
+bool uring_diskmgr_t::prepare_sqe(action_t *a) {
+    if (a->wrap_in_datasyncs || a->get_is_resize()) {
+        return false;
+    }
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+    if (vecs_len > IOV_MAX) {
+        return false;
+    }
+
+    unsigned int tail = *sq_tail;
+    unsigned int index = tail & *sq_ring_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = a->get_is_read() ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = a->get_fd();
+    sqe->off = a->get_offset();
+    sqe->addr = reinterpret_cast<uint64_t>(vecs);
+    sqe->len = vecs_len;
+    sqe->user_data = reinterpret_cast<uint64_t>(a);
+    sq_array[index] = index;
+
+    // The kernel must see the entry's contents before it sees the new tail.
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++n_in_ring;
+    ++n_prepared;
+    return true;
+}
+
+void uring_diskmgr_t::submit_prepared() {
+    if (retry_timer != nullptr) {
+        // `on_timer()` will try again.
+        return;
+    }
+    while (n_prepared > 0) {
+        int res = sys_io_uring_enter(ring_fd, n_prepared, 0, 0);
+        if (res >= 0) {
+            n_prepared -= res;
+        } else if (get_errno() == EINTR) {
+            continue;
+        } else if (get_errno() == EAGAIN || get_errno() == EBUSY) {
+            // The kernel is out of resources for now.  If there's something in
+            // flight, its completion will get us back here.  Otherwise we try
+            // again a little later, rather than spinning on the event loop's
+            // thread.
+            if (n_in_ring <= n_prepared) {
+                retry_timer = fire_timer_once(URING_RETRY_INTERVAL_MS, this);
+            }
+            return;
+        } else {
+            crash("io_uring_enter failed: %s", errno_string(get_errno()).c_str());
+        }
+    }
+}
+
+void uring_diskmgr_t::on_event(DEBUG_VAR int events) {
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+    reap_completions();
+}
+
+void uring_diskmgr_t::on_timer() {
+    assert_thread();
+    // The timer token deletes itself after firing once.
+    retry_timer = nullptr;
+    submit_prepared();
+}
+
+void uring_diskmgr_t::reap_completions() {
+    assert_thread();
+    std::vector<action_t *> completed;
+
+    unsigned int head = *cq_head;
+    unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const io_uring_cqe *cqe = &cqes[head & *cq_ring_mask];
+        action_t *a = reinterpret_cast<action_t *>(cqe->user_data);
+        int64_t res = cqe->res;
+        ++head;
+        --n_in_ring;
+
+        if (res == static_cast<int64_t>(a->get_count())
+            || (res < 0 && res != -EAGAIN && res != -EINTR)) {
+            a->io_result = res;
+            completed.push_back(a);
+        } else {
+            // A short read or write, or a transient failure.  Let the blocker pool
+            // redo the whole operation, so that end-of-file and out-of-space
+            // conditions get reported the same way as with `pool_diskmgr_t`.
+            run_in_fallback(a);
+        }
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+    for (action_t *a : completed) {
+        finish(a);
+    }
+    // Make sure that anything left behind by `EAGAIN` gets submitted.
+    submit_prepared();
+}
+
+void uring_diskmgr_t::run_in_fallback(action_t *a) {
+    fallback_pool.do_job(new fallback_job_t(this, a));
+}
+
+void uring_diskmgr_t::finish(action_t *a) {
+    assert_thread();
+    n_pending--;
+    pump();
+    done_fun(a);
+}
+
+#endif  // USE_IO_URING
@@ -0,0 +1,116 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <functional>
+
+#include "arch/io/disk/pool.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/system_event.hpp"
+#include "arch/timer.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+
+#if defined(__linux__) && !defined(LEGACY_LINUX) && !defined(NO_IO_URING)
+#define USE_IO_URING 1
+#else
+#define USE_IO_URING 0
+#endif
+
+#if USE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* The io_uring disk manager submits reads and writes to the kernel through an
+io_uring owned by the disk manager's home thread.  Submissions are batched: every
+call to `pump()` fills as many submission queue entries as it can and hands them
+to the kernel with a single `io_uring_enter()`.  Completions are signalled through
+an eventfd that is registered with the thread's event queue, so they are reaped
+from the same event loop that drives everything else on the thread.
+
+It operates on the same action type as `pool_diskmgr_t`, so it can be dropped in
+below the rest of the IO stack.  Operations that io_uring can't express (file
+resizes, writes wrapped in datasyncs) or that come back short are handed to a small
+blocker pool that runs them the same way `pool_diskmgr_t` would. */
+
+class uring_diskmgr_t
+    : private availability_callback_t,
+      private linux_event_callback_t,
+      private timer_callback_t,
+      public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    /* Returns true if the running kernel lets us set up an io_uring.  It might not
+    if it's too old or if io_uring has been disabled (for example by a seccomp
+    filter in a container). */
+    static bool is_supported();
+
+    /* Like `pool_diskmgr_t`, the `uring_diskmgr_t` draws actions from `source` and
+    calls `done_fun` on each one when it's done. */
+    uring_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                    int max_concurrent_io_requests);
+    std::function<void(action_t *)> done_fun;
+    ~uring_diskmgr_t();
+
+private:
+    struct fallback_job_t;
+
+    void on_source_availability_changed();
+    void on_event(int events);
+    void on_timer();
+
+    void pump();
+    bool prepare_sqe(action_t *a);
+    void submit_prepared();
+    void reap_completions();
+    void run_in_fallback(action_t *a);
+    void finish(action_t *a);
+
+    linux_event_queue_t *const queue;
+    passive_producer_t<action_t *> *const source;
+
+    // Upper bound on the number of operations we have in flight at once, both in
+    // the ring and in the fallback pool.
+    const int queue_depth;
+    int n_pending;
+
+    // Number of operations that are currently owned by the kernel through the
+    // ring.  Never exceeds `sq_entries`, so the completion queue (which is twice
+    // the size of the submission queue) can't overflow.
+    unsigned int n_in_ring;
+    unsigned int n_prepared;
+
+    fd_t ring_fd;
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_ring_mask;
+    unsigned int sq_entries;
+    unsigned int *sq_array;
+
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_ring_mask;
+    io_uring_cqe *cqes;
+
+    // Set while we wait for the kernel to free the resources that a submission
+    // failed on with `EAGAIN` or `EBUSY`, if nothing that's in flight will wake us
+    // up when it completes.
+    timer_token_t *retry_timer;
+
+    system_event_t completion_event;
+    blocker_pool_t fallback_pool;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+#endif  // USE_IO_URING
+
+#endif  // ARCH_IO_DISK_URING_HPP_
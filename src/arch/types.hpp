@@ -105,6 +105,13 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// Which mechanism the disk manager uses to hand reads and writes to the OS.
+// `io_uring_desired` falls back to `pool` if the kernel doesn't support io_uring.
+enum class file_io_backend_t {
+    pool,
+    io_uring_desired
+};
+
 // A linux file.  It expects reads and writes and buffers to have an
 // alignment of DEVICE_BLOCK_SIZE.
 class file_t {
@@ -18,7 +18,6 @@ scoped_key_value_t::scoped_key_value_t(scoped_key_value_t &&movee)
     : key_(movee.key_),
       value_(movee.value_),
       buf_(std::move(movee.buf_)) {
-    movee.key_ = nullptr;
     movee.value_ = nullptr;
 }
 
@@ -117,14 +116,16 @@ void get_child_key_range(
         that the traversal is interested in */
         const btree_key_t *parent_left_excl_or_null,
         const btree_key_t *parent_right_incl,
+        /* The child's bounds might be copied out of `inode` into these */
+        store_key_t *left_excl_buf,
+        store_key_t *right_incl_buf,
         const btree_key_t **left_excl_or_null_out,
         const btree_key_t **right_incl_out) {
-    const btree_internal_pair *pair =
-        internal_node::get_pair_by_index(inode, child_index);
     if (child_index != inode->npairs - 1) {
         rassert(child_index < inode->npairs - 1);
-        if (btree_key_cmp(&pair->key, parent_right_incl) < 0) {
-            *right_incl_out = &pair->key;
+        *right_incl_buf = internal_node::get_key_by_index(inode, child_index);
+        if (btree_key_cmp(right_incl_buf->btree_key(), parent_right_incl) < 0) {
+            *right_incl_out = right_incl_buf->btree_key();
         } else {
             *right_incl_out = parent_right_incl;
         }
@@ -133,11 +134,11 @@ void get_child_key_range(
     }
 
     if (child_index > 0) {
-        const btree_internal_pair *left_neighbor =
-            internal_node::get_pair_by_index(inode, child_index - 1);
+        *left_excl_buf = internal_node::get_key_by_index(inode, child_index - 1);
         if (parent_left_excl_or_null == nullptr ||
-                btree_key_cmp(&left_neighbor->key, parent_left_excl_or_null) > 0) {
-            *left_excl_or_null_out = &left_neighbor->key;
+                btree_key_cmp(left_excl_buf->btree_key(),
+                              parent_left_excl_or_null) > 0) {
+            *left_excl_or_null_out = left_excl_buf->btree_key();
         } else {
             *left_excl_or_null_out = parent_left_excl_or_null;
         }
@@ -186,10 +187,12 @@ continue_bool_t btree_depth_first_traversal(
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
 
             // Get the child key range
+            store_key_t child_left_excl_buf, child_right_incl_buf;
             const btree_key_t *child_left_excl_or_null;
             const btree_key_t *child_right_incl;
             get_child_key_range(inode, true_index,
                                 left_excl_or_null, right_incl,
+                                &child_left_excl_buf, &child_right_incl_buf,
                                 &child_left_excl_or_null, &child_right_incl);
 
             if (continue_bool_t::ABORT == cb->filter_range(
@@ -37,7 +37,7 @@ public:
 
     const btree_key_t *key() const {
         guarantee(buf_.has());
-        return key_;
+        return key_.btree_key();
     }
     const void *value() const {
         guarantee(buf_.has());
@@ -50,7 +50,8 @@ public:
     void reset();
 
 private:
-    const btree_key_t *key_;
+    // Leaf nodes don't store keys in full, so we keep our own copy.
+    store_key_t key_;
     const void *value_;
     movable_t<counted_buf_lock_and_read_t> buf_;
 
@@ -49,8 +49,7 @@ public:
          * doesn't actually have a key and we're looking for the split points.
          * */
         for (int i = 0; i < (node->npairs - 1); i++) {
-            const btree_internal_pair *pair = internal_node::get_pair_by_index(node, i);
-            keys->push_back(store_key_t(pair->key.size, pair->key.contents));
+            keys->push_back(internal_node::get_key_by_index(node, i));
         }
     }
 
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <string>
 
 #include "btree/node.hpp"
 #include "containers/unaligned.hpp"
@@ -26,20 +27,98 @@ static_assert(offsetof(internal_node_t, pair_offsets) % 2 == 0,
 
 namespace internal_node {
 
-class ibuf_t;
-
 // We can't use "internal" for internal stuff obviously.
 namespace impl {
+
+//Note: This struct is stored directly on disk.  Changing it invalidates old data.
+ATTR_PACKED(struct key_prefix_t {
+    uint16_t begin;
+    uint16_t end;
+    uint8_t size;
+    uint8_t contents[];
+});
+
+/* A node's pairs with their keys spelled out in full.  Every operation that
+changes a node builds one of these, changes it and writes it back out with
+`encode()`, which picks the key prefix anew.  The key of the last pair of a range
+that gets encoded is ignored, because that pair becomes the special pair. */
+class pair_list_t {
+public:
+    void append(block_id_t lnode, const uint8_t *prefix, int prefix_size,
+                const uint8_t *rest, int rest_size) {
+        entry_t entry;
+        entry.lnode = lnode;
+        entry.key_offset = key_bytes.size();
+        entry.key_size = prefix_size + rest_size;
+        key_bytes.append(reinterpret_cast<const char *>(prefix), prefix_size);
+        key_bytes.append(reinterpret_cast<const char *>(rest), rest_size);
+        entries.push_back(entry);
+    }
+    void append(block_id_t lnode, const btree_key_t *key) {
+        append(lnode, nullptr, 0, key->contents, key->size);
+    }
+    void append_node(const internal_node_t *node);
+
+    void insert(size_t index, block_id_t lnode, const btree_key_t *key) {
+        append(lnode, key);
+        std::rotate(entries.begin() + index, entries.end() - 1, entries.end());
+    }
+    void erase(size_t index) {
+        entries.erase(entries.begin() + index);
+    }
+    void set_key(size_t index, const btree_key_t *key) {
+        entries[index].key_offset = key_bytes.size();
+        entries[index].key_size = key->size;
+        key_bytes.append(reinterpret_cast<const char *>(key->contents), key->size);
+    }
+
+    size_t size() const { return entries.size(); }
+    block_id_t lnode(size_t index) const { return entries[index].lnode; }
+    void set_lnode(size_t index, block_id_t lnode) { entries[index].lnode = lnode; }
+    const uint8_t *key(size_t index) const {
+        return reinterpret_cast<const uint8_t *>(key_bytes.data())
+            + entries[index].key_offset;
+    }
+    int key_size(size_t index) const { return entries[index].key_size; }
+    store_key_t store_key(size_t index) const {
+        return store_key_t(key_size(index), key(index));
+    }
+    bool key_starts_with(size_t index, const std::string &prefix) const {
+        return static_cast<size_t>(key_size(index)) >= prefix.size()
+            && memcmp(key(index), prefix.data(), prefix.size()) == 0;
+    }
+
+private:
+    struct entry_t {
+        block_id_t lnode;
+        size_t key_offset;
+        int key_size;
+    };
+    std::vector<entry_t> entries;
+    std::string key_bytes;
+};
+
 size_t pair_size_with_key(const btree_key_t *key);
 size_t pair_size_with_key_size(uint8_t size);
 
-void delete_pair(internal_node_t *node, uint16_t offset);
-uint16_t insert_pair(internal_node_t *node, const btree_internal_pair *pair);
-uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t *key);
-void delete_offset(internal_node_t *node, int index);
-void insert_offset(internal_node_t *node, uint16_t offset, int index);
-void make_last_pair_special(internal_node_t *node);
-bool is_equal(const btree_key_t *key1, const btree_key_t *key2);
+bool has_key_prefix(const internal_node_t *node);
+const key_prefix_t *get_key_prefix(const internal_node_t *node);
+bool is_prefixed(const internal_node_t *node, int index);
+size_t free_space_begin(const internal_node_t *node);
+size_t used_size(block_size_t block_size, const internal_node_t *node);
+
+std::string node_prefix(const internal_node_t *node);
+void find_prefixed_range(const pair_list_t &pairs, size_t begin, size_t end,
+                         const std::string &prefix,
+                         size_t *prefixed_begin_out, size_t *prefixed_end_out);
+size_t encoded_size(const pair_list_t &pairs, size_t begin, size_t end,
+                    const std::string &prefix);
+std::string choose_prefix(const pair_list_t &pairs, size_t begin, size_t end,
+                          const std::vector<std::string> &candidates);
+void encode(block_size_t block_size, const pair_list_t &pairs, size_t begin, size_t end,
+            const std::string &prefix, internal_node_t *node);
+void merged_pairs(const internal_node_t *node, const internal_node_t *rnode,
+                  const internal_node_t *parent, pair_list_t *pairs_out);
 }  // namespace impl
 
 void init(block_size_t block_size, internal_node_t *node) {
@@ -48,51 +127,50 @@ void init(block_size_t block_size, internal_node_t *node) {
     node->frontmost_offset = block_size.value();
 }
 
-void init(block_size_t block_size, internal_node_t *node, const internal_node_t *lnode, const uint16_t *offsets, int numpairs) {
-    init(block_size, node);
-    rassert(get_pair_by_index(lnode, lnode->npairs-1)->key.size == 0);
-    for (int i = 0; i < numpairs; i++) {
-        node->pair_offsets[i] = impl::insert_pair(node, get_pair(lnode, offsets[i]));
-    }
-    node->npairs = numpairs;
-    std::sort(node->pair_offsets, node->pair_offsets+node->npairs-1, internal_key_comp(node));
-    rassert(get_pair_by_index(node, node->npairs-1)->key.size == 0);
-}
-
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key) {
     int index = get_offset_index(node, key);
     return get_pair_by_index(node, index)->lnode;
 }
 
-bool insert(internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode) {
+bool insert(block_size_t block_size, internal_node_t *node, const btree_key_t *key,
+            block_id_t lnode, block_id_t rnode) {
     rassert(key->size <= MAX_KEY_SIZE, "key too large");
     if (is_full(node)) return false;
-    if (node->npairs == 0) {
+
+    impl::pair_list_t pairs;
+    pairs.append_node(node);
+    if (pairs.size() == 0) {
         btree_key_t special;
         special.size = 0;
-
-        const uint16_t special_offset = impl::insert_pair(node, rnode, &special);
-        impl::insert_offset(node, special_offset, 0);
+        pairs.append(rnode, &special);
     }
 
     int index = get_offset_index(node, key);
-    rassert(!impl::is_equal(&get_pair_by_index(node, index)->key, key),
+    rassert(index == static_cast<int>(pairs.size()) - 1
+            || sized_strcmp(pairs.key(index), pairs.key_size(index),
+                            key->contents, key->size) != 0,
         "tried to insert duplicate key into internal node!");
-    const uint16_t offset = impl::insert_pair(node, lnode, key);
-    impl::insert_offset(node, offset, index);
-
-    get_pair_by_index(node, index + 1)->lnode = rnode;
+    pairs.insert(index, lnode, key);
+    pairs.set_lnode(index + 1, rnode);
+
+    // The pairs fit with the old prefix, because the new key either starts with it
+    // or gets stored in full, so `is_full()` has left enough room either way.
+    impl::encode(block_size, pairs, 0, pairs.size(),
+                 impl::choose_prefix(pairs, 0, pairs.size(), {impl::node_prefix(node)}),
+                 node);
     return true;
 }
 
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key) {
     int index = get_offset_index(node, key);
-    impl::delete_pair(node, node->pair_offsets[index]);
-    impl::delete_offset(node, index);
+    impl::pair_list_t pairs;
+    pairs.append_node(node);
+    // If we remove the special pair, the pair before it becomes the special pair.
+    pairs.erase(index);
 
-    if (index == node->npairs) {
-        impl::make_last_pair_special(node);
-    }
+    impl::encode(block_size, pairs, 0, pairs.size(),
+                 impl::choose_prefix(pairs, 0, pairs.size(), {impl::node_prefix(node)}),
+                 node);
 
     validate(block_size, node);
     return true;
@@ -108,22 +186,20 @@ void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnod
     }
     int median_index = index;
 
-    // Equality takes the left branch, so the median should be from this node.
-    const btree_key_t *median_key = &get_pair_by_index(node, median_index-1)->key;
-    keycpy(median, median_key);
-
-    init(block_size, rnode, node, node->pair_offsets + median_index, node->npairs - median_index);
+    impl::pair_list_t pairs;
+    pairs.append_node(node);
 
-    // TODO: This is really slow because most pairs will likely be copied
-    // repeatedly.  There should be a better way.
-    for (index = median_index; index < node->npairs; index++) {
-        impl::delete_pair(node, node->pair_offsets[index]);
-    }
+    // Equality takes the left branch, so the median should be from this node.
+    keycpy(median, pairs.store_key(median_index - 1).btree_key());
 
-    const uint16_t new_npairs = median_index;
-    node->npairs = new_npairs;
-    //make last pair special
-    impl::make_last_pair_special(node);
+    // Both halves fit with the old prefix, because they hold fewer pairs.
+    const std::string old_prefix = impl::node_prefix(node);
+    impl::encode(block_size, pairs, median_index, pairs.size(),
+                 impl::choose_prefix(pairs, median_index, pairs.size(), {old_prefix}),
+                 rnode);
+    impl::encode(block_size, pairs, 0, median_index,
+                 impl::choose_prefix(pairs, 0, median_index, {old_prefix}),
+                 node);
 
     validate(block_size, node);
     validate(block_size, rnode);
@@ -132,24 +208,14 @@ void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnod
 void merge(block_size_t block_size, const internal_node_t *node, internal_node_t *rnode, const internal_node_t *parent) {
     validate(block_size, node);
     validate(block_size, rnode);
-    // get the key in parent which points to node
-    const btree_key_t *key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(node, 0)->key))->key;
 
-    guarantee(sizeof(internal_node_t) + (node->npairs + rnode->npairs)*sizeof(*node->pair_offsets) +
-        (block_size.value() - node->frontmost_offset) + (block_size.value() - rnode->frontmost_offset) + key_from_parent->size < block_size.value(),
+    impl::pair_list_t pairs;
+    impl::merged_pairs(node, rnode, parent, &pairs);
+    const std::string prefix = impl::choose_prefix(
+        pairs, 0, pairs.size(), {impl::node_prefix(node), impl::node_prefix(rnode)});
+    guarantee(impl::encoded_size(pairs, 0, pairs.size(), prefix) < block_size.value(),
         "internal nodes too full to merge");
-
-    memmove(rnode->pair_offsets + node->npairs, rnode->pair_offsets, rnode->npairs * sizeof(*rnode->pair_offsets));
-
-    for (int i = 0; i < node->npairs-1; i++) { // the last pair is special
-        const uint16_t new_offset = impl::insert_pair(rnode, get_pair_by_index(node, i));
-        rnode->pair_offsets[i] = new_offset;
-    }
-    const uint16_t new_offset = impl::insert_pair(rnode, get_pair_by_index(node, node->npairs-1)->lnode, key_from_parent);
-    rnode->pair_offsets[node->npairs - 1] = new_offset;
-
-    const uint16_t new_npairs = rnode->npairs + node->npairs;
-    rnode->npairs = new_npairs;
+    impl::encode(block_size, pairs, 0, pairs.size(), prefix, rnode);
 
     validate(block_size, rnode);
 }
@@ -160,95 +226,81 @@ bool level(block_size_t block_size, internal_node_t *node,
            std::vector<block_id_t> *moved_children_out) {
     validate(block_size, node);
     validate(block_size, sibling);
-    if (moved_children_out != nullptr) {
-        moved_children_out->reserve(sibling->npairs);
-    }
 
-    if (nodecmp(node, sibling) < 0) {
-        const btree_key_t *key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(node, 0)->key))->key;
-        if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(key_from_parent) >= node->frontmost_offset)
-            return false;
-        uint16_t special_pair_offset = node->pair_offsets[node->npairs-1];
-        block_id_t last_offset = get_pair(node, special_pair_offset)->lnode;
-        uint16_t new_pair_offset = impl::insert_pair(node, last_offset, key_from_parent);
-        node->pair_offsets[node->npairs - 1] = new_pair_offset;
-
-        uint16_t new_npairs = node->npairs;
-        // This loop involves repeated memmoves (resulting in ~(n^2) work where n is
-        // the block size).  There should be a way to drastically reduce the number
-        // and increase efficiency.
-        for (;;) {
-            const btree_internal_pair *pair_to_move = get_pair_by_index(sibling, 0);
-            uint16_t size_change = sizeof(*node->pair_offsets) + pair_size(pair_to_move);
-            if (new_npairs * sizeof(*node->pair_offsets) + (block_size.value() - node->frontmost_offset) + size_change >= sibling->npairs * sizeof(*sibling->pair_offsets) + (block_size.value() - sibling->frontmost_offset) - size_change) {
-                break;
-            }
-
-            const uint16_t new_offset = impl::insert_pair(node, pair_to_move);
-            node->pair_offsets[new_npairs] = new_offset;
-            ++new_npairs;
-            if (moved_children_out != nullptr) {
-                moved_children_out->push_back(pair_to_move->lnode);
-            }
-
-            impl::delete_pair(sibling, sibling->pair_offsets[0]);
-            impl::delete_offset(sibling, 0);
+    // We line up the pairs of both nodes, with the key from the parent in between,
+    // and then move the boundary between the nodes until they are about the same
+    // size.  The key at the new boundary replaces the key from the parent.
+    const bool node_is_left = nodecmp(node, sibling) < 0;
+    const internal_node_t *left = node_is_left ? node : sibling;
+    const internal_node_t *right = node_is_left ? sibling : node;
+    const std::vector<std::string> old_prefixes
+        = {impl::node_prefix(left), impl::node_prefix(right)};
+    impl::pair_list_t pairs;
+    impl::merged_pairs(left, right, parent, &pairs);
+    const size_t npairs = pairs.size();
+    const size_t old_boundary = left->npairs;
+
+    // We balance the sizes the nodes would have with a common prefix.  They can't
+    // get any bigger when we pick their prefixes for real below, since that
+    // prefix is one of the candidates.
+    const std::string prefix = impl::choose_prefix(pairs, 0, npairs, old_prefixes);
+    std::vector<size_t> cumulative_size(npairs + 1, 0);
+    for (size_t i = 0; i < npairs; ++i) {
+        int key_size = pairs.key_size(i);
+        if (!prefix.empty() && pairs.key_starts_with(i, prefix)) {
+            key_size -= prefix.size();
         }
-
-        const btree_internal_pair *pair_for_parent = get_pair_by_index(sibling, 0);
-
-        node->pair_offsets[new_npairs] = special_pair_offset;
-        ++new_npairs;
-
-        node->npairs = new_npairs;
-
-        btree_internal_pair *special_pair = get_pair(node, special_pair_offset);
-        special_pair->lnode = pair_for_parent->lnode;
-
-        keycpy(replacement_key, &pair_for_parent->key);
-
-        if (moved_children_out != nullptr) {
-            moved_children_out->push_back(pair_for_parent->lnode);
+        cumulative_size[i + 1] = cumulative_size[i] + sizeof(*node->pair_offsets)
+            + impl::pair_size_with_key_size(key_size);
+    }
+    // Ignores the headers, which are the same for both nodes, and the special
+    // pairs' keys, which are so small that we don't care.
+    auto left_size = [&](size_t boundary) { return cumulative_size[boundary]; };
+    auto right_size = [&](size_t boundary) {
+        return cumulative_size[npairs] - cumulative_size[boundary];
+    };
+
+    size_t boundary;
+    if (node_is_left) {
+        boundary = old_boundary + 1;
+        while (boundary + 1 < npairs
+               && left_size(boundary + 1) < right_size(boundary + 1)) {
+            ++boundary;
         }
-        impl::delete_pair(sibling, sibling->pair_offsets[0]);
-        impl::delete_offset(sibling, 0);
     } else {
-        uint16_t offset;
-        const btree_key_t *key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(sibling, 0)->key))->key;
-        if (sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(key_from_parent) >= node->frontmost_offset)
-            return false;
-        block_id_t first_child = get_pair_by_index(sibling, sibling->npairs-1)->lnode;
-        offset = impl::insert_pair(node, first_child, key_from_parent);
-        impl::insert_offset(node, offset, 0);
-        if (moved_children_out != nullptr) {
-            moved_children_out->push_back(first_child);
+        boundary = old_boundary - 1;
+        while (boundary > 2 && right_size(boundary - 1) < left_size(boundary - 1)) {
+            --boundary;
         }
-        impl::delete_pair(sibling, sibling->pair_offsets[sibling->npairs-1]);
-        impl::delete_offset(sibling, sibling->npairs-1);
-
-        // This loop involves repeated memmoves. There should be a way to
-        // drastically reduce the number and increase efficiency.
-        for (;;) {
-            const btree_internal_pair *pair_to_move = get_pair_by_index(sibling, sibling->npairs-1);
-            uint16_t size_change = sizeof(*node->pair_offsets) + pair_size(pair_to_move);
-            if (node->npairs * sizeof(*node->pair_offsets) + (block_size.value() - node->frontmost_offset) + size_change >= sibling->npairs * sizeof(*sibling->pair_offsets) + (block_size.value() - sibling->frontmost_offset) - size_change) {
-                break;
-            }
-
-            offset = impl::insert_pair(node, pair_to_move);
-            impl::insert_offset(node, offset, 0);
-            if (moved_children_out != nullptr) {
-                moved_children_out->push_back(pair_to_move->lnode);
-            }
+    }
+    rassert(boundary > 0 && boundary < npairs);
+
+    const std::string left_prefix = impl::choose_prefix(pairs, 0, boundary,
+        {prefix, old_prefixes[0], old_prefixes[1]});
+    const std::string right_prefix = impl::choose_prefix(pairs, boundary, npairs,
+        {prefix, old_prefixes[0], old_prefixes[1]});
+    const size_t new_left_size = impl::encoded_size(pairs, 0, boundary, left_prefix);
+    const size_t new_right_size
+        = impl::encoded_size(pairs, boundary, npairs, right_prefix);
+    const size_t new_node_size = node_is_left ? new_left_size : new_right_size;
+    if (new_left_size > block_size.value() || new_right_size > block_size.value()
+        || new_node_size + MAX_KEY_SIZE >= block_size.value()) {
+        return false;
+    }
 
-            impl::delete_pair(sibling, sibling->pair_offsets[sibling->npairs-1]);
-            impl::delete_offset(sibling, sibling->npairs-1);
+    if (moved_children_out != nullptr) {
+        size_t moved_begin = std::min(boundary, old_boundary);
+        size_t moved_end = std::max(boundary, old_boundary);
+        for (size_t i = moved_begin; i < moved_end; ++i) {
+            moved_children_out->push_back(pairs.lnode(i));
         }
-
-        keycpy(replacement_key, &get_pair_by_index(sibling, sibling->npairs-1)->key);
-
-        impl::make_last_pair_special(sibling);
     }
+    keycpy(replacement_key, pairs.store_key(boundary - 1).btree_key());
+
+    impl::encode(block_size, pairs, 0, boundary, left_prefix,
+                 node_is_left ? node : sibling);
+    impl::encode(block_size, pairs, boundary, npairs, right_prefix,
+                 node_is_left ? sibling : node);
 
     validate(block_size, node);
     validate(block_size, sibling);
@@ -262,11 +314,11 @@ int sibling(const internal_node_t *node, const btree_key_t *key, block_id_t *sib
     int cmp;
     if (index > 0) {
         sib_pair = get_pair_by_index(node, index-1);
-        key_in_middle_out->assign(&sib_pair->key);
+        *key_in_middle_out = get_key_by_index(node, index - 1);
         cmp = 1;
     } else {
         sib_pair = get_pair_by_index(node, index+1);
-        key_in_middle_out->assign(&get_pair_by_index(node, index)->key);
+        *key_in_middle_out = get_key_by_index(node, index);
         cmp = -1;
     }
 
@@ -274,78 +326,74 @@ int sibling(const internal_node_t *node, const btree_key_t *key, block_id_t *sib
     return cmp; //equivalent to nodecmp(node, sibling)
 }
 
-
-/* `is_sorted()` returns true if the given range is sorted. */
-
-template <class ForwardIterator, class StrictWeakOrdering>
-bool is_sorted(ForwardIterator first, ForwardIterator last,
-                       StrictWeakOrdering comp) {
-    for (ForwardIterator it = first; it + 1 < last; it++) {
-        if (!comp(*it, *(it+1)))
-            return false;
-    }
-    return true;
-}
-
-void update_key(internal_node_t *node, const btree_key_t *key_to_replace, const btree_key_t *replacement_key) {
-
+void update_key(block_size_t block_size, internal_node_t *node,
+                const btree_key_t *key_to_replace, const btree_key_t *replacement_key) {
     const int index = get_offset_index(node, key_to_replace);
-    const block_id_t tmp_lnode = get_pair_by_index(node, index)->lnode;
-    impl::delete_pair(node, node->pair_offsets[index]);
+    impl::pair_list_t pairs;
+    pairs.append_node(node);
+    pairs.set_key(index, replacement_key);
 
-    guarantee(sizeof(internal_node_t) + (node->npairs) * sizeof(*node->pair_offsets) + impl::pair_size_with_key(replacement_key) < node->frontmost_offset,
+    const std::string prefix
+        = impl::choose_prefix(pairs, 0, pairs.size(), {impl::node_prefix(node)});
+    guarantee(impl::encoded_size(pairs, 0, pairs.size(), prefix) <= block_size.value(),
         "cannot fit updated key in internal node");
+    impl::encode(block_size, pairs, 0, pairs.size(), prefix, node);
 
-    const uint16_t new_offset = impl::insert_pair(node, tmp_lnode, replacement_key);
-    node->pair_offsets[index] = new_offset;
-
-    rassert(is_sorted(node->pair_offsets, node->pair_offsets+node->npairs-1, internal_key_comp(node)),
-            "Invalid key given to update_key: offsets no longer in sorted order");
-    rassert(get_pair_by_index(node, node->npairs-1)->key.size == 0);
+    validate(block_size, node);
 }
 
 bool is_full(const internal_node_t *node) {
-    return sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key_size(MAX_KEY_SIZE) >=  node->frontmost_offset;
+    return impl::free_space_begin(node) + sizeof(*node->pair_offsets)
+        + impl::pair_size_with_key_size(MAX_KEY_SIZE) >= node->frontmost_offset;
 }
 
 bool change_unsafe(const internal_node_t *node) {
-    return sizeof(internal_node_t) + node->npairs * sizeof(*node->pair_offsets) + MAX_KEY_SIZE >= node->frontmost_offset;
+    return impl::free_space_begin(node) + MAX_KEY_SIZE >= node->frontmost_offset;
 }
 
 void validate(DEBUG_VAR block_size_t block_size, DEBUG_VAR const internal_node_t *node) {
 #ifndef NDEBUG
-    rassert(reinterpret_cast<const char *>(&(node->pair_offsets[node->npairs])) <= reinterpret_cast<const char *>(get_pair(node, node->frontmost_offset)));
+    rassert(node::is_internal(reinterpret_cast<const node_t *>(node)));
+    rassert(impl::free_space_begin(node) <= node->frontmost_offset);
     rassert(node->frontmost_offset > 0);
     rassert(node->frontmost_offset <= block_size.value());
     for (int i = 0; i < node->npairs; i++) {
         rassert(node->pair_offsets[i] < block_size.value());
         rassert(node->pair_offsets[i] >= node->frontmost_offset);
     }
-    rassert(is_sorted(node->pair_offsets, node->pair_offsets+node->npairs-1, internal_key_comp(node)),
-        "Offsets no longer in sorted order");
+    if (impl::has_key_prefix(node)) {
+        const impl::key_prefix_t *prefix = impl::get_key_prefix(node);
+        rassert(prefix->begin < prefix->end);
+        rassert(prefix->end < node->npairs);
+        rassert(prefix->size > 0);
+    }
+    for (int i = 0; i + 2 < node->npairs; i++) {
+        rassert(get_key_by_index(node, i) < get_key_by_index(node, i + 1),
+            "Offsets no longer in sorted order");
+    }
     rassert(get_pair_by_index(node, node->npairs-1)->key.size == 0);
 #endif
 }
 
 bool is_underfull(block_size_t block_size, const internal_node_t *node) {
     return (sizeof(internal_node_t) + 1) / 2 +
-        node->npairs*sizeof(*node->pair_offsets) +
-        (block_size.value() - node->frontmost_offset) +
+        (impl::used_size(block_size, node) - sizeof(internal_node_t)) +
         /* EPSILON TODO this epsilon is too high lower it*/
         INTERNAL_EPSILON * 2  < block_size.value() / 2;
 }
 
 bool is_mergable(block_size_t block_size, const internal_node_t *node, const internal_node_t *sibling, const internal_node_t *parent) {
-    const btree_key_t *key_from_parent;
+    impl::pair_list_t pairs;
     if (nodecmp(node, sibling) < 0) {
-        key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(node, 0)->key))->key;
+        impl::merged_pairs(node, sibling, parent, &pairs);
     } else {
-        key_from_parent = &get_pair_by_index(parent, get_offset_index(parent, &get_pair_by_index(sibling, 0)->key))->key;
+        impl::merged_pairs(sibling, node, parent, &pairs);
     }
-    return sizeof(internal_node_t) +
-        (node->npairs + sibling->npairs + 1)*sizeof(*node->pair_offsets) +
-        (block_size.value() - node->frontmost_offset) +
-        (block_size.value() - sibling->frontmost_offset) + key_from_parent->size +
+    // `merge()` picks the prefix the same way.
+    const std::string prefix = impl::choose_prefix(
+        pairs, 0, pairs.size(), {impl::node_prefix(node), impl::node_prefix(sibling)});
+    return impl::encoded_size(pairs, 0, pairs.size(), prefix) +
+        sizeof(*node->pair_offsets) +
         impl::pair_size_with_key_size(MAX_KEY_SIZE) +
         INTERNAL_EPSILON < block_size.value(); // must still have enough room for an arbitrary key  // TODO: we can't be tighter?
 }
@@ -373,24 +421,80 @@ btree_internal_pair *get_pair_by_index(internal_node_t *node, int index) {
     return get_pair(node, node->pair_offsets[index]);
 }
 
+store_key_t get_key_by_index(const internal_node_t *node, int index) {
+    const btree_key_t *key = &get_pair_by_index(node, index)->key;
+    if (!impl::is_prefixed(node, index)) {
+        return store_key_t(key);
+    }
+    const impl::key_prefix_t *prefix = impl::get_key_prefix(node);
+    uint8_t buf[MAX_KEY_SIZE];
+    memcpy(buf, prefix->contents, prefix->size);
+    memcpy(buf + prefix->size, key->contents, key->size);
+    return store_key_t(prefix->size + key->size, buf);
+}
+
 int get_offset_index(const internal_node_t *node, const btree_key_t *key) {
-    return std::lower_bound(
-        node->pair_offsets, 
-        node->pair_offsets + node->npairs - 1, 
-        static_cast<uint16_t>(internal_key_comp::faux_offset), 
-        internal_key_comp(node, key)
-    ) - node->pair_offsets;
+    int beg = 0;
+    int end = node->npairs - 1;
+    const uint8_t *contents = key->contents;
+    int size = key->size;
+    if (impl::has_key_prefix(node)) {
+        // The keys that start with the prefix are all in [prefix->begin,
+        // prefix->end).  The keys before them are smaller than anything that starts
+        // with the prefix, and the keys after them are bigger.
+        const impl::key_prefix_t *prefix = impl::get_key_prefix(node);
+        if (size >= prefix->size
+            && memcmp(contents, prefix->contents, prefix->size) == 0) {
+            beg = prefix->begin;
+            end = prefix->end;
+            contents += prefix->size;
+            size -= prefix->size;
+        } else if (sized_strcmp(contents, size, prefix->contents, prefix->size) < 0) {
+            end = prefix->begin;
+        } else {
+            beg = prefix->end;
+        }
+    }
+
+    // Equivalent to a `std::lower_bound` on the keys, except that the head of
+    // `key` (or of its rest after the prefix) is computed once for all of the
+    // probes.
+    const uint64_t head = key_head(contents, size);
+    while (beg < end) {
+        int test_point = beg + (end - beg) / 2;
+        const btree_key_t *pair_key = &get_pair(node, node->pair_offsets[test_point])->key;
+        if (sized_strcmp_with_head(head, contents, size,
+                                   pair_key->contents, pair_key->size) > 0) {
+            beg = test_point + 1;
+        } else {
+            end = test_point;
+        }
+    }
+    return beg;
 }
 
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2) {
-    const btree_key_t *key1 = &get_pair_by_index(node1, 0)->key;
-    const btree_key_t *key2 = &get_pair_by_index(node2, 0)->key;
+    const store_key_t key1 = get_key_by_index(node1, 0);
+    const store_key_t key2 = get_key_by_index(node2, 0);
 
-    return btree_key_cmp(key1, key2);
+    return btree_key_cmp(key1.btree_key(), key2.btree_key());
 }
 
 namespace impl {
 
+void pair_list_t::append_node(const internal_node_t *node) {
+    const key_prefix_t *prefix = has_key_prefix(node) ? get_key_prefix(node) : nullptr;
+    for (int i = 0; i < node->npairs; ++i) {
+        const btree_internal_pair *pair = get_pair_by_index(node, i);
+        if (prefix != nullptr && i >= prefix->begin && i < prefix->end) {
+            append(pair->lnode, prefix->contents, prefix->size,
+                   pair->key.contents, pair->key.size);
+        } else {
+            append(pair->lnode, &pair->key);
+        }
+    }
+}
+
 size_t pair_size_with_key(const btree_key_t *key) {
     return pair_size_with_key_size(key->size);
 }
@@ -399,87 +503,196 @@ size_t pair_size_with_key_size(uint8_t size) {
     return offsetof(btree_internal_pair, key) + offsetof(btree_key_t, contents) + size;
 }
 
-void delete_pair(internal_node_t *node, uint16_t offset) {
-    btree_internal_pair *pair_to_delete = get_pair(node, offset);
-    btree_internal_pair *front_pair = get_pair(node, node->frontmost_offset);
-    const size_t shift = pair_size(pair_to_delete);
-    const size_t size = offset - node->frontmost_offset;
-
-    rassert(node->magic == internal_node_t::expected_magic);
-    memmove(reinterpret_cast<char *>(front_pair) + shift, front_pair, size);
-    rassert(node->magic == internal_node_t::expected_magic);
-
-
-    node->frontmost_offset = node->frontmost_offset + shift;
-
-    scoped_array_t<uint16_t> new_pair_offsets(node->npairs);
-    memcpy(new_pair_offsets.data(), node->pair_offsets, sizeof(uint16_t) * node->npairs);
-
-    for (int i = 0; i < node->npairs; i++) {
-        if (new_pair_offsets[i] < offset)
-            new_pair_offsets[i] += shift;
-    }
-
-    memcpy(node->pair_offsets, new_pair_offsets.data(), sizeof(uint16_t) * node->npairs);
+bool has_key_prefix(const internal_node_t *node) {
+    return node->magic == internal_node_t::key_prefix_magic;
 }
 
-uint16_t insert_pair(internal_node_t *node, const btree_internal_pair *pair) {
-    const uint16_t frontmost_offset = node->frontmost_offset - pair_size(pair);
-    node->frontmost_offset = frontmost_offset;
-
-    // insert contents
-    memcpy(get_pair(node, frontmost_offset), pair, pair_size(pair));
-    return frontmost_offset;
+const key_prefix_t *get_key_prefix(const internal_node_t *node) {
+    rassert(has_key_prefix(node));
+    return reinterpret_cast<const key_prefix_t *>(node->pair_offsets + node->npairs);
 }
 
-uint16_t insert_pair(internal_node_t *node, block_id_t lnode, const btree_key_t *key) {
-    const uint16_t frontmost_offset = node->frontmost_offset - pair_size_with_key(key);
-    node->frontmost_offset = frontmost_offset;
-
-    btree_internal_pair *new_pair = get_pair(node, frontmost_offset);
-
-    // Use a buffer to prepare the key/value pair which we can then use to generate a patch
-    scoped_array_t<char> pair_buf(pair_size_with_key(key));
-    btree_internal_pair *new_buf_pair = reinterpret_cast<btree_internal_pair *>(pair_buf.data());
-
-    // insert contents
-    new_buf_pair->lnode = lnode;
-    keycpy(&new_buf_pair->key, key);
-
-    // Patch the new pair into node_buf
-    memcpy(new_pair, new_buf_pair, pair_size_with_key(key));
-
-    return frontmost_offset;
+bool is_prefixed(const internal_node_t *node, int index) {
+    if (!has_key_prefix(node)) {
+        return false;
+    }
+    const key_prefix_t *prefix = get_key_prefix(node);
+    return index >= prefix->begin && index < prefix->end;
 }
 
-void delete_offset(internal_node_t *node, int index) {
-    uint16_t *pair_offsets = node->pair_offsets;
-    if (node->npairs > 1) {
-        memmove(pair_offsets + index, pair_offsets + index + 1, (node->npairs - index - 1) * sizeof(uint16_t));
+// The offset of the first byte after the pair offsets and the key prefix.
+size_t free_space_begin(const internal_node_t *node) {
+    size_t offset = offsetof(internal_node_t, pair_offsets)
+        + node->npairs * sizeof(*node->pair_offsets);
+    if (has_key_prefix(node)) {
+        offset += sizeof(key_prefix_t) + get_key_prefix(node)->size;
     }
-    node->npairs -= 1;
+    return offset;
 }
 
-void insert_offset(internal_node_t *node, uint16_t offset, int index) {
-    uint16_t *pair_offsets = node->pair_offsets;
-    memmove(pair_offsets + index + 1, pair_offsets + index, (node->npairs - index) * sizeof(uint16_t));
-    pair_offsets[index] = offset;
-    node->npairs += 1;
+size_t used_size(block_size_t block_size, const internal_node_t *node) {
+    return free_space_begin(node) + (block_size.value() - node->frontmost_offset);
 }
 
-void make_last_pair_special(internal_node_t *node) {
-    const int index = node->npairs - 1;
-    const uint16_t old_offset = node->pair_offsets[index];
-    btree_key_t tmp;
-    tmp.size = 0;
-    const uint16_t new_offset = insert_pair(node, get_pair(node, old_offset)->lnode, &tmp);
-    node->pair_offsets[index] = new_offset;
-    delete_pair(node, old_offset);
+std::string node_prefix(const internal_node_t *node) {
+    if (!has_key_prefix(node)) {
+        return std::string();
+    }
+    const key_prefix_t *prefix = get_key_prefix(node);
+    return std::string(reinterpret_cast<const char *>(prefix->contents), prefix->size);
+}
+
+// Finds the keys in [begin, end - 1) that start with `prefix`.  Since the keys are
+// sorted, they are next to each other.
+void find_prefixed_range(const pair_list_t &pairs, size_t begin, size_t end,
+                         const std::string &prefix,
+                         size_t *prefixed_begin_out, size_t *prefixed_end_out) {
+    size_t i = begin;
+    if (!prefix.empty()) {
+        while (i + 1 < end && !pairs.key_starts_with(i, prefix)) {
+            ++i;
+        }
+    } else {
+        i = end - 1;
+    }
+    *prefixed_begin_out = i;
+    while (i + 1 < end && pairs.key_starts_with(i, prefix)) {
+        ++i;
+    }
+    *prefixed_end_out = i;
+}
+
+// The number of bytes that `encode()` would use for the pairs in [begin, end).
+size_t encoded_size(const pair_list_t &pairs, size_t begin, size_t end,
+                    const std::string &prefix) {
+    size_t prefixed_begin, prefixed_end;
+    find_prefixed_range(pairs, begin, end, prefix, &prefixed_begin, &prefixed_end);
+    size_t size = offsetof(internal_node_t, pair_offsets)
+        + (end - begin) * sizeof(uint16_t);
+    if (prefixed_begin < prefixed_end) {
+        size += sizeof(key_prefix_t) + prefix.size();
+    }
+    for (size_t i = begin; i + 1 < end; ++i) {
+        int key_size = pairs.key_size(i);
+        if (i >= prefixed_begin && i < prefixed_end) {
+            key_size -= prefix.size();
+        }
+        size += pair_size_with_key_size(key_size);
+    }
+    return size + pair_size_with_key_size(0);
+}
+
+/* Returns the prefix among `candidates`, the empty prefix and a prefix of the
+middle key that makes the pairs in [begin, end) take up the least space.  We look at
+the prefixes of the middle key because the keys that share a prefix form a range,
+so the most useful prefixes are usually shared by the middle key too. */
+std::string choose_prefix(const pair_list_t &pairs, size_t begin, size_t end,
+                          const std::vector<std::string> &candidates) {
+    std::string best;
+    size_t best_size = encoded_size(pairs, begin, end, best);
+    auto consider = [&](const std::string &prefix) {
+        if (prefix.empty() || prefix.size() > MAX_KEY_SIZE || prefix == best) {
+            return;
+        }
+        size_t size = encoded_size(pairs, begin, end, prefix);
+        if (size < best_size) {
+            best = prefix;
+            best_size = size;
+        }
+    };
+
+    const size_t num_keys = end - begin - 1;
+    if (num_keys >= 2) {
+        const size_t middle = begin + num_keys / 2;
+        const uint8_t *middle_key = pairs.key(middle);
+        const int middle_size = pairs.key_size(middle);
+        // `num_sharing[n]` is the number of keys that share exactly `n` bytes with
+        // the middle key.
+        std::vector<size_t> num_sharing(middle_size + 1, 0);
+        for (size_t i = begin; i < begin + num_keys; ++i) {
+            const uint8_t *key = pairs.key(i);
+            int n = 0;
+            int max_n = std::min(middle_size, pairs.key_size(i));
+            while (n < max_n && key[n] == middle_key[n]) {
+                ++n;
+            }
+            ++num_sharing[n];
+        }
+        // Each key that starts with the prefix saves its size, but we also have to
+        // store the prefix once.
+        size_t num_at_least = 0;
+        size_t best_saving = sizeof(key_prefix_t);
+        int best_length = 0;
+        for (int length = middle_size; length > 0; --length) {
+            num_at_least += num_sharing[length];
+            size_t saving = (num_at_least - 1) * length;
+            if (saving > best_saving) {
+                best_saving = saving;
+                best_length = length;
+            }
+        }
+        consider(std::string(reinterpret_cast<const char *>(middle_key), best_length));
+    }
+    for (const std::string &candidate : candidates) {
+        consider(candidate);
+    }
+    return best;
+}
+
+// Overwrites `node` with the pairs in [begin, end).  The last of them becomes the
+// special pair.
+void encode(block_size_t block_size, const pair_list_t &pairs, size_t begin, size_t end,
+            const std::string &prefix, internal_node_t *node) {
+    rassert(begin < end);
+    guarantee(encoded_size(pairs, begin, end, prefix) <= block_size.value(),
+              "internal node overflow");
+    size_t prefixed_begin, prefixed_end;
+    find_prefixed_range(pairs, begin, end, prefix, &prefixed_begin, &prefixed_end);
+    const bool use_prefix = prefixed_begin < prefixed_end;
+
+    node->magic = use_prefix
+        ? internal_node_t::key_prefix_magic
+        : internal_node_t::expected_magic;
+    node->npairs = end - begin;
+    node->frontmost_offset = block_size.value();
+    if (use_prefix) {
+        key_prefix_t *key_prefix
+            = reinterpret_cast<key_prefix_t *>(node->pair_offsets + node->npairs);
+        key_prefix->begin = prefixed_begin - begin;
+        key_prefix->end = prefixed_end - begin;
+        key_prefix->size = prefix.size();
+        memcpy(key_prefix->contents, prefix.data(), prefix.size());
+    }
+
+    // We lay the pairs out back to front, so that they end up in key order.
+    for (size_t i = end; i-- > begin;) {
+        int skip = 0;
+        int key_size = i + 1 == end ? 0 : pairs.key_size(i);
+        if (i >= prefixed_begin && i < prefixed_end) {
+            skip = prefix.size();
+            key_size -= skip;
+        }
+        node->frontmost_offset -= pair_size_with_key_size(key_size);
+        btree_internal_pair *pair = get_pair(node, node->frontmost_offset);
+        pair->lnode = pairs.lnode(i);
+        pair->key.size = key_size;
+        memcpy(pair->key.contents, pairs.key(i) + skip, key_size);
+        node->pair_offsets[i - begin] = node->frontmost_offset;
+    }
 }
 
+// Lines up the pairs of `node` and of `rnode`, its right sibling.  The key from
+// `parent` that separates them goes to the special pair of `node`.
+void merged_pairs(const internal_node_t *node, const internal_node_t *rnode,
+                  const internal_node_t *parent, pair_list_t *pairs_out) {
+    // get the key in parent which points to node
+    const store_key_t key_from_parent = get_key_by_index(
+        parent,
+        get_offset_index(parent, get_key_by_index(node, 0).btree_key()));
 
-bool is_equal(const btree_key_t *key1, const btree_key_t *key2) {
-    return btree_key_cmp(key1, key2) == 0;
+    pairs_out->append_node(node);
+    pairs_out->set_key(node->npairs - 1, key_from_parent.btree_key());
+    pairs_out->append_node(rnode);
 }
 
 }  // namespace impl
@@ -0,0 +1,127 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "btree/key_filter.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+btree_key_filter_t::btree_key_filter_t()
+    : rebuilding_(false), stale_(false), too_large_(false), too_large_size_(0) { }
+
+static size_t effective_max_size(size_t max_size) {
+    return std::min<size_t>(max_size, KEY_FILTER_MAX_SIZE);
+}
+
+bool btree_key_filter_t::may_contain(const btree_key_t *key) const {
+    assert_thread();
+    return !filter_.has() || filter_->may_contain(hash_key(key));
+}
+
+bool btree_key_filter_t::is_active() const {
+    assert_thread();
+    return filter_.has();
+}
+
+void btree_key_filter_t::note_key_written(const btree_key_t *key) {
+    assert_thread();
+    if (!filter_.has() && !rebuilding_) {
+        return;
+    }
+    const uint64_t hash = hash_key(key);
+    if (filter_.has()) {
+        filter_->insert(hash);
+    }
+    if (rebuilding_) {
+        if (new_filter_.has()) {
+            new_filter_->insert(hash);
+        } else {
+            pending_hashes_.push_back(hash);
+        }
+    }
+}
+
+size_t btree_key_filter_t::memory_usage() const {
+    assert_thread();
+    return (filter_.has() ? filter_->memory_usage() : 0)
+        + (new_filter_.has() ? new_filter_->memory_usage() : 0);
+}
+
+void btree_key_filter_t::request_rebuild() {
+    assert_thread();
+    stale_ = true;
+    too_large_ = false;
+}
+
+bool btree_key_filter_t::needs_rebuild(size_t max_size) const {
+    assert_thread();
+    if (rebuilding_) {
+        return false;
+    }
+    if (too_large_) {
+        return too_large_size_ <= effective_max_size(max_size);
+    }
+    return !filter_.has()
+        || stale_
+        || filter_->fill_ratio() > KEY_FILTER_MAX_FILL_RATIO
+        || filter_->memory_usage() > effective_max_size(max_size);
+}
+
+void btree_key_filter_t::start_rebuild() {
+    assert_thread();
+    guarantee(!rebuilding_);
+    rebuilding_ = true;
+    stale_ = false;
+    too_large_ = false;
+}
+
+bool btree_key_filter_t::set_rebuild_size(int64_t population, size_t max_size) {
+    assert_thread();
+    guarantee(rebuilding_ && !new_filter_.has());
+    // Leave room for the table to grow before the filter fills up.
+    const uint64_t expected_keys = std::max<uint64_t>(
+        KEY_FILTER_MIN_KEYS, 2 * static_cast<uint64_t>(std::max<int64_t>(population, 0)));
+    const size_t size = bloom_filter_t::memory_usage(expected_keys);
+    if (size > effective_max_size(max_size)) {
+        too_large_ = true;
+        too_large_size_ = size;
+        pending_hashes_.clear();
+        return false;
+    }
+    new_filter_.init(new bloom_filter_t(expected_keys));
+    for (uint64_t hash : pending_hashes_) {
+        new_filter_->insert(hash);
+    }
+    pending_hashes_.clear();
+    pending_hashes_.shrink_to_fit();
+    return true;
+}
+
+void btree_key_filter_t::add_existing_key(const btree_key_t *key) {
+    assert_thread();
+    guarantee(rebuilding_);
+    if (new_filter_.has()) {
+        new_filter_->insert(hash_key(key));
+    }
+}
+
+void btree_key_filter_t::finish_rebuild() {
+    assert_thread();
+    guarantee(rebuilding_);
+    rebuilding_ = false;
+    // If the B-tree was too large, this leaves us without a filter at all.
+    filter_ = std::move(new_filter_);
+    pending_hashes_.clear();
+}
+
+void btree_key_filter_t::abort_rebuild() {
+    assert_thread();
+    guarantee(rebuilding_);
+    rebuilding_ = false;
+    new_filter_.reset();
+    pending_hashes_.clear();
+    too_large_ = false;
+}
+
+uint64_t btree_key_filter_t::hash_key(const btree_key_t *key) {
+    return bloom_filter_t::hash(key->contents, key->size);
+}
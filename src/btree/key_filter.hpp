@@ -0,0 +1,95 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef BTREE_KEY_FILTER_HPP_
+#define BTREE_KEY_FILTER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "arch/compiler.hpp"
+#include "btree/keys.hpp"
+#include "containers/bloom_filter.hpp"
+#include "containers/scoped.hpp"
+#include "threading.hpp"
+
+/* `btree_key_filter_t` lets point reads skip the B-tree descent for keys that aren't in
+the B-tree.  It's an in-memory Bloom filter that contains every key that is in the
+B-tree, and some that used to be.
+
+The filter is only correct if every write that might insert a key calls
+`note_key_written()` while it's in line for the superblock, and every read that relies
+on `may_contain()` calls it only after it has acquired the superblock.  A write that's
+ahead of the read in line has then noted its key, even if it hasn't reached the leaf
+node yet.
+
+Keys can't be removed from a Bloom filter, so deletions leave false positives behind.
+The filter gets rebuilt from a traversal of the B-tree once it's too full, or when
+someone calls `request_rebuild()` after a big batch of deletions.  Rebuilds are driven
+by the owner of the B-tree:
+
+    1. `start_rebuild()`, before getting in line for the superblock.
+    2. `set_rebuild_size()` with the B-tree's population and the memory that the filter
+       may use.
+    3. `add_existing_key()` for every key that a snapshotted traversal finds.
+    4. `finish_rebuild()`, or `abort_rebuild()` if the traversal was interrupted.
+
+Writes that get in line for the superblock after step 1 also go into the new filter,
+and the traversal sees every write that got in line before it.
+
+The owner is also responsible for accounting for `memory_usage()`, and for passing the
+same memory budget to `needs_rebuild()` and `set_rebuild_size()`.  If the budget shrinks
+below the filter's size, the filter gets rebuilt and dropped; if it grows, a filter that
+didn't fit before gets another try. */
+class btree_key_filter_t : public home_thread_mixin_debug_only_t {
+public:
+    btree_key_filter_t();
+
+    /* Returns `false` if `key` is definitely not in the B-tree. */
+    bool may_contain(const btree_key_t *key) const;
+
+    /* Returns `true` if `may_contain()` can ever return `false`. */
+    bool is_active() const;
+
+    void note_key_written(const btree_key_t *key);
+
+    /* The number of bytes used by the filter, and by its replacement during a
+    rebuild. */
+    size_t memory_usage() const;
+
+    void request_rebuild();
+    bool needs_rebuild(size_t max_size) const;
+
+    void start_rebuild();
+    // Returns `false` if the filter for the B-tree would take more than `max_size`
+    // bytes, in which case there's no point in traversing it.
+    MUST_USE bool set_rebuild_size(int64_t population, size_t max_size);
+    void add_existing_key(const btree_key_t *key);
+    void finish_rebuild();
+    void abort_rebuild();
+
+private:
+    static uint64_t hash_key(const btree_key_t *key);
+
+    scoped_ptr_t<bloom_filter_t> filter_;
+
+    /* These are only meaningful between `start_rebuild()` and `finish_rebuild()`.
+    Until the new filter has been sized, the hashes of written keys are kept in
+    `pending_hashes_`. */
+    bool rebuilding_;
+    scoped_ptr_t<bloom_filter_t> new_filter_;
+    std::vector<uint64_t> pending_hashes_;
+
+    /* Set by `request_rebuild()`. */
+    bool stale_;
+
+    /* Set if the last rebuild found too many keys to build a filter for them within
+    its memory budget.  We don't try again until someone calls `request_rebuild()`, or
+    the budget grows to `too_large_size_` bytes. */
+    bool too_large_;
+    size_t too_large_size_;
+
+    DISABLE_COPYING(btree_key_filter_t);
+};
+
+#endif  // BTREE_KEY_FILTER_HPP_
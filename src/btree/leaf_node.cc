@@ -13,15 +13,15 @@
 #include "repli_timestamp.hpp"
 #include "utils.hpp"
 
-// We comment out this warning, and static_assert that pair_offsets is
-// at an aligned offset.
+// We comment out this warning, and static_assert that the pair offsets
+// are at an aligned offset.
 #if defined(__GNUC__) && (100 * __GNUC__ + __GNUC_MINOR__ >= 901)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Waddress-of-packed-member"
 #endif
 
-static_assert(offsetof(leaf_node_t, pair_offsets) % 2 == 0,
-              "pair_offsets must be at uint16_t alignment");
+static_assert(sizeof(leaf_node_t) % 2 == 0,
+              "pair offsets must be at uint16_t alignment");
 
 // An insane sanity check, or, documentation of exactly what we expect from the type.
 static_assert(alignof(unaligned<uint16_t>) == 1, "expecting unaligned struct to have 1 byte alignment");
@@ -72,9 +72,15 @@ const int SKIP_ENTRY_RESERVED = 251;
 // Entries are contiguously connected to the end of a btree
 // block. Here's what a full leaf node looks like.
 //
-// [magic][num_pairs][live_size][frontmost][tstamp_cutpoint][off0][off1][off2]...[offN-1]........[tstamp][entry][tstamp][entry][tstamp][entry][tstamp][entry][entry][entry][entry][entry][entry][entry]
-//                                                          \___________________________/        ^                                                           ^                                         ^
-//                                                                  N = num_pairs            frontmost                                                tstamp_cutpoint                            (block size)
+// [magic][num_pairs][live_size][frontmost][tstamp_cutpoint][prefix][off0][off1][off2]...[offN-1]........[tstamp][entry][tstamp][entry][tstamp][entry][tstamp][entry][entry][entry][entry][entry][entry][entry]
+//                                                                  \___________________________/        ^                                                           ^                                         ^
+//                                                                          N = num_pairs            frontmost                                                tstamp_cutpoint                            (block size)
+//
+// The [prefix] is a [uint8_t size][byte]...[byte] key prefix, padded
+// to an even length, that every key in the node begins with.  Keys in
+// entries only store what comes after it.  Nodes written before key
+// prefixes existed have no [prefix] at all (see `has_key_prefix()`),
+// which works the same as an empty prefix.
 //
 // [tstamp] in [tstamp][entry] pairs are non-increasing (when you look at them
 // from frontmost to tstamp_cutpoint). This is true even of skip entries.
@@ -98,6 +104,75 @@ const int SKIP_ENTRY_RESERVED = 251;
 // thorough.
 
 
+// Set in the last byte of the magic of nodes that have a key prefix.
+const uint8_t KEY_PREFIX_MAGIC_BIT = 0x80;
+
+bool has_key_prefix(const leaf_node_t *node) {
+    uint8_t last = node->magic.bytes[sizeof(node->magic.bytes) - 1];
+    return (last & KEY_PREFIX_MAGIC_BIT) != 0;
+}
+
+block_magic_t key_prefix_magic(value_sizer_t *sizer) {
+    block_magic_t magic = sizer->btree_leaf_magic();
+    magic.bytes[sizeof(magic.bytes) - 1] |= KEY_PREFIX_MAGIC_BIT;
+    return magic;
+}
+
+bool is_leaf_magic(value_sizer_t *sizer, block_magic_t magic) {
+    return magic == sizer->btree_leaf_magic() || magic == key_prefix_magic(sizer);
+}
+
+int key_prefix_size(const leaf_node_t *node) {
+    if (!has_key_prefix(node)) {
+        return 0;
+    }
+    return *(reinterpret_cast<const uint8_t *>(node) + sizeof(leaf_node_t));
+}
+
+const uint8_t *key_prefix(const leaf_node_t *node) {
+    return reinterpret_cast<const uint8_t *>(node) + sizeof(leaf_node_t) + 1;
+}
+
+int header_size_for_prefix(int prefix_size) {
+    // The size byte and the prefix, rounded up to keep the pair offsets aligned.
+    return sizeof(leaf_node_t) + ((1 + prefix_size + 1) & ~1);
+}
+
+int header_size(const leaf_node_t *node) {
+    if (!has_key_prefix(node)) {
+        return sizeof(leaf_node_t);
+    }
+    return header_size_for_prefix(key_prefix_size(node));
+}
+
+uint16_t *pair_offsets(leaf_node_t *node) {
+    return reinterpret_cast<uint16_t *>(reinterpret_cast<char *>(node) + header_size(node));
+}
+
+const uint16_t *pair_offsets(const leaf_node_t *node) {
+    return reinterpret_cast<const uint16_t *>(reinterpret_cast<const char *>(node) + header_size(node));
+}
+
+// Returns how many bytes at the start of `key` match `node`'s key prefix.
+int matching_prefix_size(const leaf_node_t *node, const btree_key_t *key) {
+    int n = std::min<int>(key_prefix_size(node), key->size);
+    const uint8_t *prefix = key_prefix(node);
+    int i = 0;
+    while (i < n && prefix[i] == key->contents[i]) {
+        ++i;
+    }
+    return i;
+}
+
+int common_prefix_size(const btree_key_t *left, const btree_key_t *right) {
+    int n = std::min<int>(left->size, right->size);
+    int i = 0;
+    while (i < n && left->contents[i] == right->contents[i]) {
+        ++i;
+    }
+    return i;
+}
+
 struct entry_t;
 struct value_t;
 
@@ -151,6 +226,17 @@ int entry_size(value_sizer_t *sizer, const entry_t *p) {
     }
 }
 
+// Writes the key of `p`, which is in `node`, to `key_out`.  (The entry
+// itself only stores what comes after the node's key prefix.)
+void full_entry_key(const leaf_node_t *node, const entry_t *p, btree_key_t *key_out) {
+    const btree_key_t *suffix = entry_key(p);
+    int prefix_size = key_prefix_size(node);
+    rassert(prefix_size + suffix->size <= MAX_KEY_SIZE);
+    key_out->size = prefix_size + suffix->size;
+    memcpy(key_out->contents, key_prefix(node), prefix_size);
+    memcpy(key_out->contents + prefix_size, suffix->contents, suffix->size);
+}
+
 const entry_t *get_entry(const leaf_node_t *node, int offset) {
     return reinterpret_cast<const entry_t *>(reinterpret_cast<const char *>(node) + offset + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0));
 }
@@ -208,19 +294,20 @@ void strprint_entry(std::string *out, value_sizer_t *sizer, const entry_t *entry
 
 std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
     std::string out;
-    out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
-            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
+    out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u, key_prefix='%.*s')\n",
+            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint,
+            key_prefix_size(node), key_prefix(node));
 
     out += strprintf("  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        out += strprintf(" %d", node->pair_offsets[i]);
+        out += strprintf(" %d", pair_offsets(node)[i]);
     }
     out += strprintf("\n");
 
     out += strprintf("  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        out += strprintf(" %d:", node->pair_offsets[i]);
-        strprint_entry(&out, sizer, get_entry(node, node->pair_offsets[i]));
+        out += strprintf(" %d:", pair_offsets(node)[i]);
+        strprint_entry(&out, sizer, get_entry(node, pair_offsets(node)[i]));
     }
     out += strprintf("\n");
 
@@ -261,20 +348,21 @@ void print_entry(FILE *fp, value_sizer_t *sizer, const entry_t *entry) {
 
 
 void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node) {
-    fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
-            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
+    fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u, key_prefix='%.*s')\n",
+            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint,
+            key_prefix_size(node), key_prefix(node));
 
     fprintf(fp, "  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        fprintf(fp, " %d", node->pair_offsets[i]);
+        fprintf(fp, " %d", pair_offsets(node)[i]);
     }
     fprintf(fp, "\n");
     fflush(fp);
 
     fprintf(fp, "  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        fprintf(fp, " %d:", node->pair_offsets[i]);
-        print_entry(fp, sizer, get_entry(node, node->pair_offsets[i]));
+        fprintf(fp, " %d:", pair_offsets(node)[i]);
+        print_entry(fp, sizer, get_entry(node, pair_offsets(node)[i]));
     }
     fprintf(fp, "\n");
 
@@ -326,9 +414,11 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
     // is not before the end of pair_offsets
 
     // Basic sanity checks on fields' values.
-    if (failed(node->magic == sizer->btree_leaf_magic(),
+    if (failed(is_leaf_magic(sizer, node->magic),
                "bad leaf magic")
-        || failed(node->frontmost >= offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t),
+        || failed(key_prefix_size(node) <= MAX_KEY_SIZE,
+                  "key prefix is too long")
+        || failed(node->frontmost >= header_size(node) + node->num_pairs * sizeof(uint16_t),
                   "frontmost offset is before the end of pair_offsets")
         || failed(node->live_size <= (sizer->block_size().value() - node->frontmost) + sizeof(uint16_t) * node->num_pairs,
                   "live_size is impossibly large")
@@ -342,7 +432,7 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
 
     // sizeof(offs) is guaranteed to be less than the block_size() thanks to assertions above.
     scoped_array_t<uint16_t> offs(node->num_pairs);
-    memcpy(offs.data(), node->pair_offsets, node->num_pairs * sizeof(uint16_t));
+    memcpy(offs.data(), pair_offsets(node), node->num_pairs * sizeof(uint16_t));
 
     std::sort(offs.data(), offs.data() + node->num_pairs);
 
@@ -389,17 +479,24 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
         }
 
         const entry_t *ent = get_entry(node, offset);
+        if (!entry_is_skip(ent)
+            && failed(key_prefix_size(node) + entry_key(ent)->size <= MAX_KEY_SIZE,
+                      "key is too long")) {
+            return false;
+        }
         if (entry_is_live(ent)) {
+            store_key_t key;
+            full_entry_key(node, ent, key.btree_key());
             const void *value = entry_value(ent);
             int space = sizer->block_size().value() - (reinterpret_cast<const char *>(value) - reinterpret_cast<const char *>(node));
             if (!sizer->fits(value, space)) {
-                *msg_out = strprintf("problem with key %.*s: value does not fit\n", entry_key(ent)->size, entry_key(ent)->contents);
+                *msg_out = strprintf("problem with key %.*s: value does not fit\n", key.size(), key.contents());
                 return false;
             }
 
             std::string fscker_msg;
-            if (!fscker->fsck(sizer, entry_key(ent), value, &fscker_msg)) {
-                *msg_out = strprintf("Problem with key %.*s: %s\n", entry_key(ent)->size, entry_key(ent)->contents, fscker_msg.c_str());
+            if (!fscker->fsck(sizer, key.btree_key(), value, &fscker_msg)) {
+                *msg_out = strprintf("Problem with key %.*s: %s\n", key.size(), key.contents(), fscker_msg.c_str());
                 return false;
             }
 
@@ -437,8 +534,10 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
     // Entries look valid, check key ordering.
 
     const btree_key_t *last = left_exclusive_or_null;
+    store_key_t keys[2];
     for (int k = 0; k < node->num_pairs; ++k) {
-        const btree_key_t *key = entry_key(get_entry(node, node->pair_offsets[k]));
+        btree_key_t *key = keys[k % 2].btree_key();
+        full_entry_key(node, get_entry(node, pair_offsets(node)[k]), key);
         if (failed(last == nullptr || btree_key_cmp(last, key) < 0,
                    "keys out of order")) {
             return false;
@@ -465,16 +564,32 @@ void validate(DEBUG_VAR value_sizer_t *sizer, DEBUG_VAR const leaf_node_t *node)
 #endif
 }
 
-void init(value_sizer_t *sizer, leaf_node_t *node) {
-    node->magic = sizer->btree_leaf_magic();
+void init(value_sizer_t *sizer, leaf_node_t *node, const uint8_t *prefix, int prefix_size) {
+    rassert(prefix_size <= MAX_KEY_SIZE);
+    node->magic = key_prefix_magic(sizer);
     node->num_pairs = 0;
     node->live_size = 0;
     node->frontmost = sizer->block_size().value();
     node->tstamp_cutpoint = node->frontmost;
+
+    uint8_t *header = reinterpret_cast<uint8_t *>(node) + sizeof(leaf_node_t);
+    header[0] = prefix_size;
+    if (prefix_size > 0) {
+        memcpy(header + 1, prefix, prefix_size);
+    }
+    if (prefix_size % 2 == 0) {
+        header[1 + prefix_size] = 0;
+    }
 }
 
+void init(value_sizer_t *sizer, leaf_node_t *node) {
+    init(sizer, node, nullptr, 0);
+}
+
+// The space available to the entries and pair offsets of a node without
+// a key prefix.
 int free_space(value_sizer_t *sizer) {
-    return sizer->block_size().value() - offsetof(leaf_node_t, pair_offsets);
+    return sizer->block_size().value() - sizeof(leaf_node_t);
 }
 
 // Returns the mandatory storage cost of the node, returning a value
@@ -520,6 +635,40 @@ int mandatory_cost(value_sizer_t *sizer, const leaf_node_t *node, int required_t
     return mandatory_cost(sizer, node, required_timestamps, &ignored);
 }
 
+// Returns what the mandatory storage cost of the node would be with
+// its keys stored in full, plus the header space taken by the key
+// prefix.  Unlike `mandatory_cost()`, this doesn't change when keys
+// get re-encoded with a different prefix, so it's what we use to
+// decide whether nodes are underfull and how to level them.
+int expanded_cost(value_sizer_t *sizer, const leaf_node_t *node, int *tstamp_back_offset_out) {
+    int size = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, tstamp_back_offset_out)
+        + (header_size(node) - static_cast<int>(sizeof(leaf_node_t)));
+
+    int prefix_size = key_prefix_size(node);
+    if (prefix_size == 0) {
+        return size;
+    }
+
+    // Only the entries that `mandatory_cost()` counted carry their prefix: the
+    // deletion entries it left out can be dropped instead of expanded.
+    int counted = 0;
+    entry_iter_t iter = entry_iter_t::make(node);
+    while (!iter.done(sizer)) {
+        const entry_t *ent = get_entry(node, iter.offset);
+        if (entry_is_live(ent)
+            || (entry_is_deletion(ent) && iter.offset < *tstamp_back_offset_out)) {
+            ++counted;
+        }
+        iter.step(sizer, node);
+    }
+    return size + prefix_size * counted;
+}
+
+int expanded_cost(value_sizer_t *sizer, const leaf_node_t *node) {
+    int ignored;
+    return expanded_cost(sizer, node, &ignored);
+}
+
 int leaf_epsilon(value_sizer_t *sizer) {
     // Returns the maximum possible entry size, i.e. the key cost plus
     // the value cost plus pair_offsets plus timestamp cost.
@@ -553,14 +702,23 @@ bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *k
     // because it doesn't actually fit.
     int size = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
 
+    // If the key doesn't begin with the node's key prefix, the prefix
+    // has to get shorter, and every other key gets longer by as much.
+    int prefix_size = key_prefix_size(node);
+    int new_prefix_size = matching_prefix_size(node, key);
+    size += (prefix_size - new_prefix_size) * node->num_pairs;
+
     // Add the space we'll need for the new key/value pair we would
     // insert.  We conservatively assume the key is not already
     // contained in the node.
 
-    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() + sizer->size(value);
+    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() - new_prefix_size + sizer->size(value);
 
     // The node is full if we can't fit all that data within the free space.
-    return size > free_space(sizer);
+    int header = has_key_prefix(node)
+        ? header_size_for_prefix(new_prefix_size)
+        : header_size(node);
+    return size > static_cast<int>(sizer->block_size().value()) - header;
 }
 
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node) {
@@ -578,8 +736,12 @@ bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node) {
     // leaf_epsilon) / 2 - leaf_epsilon / 2.  Which is no less than is
     // free_space / 2 - leaf_epsilon.  We don't want an immediately
     // split node to be underfull, hence the threshold used below.
+    //
+    // We measure the node as if its keys weren't prefix-compressed.
+    // Otherwise a merge of two underfull nodes whose keys have
+    // different prefixes might not fit in one node.
 
-    return mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS) < free_space(sizer) / 2 - leaf_epsilon(sizer);
+    return expanded_cost(sizer, node) < free_space(sizer) / 2 - leaf_epsilon(sizer);
 }
 
 
@@ -609,7 +771,7 @@ void garbage_collect(
         indices[i] = i;
     }
 
-    std::sort(indices.data(), indices.data() + node->num_pairs, indirect_index_comparator_t(node->pair_offsets));
+    std::sort(indices.data(), indices.data() + node->num_pairs, indirect_index_comparator_t(pair_offsets(node)));
 
     int mand_offset;
     UNUSED int cost = mandatory_cost(sizer, node, num_tstamped, &mand_offset);
@@ -622,7 +784,7 @@ void garbage_collect(
     int w = sizer->block_size().value();
     int i = node->num_pairs - 1;
     for (; i >= 0; --i) {
-        int offset = node->pair_offsets[indices[i]];
+        int offset = pair_offsets(node)[indices[i]];
 
         if (offset < mand_offset) {
             break;
@@ -633,18 +795,18 @@ void garbage_collect(
             int sz = entry_size(sizer, ent);
             w -= sz;
             memmove(get_at_offset(node, w), ent, sz);
-            node->pair_offsets[indices[i]] = w;
+            pair_offsets(node)[indices[i]] = w;
         } else {
-            node->pair_offsets[indices[i]] = 0;
+            pair_offsets(node)[indices[i]] = 0;
         }
     }
 
-    // Either i < 0 or node->pair_offsets[indices[i]] < mand_offset.
+    // Either i < 0 or pair_offsets(node)[indices[i]] < mand_offset.
 
     node->tstamp_cutpoint = w;
 
     for (; i >= 0; --i) {
-        int offset = node->pair_offsets[indices[i]];
+        int offset = pair_offsets(node)[indices[i]];
         entry_t *ent = get_entry(node, offset);
         rassert(!entry_is_skip(ent));
 
@@ -654,7 +816,7 @@ void garbage_collect(
         w -= sz;
 
         memmove(get_at_offset(node, w), get_at_offset(node, offset), sz);
-        node->pair_offsets[indices[i]] = w;
+        pair_offsets(node)[indices[i]] = w;
     }
 
     node->frontmost = w;
@@ -666,8 +828,8 @@ void garbage_collect(
             *preserved_index = j;
         }
 
-        if (node->pair_offsets[k] != 0) {
-            node->pair_offsets[j] = node->pair_offsets[k];
+        if (pair_offsets(node)[k] != 0) {
+            pair_offsets(node)[j] = pair_offsets(node)[k];
 
             j += 1;
         }
@@ -709,248 +871,232 @@ void clean_entry(void *p, int sz) {
     }
 }
 
-// Moves entries with pair_offsets indices in the clopen range [beg,
-// end) from fro to tow.
-void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
-                   int wpoint, leaf_node_t *tow, int fro_copysize,
-                   int fro_mand_offset,
-                   std::vector<const void *> *moved_values_out) {
-    rassert(is_underfull(sizer, tow));
-    rassert(end >= beg);
+// An entry that `rebuild()` copies into a rebuilt node.
+struct rebuild_entry_t {
+    const leaf_node_t *node;
+    // The offset of the entry in `node`, which is where its timestamp
+    // is if it has one.
+    int offset;
+    // Whether the entry keeps its timestamp in the rebuilt node.
+    bool tstamped;
+};
 
-    // This assertion is a bit loose.
-    rassert(fro_copysize + mandatory_cost(sizer, tow, MANDATORY_TIMESTAMPS) <= free_space(sizer));
+// Rewrites `node` so that it contains `entries`, which are in key
+// order and may point into `node` itself.  `physical_order` is a
+// permutation of the indices of `entries` giving the order in which
+// they are stored, with the timestamped entries first, newest first.
+// The rebuilt node gets the longest key prefix shared by all of the
+// keys and by `key_to_cover_or_null`.
+void rebuild(value_sizer_t *sizer, leaf_node_t *node,
+             const std::vector<rebuild_entry_t> &entries,
+             const std::vector<int> &physical_order,
+             const btree_key_t *key_to_cover_or_null) {
+    rassert(physical_order.size() == entries.size());
+    const int bs = sizer->block_size().value();
+
+    // The keys are sorted, so the first and last ones are enough to find
+    // the prefix they all share.
+    store_key_t prefix;
+    int prefix_size = 0;
+    if (!entries.empty()) {
+        store_key_t last;
+        full_entry_key(entries.front().node,
+                       get_entry(entries.front().node, entries.front().offset),
+                       prefix.btree_key());
+        full_entry_key(entries.back().node,
+                       get_entry(entries.back().node, entries.back().offset),
+                       last.btree_key());
+        prefix_size = common_prefix_size(prefix.btree_key(), last.btree_key());
+        if (key_to_cover_or_null != nullptr) {
+            prefix_size = std::min(prefix_size,
+                common_prefix_size(prefix.btree_key(), key_to_cover_or_null));
+        }
+    } else if (key_to_cover_or_null != nullptr) {
+        prefix.assign(key_to_cover_or_null);
+        prefix_size = prefix.size();
+    }
 
-    // Make tow have a nice big region we can copy entries to.  Also,
-    // this means we have no "skip" entries in tow.
-    garbage_collect(sizer, tow, MANDATORY_TIMESTAMPS, &wpoint);
+    scoped_malloc_t<leaf_node_t> scratch(bs);
+    leaf_node_t *out = scratch.get();
+    init(sizer, out, prefix.contents(), prefix_size);
+    out->num_pairs = entries.size();
 
-    // Now resize and move tow's pair_offsets.
-    memmove(tow->pair_offsets + wpoint + (end - beg), tow->pair_offsets + wpoint, sizeof(uint16_t) * (tow->num_pairs - wpoint));
+    int total_size = 0;
+    for (const rebuild_entry_t &e : entries) {
+        const entry_t *ent = get_entry(e.node, e.offset);
+        rassert(!entry_is_skip(ent));
+        total_size += entry_size(sizer, ent) + key_prefix_size(e.node) - prefix_size
+            + (e.tstamped ? sizeof(repli_timestamp_t) : 0);
+    }
+    int frontmost = bs - total_size;
+    guarantee(header_size(out) + static_cast<int>(sizeof(uint16_t)) * out->num_pairs
+              <= frontmost,
+              "rebuilt leaf node doesn't fit in a block");
+    out->frontmost = frontmost;
 
-    tow->num_pairs += end - beg;
+    int w = frontmost;
+    bool seen_tstamp_cutpoint = false;
+    for (int i : physical_order) {
+        const rebuild_entry_t &e = entries[i];
+        pair_offsets(out)[i] = w;
+        if (e.tstamped) {
+            rassert(!seen_tstamp_cutpoint);
+            rassert(e.offset < e.node->tstamp_cutpoint);
+            reinterpret_cast<unaligned<repli_timestamp_t> *>(get_at_offset(out, w))->value
+                = get_timestamp(e.node, e.offset);
+            w += sizeof(repli_timestamp_t);
+        } else if (!seen_tstamp_cutpoint) {
+            out->tstamp_cutpoint = w;
+            seen_tstamp_cutpoint = true;
+        }
 
-    // pos a
+        const entry_t *ent = get_entry(e.node, e.offset);
+        store_key_t key;
+        full_entry_key(e.node, ent, key.btree_key());
+        int suffix_size = key.size() - prefix_size;
 
-    // Now we're going to do something crazy.  Fill the new hole in
-    // the pair offsets with the numbers in [0, end - beg).
-    for (int i = 0; i < end - beg; ++i) {
-        tow->pair_offsets[wpoint + i] = i;
+        uint8_t *p = reinterpret_cast<uint8_t *>(get_at_offset(out, w));
+        if (entry_is_deletion(ent)) {
+            *p++ = DELETE_ENTRY_CODE;
+        }
+        *p++ = suffix_size;
+        memcpy(p, key.contents() + prefix_size, suffix_size);
+        p += suffix_size;
+        if (entry_is_live(ent)) {
+            const void *value = entry_value(ent);
+            int value_size = sizer->size(value);
+            memcpy(p, value, value_size);
+            p += value_size;
+            out->live_size += sizeof(uint16_t) + (p - reinterpret_cast<uint8_t *>(get_at_offset(out, w)));
+        }
+        w = p - reinterpret_cast<uint8_t *>(out);
     }
+    if (!seen_tstamp_cutpoint) {
+        out->tstamp_cutpoint = w;
+    }
+    guarantee(w == bs);
 
-    // We treat these numbers as indices into [beg, end) in fro, and
-    // sort them so that we can access [beg, end) in order by
-    // increasing offset.
-    std::sort(tow->pair_offsets + wpoint, tow->pair_offsets + wpoint + (end - beg), indirect_index_comparator_t(fro->pair_offsets + beg));
-
-    int tow_offset = tow->frontmost;
-
-    // The offset we read from (indirectly pointing to fro's [beg,
-    // end)) in tow->pair_offsets, and the offset at which we stop.
-    int fro_index = wpoint;
-    int fro_index_end = wpoint + (end - beg);
+    memcpy(node, out, bs);
+    validate(sizer, node);
+}
 
-    const int new_frontmost = tow->frontmost - fro_copysize;
+// Rewrites `node` with the longest key prefix that its keys and
+// `key_to_cover_or_null` share.  Skip entries get dropped on the way.
+void recompute_prefix(value_sizer_t *sizer, leaf_node_t *node,
+                      const btree_key_t *key_to_cover_or_null) {
+    std::vector<rebuild_entry_t> entries;
+    entries.reserve(node->num_pairs);
+    for (int i = 0; i < node->num_pairs; ++i) {
+        int offset = pair_offsets(node)[i];
+        entries.push_back(rebuild_entry_t{node, offset, offset < node->tstamp_cutpoint});
+    }
 
-    int wri_offset = new_frontmost;
+    std::vector<int> physical_order(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        physical_order[i] = i;
+    }
+    std::sort(physical_order.begin(), physical_order.end(),
+        [&](int x, int y) { return entries[x].offset < entries[y].offset; });
 
-    int adjustable_tow_offsets[MANDATORY_TIMESTAMPS];
-    int num_adjustable_tow_offsets = 0;
+    rebuild(sizer, node, entries, physical_order, key_to_cover_or_null);
+}
 
-    // To detect bugs in the code
-    int actually_copied = 0;
+// Moves entries with pair_offsets indices in the clopen range [beg,
+// end) from fro to tow.  tow is rebuilt with the longest key prefix
+// shared by its new set of keys and `key_to_cover_or_null`.
+void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
+                   int wpoint, leaf_node_t *tow, int fro_mand_offset,
+                   const btree_key_t *key_to_cover_or_null,
+                   std::vector<const void *> *moved_values_out) {
+    rassert(is_underfull(sizer, tow));
+    rassert(end >= beg);
 
-    // We will gradually compute the live size.
-    int livesize = tow->live_size;
+    // Get rid of tow's skip entries and non-mandatory timestamps.
+    garbage_collect(sizer, tow, MANDATORY_TIMESTAMPS, &wpoint);
 
+    // Everything that might end up in tow, in key order.
+    std::vector<rebuild_entry_t> entries;
+    entries.reserve(tow->num_pairs + (end - beg));
     for (int i = 0; i < wpoint; ++i) {
-        if (tow->pair_offsets[i] < tow->tstamp_cutpoint) {
-            rassert(num_adjustable_tow_offsets < MANDATORY_TIMESTAMPS);
-            adjustable_tow_offsets[num_adjustable_tow_offsets] = i;
-            ++num_adjustable_tow_offsets;
-        }
+        entries.push_back(rebuild_entry_t{tow, pair_offsets(tow)[i], false});
     }
-
-    for (int i = wpoint + (end - beg); i < tow->num_pairs; ++i) {
-        if (tow->pair_offsets[i] < tow->tstamp_cutpoint) {
-            rassert(num_adjustable_tow_offsets < MANDATORY_TIMESTAMPS);
-            adjustable_tow_offsets[num_adjustable_tow_offsets] = i;
-            ++num_adjustable_tow_offsets;
-        }
+    for (int i = beg; i < end; ++i) {
+        entries.push_back(rebuild_entry_t{fro, pair_offsets(fro)[i], false});
+    }
+    for (int i = wpoint; i < tow->num_pairs; ++i) {
+        entries.push_back(rebuild_entry_t{tow, pair_offsets(tow)[i], false});
     }
 
-    int fro_live_size_adjustment = 0;
-
-    for (;;) {
-        rassert(tow_offset <= tow->tstamp_cutpoint);
-        if (tow_offset == tow->tstamp_cutpoint || fro_index == fro_index_end) {
-            // We have no more timestamped information to push.
-            break;
-        }
-
-        int fro_offset = fro->pair_offsets[beg + tow->pair_offsets[fro_index]];
-
-        if (fro_offset >= fro_mand_offset) {
-            // We have no more timestamped information to push.
-            break;
-        }
+    // The entries of each node in the order they're stored in, which
+    // puts the timestamped ones first, newest first.
+    std::vector<int> tow_order, fro_order;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        (entries[i].node == tow ? tow_order : fro_order).push_back(i);
+    }
+    auto by_offset = [&](int x, int y) { return entries[x].offset < entries[y].offset; };
+    std::sort(tow_order.begin(), tow_order.end(), by_offset);
+    std::sort(fro_order.begin(), fro_order.end(), by_offset);
 
-        repli_timestamp_t fro_tstamp = get_timestamp(fro, fro_offset);
-        repli_timestamp_t tow_tstamp = get_timestamp(tow, tow_offset);
+    // Merge the timestamped entries for as long as both nodes have some
+    // left.  Everything after that goes without a timestamp, so
+    // deletions past that point get dropped.
+    std::vector<int> physical_order;
+    size_t t = 0, f = 0;
+    while (t < tow_order.size() && entries[tow_order[t]].offset < tow->tstamp_cutpoint
+           && f < fro_order.size() && entries[fro_order[f]].offset < fro_mand_offset) {
+        rebuild_entry_t *tow_entry = &entries[tow_order[t]];
+        rebuild_entry_t *fro_entry = &entries[fro_order[f]];
 
         // Greater timestamps go first.
-        if (tow_tstamp < fro_tstamp) {
-            entry_t *ent = get_entry(fro, fro_offset);
-            int entsz = entry_size(sizer, ent);
-            int sz = sizeof(repli_timestamp_t) + entsz;
-            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sz);
-
-            if (entry_is_live(ent)) {
-                livesize += entsz + sizeof(uint16_t);
-                fro_live_size_adjustment -= entsz + sizeof(uint16_t);
-            }
-
-            clean_entry(ent, entsz);
-
-            // Update the pair offset in fro to be the offset in tow
-            // -- we'll never use the old value again and we'll copy
-            // the newer values to tow later.
-            fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
-
-            wri_offset += sz;
-            actually_copied += sz;
-            fro_index++;
-
+        if (get_timestamp(tow, tow_entry->offset) < get_timestamp(fro, fro_entry->offset)) {
+            fro_entry->tstamped = true;
+            physical_order.push_back(fro_order[f]);
+            ++f;
         } else {
-            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, get_entry(tow, tow_offset));
-            memmove(get_at_offset(tow, wri_offset), get_at_offset(tow, tow_offset), sz);
-
-            // Update the pair offset of the entry we've moved.
-            int i;
-            for (i = 0; i < num_adjustable_tow_offsets; ++i) {
-                int j = adjustable_tow_offsets[i];
-                if (tow->pair_offsets[j] == tow_offset) {
-                    tow->pair_offsets[j] = wri_offset;
-                    break;
-                }
-            }
-
-            // Make sure we updated something.
-            rassert(i != num_adjustable_tow_offsets);
-
-            wri_offset += sz;
-            tow_offset += sz;
+            tow_entry->tstamped = true;
+            physical_order.push_back(tow_order[t]);
+            ++t;
         }
     }
 
-    uint16_t new_tstamp_cutpoint = wri_offset;
-
-    // Now we have some untimestamped entries to write.
-    for (; fro_index < fro_index_end; ++fro_index) {
-        int fro_offset = fro->pair_offsets[beg + tow->pair_offsets[fro_index]];
-        entry_t *ent = get_entry(fro, fro_offset);
-        if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
-            memmove(get_at_offset(tow, wri_offset), ent, sz);
-            clean_entry(ent, sz);
-            fro_live_size_adjustment -= sz + sizeof(uint16_t);
-
-            fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
-
-            wri_offset += sz;
-            livesize += sz + sizeof(uint16_t);
-            actually_copied += sz;
-            rassert(wri_offset <= tow_offset);
+    std::vector<bool> dropped(entries.size(), false);
+    for (; f < fro_order.size(); ++f) {
+        if (entry_is_live(get_entry(fro, entries[fro_order[f]].offset))) {
+            physical_order.push_back(fro_order[f]);
         } else {
-            rassert(entry_is_deletion(ent));
-
-            // This is a dead entry.  We'll need to squash this dead entry later.
-            fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = 0;
-
-            int sz = entry_size(sizer, ent);
-            clean_entry(ent, sz);
+            dropped[fro_order[f]] = true;
         }
     }
-
-    guarantee(actually_copied <= fro_copysize);
-    rassert(wri_offset <= tow_offset);
-
-    // tow may have some timestamped entries that need to become
-    // un-timestamped.
-    while (tow_offset < tow->tstamp_cutpoint) {
-        rassert(wri_offset <= tow_offset);
-
-        entry_t *ent = get_entry(tow, tow_offset);
-        int sz = entry_size(sizer, ent);
-        if (entry_is_live(ent)) {
-            memmove(get_at_offset(tow, wri_offset), ent, sz);
-
-            // Update the pair offset of the entry we've moved.
-            int i;
-            for (i = 0; i < num_adjustable_tow_offsets; ++i) {
-                int j = adjustable_tow_offsets[i];
-                if (tow->pair_offsets[j] == tow_offset) {
-                    tow->pair_offsets[j] = wri_offset;
-                    break;
-                }
-            }
-
-            // Make sure we updated something.
-            rassert(i != num_adjustable_tow_offsets);
-
-            wri_offset += sz;
+    for (; t < tow_order.size(); ++t) {
+        if (entry_is_live(get_entry(tow, entries[tow_order[t]].offset))) {
+            physical_order.push_back(tow_order[t]);
         } else {
-
-            // Update the pair offset of the entry we've deleted, so
-            // that it gets squashed later.
-            int i;
-            for (i = 0; i < num_adjustable_tow_offsets; ++i) {
-                int j = adjustable_tow_offsets[i];
-                if (tow->pair_offsets[j] == tow_offset) {
-                    tow->pair_offsets[j] = 0;
-                }
-            }
+            dropped[tow_order[t]] = true;
         }
-        tow_offset += sizeof(repli_timestamp_t) + sz;
     }
 
-    guarantee(wri_offset <= tow_offset);
-
-    // If we needed to untimestamp any tow entries, we'll need a skip
-    // entry for the open space.
-    if (wri_offset < tow_offset) {
-        // printf("wri_offset = %d, tow_offset = %d\n", wri_offset, tow_offset);
-        clean_entry(get_at_offset(tow, wri_offset), tow_offset - wri_offset);
+    // Squash the dropped entries.
+    std::vector<rebuild_entry_t> kept;
+    std::vector<int> kept_index(entries.size(), -1);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (!dropped[i]) {
+            kept_index[i] = kept.size();
+            kept.push_back(entries[i]);
+        }
+    }
+    for (int &i : physical_order) {
+        i = kept_index[i];
     }
 
-    // We don't need to do anything else for tow entries because we
-    // did a garbage collection in tow so they are contiguous through
-    // the end of the buffer (and the rest don't have timestamps).
-
-    // Copy the valid tow offsets from [beg, end) to the wpoint point
-    // in tow, and move fro entries.
-    memcpy(tow->pair_offsets + wpoint, fro->pair_offsets + beg,
-           sizeof(uint16_t) * (end - beg));
-    memmove(fro->pair_offsets + beg, fro->pair_offsets + end, sizeof(uint16_t) * (fro->num_pairs - end));
-    fro->num_pairs -= end - beg;
-
-    tow->frontmost = new_frontmost;
-
-    tow->live_size = livesize;
-
-    tow->tstamp_cutpoint = new_tstamp_cutpoint;
-
-    fro->live_size += fro_live_size_adjustment;
+    rebuild(sizer, tow, kept, physical_order, key_to_cover_or_null);
 
     if (moved_values_out != nullptr) {
         // Collect value pointers of the moved values
         moved_values_out->clear();
         moved_values_out->reserve(end - beg);
-        for (int pair_idx = wpoint; pair_idx < wpoint + (end - beg); ++pair_idx) {
-            const int offset = tow->pair_offsets[pair_idx];
-            // Skip dead entries
-            if (offset != 0) {
-                const entry_t *entry = get_entry(tow, offset);
+        for (size_t i = 0; i < kept.size(); ++i) {
+            if (kept[i].node == fro) {
+                const entry_t *entry = get_entry(tow, pair_offsets(tow)[i]);
                 // Skip deletions
                 if (entry_is_live(entry)) {
                     moved_values_out->push_back(entry_value(entry));
@@ -959,38 +1105,59 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         }
     }
 
-    {
-        // Squash dead entries that we copied pair_offsets from fro,
-        // for, and that we removed from tow, as well.
-        int j, k;
-        for (j = 0, k = 0; k < tow->num_pairs; ++k) {
-            if (tow->pair_offsets[k] != 0) {
-                tow->pair_offsets[j] = tow->pair_offsets[k];
-
-                j += 1;
-            }
+    // Now that tow has its copies, clean the moved entries out of fro.
+    for (int i = beg; i < end; ++i) {
+        entry_t *ent = get_entry(fro, pair_offsets(fro)[i]);
+        int sz = entry_size(sizer, ent);
+        if (entry_is_live(ent)) {
+            fro->live_size -= sz + sizeof(uint16_t);
         }
-        tow->num_pairs = j;
+        clean_entry(ent, sz);
     }
+    memmove(pair_offsets(fro) + beg, pair_offsets(fro) + end,
+            sizeof(uint16_t) * (fro->num_pairs - end));
+    fro->num_pairs -= end - beg;
 
     validate(sizer, fro);
     validate(sizer, tow);
 }
 
-void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode,
+           btree_key_t *median_out, const btree_key_t *key_to_insert_or_null) {
+    if (key_to_insert_or_null != nullptr
+        && matching_prefix_size(node, key_to_insert_or_null) < key_prefix_size(node)) {
+        // The key comes before or after all of the node's keys.  Making
+        // room for it in either half could take more space than the split
+        // frees up, so it gets a node of its own.
+        guarantee(node->num_pairs > 0);
+        int index;
+        find_key(node, key_to_insert_or_null, &index);
+        if (index == 0) {
+            memcpy(rnode, node, sizer->block_size().value());
+            init(sizer, node);
+            keycpy(median_out, key_to_insert_or_null);
+        } else {
+            guarantee(index == node->num_pairs);
+            init(sizer, rnode);
+            full_entry_key(node, get_entry(node, pair_offsets(node)[node->num_pairs - 1]),
+                           median_out);
+        }
+        return;
+    }
+
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    int capacity = sizer->block_size().value() - header_size(node);
 
-    guarantee(mandatory >= free_space(sizer) - leaf_epsilon(sizer));
+    guarantee(mandatory >= capacity - leaf_epsilon(sizer));
 
     // We shall split the mandatory cost of this node as evenly as possible.
 
-    int num_mandatories = 0;
     int i = node->num_pairs - 1;
     int prev_rcost = 0;
     int rcost = 0;
     while (i >= 0 && rcost < mandatory / 2) {
-        int offset = node->pair_offsets[i];
+        int offset = pair_offsets(node)[i];
         entry_t *ent = get_entry(node, offset);
 
         // We only take mandatory entries' costs into consideration,
@@ -1002,23 +1169,19 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
         if (entry_is_live(ent)) {
             prev_rcost = rcost;
             rcost += entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
-
-            ++num_mandatories;
         } else {
             rassert(entry_is_deletion(ent));
 
             if (offset < tstamp_back_offset) {
                 prev_rcost = rcost;
                 rcost += entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
-
-                ++num_mandatories;
             }
         }
 
         --i;
     }
 
-    // Since the mandatory_cost is at least free_space - leaf_epsilon there's no way i can equal num_pairs or zero.
+    // Since the mandatory_cost is at least capacity - leaf_epsilon there's no way i can equal num_pairs or zero.
     guarantee(i < node->num_pairs);
     guarantee(i > 0);
 
@@ -1031,7 +1194,6 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
     if ((mandatory - prev_rcost) - prev_rcost < rcost - (mandatory - rcost)) {
         end_rcost = prev_rcost;
         s = i + 2;
-        --num_mandatories;
     } else {
         end_rcost = rcost;
         s = i + 1;
@@ -1039,18 +1201,29 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
 
     // If our math was right, neither node can be underfull just
     // considering the split of the mandatory costs.
-    guarantee(end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
-    guarantee(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
+    guarantee(end_rcost >= capacity / 2 - leaf_epsilon(sizer));
+    guarantee(mandatory - end_rcost >= capacity / 2 - leaf_epsilon(sizer));
 
     // Now we wish to move the elements at indices [s, num_pairs) to rnode.
 
-    init(sizer, rnode);
+    full_entry_key(node, get_entry(node, pair_offsets(node)[s - 1]), median_out);
 
-    int node_copysize = end_rcost - num_mandatories * sizeof(uint16_t);
-    move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize,
-                  tstamp_back_offset, nullptr);
+    // Both halves get the longest key prefix they can have, except that
+    // the one the new key goes into has to keep a prefix the key shares.
+    const btree_key_t *left_key_or_null = nullptr;
+    const btree_key_t *right_key_or_null = nullptr;
+    if (key_to_insert_or_null != nullptr) {
+        if (btree_key_cmp(key_to_insert_or_null, median_out) <= 0) {
+            left_key_or_null = key_to_insert_or_null;
+        } else {
+            right_key_or_null = key_to_insert_or_null;
+        }
+    }
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    init(sizer, rnode);
+    move_elements(sizer, node, s, node->num_pairs, 0, rnode, tstamp_back_offset,
+                  right_key_or_null, nullptr);
+    recompute_prefix(sizer, node, left_key_or_null);
 }
 
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
@@ -1060,21 +1233,10 @@ void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
     rassert(is_underfull(sizer, right));
 
     int tstamp_back_offset;
-    int mandatory = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
-
-    int left_copysize = mandatory;
-    // Uncount the uint16_t cost of mandatory entries.  Sigh.
-    // This includes deletion entries *before* the `tstamp_back_offset`, as well
-    // as all non-deletion entries.
-    for (int i = 0; i < left->num_pairs; ++i) {
-        if (left->pair_offsets[i] < tstamp_back_offset
-            || !entry_is_deletion(get_entry(left, left->pair_offsets[i]))) {
-            left_copysize -= sizeof(uint16_t);
-        }
-    }
+    mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
-    move_elements(sizer, left, 0, left->num_pairs, 0, right, left_copysize,
-                  tstamp_back_offset, nullptr);
+    move_elements(sizer, left, 0, left->num_pairs, 0, right, tstamp_back_offset,
+                  nullptr, nullptr);
 }
 
 // We move keys out of sibling and into node.
@@ -1092,10 +1254,9 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     // from sibling.
     int beg, end, *w, wstep;
 
-    int node_weight = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+    int node_weight = expanded_cost(sizer, node);
     int tstamp_back_offset;
-    int sibling_weight = mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS,
-                                        &tstamp_back_offset);
+    int sibling_weight = expanded_cost(sizer, sibling, &tstamp_back_offset);
 
     guarantee(node_weight < sibling_weight);
 
@@ -1119,37 +1280,67 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
 
     guarantee(end - beg != sibling->num_pairs - 1);
 
-    int prev_weight_movement = 0;
-    int weight_movement = 0;
-    int num_mandatories = 0;
-    int prev_diff = sizer->block_size().value();  // some impossibly large value
+    // The moved entries get re-encoded with the prefix that all of
+    // node's keys share afterwards, which can make node's own keys
+    // longer.  We keep track of an upper bound on node's size, and stop
+    // before it stops fitting.
+    const int bs = sizer->block_size().value();
+    const int node_prefix_size = key_prefix_size(node);
+    const int sibling_prefix_size = key_prefix_size(sibling);
+    const int node_cost = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+    // The key of node farthest away from sibling.
+    store_key_t far_key;
+    bool have_far_key = node->num_pairs > 0;
+    if (have_far_key) {
+        int far_index = nodecmp_node_with_sib < 0 ? 0 : node->num_pairs - 1;
+        full_entry_key(node, get_entry(node, pair_offsets(node)[far_index]),
+                       far_key.btree_key());
+    }
+    int moved_cost = 0;
+    int moved_count = 0;
+    bool out_of_space = false;
+
+    int prev_diff = bs;  // some impossibly large value
     for (;;) {
-        int offset = sibling->pair_offsets[*w];
+        int offset = pair_offsets(sibling)[*w];
         entry_t *ent = get_entry(sibling, offset);
 
         // We only take mandatory entries' costs into consideration.
+        int sz = 0;
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
-            prev_diff = sibling_weight - node_weight;
-            prev_weight_movement = weight_movement;
-            weight_movement += sz;
-            node_weight += sz;
-            sibling_weight -= sz;
-
-            ++num_mandatories;
+            sz = entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
         } else {
             rassert(entry_is_deletion(ent));
 
             if (offset < tstamp_back_offset) {
-                int sz = entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
-                prev_diff = sibling_weight - node_weight;
-                prev_weight_movement = weight_movement;
-                weight_movement += sz;
-                node_weight += sz;
-                sibling_weight -= sz;
-
-                ++num_mandatories;
+                sz = entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
+            }
+        }
+
+        if (sz != 0) {
+            store_key_t key;
+            full_entry_key(sibling, ent, key.btree_key());
+            if (!have_far_key) {
+                far_key = key;
+                have_far_key = true;
+            }
+            int new_prefix_size = common_prefix_size(far_key.btree_key(), key.btree_key());
+            // (The extra byte covers the header's padding in case the
+            // rebuilt node ends up with a longer prefix than this.)
+            int new_node_cost = header_size_for_prefix(new_prefix_size) + 1
+                + node_cost + std::max(0, node_prefix_size - new_prefix_size) * node->num_pairs
+                + moved_cost + sz + (sibling_prefix_size - new_prefix_size) * (moved_count + 1);
+            if (new_node_cost > bs) {
+                out_of_space = true;
+                *w -= wstep;
+                break;
             }
+            moved_cost += sz;
+            ++moved_count;
+
+            prev_diff = sibling_weight - node_weight;
+            node_weight += sz + sibling_prefix_size;
+            sibling_weight -= sz + sibling_prefix_size;
         }
 
         if (end - beg == sibling->num_pairs - 1 || node_weight >= sibling_weight) {
@@ -1161,10 +1352,24 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
 
     guarantee(end - beg < sibling->num_pairs - 1);
 
-    if (prev_diff <= sibling_weight - node_weight) {
+    if (!out_of_space && prev_diff <= sibling_weight - node_weight) {
         *w -= wstep;
-        --num_mandatories;
-        weight_movement = prev_weight_movement;
+    }
+
+    // The key that separates the nodes afterwards is that of the last entry that
+    // node gets if it's on the left, or of the last entry that sibling keeps
+    // otherwise.  We make sure that it's a live entry's, since a deletion entry's
+    // key would linger in the parent node after the deletion entry is gone.
+    if (nodecmp_node_with_sib < 0) {
+        while (end >= beg
+               && !entry_is_live(get_entry(sibling, pair_offsets(sibling)[end]))) {
+            --end;
+        }
+    } else {
+        while (beg <= end
+               && !entry_is_live(get_entry(sibling, pair_offsets(sibling)[beg - 1]))) {
+            ++beg;
+        }
     }
 
     if (end < beg) {
@@ -1173,18 +1378,36 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
         return false;
     }
 
-    int sib_copysize = weight_movement - num_mandatories * sizeof(uint16_t);
+    // Deletions might all get dropped on the way, so make sure that
+    // node will actually get some keys.
+    bool moves_live_entry = false;
+    for (int i = beg; i <= end && !moves_live_entry; ++i) {
+        moves_live_entry = entry_is_live(get_entry(sibling, pair_offsets(sibling)[i]));
+    }
+    if (!moves_live_entry) {
+        return false;
+    }
+
     move_elements(sizer, sibling, beg, end + 1,
                   nodecmp_node_with_sib < 0 ? node->num_pairs : 0, node,
-                  sib_copysize, tstamp_back_offset, moved_values_out);
+                  tstamp_back_offset, nullptr, moved_values_out);
+
+    // The keys left in sibling might share a longer prefix now.  (We
+    // leave nodes without a key prefix alone, since rebuilding them
+    // needs a little more room for the header.)
+    if (has_key_prefix(sibling)) {
+        recompute_prefix(sizer, sibling, nullptr);
+    }
 
     guarantee(node->num_pairs > 0);
     guarantee(sibling->num_pairs > 0);
 
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        full_entry_key(node, get_entry(node, pair_offsets(node)[node->num_pairs - 1]),
+                       replacement_key_out);
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        full_entry_key(sibling, get_entry(sibling, pair_offsets(sibling)[sibling->num_pairs - 1]),
+                       replacement_key_out);
     }
 
     return true;
@@ -1198,6 +1421,21 @@ bool is_mergable(value_sizer_t *sizer, const leaf_node_t *node, const leaf_node_
 // for the key, or to the index the key would have if it were
 // inserted.  Returns true if the key at said index is actually equal.
 bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
+    // All of the node's keys begin with its key prefix, so a key that
+    // doesn't comes before or after all of them.  Otherwise we only
+    // need to compare what comes after the prefix.
+    int prefix_size = key_prefix_size(node);
+    int prefix_res = sized_strcmp(key->contents, std::min<int>(key->size, prefix_size),
+                                  key_prefix(node), prefix_size);
+    if (prefix_res != 0) {
+        *index_out = prefix_res < 0 ? 0 : node->num_pairs;
+        return false;
+    }
+    const uint8_t *key_suffix = key->contents + prefix_size;
+    const int key_suffix_size = key->size - prefix_size;
+    const uint64_t key_suffix_head = key_head(key_suffix, key_suffix_size);
+    const uint16_t *offsets = pair_offsets(node);
+
     int beg = 0;
     int end = node->num_pairs;
 
@@ -1208,9 +1446,10 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
-        const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
+        const btree_key_t *ek = entry_key(get_entry(node, offsets[test_point]));
 
-        int res = btree_key_cmp(key, ek);
+        int res = sized_strcmp_with_head(key_suffix_head, key_suffix, key_suffix_size,
+                                         ek->contents, ek->size);
 
         if (res < 0) {
             // key < *test_point.
@@ -1235,7 +1474,7 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
 bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, void *value_out) {
     int index;
     if (find_key(node, key, &index)) {
-        const entry_t *ent = get_entry(node, node->pair_offsets[index]);
+        const entry_t *ent = get_entry(node, pair_offsets(node)[index]);
         if (entry_is_live(ent)) {
             const void *val = entry_value(ent);
             memcpy(value_out, val, sizer->size(val));
@@ -1257,8 +1496,10 @@ appropriate, and maintaining `frontmost` and `tstamp_cutpoint`. The caller is
 responsible for writing the actual entry itself (including the key) and for
 updating `live_size` if the newly created entry is live.
 
-`new_entry_size` is the total size of the new entry, including key, value,
-and/or code byte, but not including repli timestamp.
+`new_entry_size_without_key` is the size of the new entry's value and/or code
+byte. The key only takes up what comes after the node's key prefix. If `key`
+doesn't begin with the key prefix, `prepare_space_for_new_entry()` first
+shortens the prefix.
 
 It is an error to put a deletion entry after `tstamp_cutpoint`. If the caller
 intends to insert a deletion entry, it should pass `false` for
@@ -1272,7 +1513,7 @@ MUST_USE bool prepare_space_for_new_entry(
         value_sizer_t *sizer,
         leaf_node_t *node,
         const btree_key_t *key,
-        int new_entry_size,
+        int new_entry_size_without_key,
         repli_timestamp_t tstamp,
         /* Used to derive the highest possible timestamp that non-timestamped
         entries might have. Usually the recency of the buf_t that node is in. */
@@ -1297,6 +1538,34 @@ MUST_USE bool prepare_space_for_new_entry(
     int gc_tstamp_cutoff_upper_bound;
     mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS - 1, &gc_tstamp_cutoff_upper_bound);
 
+    /* If `key` doesn't begin with the node's key prefix, it isn't in the node,
+    and we have to rebuild the node with a shorter prefix before we can add it.
+    That makes every other key longer. `is_full()` accounts for this, but a
+    deletion entry might not fit. In that case we drop the deletion entry and,
+    like below, all existing timestamps along with it. */
+    int new_prefix_size = matching_prefix_size(node, key);
+    if (new_prefix_size < key_prefix_size(node)) {
+        int ignore = 0;
+        garbage_collect(sizer, node, MANDATORY_TIMESTAMPS - 1, &ignore,
+                        make_optional(gc_tstamp_cutoff_upper_bound));
+        int rebuilt_size = header_size_for_prefix(new_prefix_size)
+            + sizeof(uint16_t) * (node->num_pairs + 1)
+            + (sizer->block_size().value() - node->frontmost)
+            + (key_prefix_size(node) - new_prefix_size) * node->num_pairs
+            + sizeof(repli_timestamp_t)
+            + new_entry_size_without_key + 1 + key->size - new_prefix_size;
+        if (rebuilt_size > static_cast<int>(sizer->block_size().value())) {
+            guarantee(!allow_after_tstamp_cutpoint);
+            erase_deletions(sizer, node, optional<repli_timestamp_t>());
+            return false;
+        }
+        recompute_prefix(sizer, node, key);
+        mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS - 1, &gc_tstamp_cutoff_upper_bound);
+    }
+
+    const int new_entry_size =
+        new_entry_size_without_key + 1 + key->size - key_prefix_size(node);
+
     /* Figure out where in `pair_offsets` to put the offset of the new entry,
     and simultaneously check for an existing entry for this key. If the entry
     already exists, clean it. */
@@ -1305,7 +1574,7 @@ MUST_USE bool prepare_space_for_new_entry(
     bool found = find_key(node, key, &index);
 
     if (found) {
-        int offset = node->pair_offsets[index];
+        int offset = pair_offsets(node)[index];
         entry_t *ent = get_entry(node, offset);
 
         int sz = entry_size(sizer, ent);
@@ -1336,7 +1605,7 @@ MUST_USE bool prepare_space_for_new_entry(
     We check for this condition further down, and recover from it by dropping
     all existing timestamps and discarding the delete entry by returning `false`. */
 
-    if (offsetof(leaf_node_t, pair_offsets) +
+    if (header_size(node) +
             sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1)) +
             sizeof(repli_timestamp_t) +
             new_entry_size >
@@ -1346,8 +1615,8 @@ MUST_USE bool prepare_space_for_new_entry(
             /* We can't re-use an existing index if we're garbage collecting. */
             found = false;
             memmove(
-                node->pair_offsets + index,
-                node->pair_offsets + index + 1,
+                pair_offsets(node) + index,
+                pair_offsets(node) + index + 1,
                 sizeof(uint16_t) * (node->num_pairs - index - 1));
             --node->num_pairs;
         }
@@ -1415,7 +1684,7 @@ MUST_USE bool prepare_space_for_new_entry(
     bool drop_timestamps = false;
     if (actually_create_entry
         && !allow_after_tstamp_cutpoint
-        && offsetof(leaf_node_t, pair_offsets)
+        && header_size(node)
            + sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1))
            + new_entry_size
            + sizeof(repli_timestamp_t)
@@ -1430,8 +1699,8 @@ MUST_USE bool prepare_space_for_new_entry(
             a new one; close the gap in `pair_offsets`. `index` is the location
             of the open slot. */
             memmove(
-                node->pair_offsets + index,
-                node->pair_offsets + index + 1,
+                pair_offsets(node) + index,
+                pair_offsets(node) + index + 1,
                 sizeof(uint16_t) * (node->num_pairs - index - 1));
             --node->num_pairs;
         }
@@ -1450,8 +1719,8 @@ MUST_USE bool prepare_space_for_new_entry(
 
     if (!found) {
         memmove(
-            node->pair_offsets + index + 1,
-            node->pair_offsets + index,
+            pair_offsets(node) + index + 1,
+            pair_offsets(node) + index,
             sizeof(uint16_t) * (node->num_pairs - index));
         ++node->num_pairs;
     }
@@ -1476,14 +1745,14 @@ MUST_USE bool prepare_space_for_new_entry(
         the entries */
         for (int i = 0; i < node->num_pairs; ++i) {
             if (i == index) continue;
-            if (node->pair_offsets[i] < end_of_where_new_entry_should_go) {
-                node->pair_offsets[i] -= total_space_for_new_entry;
+            if (pair_offsets(node)[i] < end_of_where_new_entry_should_go) {
+                pair_offsets(node)[i] -= total_space_for_new_entry;
             }
         }
     }
 
     node->frontmost -= total_space_for_new_entry;
-    guarantee(offsetof(leaf_node_t, pair_offsets)
+    guarantee(header_size(node)
               + sizeof(uint16_t) * node->num_pairs <= node->frontmost);
 
     /* Write the timestamp if we need one, and update `node->tstamp_cutpoint` if
@@ -1499,7 +1768,7 @@ MUST_USE bool prepare_space_for_new_entry(
 
     /* Record the offset in `pair_offsets` */
 
-    node->pair_offsets[index] = start_of_where_new_entry_should_go;
+    pair_offsets(node)[index] = start_of_where_new_entry_should_go;
 
     /* Fill output variable */
 
@@ -1513,6 +1782,18 @@ MUST_USE bool prepare_space_for_new_entry(
     return true;
 }
 
+// Writes what comes after `node`'s key prefix in `key` to `location`, in
+// the same format as a `btree_key_t`, and returns the number of bytes
+// written.
+int write_key_suffix(const leaf_node_t *node, const btree_key_t *key, char *location) {
+    int prefix_size = key_prefix_size(node);
+    rassert(matching_prefix_size(node, key) == prefix_size);
+    uint8_t suffix_size = key->size - prefix_size;
+    *location = suffix_size;
+    memcpy(location + 1, key->contents + prefix_size, suffix_size);
+    return 1 + suffix_size;
+}
+
 // Inserts a key/value pair into the node.  Hopefully you've already
 // cleaned up the old value, if there is one.
 void insert(
@@ -1528,18 +1809,18 @@ void insert(
 
     char *location_to_write_data;
     bool should_write = prepare_space_for_new_entry(sizer, node,
-        key, key->full_size() + sizer->size(value), tstamp, maximum_existing_tstamp,
+        key, sizer->size(value), tstamp, maximum_existing_tstamp,
         true,
         &location_to_write_data);
     guarantee(should_write);
 
     /* Now copy the data into the node itself */
 
-    memcpy(location_to_write_data, key, key->full_size());
-    location_to_write_data += key->full_size();
+    int suffix_size = write_key_suffix(node, key, location_to_write_data);
+    location_to_write_data += suffix_size;
     memcpy(location_to_write_data, value, sizer->size(value));
 
-    node->live_size += sizeof(uint16_t) + key->full_size() + sizer->size(value);
+    node->live_size += sizeof(uint16_t) + suffix_size + sizer->size(value);
 
     validate(sizer, node);
 }
@@ -1558,14 +1839,14 @@ void remove(
     char *location_to_write_data;
     if (prepare_space_for_new_entry(sizer, node,
             key,
-            1 + key->full_size(),   /* 1 for `DELETE_ENTRY_CODE` */
+            1,   /* for `DELETE_ENTRY_CODE` */
             tstamp,
             maximum_existing_tstamp,
             false,
             &location_to_write_data)) {
         *location_to_write_data = static_cast<char>(DELETE_ENTRY_CODE);
         ++location_to_write_data;
-        memcpy(location_to_write_data, key, key->full_size());
+        write_key_suffix(node, key, location_to_write_data);
     }
 
     validate(sizer, node);
@@ -1576,7 +1857,7 @@ void erase_presence(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *
     int index;
     bool found = find_key(node, key, &index);
     if (found) {
-        int offset = node->pair_offsets[index];
+        int offset = pair_offsets(node)[index];
         entry_t *ent = get_entry(node, offset);
 
         int sz = entry_size(sizer, ent);
@@ -1586,7 +1867,7 @@ void erase_presence(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *
 
         clean_entry(ent, sz);
 
-        memmove(node->pair_offsets + index, node->pair_offsets + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t));
+        memmove(pair_offsets(node) + index, pair_offsets(node) + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t));
         node->num_pairs -= 1;
     }
 
@@ -1668,13 +1949,13 @@ void erase_deletions(
     int src = 0, dst = 0;
     int num_deleted = deletion_offsets.size();
     for (; src < node->num_pairs; ++src) {
-        uint16_t off = node->pair_offsets[src];
+        uint16_t off = pair_offsets(node)[src];
         auto it = deletion_offsets.find(off);
         if (it == deletion_offsets.end()) {
             if (off >= new_tstamp_cutpoint && off < old_tstamp_cutpoint) {
                 off += sizeof(repli_timestamp_t);
             }
-            node->pair_offsets[dst++] = off;
+            pair_offsets(node)[dst++] = off;
         } else {
             guarantee(off >= new_tstamp_cutpoint && off < old_tstamp_cutpoint);
             deletion_offsets.erase(it);
@@ -1700,6 +1981,7 @@ continue_bool_t visit_entries(
             const void *value   /* null for deletion */
             )> &cb) {
     repli_timestamp_t earliest_so_far = maximum_existing_timestamp;
+    store_key_t key;
     for (entry_iter_t iter = entry_iter_t::make(node);
             !iter.done(sizer); iter.step(sizer, node)) {
         repli_timestamp_t tstamp;
@@ -1716,7 +1998,8 @@ continue_bool_t visit_entries(
             continue;
         }
 
-        if (continue_bool_t::ABORT == cb(entry_key(ent), tstamp, entry_value(ent))) {
+        full_entry_key(node, ent, key.btree_key());
+        if (continue_bool_t::ABORT == cb(key.btree_key(), tstamp, entry_value(ent))) {
             return continue_bool_t::ABORT;
         }
     }
@@ -1732,8 +2015,9 @@ iterator::iterator(const leaf_node_t *node, int index)
 std::pair<const btree_key_t *, const void *> iterator::operator*() const {
     guarantee(index_ < static_cast<int>(node_->num_pairs));
     guarantee(index_ >= 0);
-    const entry_t *entree = get_entry(node_, node_->pair_offsets[index_]);
-    return std::make_pair(entry_key(entree), entry_value(entree));
+    const entry_t *entree = get_entry(node_, pair_offsets(node_)[index_]);
+    full_entry_key(node_, entree, key_.btree_key());
+    return std::make_pair(key_.btree_key(), entry_value(entree));
 }
 
 iterator &iterator::operator++() {
@@ -1741,7 +2025,7 @@ iterator &iterator::operator++() {
               "Trying to increment past the end of an iterator.");
     do {
         ++index_;
-    } while (index_ < node_->num_pairs && !entry_is_live(get_entry(node_, node_->pair_offsets[index_])));
+    } while (index_ < node_->num_pairs && !entry_is_live(get_entry(node_, pair_offsets(node_)[index_])));
     return *this;
 }
 
@@ -1749,7 +2033,7 @@ iterator &iterator::operator--() {
     guarantee(index_ > -1, "Trying to decrement past the beginning of an iterator.");
     do {
         --index_;
-    } while (index_ >= 0 && !entry_is_live(get_entry(node_, node_->pair_offsets[index_])));
+    } while (index_ >= 0 && !entry_is_live(get_entry(node_, pair_offsets(node_)[index_])));
     return *this;
 }
 
@@ -1812,7 +2096,7 @@ leaf::iterator inclusive_lower_bound(const btree_key_t *key, const leaf_node_t &
     int index;
     leaf::find_key(&leaf_node, key, &index);
     if (index == leaf_node.num_pairs ||
-        entry_is_live(leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]))) {
+        entry_is_live(leaf::get_entry(&leaf_node, pair_offsets(&leaf_node)[index]))) {
         return leaf_node_t::iterator(&leaf_node, index);
     } else {
         return ++leaf_node_t::iterator(&leaf_node, index);
@@ -1821,12 +2105,10 @@ leaf::iterator inclusive_lower_bound(const btree_key_t *key, const leaf_node_t &
 
 leaf::reverse_iterator exclusive_upper_bound(const btree_key_t *key, const leaf_node_t &leaf_node) {
     int index;
-    leaf::find_key(&leaf_node, key, &index);
+    bool found = leaf::find_key(&leaf_node, key, &index);
     if (index < leaf_node.num_pairs) {
-        const leaf::entry_t *entry = leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]);
-        const btree_key_t *ekey = leaf::entry_key(entry);
-        if (entry_is_live(entry) &&
-            btree_key_cmp(ekey, key) == 0) {
+        const leaf::entry_t *entry = leaf::get_entry(&leaf_node, pair_offsets(&leaf_node)[index]);
+        if (entry_is_live(entry) && found) {
             // We have to skip this entry to make the iterator exclusive,
             // hence the ++.
             return ++leaf_node_t::reverse_iterator(&leaf_node, index);
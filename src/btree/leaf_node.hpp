@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "arch/compiler.hpp"
+#include "btree/keys.hpp"
 #include "btree/types.hpp"
 #include "buffer_cache/types.hpp"
 #include "containers/optional.hpp"
@@ -20,10 +21,18 @@ class iterator;
 class reverse_iterator;
 } //namespace leaf
 
-// The leaf node begins with the following struct layout.
+// The leaf node begins with the following struct layout.  Leaf nodes
+// written by this version carry a key prefix shared by all of their
+// entries: the struct is followed by a one-byte prefix size, the
+// prefix bytes, and padding to a 2-byte boundary, and then the pair
+// offsets.  Such nodes have the high bit of their magic's last byte
+// set.  Nodes with the sizer's plain magic have an empty prefix and
+// their pair offsets directly follow the struct.
 ATTR_PACKED(struct leaf_node_t {
     // The value-type-specific magic value.  It's a bit of a hack, but
     // it's possible to construct a value_sizer_t based on this value.
+    // (The magic of a prefix-compressed node has the high bit of its
+    // last byte set.)
     block_magic_t magic;
 
     // The size of pair_offsets.
@@ -40,9 +49,6 @@ ATTR_PACKED(struct leaf_node_t {
     // The first offset whose entry is not accompanied by a timestamp.
     uint16_t tstamp_cutpoint;
 
-    // The pair offsets.
-    uint16_t pair_offsets[];
-
     //Iteration
     typedef leaf::iterator iterator;
     typedef leaf::reverse_iterator reverse_iterator;
@@ -99,6 +105,14 @@ protected:
     DISABLE_COPYING(key_value_fscker_t);
 };
 
+// Returns true if `magic` is `sizer`'s leaf magic, with or without the
+// prefix compression bit.
+bool is_leaf_magic(value_sizer_t *sizer, block_magic_t magic);
+
+// The number of bytes at the start of every key in `node`, which are
+// stored once in the node's header instead of in every entry.
+int key_prefix_size(const leaf_node_t *node);
+
 bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const btree_key_t *right_inclusive_or_null, const leaf_node_t *node, key_value_fscker_t *fscker, std::string *msg_out);
 
 void validate(value_sizer_t *sizer, const leaf_node_t *node);
@@ -111,8 +125,11 @@ bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *k
 
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node);
 
+// `key_to_insert_or_null` is the key whose insertion made the split
+// necessary.  A key that doesn't share `node`'s prefix goes into a
+// node of its own, since re-encoding `node` around it might not fit.
 void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *sibling,
-           btree_key_t *median_out);
+           btree_key_t *median_out, const btree_key_t *key_to_insert_or_null);
 
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right);
 
@@ -167,7 +184,8 @@ void erase_deletions(
 
 /* Calls `cb` on every entry in the node, whether a real entry or a deletion. The calls
 will be in order from most recent to least recent. For entries with no timestamp, the
-callback will get `min_deletion_timestamp() - 1`. */
+callback will get `min_deletion_timestamp() - 1`. The key passed to `cb` is only valid
+for the duration of the call. */
 continue_bool_t visit_entries(
     value_sizer_t *sizer,
     const leaf_node_t *node,
@@ -179,6 +197,9 @@ continue_bool_t visit_entries(
         const void *value   /* null for deletion */
         )> &cb);
 
+// The key returned by `operator*` is reassembled from the node's key
+// prefix, so it lives in the iterator and is only valid until the
+// iterator is dereferenced again or destroyed.
 class iterator {
 public:
     iterator();
@@ -197,6 +218,7 @@ private:
     int cmp(const iterator &other) const;
     const leaf_node_t *node_;
     int index_;
+    mutable store_key_t key_;
 };
 
 class reverse_iterator {
@@ -5,11 +5,14 @@
 #include "btree/internal_node.hpp"
 
 const block_magic_t internal_node_t::expected_magic = { { 'i', 'n', 't', 'e' } };
+// Like the leaf nodes' prefix magics, this has the high bit of its last byte set.
+const block_magic_t internal_node_t::key_prefix_magic =
+    { { 'i', 'n', 't', static_cast<char>('e' | 0x80) } };
 
 namespace node {
 
 bool is_underfull(value_sizer_t *sizer, const node_t *node) {
-    if (node->magic == sizer->btree_leaf_magic()) {
+    if (leaf::is_leaf_magic(sizer, node->magic)) {
         return leaf::is_underfull(sizer, reinterpret_cast<const leaf_node_t *>(node));
     } else {
         rassert(is_internal(node));
@@ -18,7 +21,7 @@ bool is_underfull(value_sizer_t *sizer, const node_t *node) {
 }
 
 bool is_mergable(value_sizer_t *sizer, const node_t *node, const node_t *sibling, const internal_node_t *parent) {
-    if (sizer->btree_leaf_magic() == node->magic) {
+    if (leaf::is_leaf_magic(sizer, node->magic)) {
         return leaf::is_mergable(sizer, reinterpret_cast<const leaf_node_t *>(node), reinterpret_cast<const leaf_node_t *>(sibling));
     } else {
         rassert(is_internal(node));
@@ -27,10 +30,11 @@ bool is_mergable(value_sizer_t *sizer, const node_t *node, const node_t *sibling
 }
 
 
-void split(value_sizer_t *sizer, node_t *node, node_t *rnode, btree_key_t *median) {
+void split(value_sizer_t *sizer, node_t *node, node_t *rnode, btree_key_t *median,
+           const btree_key_t *key_to_insert) {
     if (is_leaf(node)) {
         leaf::split(sizer, reinterpret_cast<leaf_node_t *>(node),
-                    reinterpret_cast<leaf_node_t *>(rnode), median);
+                    reinterpret_cast<leaf_node_t *>(rnode), median, key_to_insert);
     } else {
         internal_node::split(sizer->block_size(), reinterpret_cast<internal_node_t *>(node),
                              reinterpret_cast<internal_node_t *>(rnode), median);
@@ -47,9 +51,9 @@ void merge(value_sizer_t *sizer, node_t *node, node_t *rnode, const internal_nod
 
 void validate(DEBUG_VAR value_sizer_t *sizer, DEBUG_VAR const node_t *node) {
 #ifndef NDEBUG
-    if (node->magic == sizer->btree_leaf_magic()) {
+    if (leaf::is_leaf_magic(sizer, node->magic)) {
         leaf::validate(sizer, reinterpret_cast<const leaf_node_t *>(node));
-    } else if (node->magic == internal_node_t::expected_magic) {
+    } else if (is_internal(node)) {
         internal_node::validate(sizer->block_size(), reinterpret_cast<const internal_node_t *>(node));
     } else {
         unreachable("Invalid leaf node type.");
@@ -43,6 +43,12 @@ static const uint32_t BTREE_STATBLOCK_SIZE = sizeof(btree_statblock_t);
 
 
 //Note: This struct is stored directly on disk.  Changing it invalidates old data.
+// Nodes with the `key_prefix_magic` store a prefix of their keys right after their
+// pair offsets:
+// [magic][npairs][frontmost][off0]...[offN-1][begin][end][size][prefix]...[pair]...
+// The keys of the pairs with indices in [begin, end) start with the prefix, and
+// those pairs only store the rest of their key.  Nodes with the `expected_magic`
+// have no key prefix.
 ATTR_PACKED(struct internal_node_t {
     block_magic_t magic;
     uint16_t npairs;
@@ -50,6 +56,7 @@ ATTR_PACKED(struct internal_node_t {
     uint16_t pair_offsets[0];
 
     static const block_magic_t expected_magic;
+    static const block_magic_t key_prefix_magic;
 });
 
 // A node_t is either a btree_internal_node or a btree_leaf_node.
@@ -60,7 +67,8 @@ ATTR_PACKED(struct node_t {
 namespace node {
 
 inline bool is_internal(const node_t *node) {
-    if (node->magic == internal_node_t::expected_magic) {
+    if (node->magic == internal_node_t::expected_magic
+        || node->magic == internal_node_t::key_prefix_magic) {
         return true;
     }
     return false;
@@ -77,7 +85,9 @@ bool is_mergable(value_sizer_t *sizer, const node_t *node, const node_t *sibling
 
 bool is_underfull(value_sizer_t *sizer, const node_t *node);
 
-void split(value_sizer_t *sizer, node_t *node, node_t *rnode, btree_key_t *median);
+// `key_to_insert` is the key whose insertion made the split necessary.
+void split(value_sizer_t *sizer, node_t *node, node_t *rnode, btree_key_t *median,
+           const btree_key_t *key_to_insert);
 
 void merge(value_sizer_t *sizer, node_t *node, node_t *rnode, const internal_node_t *parent);
 
@@ -113,7 +113,7 @@ void check_and_handle_split(value_sizer_t *sizer,
         node::split(sizer,
                     static_cast<node_t *>(buf_write.get_data_write()),
                     static_cast<node_t *>(rbuf_write.get_data_write()),
-                    median);
+                    median, key);
 
         // We must detach all entries that we have removed from `buf`.
         buf_read_t rbuf_read(&rbuf);
@@ -147,7 +147,8 @@ void check_and_handle_split(value_sizer_t *sizer,
     {
         buf_write_t last_write(last_buf);
         DEBUG_VAR bool success
-            = internal_node::insert(static_cast<internal_node_t *>(last_write.get_data_write()),
+            = internal_node::insert(sizer->block_size(),
+                                    static_cast<internal_node_t *>(last_write.get_data_write()),
                                     median,
                                     buf->block_id(), rbuf.block_id());
         rassert(success, "could not insert internal btree node");
@@ -350,7 +351,8 @@ void check_and_handle_underfull(value_sizer_t *sizer,
 
             if (leveled) {
                 buf_write_t last_buf_write(last_buf);
-                internal_node::update_key(static_cast<internal_node_t *>(last_buf_write.get_data_write()),
+                internal_node::update_key(sizer->block_size(),
+                                          static_cast<internal_node_t *>(last_buf_write.get_data_write()),
                                           key_in_middle.btree_key(),
                                           replacement_key);
             }
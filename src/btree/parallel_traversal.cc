@@ -601,13 +601,14 @@ void ranged_block_ids_t::get_block_id_and_bounding_interval(int index,
 
         const btree_internal_pair *pair = internal_node::get_pair_by_index(node_.get(), index);
         *block_id_out = pair->lnode;
-        *right_incl_bound_out = (index == node_->npairs - 1 ? right_inclusive_or_null_ : &pair->key);
+        *right_incl_bound_out = (index == node_->npairs - 1
+                                 ? right_inclusive_or_null_
+                                 : keys_[index].btree_key());
 
         if (index == 0) {
             *left_excl_bound_out = left_exclusive_or_null_;
         } else {
-            const btree_internal_pair *left_neighbor = internal_node::get_pair_by_index(node_.get(), index - 1);
-            *left_excl_bound_out = &left_neighbor->key;
+            *left_excl_bound_out = keys_[index - 1].btree_key();
         }
     } else {
         *block_id_out = forced_block_id_;
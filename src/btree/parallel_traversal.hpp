@@ -12,6 +12,7 @@
 #include "concurrency/interruptor.hpp"
 #include "concurrency/signal.hpp"
 #include "containers/scoped.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 
 class buf_lock_t;
@@ -50,6 +51,9 @@ public:
           level(_level)
     {
         memcpy(node_.get(), node, bs.value());
+        for (int i = 0; i < node->npairs - 1; ++i) {
+            keys_.push_back(internal_node::get_key_by_index(node, i));
+        }
     }
     ranged_block_ids_t(block_id_t forced_block_id,
                        const btree_key_t *left_exclusive_or_null,
@@ -72,6 +76,8 @@ public:
 
 private:
     scoped_malloc_t<internal_node_t> node_;
+    // The keys of `node_`, which might only store the rest of them after a prefix.
+    std::vector<store_key_t> keys_;
     block_id_t forced_block_id_;
     const btree_key_t *left_exclusive_or_null_;
     const btree_key_t *right_inclusive_or_null_;
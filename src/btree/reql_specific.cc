@@ -142,6 +142,10 @@ block_id_t sindex_superblock_t::get_sindex_block_id() {
 // Run backfilling at a reduced priority
 #define BACKFILL_CACHE_PRIORITY 10
 
+// Range reads run at the same priority as other reads; they only get their own
+// account so that the cache knows they're scans.
+#define RANGE_READ_CACHE_PRIORITY 100
+
 void btree_slice_t::init_real_superblock(real_superblock_t *superblock,
                                          const std::vector<char> &metainfo_key,
                                          const binary_blob_t &metainfo_value) {
@@ -186,7 +190,10 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
             (index_type == index_type_t::SECONDARY ? "index-" : "") + identifier,
             get_num_threads()),
       cache_(c),
-      backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)) { }
+      backfill_account_(cache()->create_cache_account(
+          BACKFILL_CACHE_PRIORITY, cache_access_pattern_t::sequential)),
+      range_read_account_(cache()->create_cache_account(
+          RANGE_READ_CACHE_PRIORITY, cache_access_pattern_t::sequential)) { }
 
 btree_slice_t::~btree_slice_t() { }
 
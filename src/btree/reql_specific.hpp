@@ -2,6 +2,7 @@
 #ifndef BTREE_REQL_SPECIFIC_HPP_
 #define BTREE_REQL_SPECIFIC_HPP_
 
+#include "btree/key_filter.hpp"
 #include "btree/operations.hpp"
 
 /* Most of the code in the `btree/` directory doesn't "know" about the format of the
@@ -97,15 +98,22 @@ public:
 
     cache_t *cache() { return cache_; }
     cache_account_t *get_backfill_account() { return &backfill_account_; }
+    cache_account_t *get_range_read_account() { return &range_read_account_; }
 
     btree_stats_t stats;
 
+    // Only ever built for primary B-trees, by `store_t`.
+    btree_key_filter_t key_filter;
+
 private:
     cache_t *cache_;
 
     // Cache account to be used when backfilling.
     cache_account_t backfill_account_;
 
+    // Cache account to be used for range reads.
+    cache_account_t range_read_account_;
+
     DISABLE_COPYING(btree_slice_t);
 };
 
@@ -113,8 +113,19 @@ cache_t::~cache_t() {
     guarantee(snapshot_nodes_by_block_id_.empty());
 }
 
-cache_account_t cache_t::create_cache_account(int priority) {
-    return page_cache_.create_cache_account(priority);
+uint64_t cache_t::memory_limit() {
+    assert_thread();
+    return page_cache_.evicter().memory_limit();
+}
+
+void cache_t::set_extra_memory_usage(uint64_t bytes) {
+    assert_thread();
+    page_cache_.evicter().set_extra_memory_usage(bytes);
+}
+
+cache_account_t cache_t::create_cache_account(int priority,
+                                              cache_access_pattern_t access_pattern) {
+    return page_cache_.create_cache_account(priority, access_pattern);
 }
 
 alt_snapshot_node_t *
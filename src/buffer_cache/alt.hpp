@@ -48,12 +48,21 @@ public:
 
     max_block_size_t max_block_size() const { return page_cache_.max_block_size(); }
 
+    // The memory limit that the cache balancer currently gives this cache.
+    uint64_t memory_limit();
+
+    // Memory that is used on behalf of this cache outside of the cache itself, like
+    // the key filter of a B-tree.  Pages get evicted to keep it within the memory limit.
+    void set_extra_memory_usage(uint64_t bytes);
+
     // These todos come from the mirrored cache.  The real problem is that whole
     // cache account / priority thing is just one ghetto hack amidst a dozen other
     // throttling systems.  TODO: Come up with a consistent priority scheme,
     // i.e. define a "default" priority etc.  TODO: As soon as we can support it, we
     // might consider supporting a mem_cap paremeter.
-    cache_account_t create_cache_account(int priority);
+    cache_account_t create_cache_account(
+        int priority,
+        cache_access_pattern_t access_pattern = cache_access_pattern_t::random);
 
 private:
     friend class txn_t;
@@ -9,6 +9,14 @@ namespace alt {
 class page_cache_t;
 }
 
+// How the pages touched through a cache account are going to be used.  The evicter
+// doesn't let pages that were only touched by sequential scans (range reads,
+// backfills, index construction) push out pages that get used over and over.
+enum class cache_access_pattern_t {
+    random,
+    sequential
+};
+
 class cache_account_t {
 public:
     cache_account_t();
@@ -19,17 +27,22 @@ public:
     file_account_t *get() const {
         return io_account_;
     }
+    cache_access_pattern_t access_pattern() const {
+        return access_pattern_;
+    }
 private:
     friend class alt::page_cache_t;
     // Takes ownership of the file_account_t pointee.
     void init(threadnum_t thread, file_account_t *io_account);
-    cache_account_t(threadnum_t thread, file_account_t *io_account);
+    cache_account_t(threadnum_t thread, file_account_t *io_account,
+                    cache_access_pattern_t access_pattern);
     void reset();
 
     // I hate having this thread_ variable.  The file_account_t does need to be
     // destroyed on the right thread, though.
     threadnum_t thread_;
     file_account_t *io_account_;
+    cache_access_pattern_t access_pattern_;
     DISABLE_COPYING(cache_account_t);
 };
 
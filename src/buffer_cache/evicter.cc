@@ -1,5 +1,7 @@
 #include "buffer_cache/evicter.hpp"
 
+#include <algorithm>
+
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/page.hpp"
@@ -8,16 +10,26 @@
 
 namespace alt {
 
+// The probationary segment gets 1/PROBATIONARY_SHARE_DIVISOR of the memory limit.
+// The 2Q paper suggests a quarter.
+const uint64_t PROBATIONARY_SHARE_DIVISOR = 4;
+
+// We remember as many recently evicted blocks as would fill
+// 1/RECENTLY_EVICTED_SHARE_DIVISOR of the memory limit.
+const uint64_t RECENTLY_EVICTED_SHARE_DIVISOR = 2;
+
 evicter_t::evicter_t()
     : initialized_(false),
       page_cache_(nullptr),
       balancer_(nullptr),
       balancer_notify_activity_boolean_(nullptr),
       throttler_(nullptr),
+      extra_memory_usage_(0),
       bytes_loaded_counter_(0),
       access_count_counter_(0),
       access_time_counter_(INITIAL_ACCESS_TIME),
-      evict_if_necessary_active_(false) { }
+      evict_if_necessary_active_(false),
+      recently_evicted_counter_(0) { }
 
 evicter_t::~evicter_t() {
     assert_thread();
@@ -154,7 +166,9 @@ void evicter_t::add_to_evictable_unbacked(page_t *page) {
 void evicter_t::add_to_evictable_disk_backed(page_t *page) {
     assert_thread();
     guarantee(initialized_);
-    evictable_disk_backed_.add(page, page->hypothetical_memory_usage(page_cache_));
+    eviction_bag_t *bag = correct_eviction_category(page);
+    rassert(bag == &evictable_probationary_ || bag == &evictable_protected_);
+    bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
@@ -165,7 +179,8 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     rassert(unevictable_.has_page(page));
     unevictable_.remove(page, page->hypothetical_memory_usage(page_cache_));
     eviction_bag_t *new_bag = correct_eviction_category(page);
-    rassert(new_bag == &evictable_disk_backed_
+    rassert(new_bag == &evictable_probationary_
+            || new_bag == &evictable_protected_
             || new_bag == &evictable_unbacked_);
     new_bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
@@ -190,7 +205,7 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (!page->is_loaded()) {
         return &evicted_;
     } else if (page->is_disk_backed()) {
-        return &evictable_disk_backed_;
+        return page->is_reused() ? &evictable_protected_ : &evictable_probationary_;
     } else {
         return &evictable_unbacked_;
     }
@@ -208,8 +223,82 @@ uint64_t evicter_t::in_memory_size() const {
     assert_thread();
     guarantee(initialized_);
     return unevictable_.size()
-        + evictable_disk_backed_.size()
-        + evictable_unbacked_.size();
+        + evictable_probationary_.size()
+        + evictable_protected_.size()
+        + evictable_unbacked_.size()
+        + extra_memory_usage_;
+}
+
+void evicter_t::set_extra_memory_usage(uint64_t bytes) {
+    assert_thread();
+    guarantee(initialized_);
+    extra_memory_usage_ = bytes;
+    evict_if_necessary();
+}
+
+bool evicter_t::forget_recently_evicted(block_id_t block_id) {
+    assert_thread();
+    return recently_evicted_.erase(block_id) != 0;
+}
+
+bool evicter_t::page_is_in_probationary_segment(page_t *page) const {
+    assert_thread();
+    return evictable_probationary_.has_page(page);
+}
+
+bool evicter_t::page_is_in_protected_segment(page_t *page) const {
+    assert_thread();
+    return evictable_protected_.has_page(page);
+}
+
+uint64_t evicter_t::probationary_segment_size() const {
+    assert_thread();
+    return evictable_probationary_.size();
+}
+
+uint64_t evicter_t::protected_segment_size() const {
+    assert_thread();
+    return evictable_protected_.size();
+}
+
+bool evicter_t::block_is_recently_evicted(block_id_t block_id) const {
+    assert_thread();
+    return recently_evicted_.count(block_id) != 0;
+}
+
+size_t evicter_t::recently_evicted_count() const {
+    assert_thread();
+    return recently_evicted_.size();
+}
+
+void evicter_t::remember_recently_evicted(block_id_t block_id) {
+    const uint64_t capacity = std::max<uint64_t>(
+        1,
+        memory_limit_ / RECENTLY_EVICTED_SHARE_DIVISOR
+        / page_cache_->max_block_size().ser_value());
+
+    const uint64_t sequence_number = ++recently_evicted_counter_;
+    recently_evicted_[block_id] = sequence_number;
+    recently_evicted_order_.push_back(std::make_pair(block_id, sequence_number));
+
+    while (recently_evicted_.size() > capacity
+           || recently_evicted_order_.size() > 2 * capacity) {
+        const std::pair<block_id_t, uint64_t> oldest = recently_evicted_order_.front();
+        recently_evicted_order_.pop_front();
+        auto it = recently_evicted_.find(oldest.first);
+        if (it != recently_evicted_.end() && it->second == oldest.second) {
+            recently_evicted_.erase(it);
+        }
+    }
+}
+
+eviction_bag_t *evicter_t::segment_to_evict_from() {
+    if (evictable_probationary_.size() > memory_limit_ / PROBATIONARY_SHARE_DIVISOR
+        || evictable_protected_.size() == 0) {
+        return &evictable_probationary_;
+    } else {
+        return &evictable_protected_;
+    }
 }
 
 void evicter_t::evict_if_necessary() THROWS_NOTHING {
@@ -229,9 +318,15 @@ void evicter_t::evict_if_necessary() THROWS_NOTHING {
 
     evict_if_necessary_active_ = true;
     page_t *page;
-    while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_,
-                                                   page_cache_)) {
+    while (in_memory_size() > memory_limit_) {
+        eviction_bag_t *segment = segment_to_evict_from();
+        if (!segment->remove_oldish(&page, access_time_counter_, page_cache_)) {
+            break;
+        }
+        // Pages that were only ever touched by scans aren't worth remembering.
+        if (segment == &evictable_probationary_ && page->is_accessed()) {
+            remember_recently_evicted(page->block_id());
+        }
         evicted_.add(page, page->hypothetical_memory_usage(page_cache_));
         page->evict_self(page_cache_);
         page_cache_->consider_evicting_current_page(page->block_id());
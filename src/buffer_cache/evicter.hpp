@@ -3,12 +3,16 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <functional>
+#include <unordered_map>
+#include <utility>
 
 #include "buffer_cache/eviction_bag.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cache_line_padded.hpp"
 #include "concurrency/pubsub.hpp"
+#include "serializer/types.hpp"
 #include "threading.hpp"
 
 class cache_balancer_t;
@@ -18,6 +22,17 @@ namespace alt {
 
 class page_cache_t;
 
+/* The evicter keeps loaded, disk-backed pages in two segments, in the manner of
+2Q.  Pages start out in the probationary segment and move to the protected
+segment when they get accessed again (see `page_t::is_reused()`).  Eviction takes
+pages from the probationary segment for as long as it's bigger than its share of
+the memory limit, so a large scan can only ever displace that share of the cache.
+
+Accesses through accounts with a sequential access pattern never promote a page.
+To catch pages that get reused at a longer interval than the probationary segment
+can hold on to them, we remember the block ids of some pages that were recently
+evicted from it; if one of them gets loaded again, it goes straight to the
+protected segment. */
 class evicter_t : public home_thread_mixin_debug_only_t {
 public:
     void add_not_yet_loaded(page_t *page);
@@ -35,6 +50,18 @@ public:
     void remove_page(page_t *page);
     void reloading_page(page_t *page);
 
+    // Returns true if the block was recently evicted from the probationary segment,
+    // and forgets about it.
+    bool forget_recently_evicted(block_id_t block_id);
+
+    // These are for the unit tests.
+    bool page_is_in_probationary_segment(page_t *page) const;
+    bool page_is_in_protected_segment(page_t *page) const;
+    uint64_t probationary_segment_size() const;
+    uint64_t protected_segment_size() const;
+    bool block_is_recently_evicted(block_id_t block_id) const;
+    size_t recently_evicted_count() const;
+
     // Evicter will be unusable until initialize is called
     evicter_t();
     ~evicter_t();
@@ -58,6 +85,11 @@ public:
 
     uint64_t in_memory_size() const;
 
+    // Sets the amount of memory that is used on behalf of this cache outside of its
+    // pages.  It counts towards `in_memory_size()`, so pages get evicted to make room
+    // for it.
+    void set_extra_memory_usage(uint64_t bytes);
+
     // This is decremented past UINT64_MAX to force code to be aware of access time
     // rollovers.
     static const uint64_t INITIAL_ACCESS_TIME = UINT64_MAX - 100;
@@ -71,6 +103,11 @@ private:
     // Evicts any evictable pages until under the memory limit
     void evict_if_necessary() THROWS_NOTHING;
 
+    // Picks the segment that the next page to be evicted should come from.
+    eviction_bag_t *segment_to_evict_from();
+
+    void remember_recently_evicted(block_id_t block_id);
+
     bool initialized_;
     page_cache_t *page_cache_;
     cache_balancer_t *balancer_;
@@ -79,6 +116,7 @@ private:
     alt_txn_throttler_t *throttler_;
 
     uint64_t memory_limit_;
+    uint64_t extra_memory_usage_;
 
     // These are updated every time a page is loaded, created, or destroyed, and
     // cleared when cache memory limits are re-evaluated.  This value can go
@@ -95,10 +133,19 @@ private:
 
     // These track every page's eviction status.
     eviction_bag_t unevictable_;
-    eviction_bag_t evictable_disk_backed_;
+    eviction_bag_t evictable_probationary_;
+    eviction_bag_t evictable_protected_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
+    // Block ids of pages that were recently evicted from `evictable_probationary_`,
+    // in the order they were evicted in.  A block that gets remembered more than
+    // once appears in `recently_evicted_order_` more than once, but only its latest
+    // sequence number is in `recently_evicted_`.
+    std::unordered_map<block_id_t, uint64_t> recently_evicted_;
+    std::deque<std::pair<block_id_t, uint64_t> > recently_evicted_order_;
+    uint64_t recently_evicted_counter_;
+
     auto_drainer_t drainer_;
 
     DISABLE_COPYING(evicter_t);
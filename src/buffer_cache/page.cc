@@ -56,6 +56,8 @@ page_t::page_t(block_id_t _block_id, page_cache_t *page_cache)
     : block_id_(_block_id),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_(false),
+      reused_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_deferred_loaded(this);
 
@@ -70,6 +72,8 @@ page_t::page_t(block_id_t _block_id, page_cache_t *page_cache,
     : block_id_(_block_id),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_(false),
+      reused_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
 
@@ -86,6 +90,8 @@ page_t::page_t(block_id_t _block_id, buf_ptr_t buf,
       loader_(nullptr),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_(false),
+      reused_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
@@ -100,6 +106,8 @@ page_t::page_t(block_id_t _block_id,
       buf_(std::move(buf)),
       block_token_(_block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      accessed_(false),
+      reused_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -109,6 +117,8 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *accoun
     : block_id_(copyee->block_id_),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_(copyee->accessed_),
+      reused_(copyee->reused_),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -411,10 +421,18 @@ void page_t::pulse_waiters_or_make_evictable(page_cache_t *page_cache) {
 }
 
 void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
-    eviction_bag_t *old_bag
-        = acq->page_cache()->evicter().correct_eviction_category(this);
+    evicter_t *evicter = &acq->page_cache()->evicter();
+    eviction_bag_t *old_bag = evicter->correct_eviction_category(this);
     waiters_.push_front(acq);
-    acq->page_cache()->evicter().change_to_correct_eviction_bag(old_bag, this);
+    // The page is unevictable while it has waiters, so this can't affect which
+    // eviction bag it belongs in right now.
+    if (account->access_pattern() != cache_access_pattern_t::sequential) {
+        if (accessed_ || evicter->forget_recently_evicted(block_id_)) {
+            reused_ = true;
+        }
+        accessed_ = true;
+    }
+    evicter->change_to_correct_eviction_bag(old_bag, this);
     if (buf_.has()) {
         acq->buf_ready_signal_.pulse();
     } else if (loader_ != nullptr) {
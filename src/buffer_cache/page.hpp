@@ -65,6 +65,10 @@ public:
     bool has_waiters() const { return !waiters_.empty(); }
     bool is_loaded() const { return buf_.has(); }
     bool is_disk_backed() const { return block_token_.has(); }
+    // True once the page has been accessed again after its first (non-sequential)
+    // access.  The evicter protects such pages from being pushed out by scans.
+    bool is_reused() const { return reused_; }
+    bool is_accessed() const { return accessed_; }
 
     void evict_self(page_cache_t *page_cache);
 
@@ -132,6 +136,13 @@ private:
 
     uint64_t access_time_;
 
+    // Whether the page has been accessed through an account with a random access
+    // pattern, and whether it has been accessed like that more than once (or was
+    // accessed like that shortly after having been evicted).  Accesses by
+    // sequential scans don't count.
+    bool accessed_;
+    bool reused_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
@@ -146,13 +157,14 @@ private:
     // if loader_ is non-null:  unevictable_pages_
     // else if waiters_ is non-empty: unevictable_pages_
     // else if buf_ is null: evicted_pages_ (and block_token_ is non-null)
-    // else if block_token_ is non-null: evictable_disk_backed_pages_
+    // else if block_token_ is non-null: evictable_protected_ if reused_ is true,
+    //                                   evictable_probationary_ otherwise
     // else: evictable_unbacked_pages_ (buf_ is non-null, block_token_ is null)
     //
-    // So, when loader_, waiters_, buf_, or block_token_ is touched, we might
-    // need to change this page's eviction bag.
+    // So, when loader_, waiters_, buf_, block_token_, or reused_ is touched, we
+    // might need to change this page's eviction bag.
     //
-    // The logic above is implemented in page_cache_t::correct_eviction_category.
+    // The logic above is implemented in evicter_t::correct_eviction_category.
     backindex_bag_index_t eviction_index_;
 
     DISABLE_COPYING(page_t);
@@ -416,7 +416,8 @@ current_page_t *page_cache_t::internal_page_for_new_chosen(block_id_t block_id)
     return inserted_page.first->second;
 }
 
-cache_account_t page_cache_t::create_cache_account(int priority) {
+cache_account_t page_cache_t::create_cache_account(
+        int priority, cache_access_pattern_t access_pattern) {
     // We assume that a priority of 100 means that the transaction should have the
     // same priority as all the non-accounted transactions together. Not sure if this
     // makes sense.
@@ -438,7 +439,7 @@ cache_account_t page_cache_t::create_cache_account(int priority) {
                                                   outstanding_requests_limit);
     }
 
-    return cache_account_t(serializer_->home_thread(), io_account);
+    return cache_account_t(serializer_->home_thread(), io_account, access_pattern);
 }
 
 
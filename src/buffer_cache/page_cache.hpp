@@ -351,7 +351,9 @@ public:
 
     max_block_size_t max_block_size() const { return max_block_size_; }
 
-    cache_account_t create_cache_account(int priority);
+    cache_account_t create_cache_account(
+        int priority,
+        cache_access_pattern_t access_pattern = cache_access_pattern_t::random);
 
     cache_account_t *default_reads_account() {
         return &default_reads_account_;
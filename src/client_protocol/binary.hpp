@@ -0,0 +1,38 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CLIENT_PROTOCOL_BINARY_HPP_
+#define CLIENT_PROTOCOL_BINARY_HPP_
+
+#include <stdint.h>
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+
+class signal_t;
+
+namespace ql {
+class response_t;
+class query_cache_t;
+class query_params_t;
+}
+
+// Clients can ask for this protocol by setting `result_format` to "binary" during the
+// handshake.  Queries are JSON, just like with `json_protocol_t`, but responses skip
+// JSON entirely: the payload after the token and size is the response object
+// (`{"t": ..., "r": [...], ...}`) in the datum serialization format of
+// `rdb_protocol/serialize_datum.hpp`.  Rows that were read from disk are already in
+// that format, so they're sent as they are.  Binary values are sent natively rather
+// than as base64 encoded pseudotypes.  `test/common/binary_datum.py` has a reference
+// decoder.
+class binary_protocol_t {
+public:
+    static scoped_ptr_t<ql::query_params_t> parse_query(tcp_conn_t *conn,
+                                                        signal_t *interruptor,
+                                                        ql::query_cache_t *query_cache);
+
+    static void send_response(ql::response_t *response,
+                              int64_t token,
+                              tcp_conn_t *conn,
+                              signal_t *interruptor);
+};
+
+#endif // CLIENT_PROTOCOL_BINARY_HPP_
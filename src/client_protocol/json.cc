@@ -1,6 +1,10 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "client_protocol/json.hpp"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "arch/io/network.hpp"
 #include "arch/timing.hpp"
 #include "client_protocol/protocols.hpp"
@@ -48,7 +52,8 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query_from_buffer(
 scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
         tcp_conn_t *conn,
         signal_t *interruptor,
-        ql::query_cache_t *query_cache) {
+        ql::query_cache_t *query_cache,
+        send_response_fn_t send_error) {
     int64_t token;
     uint32_t size;
     conn->read_buffered(&token, sizeof(token), interruptor);
@@ -75,7 +80,7 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
             conn->pop(size, &pop_interruptor);
         }
 
-        send_response(&error, token, conn, interruptor);
+        send_error(&error, token, conn, interruptor);
         throw tcp_conn_read_closed_exc_t();
     }
 
@@ -91,11 +96,128 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
         parse_query_from_buffer(std::move(data), 0, query_cache, token, &error);
 
     if (!res.has()) {
-        send_response(&error, token, conn, interruptor);
+        send_error(&error, token, conn, interruptor);
     }
     return res;
 }
 
+namespace {
+
+// Responses with more rows than this are encoded on several threads.  When sending
+// them to a client we also encode them a window of rows at a time, see
+// `encode_response_chunks()`.
+const size_t PARALLELIZATION_THRESHOLD = 500;
+const size_t YIELD_INTERVAL = 2000;
+
+// How large the pieces are that we keep the encoding of a windowed response in.
+const size_t STREAM_CHUNK_SIZE = 64 * KILOBYTE;
+// How many rows of a windowed response every thread encodes at a time.
+const size_t STREAM_ROWS_PER_THREAD = 1000;
+
+// Writes everything up to and including the start of the array of rows.
+void write_response_prologue(ql::response_t *response,
+                             rapidjson::Writer<rapidjson::StringBuffer> *writer) {
+    writer->StartObject();
+    writer->Key("t", 1);
+    writer->Int(response->type());
+    if (response->type() == Response::RUNTIME_ERROR &&
+        response->error_type()) {
+        writer->Key("e", 1);
+        writer->Int(*response->error_type());
+    }
+
+    writer->Key("r", 1);
+    writer->StartArray();
+}
+
+// Writes everything from the end of the array of rows on.
+void write_response_epilogue(ql::response_t *response,
+                             rapidjson::Writer<rapidjson::StringBuffer> *writer) {
+    writer->EndArray();
+    if (response->backtrace()) {
+        writer->Key("b", 1);
+        response->backtrace()->write_json(writer);
+    }
+    if (response->profile()) {
+        writer->Key("p", 1);
+        response->profile()->write_json(writer);
+    }
+    if (response->type() == Response::SUCCESS_PARTIAL ||
+        response->type() == Response::SUCCESS_SEQUENCE) {
+        writer->Key("n", 1);
+        writer->StartArray();
+        for (const auto &note : response->notes()) {
+            writer->Int(note);
+        }
+        writer->EndArray();
+    }
+    writer->EndObject();
+    guarantee(writer->IsComplete());
+}
+
+int64_t num_row_ranges() {
+    return std::min<int64_t>(16, get_num_db_threads());
+}
+
+// Large responses that get sent to a client are encoded a window of this many rows at a
+// time.
+size_t stream_window_size() {
+    return num_row_ranges() * STREAM_ROWS_PER_THREAD;
+}
+
+// Splits the rows from `begin` to `end` into `num_row_ranges()` ranges and calls
+// `fn(m, range_begin, range_end)` for the `m`th range on its own thread.
+template <class callable_t>
+void pmap_row_ranges(size_t begin, size_t end, const callable_t &fn) {
+    int64_t num_threads = num_row_ranges();
+    int32_t thread_offset = get_thread_id().threadnum;
+
+    size_t per_thread = (end - begin) / num_threads;
+    pmap(num_threads, [&](int64_t m) {
+            int32_t target_thread =
+                (thread_offset + static_cast<int32_t>(m)) % get_num_db_threads();
+            on_thread_t rethreader((threadnum_t(target_thread)));
+
+            size_t range_begin = begin + per_thread * m;
+            size_t range_end = (m == num_threads - 1) ?
+                end : (range_begin + per_thread);
+            fn(m, range_begin, range_end);
+        });
+}
+
+// Encodes the rows from `begin` to `end` as a JSON array per range into
+// `buffers_out`, on several threads.  Returns `false` if a row can't be encoded.
+MUST_USE bool encode_row_ranges(ql::response_t *response, size_t begin, size_t end,
+                                std::vector<rapidjson::StringBuffer> *buffers_out) {
+    // Not a `std::vector<bool>`, whose elements can't be written concurrently.
+    std::vector<char> range_failed(num_row_ranges(), false);
+    pmap_row_ranges(begin, end, [&](int64_t m, size_t range_begin, size_t range_end) {
+            rapidjson::StringBuffer *thread_buffer = &(*buffers_out)[m];
+            thread_buffer->Clear();
+            rapidjson::Writer<rapidjson::StringBuffer> thread_writer(*thread_buffer);
+            try {
+                thread_writer.StartArray();
+                for (size_t i = range_begin; i < range_end; ++i) {
+                    if ((i + 1) % YIELD_INTERVAL == 0) {
+                        coro_t::yield();
+                    }
+                    response->data()[i].write_json(&thread_writer);
+                }
+                thread_writer.EndArray();
+            } catch (const std::exception &) {
+                range_failed[m] = true;
+            }
+        });
+    for (char failed : range_failed) {
+        if (failed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
 void write_response_internal(ql::response_t *response,
                              rapidjson::StringBuffer *buffer_out,
                              bool throw_errors) {
@@ -103,39 +225,18 @@ void write_response_internal(ql::response_t *response,
     size_t start_offset = buffer_out->GetSize();
 
     try {
-        writer.StartObject();
-        writer.Key("t", 1);
-        writer.Int(response->type());
-        if (response->type() == Response::RUNTIME_ERROR &&
-            response->error_type()) {
-            writer.Key("e", 1);
-            writer.Int(*response->error_type());
-        }
-
-        writer.Key("r", 1);
-        writer.StartArray();
-        const size_t PARALLELIZATION_THRESHOLD = 500;
+        write_response_prologue(response, &writer);
         if (response->data().size() > PARALLELIZATION_THRESHOLD) {
-            int64_t num_threads = std::min<int64_t>(16, get_num_db_threads());
-            int32_t thread_offset = get_thread_id().threadnum;
-            std::vector<rapidjson::StringBuffer> buffers(num_threads);
-
-            size_t per_thread = response->data().size() / num_threads;
-            pmap(num_threads, [&](int64_t m) {
-                    int32_t target_thread =
-                        (thread_offset + static_cast<int32_t>(m)) % get_num_db_threads();
-                    on_thread_t rethreader((threadnum_t(target_thread)));
+            std::vector<rapidjson::StringBuffer> buffers(num_row_ranges());
+
+            pmap_row_ranges(0, response->data().size(),
+                            [&](int64_t m, size_t offset, size_t end) {
                     rapidjson::StringBuffer *thread_buffer = &buffers[m];
                     rapidjson::Writer<rapidjson::StringBuffer>
                         thread_writer(*thread_buffer);
 
                     thread_writer.StartArray();
-                    size_t offset = per_thread * m;
-                    size_t end = (m == num_threads - 1) ?
-                        response->data().size() : (per_thread * (m + 1));
-
                     for (size_t i = offset; i < end; ++i) {
-                        const size_t YIELD_INTERVAL = 2000;
                         if ((i + 1) % YIELD_INTERVAL == 0) {
                             coro_t::yield();
                         }
@@ -153,26 +254,7 @@ void write_response_internal(ql::response_t *response,
                 item.write_json(&writer);
             }
         }
-        writer.EndArray();
-        if (response->backtrace()) {
-            writer.Key("b", 1);
-            response->backtrace()->write_json(&writer);
-        }
-        if (response->profile()) {
-            writer.Key("p", 1);
-            response->profile()->write_json(&writer);
-        }
-        if (response->type() == Response::SUCCESS_PARTIAL ||
-            response->type() == Response::SUCCESS_SEQUENCE) {
-            writer.Key("n", 1);
-            writer.StartArray();
-            for (const auto &note : response->notes()) {
-                writer.Int(note);
-            }
-            writer.EndArray();
-        }
-        writer.EndObject();
-        guarantee(writer.IsComplete());
+        write_response_epilogue(response, &writer);
     } catch (const ql::base_exc_t &ex) {
         buffer_out->Pop(buffer_out->GetSize() - start_offset);
         response->fill_error(Response::RUNTIME_ERROR, Response::QUERY_LOGIC,
@@ -191,6 +273,78 @@ void write_response_internal(ql::response_t *response,
     }
 }
 
+namespace {
+
+// Encodes `response` a window of `stream_window_size()` rows at a time, on several
+// threads like `write_response_internal()`, and appends the encoding to `chunks_out`
+// in pieces of about `STREAM_CHUNK_SIZE` bytes.  Every window is encoded into the same
+// per-thread buffers, so apart from one window the encoding only exists in memory
+// once.  Returns `false` if the response can't be encoded, in which case it has to go
+// through `write_response_internal()` so the error gets reported properly.
+MUST_USE bool encode_response_chunks(ql::response_t *response,
+                                     std::vector<std::string> *chunks_out,
+                                     int64_t *size_out) {
+    try {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        int64_t size = 0;
+        auto finish_chunk = [&]() {
+            chunks_out->emplace_back(buffer.GetString(), buffer.GetSize());
+            size += buffer.GetSize();
+            buffer.Clear();
+        };
+
+        write_response_prologue(response, &writer);
+        const size_t num_rows = response->data().size();
+        const size_t window_size = stream_window_size();
+        std::vector<rapidjson::StringBuffer> buffers(num_row_ranges());
+        for (size_t window = 0; window < num_rows; window += window_size) {
+            if (!encode_row_ranges(response, window,
+                                   std::min(num_rows, window + window_size),
+                                   &buffers)) {
+                return false;
+            }
+            for (const auto &thread_buffer : buffers) {
+                // The ranges of the last window can be empty.
+                if (thread_buffer.GetSize() > 2) {
+                    writer.SpliceArray(thread_buffer);
+                }
+            }
+            if (buffer.GetSize() >= STREAM_CHUNK_SIZE) {
+                finish_chunk();
+            }
+        }
+        write_response_epilogue(response, &writer);
+        finish_chunk();
+
+        *size_out = size;
+        return true;
+    } catch (const std::exception &) {
+        return false;
+    }
+}
+
+// Writes the chunks that `encode_response_chunks()` produced to the connection.
+void send_response_chunks(const std::vector<std::string> &chunks,
+                          int64_t token,
+                          int64_t payload_size,
+                          tcp_conn_t *conn,
+                          signal_t *interruptor) {
+    uint32_t data_size = static_cast<uint32_t>(payload_size);
+#ifdef __s390x__
+    token = __builtin_bswap64(token);
+    data_size = __builtin_bswap32(data_size);
+#endif
+    conn->write_buffered(&token, sizeof(token), interruptor);
+    conn->write_buffered(&data_size, sizeof(data_size), interruptor);
+    for (const std::string &chunk : chunks) {
+        conn->write_buffered(chunk.data(), chunk.size(), interruptor);
+    }
+    conn->flush_buffer(interruptor);
+}
+
+}  // namespace
+
 // Small wrapper - in debug mode we would rather crash than send the error back
 void json_protocol_t::write_response_to_buffer(ql::response_t *response,
                                                rapidjson::StringBuffer *buffer_out) {
@@ -205,6 +359,17 @@ void json_protocol_t::send_response(ql::response_t *response,
                                     int64_t token,
                                     tcp_conn_t *conn,
                                     signal_t *interruptor) {
+    if (response->data().size() > PARALLELIZATION_THRESHOLD) {
+        std::vector<std::string> chunks;
+        int64_t payload_size;
+        if (encode_response_chunks(response, &chunks, &payload_size)
+            && payload_size < wire_protocol_t::TOO_LARGE_RESPONSE_SIZE) {
+            send_response_chunks(chunks, token, payload_size, conn, interruptor);
+            return;
+        }
+        // Errors and responses that are too large are dealt with below.
+    }
+
     uint32_t data_size; // filled in below
     const size_t prefix_size = sizeof(token) + sizeof(data_size);
 
@@ -25,9 +25,18 @@ public:
             ql::query_cache_t *query_cache, int64_t token,
             ql::response_t *error_out);
 
-    static scoped_ptr_t<ql::query_params_t> parse_query(tcp_conn_t *conn,
-                                                        signal_t *interruptor,
-                                                        ql::query_cache_t *query_cache);
+    typedef void (*send_response_fn_t)(ql::response_t *response,
+                                       int64_t token,
+                                       tcp_conn_t *conn,
+                                       signal_t *interruptor);
+
+    // Errors that prevent the query from being parsed are reported to the client
+    // through `send_error`, so other protocols that take JSON queries can use this.
+    static scoped_ptr_t<ql::query_params_t> parse_query(
+            tcp_conn_t *conn,
+            signal_t *interruptor,
+            ql::query_cache_t *query_cache,
+            send_response_fn_t send_error = &json_protocol_t::send_response);
 
     // Used by the HTTP ReQL server to write the query response into the HTTP response
     static void write_response_to_buffer(ql::response_t *response,
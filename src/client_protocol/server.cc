@@ -275,6 +275,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
     }
 
     uint8_t version = 0;
+    bool binary_results = false;
     std::unique_ptr<auth::base_authenticator_t> authenticator;
     uint32_t error_code = 0;
     std::string error_message;
@@ -413,6 +414,22 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                         5, "Expected a string for `authentication`.");
                 }
 
+                // Optional, older clients don't send it.
+                ql::datum_t result_format =
+                    datum.get_field("result_format", ql::NOTHROW);
+                if (result_format.has()) {
+                    if (result_format.get_type() != ql::datum_t::R_STR) {
+                        throw client_protocol::client_server_error_t(
+                            23, "Expected a string for `result_format`.");
+                    }
+                    if (result_format.as_str() == "binary") {
+                        binary_results = true;
+                    } else if (result_format.as_str() != "json") {
+                        throw client_protocol::client_server_error_t(
+                            24, "Unsupported `result_format`.");
+                    }
+                }
+
                 ql::datum_object_builder_t datum_object_builder;
                 datum_object_builder.overwrite("success", ql::datum_t::boolean(true));
                 datum_object_builder.overwrite(
@@ -462,13 +479,18 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                 : ql::return_empty_normal_batches_t::NO,
             auth::user_context_t(authenticator->get_authenticated_username()));
 
-        connection_loop<json_protocol_t>(
-            conn.get(),
-            (version < 4)
-                ? 1
-                : 1024,
-            &query_cache,
-            &ct_keepalive);
+        if (binary_results) {
+            connection_loop<binary_protocol_t>(
+                conn.get(), 1024, &query_cache, &ct_keepalive);
+        } else {
+            connection_loop<json_protocol_t>(
+                conn.get(),
+                (version < 4)
+                    ? 1
+                    : 1024,
+                &query_cache,
+                &ct_keepalive);
+        }
     } catch (client_protocol::client_server_error_t const &error) {
         // We can't write the response here due to coroutine switching inside an
         // exception handler
@@ -1109,6 +1109,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           optional<uint64_t> total_cache_size,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const file_io_backend_t io_backend,
                           bool *const result_out) {
     server_id_t our_server_id = server_id_t::generate_server_id();
 
@@ -1122,7 +1123,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     server_config.config.cache_size_bytes = total_cache_size;
     server_config.version = 1;
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -1159,6 +1160,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          const std::string &initial_password,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const file_io_backend_t io_backend,
                          const optional<optional<uint64_t> >
                             &total_cache_size,
                          const server_id_t *our_server_id,
@@ -1176,7 +1178,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logNTC("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -1304,6 +1306,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const std::string &initial_password,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const file_io_backend_t io_backend,
                              const optional<optional<uint64_t> >
                                 &total_cache_size,
                              const bool new_directory,
@@ -1312,7 +1315,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info, initial_password, direct_io_mode,
-                            max_concurrent_io_requests, total_cache_size,
+                            max_concurrent_io_requests, io_backend, total_cache_size,
                             nullptr, nullptr, nullptr, data_directory_lock,
                             result_out);
     } else {
@@ -1348,7 +1351,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         server_config.version = 1;
 
         run_rethinkdb_serve(base_path, serve_info, initial_password, direct_io_mode,
-                            max_concurrent_io_requests,
+                            max_concurrent_io_requests, io_backend,
                             optional<optional<uint64_t> >(),
                             &our_server_id, &server_config, &cluster_metadata,
                             data_directory_lock, result_out);
@@ -1435,6 +1438,22 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--direct-io", "use direct I/O for file access");
 #endif
+#ifdef __linux__
+    options_out->push_back(options::option_t(options::names_t("--io-uring"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--io-uring", "submit file I/O through io_uring instead of a thread pool");
+#endif
+    options_out->push_back(options::option_t(options::names_t("--block-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--block-compression {none|zlib}",
+             "compress table data blocks before writing them to disk");
+    options_out->push_back(options::option_t(options::names_t("--btree-block-size"),
+                                             options::OPTIONAL,
+                                             strprintf("%lld", DEFAULT_BTREE_BLOCK_SIZE / KILOBYTE)));
+    help.add("--btree-block-size kb",
+             "size of the btree nodes of newly created tables (in kilobytes). Can be "
+             "4, 8, 16 or 32.");
     options_out->push_back(options::option_t(options::names_t("--cache-size"),
                                              options::OPTIONAL));
     help.add("--cache-size mb", "total cache size (in megabytes) for the process. Can "
@@ -1910,12 +1929,48 @@ MUST_USE bool parse_io_threads_option(const std::map<std::string, options::value
     return true;
 }
 
+MUST_USE bool parse_block_compression_option(
+        const std::map<std::string, options::values_t> &opts,
+        block_compression_t *block_compression_out) {
+    const std::string block_compression = get_single_option(opts, "--block-compression");
+    if (block_compression == "none") {
+        *block_compression_out = block_compression_t::none;
+    } else if (block_compression == "zlib") {
+        *block_compression_out = block_compression_t::zlib;
+    } else {
+        fprintf(stderr, "ERROR: block-compression must be 'none' or 'zlib'\n");
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_btree_block_size_option(
+        const std::map<std::string, options::values_t> &opts,
+        uint64_t *btree_block_size_out) {
+    const int btree_block_size_kb = get_single_int(opts, "--btree-block-size");
+    if (btree_block_size_kb <= 0
+        || btree_block_size_kb * KILOBYTE < DEFAULT_BTREE_BLOCK_SIZE
+        || btree_block_size_kb * KILOBYTE > MAX_BTREE_BLOCK_SIZE
+        || (btree_block_size_kb & (btree_block_size_kb - 1)) != 0) {
+        fprintf(stderr, "ERROR: btree-block-size must be 4, 8, 16 or 32\n");
+        return false;
+    }
+    *btree_block_size_out = btree_block_size_kb * KILOBYTE;
+    return true;
+}
+
 file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, options::values_t> &opts) {
     return exists_option(opts, "--direct-io") ?
         file_direct_io_mode_t::direct_desired :
         file_direct_io_mode_t::buffered_desired;
 }
 
+file_io_backend_t parse_io_backend_option(const std::map<std::string, options::values_t> &opts) {
+    return exists_option(opts, "--io-uring") ?
+        file_io_backend_t::io_uring_desired :
+        file_io_backend_t::pool;
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1965,6 +2020,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
         recreate_temporary_directory(base_path);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const file_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_create,
@@ -1975,6 +2031,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      total_cache_size,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      &result),
                            num_workers);
 
@@ -2074,6 +2131,16 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        block_compression_t block_compression;
+        if (!parse_block_compression_option(opts, &block_compression)) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t btree_block_size;
+        if (!parse_btree_block_size_option(opts, &btree_block_size)) {
+            return EXIT_FAILURE;
+        }
+
         optional<optional<uint64_t> > total_cache_size =
             parse_total_cache_size_option(opts);
 
@@ -2121,9 +2188,12 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
-                                tls_configs);
+                                tls_configs,
+                                block_compression,
+                                btree_block_size);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const file_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_serve,
@@ -2132,6 +2202,7 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      initial_password,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      static_cast<server_id_t*>(nullptr),
                                      static_cast<server_config_versioned_t *>(nullptr),
@@ -2223,7 +2294,9 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
-                                tls_configs);
+                                tls_configs,
+                                block_compression_t::none,
+                                DEFAULT_BTREE_BLOCK_SIZE);
 
         bool result;
         run_in_thread_pool(
@@ -2341,6 +2414,16 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        block_compression_t block_compression;
+        if (!parse_block_compression_option(opts, &block_compression)) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t btree_block_size;
+        if (!parse_btree_block_size_option(opts, &btree_block_size)) {
+            return EXIT_FAILURE;
+        }
+
         optional<int> join_delay_secs = parse_join_delay_secs_option(opts);
         optional<int> node_reconnect_timeout_secs =
             parse_node_reconnect_timeout_secs_option(opts);
@@ -2410,9 +2493,12 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
-                                tls_configs);
+                                tls_configs,
+                                block_compression,
+                                btree_block_size);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const file_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_porcelain,
@@ -2422,6 +2508,7 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      initial_password,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      is_new_directory,
                                      &serve_info,
@@ -282,7 +282,9 @@ bool do_serve(io_backender_t *io_backender,
                               nullptr,   /* we'll fill this in later */
                               semilattice_manager_auth.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              io_backender,
+                              base_path);
         {
             /* Extract a subview of the directory with all the table meta manager
             business cards. */
@@ -311,7 +313,9 @@ bool do_serve(io_backender_t *io_backender,
                         cache_balancer.get(),
                         base_path,
                         &rdb_ctx,
-                        metadata_file));
+                        metadata_file,
+                        serve_info.block_compression,
+                        serve_info.btree_block_size));
                 multi_table_manager.init(new multi_table_manager_t(
                     server_id,
                     &mailbox_manager,
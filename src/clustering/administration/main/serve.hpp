@@ -12,6 +12,7 @@
 #include "clustering/administration/persist/file.hpp"
 #include "arch/address.hpp"
 #include "arch/io/openssl.hpp"
+#include "serializer/log/config.hpp"
 
 class os_signal_cond_t;
 
@@ -117,7 +118,9 @@ public:
                  std::vector<std::string> &&_argv,
                  const int _join_delay_secs,
                  const int _node_reconnect_timeout_secs,
-                 tls_configs_t _tls_configs) :
+                 tls_configs_t _tls_configs,
+                 block_compression_t _block_compression,
+                 uint64_t _btree_block_size) :
         joins(std::move(_joins)),
         reql_http_proxy(std::move(_reql_http_proxy)),
         web_assets(std::move(_web_assets)),
@@ -125,7 +128,9 @@ public:
         config_file(_config_file),
         argv(std::move(_argv)),
         join_delay_secs(_join_delay_secs),
-        node_reconnect_timeout_secs(_node_reconnect_timeout_secs)
+        node_reconnect_timeout_secs(_node_reconnect_timeout_secs),
+        block_compression(_block_compression),
+        btree_block_size(_btree_block_size)
     {
         tls_configs = _tls_configs;
     }
@@ -146,6 +151,11 @@ public:
     int join_delay_secs;
     int node_reconnect_timeout_secs;
     tls_configs_t tls_configs;
+    /* How the serializers of the tables on this server compress blocks. */
+    block_compression_t block_compression;
+    /* The serializer block size for tables that get created on this server. Existing
+    tables keep the block size they were created with. */
+    uint64_t btree_block_size;
 };
 
 /* This has been factored out from `command_line.hpp` because it takes a very
@@ -383,8 +383,9 @@ metadata_file_t::metadata_file_t(
             // The metadata is now serialized using the latest serialization version
             metadata_version = cluster_version_t::LATEST_DISK;
         } // fallthrough intentional
-        case cluster_version_t::v2_4_is_latest:
+        case cluster_version_t::v2_4_is_latest_disk:
             break; // Up-to-date, do nothing
+        case cluster_version_t::v2_5_is_latest:
         default: unreachable();
         }
     }
@@ -29,6 +29,8 @@ public:
             scoped_ptr_t<real_branch_history_manager_t> &&bhm,
             const base_path_t &base_path,
             io_backender_t *io_backender,
+            block_compression_t block_compression,
+            uint64_t btree_block_size,
             cache_balancer_t *cache_balancer,
             rdb_context_t *rdb_context,
             perfmon_collection_t *perfmon_collection_serializers,
@@ -60,16 +62,18 @@ public:
         filepath_file_opener_t file_opener(path, io_backender);
 
         if (create) {
-            log_serializer_t::create(
-                &file_opener,
-                log_serializer_t::static_config_t());
+            log_serializer_t::static_config_t static_config;
+            static_config.block_size_ = btree_block_size;
+            log_serializer_t::create(&file_opener, static_config);
         }
 
         // TODO: Could we handle failure when loading the serializer?  Right
         // now, we don't.
 
+        log_serializer_t::dynamic_config_t serializer_config;
+        serializer_config.block_compression = block_compression;
         scoped_ptr_t<serializer_t> inner_serializer(new log_serializer_t(
-            log_serializer_t::dynamic_config_t(),
+            serializer_config,
             &file_opener,
             perfmon_collection_serializers));
         serializer.init(new merger_serializer_t(
@@ -301,6 +305,8 @@ void real_table_persistence_interface_t::load_multistore(
         std::move(bhm),
         base_path,
         io_backender,
+        block_compression,
+        btree_block_size,
         cache_balancer,
         rdb_context,
         perfmon_collection_serializers,
@@ -78,6 +78,10 @@
 // Size of each btree node (in bytes) on disk
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
 
+// The largest btree node size that can be chosen for new tables.  The in-memory LBA
+// index stores block sizes in 16 bits, so 64 KB blocks wouldn't fit.
+#define MAX_BTREE_BLOCK_SIZE                      (32 * KILOBYTE)
+
 // Size of each extent (in bytes)
 // This should not be too small, or garbage collection will become
 // inefficient (especially on rotational drives).
@@ -156,6 +160,29 @@
 // block infos.
 #define LBA_RECONSTRUCTION_BATCH_SIZE             1024
 
+// Primary B-trees keep an in-memory Bloom filter over their keys, so that point reads
+// for missing keys don't have to descend the tree.  The filter is sized for twice the
+// table's population, but at least `KEY_FILTER_MIN_KEYS` keys.  Its memory counts
+// against the shard's cache; shards whose filter would take more than
+// `KEY_FILTER_MAX_SIZE` bytes, or more than `1 / KEY_FILTER_CACHE_SHARE_DIVISOR` of the
+// cache's memory limit, go without one.  Since deleted keys stay in the filter, it is
+// rebuilt once more than `KEY_FILTER_MAX_FILL_RATIO` of its bits are set (about half of
+// them are at its intended size).
+#define KEY_FILTER_MIN_KEYS                       65536
+#define KEY_FILTER_MAX_SIZE                       (128 * MEGABYTE)
+#define KEY_FILTER_CACHE_SHARE_DIVISOR            8
+#define KEY_FILTER_MAX_FILL_RATIO                 0.6
+
+// Non-indexed `order_by`s that don't fit into the array size limit are sorted in runs that
+// get spilled to disk.  Once there are `EXTERNAL_SORT_MAX_RUNS` runs of about the same
+// size, they are merged into a single one, so that a merge never needs more than that
+// many files open and every element gets merged a logarithmic number of times.
+#define EXTERNAL_SORT_MAX_RUNS                    16
+
+// `inner_join`s that are evaluated by hashing, but whose right side doesn't fit into
+// the array size limit, partition both sides into this many temporary files.
+#define HASH_JOIN_PARTITIONS                      16
+
 #if defined (__powerpc64__)
 // getifaddrs() calls alloca() and it tries to allocate 64KB of memory
 // in stack frame. To avoid stack overflow, increasing the stack size
@@ -0,0 +1,92 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "containers/bloom_filter.hpp"
+
+#include <algorithm>
+
+// Ten bits per item and seven probes give about 1% false positives.
+const uint64_t BLOOM_FILTER_BITS_PER_ITEM = 10;
+const int BLOOM_FILTER_NUM_PROBES = 7;
+
+// Each block is one 64-byte cache line.
+const uint64_t BLOOM_FILTER_WORDS_PER_BLOCK = 8;
+const uint64_t BLOOM_FILTER_BITS_PER_BLOCK = BLOOM_FILTER_WORDS_PER_BLOCK * 64;
+const int BLOOM_FILTER_BITS_PER_PROBE = 9;  // log2(BLOOM_FILTER_BITS_PER_BLOCK)
+static_assert(BLOOM_FILTER_NUM_PROBES * BLOOM_FILTER_BITS_PER_PROBE <= 64,
+              "The probes must fit into a single 64-bit hash.");
+
+static uint64_t mix_bloom_hash(uint64_t h) {
+    // The finalizer of SplitMix64.
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+bloom_filter_t::bloom_filter_t(uint64_t expected_items)
+    : words_(num_blocks_for(expected_items) * BLOOM_FILTER_WORDS_PER_BLOCK, 0),
+      num_blocks_(num_blocks_for(expected_items)),
+      bits_set_(0) { }
+
+uint64_t bloom_filter_t::hash(const void *data, size_t size) {
+    // FNV-1a, followed by a finalizer so that all bits of the result are usable.
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return mix_bloom_hash(h);
+}
+
+void bloom_filter_t::insert(uint64_t hash) {
+    uint64_t *block = block_for(hash);
+    uint64_t probes = mix_bloom_hash(hash);
+    for (int i = 0; i < BLOOM_FILTER_NUM_PROBES; ++i) {
+        const uint64_t bit = probes % BLOOM_FILTER_BITS_PER_BLOCK;
+        probes >>= BLOOM_FILTER_BITS_PER_PROBE;
+        const uint64_t mask = uint64_t(1) << (bit % 64);
+        if ((block[bit / 64] & mask) == 0) {
+            block[bit / 64] |= mask;
+            ++bits_set_;
+        }
+    }
+}
+
+bool bloom_filter_t::may_contain(uint64_t hash) const {
+    const uint64_t *block = block_for(hash);
+    uint64_t probes = mix_bloom_hash(hash);
+    for (int i = 0; i < BLOOM_FILTER_NUM_PROBES; ++i) {
+        const uint64_t bit = probes % BLOOM_FILTER_BITS_PER_BLOCK;
+        probes >>= BLOOM_FILTER_BITS_PER_PROBE;
+        if ((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double bloom_filter_t::fill_ratio() const {
+    return static_cast<double>(bits_set_)
+        / static_cast<double>(num_blocks_ * BLOOM_FILTER_BITS_PER_BLOCK);
+}
+
+size_t bloom_filter_t::memory_usage() const {
+    return words_.size() * sizeof(uint64_t);
+}
+
+size_t bloom_filter_t::memory_usage(uint64_t expected_items) {
+    return num_blocks_for(expected_items) * BLOOM_FILTER_WORDS_PER_BLOCK
+        * sizeof(uint64_t);
+}
+
+uint64_t bloom_filter_t::num_blocks_for(uint64_t expected_items) {
+    const uint64_t bits = std::max<uint64_t>(expected_items, 1)
+        * BLOOM_FILTER_BITS_PER_ITEM;
+    return (bits + BLOOM_FILTER_BITS_PER_BLOCK - 1) / BLOOM_FILTER_BITS_PER_BLOCK;
+}
+
+uint64_t *bloom_filter_t::block_for(uint64_t hash) {
+    return &words_[(hash % num_blocks_) * BLOOM_FILTER_WORDS_PER_BLOCK];
+}
+
+const uint64_t *bloom_filter_t::block_for(uint64_t hash) const {
+    return &words_[(hash % num_blocks_) * BLOOM_FILTER_WORDS_PER_BLOCK];
+}
@@ -0,0 +1,49 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_BLOOM_FILTER_HPP_
+#define CONTAINERS_BLOOM_FILTER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "errors.hpp"
+
+/* `bloom_filter_t` is a blocked Bloom filter: every item sets all of its bits within
+a single cache line, so a lookup costs one cache miss no matter how many bits it checks.
+It's sized for about 1% false positives at its expected number of items.
+
+Items are inserted and looked up by their `hash()`, so that callers can compute the
+hash once and insert it into several filters, or keep it around until a filter exists.
+*/
+class bloom_filter_t {
+public:
+    explicit bloom_filter_t(uint64_t expected_items);
+
+    static uint64_t hash(const void *data, size_t size);
+
+    void insert(uint64_t hash);
+    bool may_contain(uint64_t hash) const;
+
+    /* The fraction of the filter's bits that are set.  This is about one half when
+    the filter holds its expected number of items, and grows as more are added. */
+    double fill_ratio() const;
+
+    size_t memory_usage() const;
+
+    /* The number of bytes that a filter for `expected_items` items uses. */
+    static size_t memory_usage(uint64_t expected_items);
+
+private:
+    static uint64_t num_blocks_for(uint64_t expected_items);
+    uint64_t *block_for(uint64_t hash);
+    const uint64_t *block_for(uint64_t hash) const;
+
+    std::vector<uint64_t> words_;
+    uint64_t num_blocks_;
+    uint64_t bits_set_;
+
+    DISABLE_COPYING(bloom_filter_t);
+};
+
+#endif  // CONTAINERS_BLOOM_FILTER_HPP_
@@ -92,6 +92,20 @@ void detach_rdb_value(buf_parent_t parent, const void *value) {
 void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
              superblock_t *superblock, point_read_response_t *response,
              profile::trace_t *trace) {
+    if (slice->key_filter.is_active()) {
+        // Writes note their key in the filter while they're in line for the
+        // superblock, so we must not consult it before we have acquired the
+        // superblock ourselves.  Reading the root block id waits for that.
+        UNUSED block_id_t root_id = superblock->get_root_block_id();
+        if (!slice->key_filter.may_contain(store_key.btree_key())) {
+            slice->stats.pm_keys_read.record();
+            slice->stats.pm_total_keys_read += 1;
+            superblock->release();
+            response->data = ql::datum_t::null();
+            return;
+        }
+    }
+
     keyvalue_location_t kv_location;
     rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
     find_keyvalue_location_for_read(&sizer, superblock,
@@ -221,6 +235,9 @@ batched_replace_response_t rdb_replace_and_return_superblock(
     const store_key_t &key = *info.key;
 
     try {
+        // We don't know yet whether the replacement inserts the key, but noting it
+        // has to happen while we hold the superblock.
+        info.btree->slice->key_filter.note_key_written(info.key->btree_key());
         keyvalue_location_t kv_location;
         rdb_value_sizer_t sizer(info.superblock->cache()->max_block_size());
         find_keyvalue_location_for_write(&sizer, info.superblock,
@@ -519,6 +536,7 @@ void rdb_set(const store_key_t &key,
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace,
              promise_t<superblock_t *> *pass_back_superblock) {
+    slice->key_filter.note_key_written(key.btree_key());
     keyvalue_location_t kv_location;
     rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
     find_keyvalue_location_for_write(&sizer, superblock, key.btree_key(), timestamp,
@@ -697,6 +715,9 @@ public:
         THROWS_ONLY(interrupted_exc_t);
     void finish(continue_bool_t last_cb) THROWS_ONLY(interrupted_exc_t);
 private:
+    // Runs the rows in `pending_rows` through the transformations and the accumulator.
+    continue_bool_t flush_pending_rows();
+
     const rget_io_data_t io; // How do get data in/out.
     job_data_t job; // What to do next (stateful).
     const optional<rget_sindex_data_t> sindex; // Optional sindex information.
@@ -706,6 +727,14 @@ private:
     // State for internal bookkeeping.
     bool bad_init;
     optional<std::string> last_truncated_secondary_for_abort;
+
+    // If the accumulator allows it, we collect up to `MAX_PENDING_ROWS` rows in
+    // `pending_rows` before running them through the transformations together, so
+    // that the per-call overhead of those is paid once per batch.
+    static const size_t MAX_PENDING_ROWS = 64;
+    const bool batch_rows;
+    ql::datums_t pending_rows;
+
     scoped_ptr_t<profile::disabler_t> disabler;
     scoped_ptr_t<profile::sampler_t> sampler;
 };
@@ -741,7 +770,8 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
     : io(std::move(_io)),
       job(std::move(_job)),
       sindex(std::move(_sindex)),
-      bad_init(false) {
+      bad_init(false),
+      batch_rows(!sindex && job.accumulator->can_batch_rows()) {
 
     if (sindex) {
         // Secondary index functions are deterministic (so no need for an
@@ -761,9 +791,36 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
 }
 
 void rget_cb_t::finish(continue_bool_t last_cb) THROWS_ONLY(interrupted_exc_t) {
+    if (!pending_rows.empty()
+        && boost::get<ql::exc_t>(&io.response->result) == nullptr) {
+        try {
+            // The accumulator never aborts, so there's nothing to do with the result.
+            UNUSED continue_bool_t cont = flush_pending_rows();
+        } catch (const ql::exc_t &e) {
+            io.response->result = e;
+        } catch (const ql::datum_exc_t &e) {
+#ifndef NDEBUG
+            unreachable();
+#else
+            io.response->result = ql::exc_t(e, ql::backtrace_id_t::empty());
+#endif // NDEBUG
+        }
+    }
     job.accumulator->finish(last_cb, &io.response->result);
 }
 
+continue_bool_t rget_cb_t::flush_pending_rows() {
+    ql::groups_t data = {{ql::datum_t(), std::move(pending_rows)}};
+    pending_rows.clear();
+    // Batching is only enabled without a secondary index.
+    auto no_sindex_val = []() { return ql::datum_t(); };
+    for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
+        (**it)(job.env, &data, no_sindex_val);
+    }
+    // Accumulators that allow batching don't look at the key.
+    return (*job.accumulator)(job.env, &data, store_key_t(), no_sindex_val);
+}
+
 // Handle a keyvalue pair.  Returns whether or not we're done early.
 continue_bool_t rget_cb_t::handle_pair(
     scoped_key_value_t &&keyvalue,
@@ -976,6 +1033,13 @@ continue_bool_t rget_cb_t::handle_pair(
             }
         }
 
+        if (batch_rows) {
+            pending_rows.insert(pending_rows.end(), copies, val);
+            return pending_rows.size() < MAX_PENDING_ROWS
+                ? continue_bool_t::CONTINUE
+                : flush_pending_rows();
+        }
+
         ql::groups_t data = {{ql::datum_t(), ql::datums_t(copies, val)}};
 
         for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
@@ -1443,7 +1507,8 @@ void rdb_modification_report_cb_t::on_mod_report(
                         new_cfeed_keys,
                         report.primary_key,
                         report.info.deleted.first,
-                        report.info.added.first}),
+                        report.info.added.first,
+                        0}),
                 report.primary_key,
                 cfeed_stamp_spot,
                 cserver.second);
@@ -1662,7 +1727,8 @@ void deserialize_sindex_info(
     case cluster_version_t::v2_1:
     case cluster_version_t::v2_2:
     case cluster_version_t::v2_3:
-    case cluster_version_t::v2_4_is_latest:
+    case cluster_version_t::v2_4:
+    case cluster_version_t::v2_5_is_latest:
         success = deserialize_reql_version(
                 &read_stream,
                 &info_out->mapping_version_info.original_reql_version,
@@ -1699,7 +1765,8 @@ void deserialize_sindex_info(
     case cluster_version_t::v2_1: // fallthru
     case cluster_version_t::v2_2: // fallthru
     case cluster_version_t::v2_3: // fallthru
-    case cluster_version_t::v2_4_is_latest:
+    case cluster_version_t::v2_4: // fallthru
+    case cluster_version_t::v2_5_is_latest:
         success = deserialize_for_version(cluster_version, &read_stream, &info_out->geo);
         throw_if_bad_deserialization(success, "sindex description");
         break;
@@ -2257,7 +2324,8 @@ void post_construct_secondary_index_range(
         interruptor);
 
     cache_account
-        = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
+        = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY,
+                                             cache_access_pattern_t::sequential);
     txn->set_account(&cache_account);
 
     continue_bool_t cont = btree_concurrent_traversal(
@@ -14,6 +14,7 @@
 #include "buffer_cache/cache_balancer.hpp"
 #include "clustering/administration/issues/outdated_index.hpp"
 #include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/archive/versioned.hpp"
@@ -183,6 +184,20 @@ store_t::~store_t() {
     drainer.drain();
 }
 
+// Whether `rget` scans a range of keys, rather than looking up a set of them like
+// `get_all` does.
+static bool is_range_scan(const rget_read_t &rget) {
+    if (rget.primary_keys.has_value()) {
+        return false;
+    }
+    if (rget.sindex.has_value()) {
+        return rget.sindex->datumspec.visit<bool>(
+            [](const ql::datum_range_t &) { return true; },
+            [](const std::map<ql::datum_t, uint64_t> &) { return false; });
+    }
+    return true;
+}
+
 void store_t::read(
         DEBUG_ONLY(const metainfo_checker_t& metainfo_checker, )
         const read_t &_read,
@@ -194,9 +209,19 @@ void store_t::read(
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> superblock;
 
+    if (boost::get<point_read_t>(&_read.read) != nullptr) {
+        maybe_rebuild_key_filter();
+    }
+
     acquire_superblock_for_read(token, &txn, &superblock,
                                 interruptor,
                                 _read.use_snapshot());
+    const rget_read_t *rget = boost::get<rget_read_t>(&_read.read);
+    if (rget != nullptr && is_range_scan(*rget)) {
+        // Range scans can touch a lot of blocks that nobody is going to need
+        // again.  Tell the cache, so that they don't push out the working set.
+        txn->set_account(btree->get_range_read_account());
+    }
     DEBUG_ONLY_CODE(metainfo->visit(
         superblock.get(), metainfo_checker.region, metainfo_checker.callback));
     protocol_read(_read, response, superblock.get(), interruptor);
@@ -300,6 +325,95 @@ void store_t::reset_data(
         sindex_block.reset_buf_lock();
         txn->commit();
     }
+
+    // The erased keys are still in the key filter.
+    btree->key_filter.request_rebuild();
+}
+
+/* Adds every key in the primary B-tree to the key filter that's being rebuilt. */
+class key_filter_rebuild_cb_t : public depth_first_traversal_callback_t {
+public:
+    explicit key_filter_rebuild_cb_t(btree_key_filter_t *_filter) : filter(_filter) { }
+
+    continue_bool_t handle_pre_leaf(
+            const counted_t<counted_buf_lock_and_read_t> &,
+            const btree_key_t *,
+            const btree_key_t *,
+            signal_t *,
+            bool *skip_out) {
+        // Don't hog the thread while traversing a big table.
+        coro_t::yield();
+        *skip_out = false;
+        return continue_bool_t::CONTINUE;
+    }
+
+    continue_bool_t handle_pair(scoped_key_value_t &&keyvalue, signal_t *) {
+        filter->add_existing_key(keyvalue.key());
+        return continue_bool_t::CONTINUE;
+    }
+
+private:
+    btree_key_filter_t *filter;
+};
+
+// The key filter's memory counts against the cache, so it only gets a share of it.
+static size_t key_filter_budget(cache_t *cache) {
+    return cache->memory_limit() / KEY_FILTER_CACHE_SHARE_DIVISOR;
+}
+
+void store_t::maybe_rebuild_key_filter() {
+    assert_thread();
+    if (btree->key_filter.needs_rebuild(key_filter_budget(cache.get()))) {
+        // This has to happen before the rebuild gets in line for the superblock.
+        btree->key_filter.start_rebuild();
+        coro_t::spawn_sometime(std::bind(&store_t::rebuild_key_filter,
+                                         this,
+                                         drainer.lock()));
+    }
+}
+
+void store_t::rebuild_key_filter(auto_drainer_t::lock_t store_keepalive)
+        THROWS_NOTHING {
+    btree_key_filter_t *filter = &btree->key_filter;
+    try {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(
+            general_cache_conn.get(), CACHE_SNAPSHOTTED_YES, &superblock, &txn);
+        // Like a range read, the traversal shouldn't push out the working set.
+        txn->set_account(btree->get_range_read_account());
+
+        int64_t population = 0;
+        const block_id_t stat_block_id = superblock->get_stat_block_id();
+        if (stat_block_id != NULL_BLOCK_ID) {
+            buf_lock_t stat_block(superblock->expose_buf(), stat_block_id,
+                                  access_t::read);
+            buf_read_t read(&stat_block);
+            uint32_t sb_size;
+            const btree_statblock_t *sb_data =
+                static_cast<const btree_statblock_t *>(read.get_data_read(&sb_size));
+            guarantee(sb_size == BTREE_STATBLOCK_SIZE);
+            population = sb_data->population;
+        }
+
+        const bool fits = filter->set_rebuild_size(
+            population, key_filter_budget(cache.get()));
+        cache->set_extra_memory_usage(filter->memory_usage());
+        if (fits) {
+            key_filter_rebuild_cb_t cb(filter);
+            btree_depth_first_traversal(superblock.get(),
+                                        key_range_t::universe(),
+                                        &cb,
+                                        access_t::read,
+                                        FORWARD,
+                                        release_superblock_t::RELEASE,
+                                        store_keepalive.get_drain_signal());
+        }
+        filter->finish_rebuild();
+    } catch (const interrupted_exc_t &) {
+        filter->abort_rebuild();
+    }
+    cache->set_extra_memory_usage(filter->memory_usage());
 }
 
 std::map<std::string, std::pair<sindex_config_t, sindex_status_t> > store_t::sindex_list(
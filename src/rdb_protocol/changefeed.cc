@@ -4,6 +4,7 @@
 #include <inttypes.h>
 
 #include <queue>
+#include <unordered_map>
 
 #include "btree/reql_specific.hpp"
 #include "clustering/administration/auth/user_context.hpp"
@@ -11,14 +12,18 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/interruptor.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/artificial_table/backend.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/intersection.hpp"
+#include "rdb_protocol/group_table.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/response.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/val.hpp"
 #include "rpc/mailbox/disconnect_watcher.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -73,11 +78,13 @@ void debug_print(printf_buffer_t *buf, const stamped_range_t &rng) {
 struct change_val_t {
     change_val_t(std::pair<uuid_u, uint64_t> _source_stamp,
                  store_key_t _pkey,
+                 uint64_t _log_position,
                  optional<indexed_datum_t> _old_val,
                  optional<indexed_datum_t> _new_val
                  DEBUG_ONLY(, optional<std::string> _sindex))
         : source_stamp(std::move(_source_stamp)),
           pkey(std::move(_pkey)),
+          log_position(_log_position),
           old_val(std::move(_old_val)),
           new_val(std::move(_new_val))
           DEBUG_ONLY(, sindex(std::move(_sindex))) {
@@ -90,6 +97,8 @@ struct change_val_t {
     }
     std::pair<uuid_u, uint64_t> source_stamp;
     store_key_t pkey;
+    // See `msg_t::change_t::log_position`.
+    uint64_t log_position;
     optional<indexed_datum_t> old_val, new_val;
     DEBUG_ONLY(optional<std::string> sindex;);
     // This should be true, but older versions of boost don't support `move`
@@ -317,14 +326,38 @@ optional<datum_t> apply_ops(
     }
 }
 
+// Roughly how much memory a change takes up in the change log.
+size_t change_log_entry_size(const msg_t::change_t &change) {
+    size_t size = sizeof(change) + change.pkey.size();
+    for (const datum_t &val : {change.old_val, change.new_val}) {
+        if (val.has()) {
+            size += serialized_size<cluster_version_t::CLUSTER>(val);
+        }
+    }
+    for (const index_vals_t *vals : {&change.old_indexes, &change.new_indexes}) {
+        for (const auto &pair : *vals) {
+            size += pair.first.size();
+            for (const index_pair_t &index_pair : pair.second) {
+                size += serialized_size<cluster_version_t::CLUSTER>(index_pair.first)
+                    + index_pair.second.size();
+            }
+        }
+    }
+    return size;
+}
+
 server_t::client_info_t::client_info_t()
     : limit_clients(),
-      limit_clients_lock(new rwlock_t()) { }
+      limit_clients_lock(new rwlock_t()),
+      wants_change_log(false) { }
 
 server_t::server_t(mailbox_manager_t *_manager, store_t *_parent)
     : uuid(generate_uuid()),
       manager(_manager),
       parent(_parent),
+      keep_change_log(false),
+      last_log_position(0),
+      change_log_bytes(0),
       stop_mailbox(manager,
                    std::bind(&server_t::stop_mailbox_cb, this, ph::_1, ph::_2)),
       limit_stop_mailbox(manager, std::bind(&server_t::limit_stop_mailbox_cb,
@@ -491,6 +524,23 @@ void server_t::add_client_cb(
     // This is true even if we have multiple shards per btree because
     // `add_client` only spawns one of us.
     guarantee(erased == 1);
+    coro_spot.reset();
+    maybe_drop_change_log();
+}
+
+void server_t::maybe_drop_change_log() {
+    // We take the locks in the same order as `send_all` and `get_stamp` do.
+    rwlock_acq_t stamp_acq(&parent->cfeed_stamp_lock, access_t::write);
+    rwlock_acq_t client_acq(&clients_lock, access_t::read);
+    for (const auto &pair : clients) {
+        if (pair.second.wants_change_log) {
+            return;
+        }
+    }
+    keep_change_log = false;
+    // `clear` might hold on to the memory.
+    std::deque<msg_t::change_t>().swap(change_log);
+    change_log_bytes = 0;
 }
 
 struct stamped_msg_t {
@@ -547,9 +597,27 @@ void server_t::send_all(
         }
     }
     acq.reset();
+    // The change log is ordered like the stamps, so we fill it in before releasing
+    // the stamp lock.
+    const msg_t *msg_to_send = &msg;
+    msg_t logged_msg;
+    if (keep_change_log) {
+        if (const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op)) {
+            msg_t::change_t logged_change = *change;
+            logged_change.log_position = ++last_log_position;
+            change_log_bytes += change_log_entry_size(logged_change);
+            change_log.push_back(logged_change);
+            while (change_log_bytes > CHANGE_LOG_MAX_BYTES) {
+                change_log_bytes -= change_log_entry_size(change_log.front());
+                change_log.pop_front();
+            }
+            logged_msg = msg_t(std::move(logged_change));
+            msg_to_send = &logged_msg;
+        }
+    }
     stamp_spot->reset(); // Done stamping, no need to hold onto it while we send.
     for (const auto &pair : stamps) {
-        send(manager, pair.first, stamped_msg_t(uuid, pair.second, msg));
+        send(manager, pair.first, stamped_msg_t(uuid, pair.second, *msg_to_send));
     }
 }
 
@@ -563,6 +631,8 @@ server_t::limit_addr_t server_t::get_limit_stop_addr() {
 
 optional<uint64_t> server_t::get_stamp(
         const client_t::addr_t &addr,
+        const optional<uint64_t> &resume_after,
+        change_log_info_t *log_info_out,
         const auto_drainer_t::lock_t &keepalive) {
     keepalive.assert_is_holding(&drainer);
     rwlock_acq_t stamp_acq(&parent->cfeed_stamp_lock, access_t::read);
@@ -570,9 +640,28 @@ optional<uint64_t> server_t::get_stamp(
     auto it = clients.find(addr);
     if (it == clients.end()) {
         return r_nullopt;
-    } else {
-        return make_optional(it->second.stamp);
     }
+    if (log_info_out != nullptr) {
+        it->second.wants_change_log = true;
+        keep_change_log = true;
+        log_info_out->position = last_log_position;
+        log_info_out->resumable = true;
+        log_info_out->changes.clear();
+        if (resume_after && *resume_after != last_log_position) {
+            // Positions are consecutive, so the log holds everything after
+            // `*resume_after` iff it starts at most one position after it.
+            if (*resume_after > last_log_position
+                || change_log.empty()
+                || change_log.front().log_position > *resume_after + 1) {
+                log_info_out->resumable = false;
+            } else {
+                size_t offset = *resume_after + 1 - change_log.front().log_position;
+                log_info_out->changes.assign(
+                    change_log.begin() + offset, change_log.end());
+            }
+        }
+    }
+    return make_optional(it->second.stamp);
 }
 
 uuid_u server_t::get_uuid() {
@@ -1265,9 +1354,9 @@ RDB_IMPL_SERIALIZABLE_3(msg_t::limit_change_t, sub, old_key, new_val);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_change_t);
 RDB_IMPL_SERIALIZABLE_2(msg_t::limit_stop_t, sub, exc);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_stop_t);
-RDB_IMPL_SERIALIZABLE_5(
+RDB_IMPL_SERIALIZABLE_6(
     msg_t::change_t,
-    old_indexes, new_indexes, pkey, old_val, new_val);
+    old_indexes, new_indexes, pkey, old_val, new_val, log_position);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::change_t);
 RDB_IMPL_SERIALIZABLE_0_SINCE_v1_13(msg_t::stop_t);
 
@@ -1383,6 +1472,7 @@ protected:
                    feed_t *feed,
                    configured_limits_t limits,
                    const datum_t &squash,
+                   double batch_interval,
                    bool include_states,
                    bool include_types);
     void maybe_signal_cond() THROWS_NOTHING;
@@ -1402,10 +1492,13 @@ protected:
     const bool squash; // Whether or not to squash changes.
     const bool include_states; // Whether or not to include notes about the state.
     const bool include_types; // Whether or not to include a type field in items.
-    // Whether we're in the middle of one logical batch (only matters for squashing).
+    // Whether we're in the middle of one logical batch (only matters for squashing
+    // and batching).
     bool mid_batch;
 private:
     friend class splice_stream_t;
+    // How long to wait for more changes before returning a batch, from `squash` or
+    // `batch_interval`.
     const double min_interval;
 
     virtual bool has_el() = 0;
@@ -1548,6 +1641,7 @@ public:
     template<class... Args>
     explicit flat_sub_t(init_squashing_queue_t init_squashing_queue, Args &&... args)
         : subscription_t(std::forward<Args>(args)...),
+          replaying_change_log(false),
           last_stamp(std::make_pair(nil_uuid(), std::numeric_limits<uint64_t>::max())) {
         if (init_squashing_queue == init_squashing_queue_t::YES && squash) {
             queue = make_scoped<squashing_queue_t>();
@@ -1559,19 +1653,26 @@ public:
         const uuid_u &shard_uuid,
         uint64_t stamp,
         const store_key_t &pkey,
+        uint64_t log_position,
         const optional<std::string> &DEBUG_ONLY(sindex),
         optional<indexed_datum_t> old_val,
         optional<indexed_datum_t> new_val) {
         if (!active()) return;
         auto stamp_pair = std::make_pair(shard_uuid, stamp);
-        if (stamp_pair == last_stamp || update_stamp(shard_uuid, stamp)) {
+        if (replaying_change_log
+            || stamp_pair == last_stamp
+            || update_stamp(shard_uuid, stamp)) {
             // If we get the same stamp multiple times in a row, we skip the
             // update step and always pass it through.  (This supports cases
-            // like `.get_all(1, 1)`).
-            last_stamp = stamp_pair;
+            // like `.get_all(1, 1)`).  Changes from the change log predate our
+            // stamps, so they don't go through them at all.
+            if (!replaying_change_log) {
+                last_stamp = stamp_pair;
+            }
             queue->add(change_val_t(
                 std::make_pair(shard_uuid, stamp),
                 pkey,
+                log_position,
                 old_val,
                 new_val
                 DEBUG_ONLY(, sindex)));
@@ -1598,6 +1699,8 @@ public:
 protected:
     // The queue of changes we've accumulated since the last time we were read from.
     scoped_ptr_t<maybe_squashing_queue_t> queue;
+    // Set while a resumed `range_sub_t` adds the changes from the change log.
+    bool replaying_change_log;
 private:
     std::pair<uuid_u, uint64_t> last_stamp;
     virtual void apply_queued_changes() { } // Changes are never queued.
@@ -1609,6 +1712,101 @@ class empty_sub_t;
 class point_sub_t;
 class limit_sub_t;
 
+// Many range subscriptions can only produce output for a few rows: those with a
+// particular primary key or secondary index value (`get_all`), or those that pass a
+// leading `filter(r.row('field').eq(value))`.  For every other change, the
+// transformations drop both the old and the new value, or `copies()` is zero, so the
+// subscription doesn't emit anything.  The `feed_t` indexes such subscriptions by those
+// values so that a change is only handed to the subscriptions it can matter to.
+struct range_sub_route_t {
+    enum class kind_t { PRIMARY_KEY, SINDEX, FIELD };
+    kind_t kind;
+    // The secondary index or field, unused for `PRIMARY_KEY`.
+    std::string name;
+    // For `PRIMARY_KEY`.
+    std::vector<store_key_t> pkeys;
+    // For `SINDEX` and `FIELD`.
+    std::vector<datum_t> values;
+};
+
+optional<range_sub_route_t> make_range_sub_route(
+        const keyspec_t::range_t &spec,
+        const optional<std::map<store_key_t, uint64_t> > &store_keys) {
+    range_sub_route_t route;
+    if (!spec.sindex) {
+        if (store_keys) {
+            route.kind = range_sub_route_t::kind_t::PRIMARY_KEY;
+            for (const auto &pair : *store_keys) {
+                route.pkeys.push_back(pair.first);
+            }
+            return make_optional(std::move(route));
+        }
+    } else if (!spec.intersect_geometry) {
+        bool is_get_all = spec.datumspec.visit<bool>(
+            [](const datum_range_t &) { return false; },
+            [&](const std::map<datum_t, uint64_t> &keys) {
+                for (const auto &pair : keys) {
+                    route.values.push_back(pair.first);
+                }
+                return true;
+            });
+        if (is_get_all) {
+            route.kind = range_sub_route_t::kind_t::SINDEX;
+            route.name = *spec.sindex;
+            return make_optional(std::move(route));
+        }
+    }
+
+    // With a `default`, rows without the field might pass the filter.
+    const filter_wire_func_t *filter = spec.transforms.empty()
+        ? nullptr
+        : boost::get<filter_wire_func_t>(&spec.transforms[0]);
+    if (filter != nullptr && !filter->default_filter_val.has_value()) {
+        datum_string_t field;
+        datum_t value;
+        if (filter->filter_func.compile_wire_func()->is_field_eq(&field, &value)) {
+            route.kind = range_sub_route_t::kind_t::FIELD;
+            route.name = field.to_std();
+            route.values.push_back(value);
+            return make_optional(std::move(route));
+        }
+    }
+    return r_nullopt;
+}
+
+// The values that the source of routes of the given kind and name has in the old and
+// the new row of `change`.
+std::vector<datum_t> change_route_values(
+        const std::pair<range_sub_route_t::kind_t, std::string> &source,
+        const msg_t::change_t &change) {
+    std::vector<datum_t> ret;
+    switch (source.first) {
+    case range_sub_route_t::kind_t::SINDEX: {
+        for (const index_vals_t *indexes : {&change.old_indexes, &change.new_indexes}) {
+            auto it = indexes->find(source.second);
+            if (it != indexes->end()) {
+                for (const auto &idx : it->second) {
+                    ret.push_back(idx.first);
+                }
+            }
+        }
+    } break;
+    case range_sub_route_t::kind_t::FIELD: {
+        for (const datum_t *val : {&change.old_val, &change.new_val}) {
+            if (val->has() && val->get_type() == datum_t::R_OBJECT) {
+                datum_t field = val->get_field(source.second.c_str(), NOTHROW);
+                if (field.has()) {
+                    ret.push_back(std::move(field));
+                }
+            }
+        }
+    } break;
+    case range_sub_route_t::kind_t::PRIMARY_KEY: // fallthru
+    default: unreachable();
+    }
+    return ret;
+}
+
 class feed_t : public home_thread_mixin_t, public slow_atomic_countable_t<feed_t> {
 public:
     feed_t(namespace_id_t const &, lifetime_t<name_resolver_t const &>);
@@ -1626,8 +1824,14 @@ public:
     void add_limit_sub(limit_sub_t *sub, const uuid_u &uuid) THROWS_NOTHING;
     void del_limit_sub(limit_sub_t *sub, const uuid_u &uuid) THROWS_NOTHING;
 
-    void each_range_sub(const auto_drainer_t::lock_t &lock,
-                        const std::function<void(range_sub_t *)> &f) THROWS_NOTHING;
+    // Only passes on the subscriptions that `change` can matter to, see
+    // `range_sub_route_t`.  `f` is called once on each thread with subscriptions,
+    // with all of the subscriptions on that thread.
+    void each_range_sub(
+        const auto_drainer_t::lock_t &lock,
+        const msg_t::change_t &change,
+        const std::function<void(const std::vector<range_sub_t *> &)> &f)
+        THROWS_NOTHING;
     void update_stamps(uuid_u server_uuid, uint64_t stamp);
     std::map<uuid_u, uint64_t> get_stamps();
     void on_point_sub(
@@ -1692,6 +1896,17 @@ private:
     std::vector<std::set<empty_sub_t *> > empty_subs;
     rwlock_t empty_subs_lock;
     std::vector<std::set<range_sub_t *> > range_subs;
+    // The same subscriptions as `range_subs`, split by their `range_sub_route_t`.
+    // Those without a route are in `unrouted_range_subs`, the others are indexed by
+    // the primary keys or by the values of the field or secondary index they're
+    // routed on.
+    std::vector<std::set<range_sub_t *> > unrouted_range_subs;
+    std::map<store_key_t, std::vector<std::set<range_sub_t *> > > pkey_range_subs;
+    std::map<std::pair<range_sub_route_t::kind_t, std::string>,
+             std::unordered_map<datum_t,
+                                std::vector<std::set<range_sub_t *> >,
+                                datum_hash_t> >
+        value_range_subs;
     rwlock_t range_subs_lock;
     std::map<uuid_u, std::vector<std::set<limit_sub_t *> > > limit_subs;
     rwlock_t limit_subs_lock;
@@ -1899,6 +2114,7 @@ public:
                 feed_t *_feed,
                 configured_limits_t _limits,
                 const datum_t &_squash,
+                double _batch_interval,
                 bool _include_states,
                 bool _include_types)
     // There will never be any changes, safe to start squashing right away.
@@ -1908,6 +2124,7 @@ public:
                  _feed,
                  std::move(_limits),
                  _squash,
+                 _batch_interval,
                  _include_states,
                  _include_types),
       state(state_t::INITIALIZING),
@@ -1982,6 +2199,7 @@ public:
                 feed_t *_feed,
                 configured_limits_t _limits,
                 const datum_t &_squash,
+                double _batch_interval,
                 bool _include_states,
                 bool _include_types,
                 datum_t _pkey)
@@ -1992,6 +2210,7 @@ public:
                      _feed,
                      std::move(_limits),
                      _squash,
+                     _batch_interval,
                      _include_states,
                      _include_types),
           pkey(std::move(_pkey)),
@@ -2083,6 +2302,7 @@ public:
         initial_val.set(change_val_t(
                resp->stamp,
                store_key_t(pkey.print_primary()),
+               0,
                r_nullopt,
                make_optional(indexed_datum_t(resp->initial_val, r_nullopt))
                DEBUG_ONLY(, r_nullopt)));
@@ -2134,6 +2354,7 @@ public:
         initial_val.set(change_val_t(
             std::make_pair(nil_uuid(), 0),
             store_key_t(pkey.print_primary()),
+            0,
             r_nullopt,
             make_optional(indexed_datum_t(initial, r_nullopt))
             DEBUG_ONLY(, r_nullopt)));
@@ -2162,6 +2383,50 @@ counted_t<splice_stream_t> make_splice_stream(Args &&...args) {
     return make_counted<splice_stream_t>(std::forward<Args>(args)...);
 }
 
+// Writes out a transformation for `range_sub_t::get_ops_key()`.  Its functions are
+// normalized, so that the same transformation gets the same key no matter which
+// variable ids and backtraces the query that it came from used.
+class normalized_transform_visitor_t : public boost::static_visitor<void> {
+public:
+    normalized_transform_visitor_t(write_message_t *_wm,
+                                   const datum_t &_deterministic_time)
+        : wm(_wm), deterministic_time(_deterministic_time) { }
+    void operator()(const map_wire_func_t &f) const {
+        serialize_normalized(wm, f, deterministic_time);
+    }
+    void operator()(const filter_wire_func_t &f) const {
+        serialize_normalized(wm, f.filter_func, deterministic_time);
+        const bool has_default = f.default_filter_val.has_value();
+        serialize<cluster_version_t::CLUSTER>(wm, has_default);
+        if (has_default) {
+            serialize_normalized(wm, *f.default_filter_val, deterministic_time);
+        }
+    }
+    void operator()(const concatmap_wire_func_t &f) const {
+        serialize<cluster_version_t::CLUSTER>(
+            wm, static_cast<int8_t>(f.result_hint));
+        serialize_normalized(wm, f, deterministic_time);
+    }
+    // Changefeeds don't get any other transformations with functions in them, so
+    // we don't bother normalizing the rest.
+    template <class T>
+    void operator()(const T &t) const {
+        serialize<cluster_version_t::CLUSTER>(wm, t);
+    }
+private:
+    write_message_t *wm;
+    datum_t deterministic_time;
+};
+
+// The results of a change's transformations, by `range_sub_t::get_ops_key()`.
+typedef std::map<std::string, std::pair<datum_t, datum_t> > evaluated_ops_t;
+// Passes a change from the `server_t` `server_uuid` on to `sub`, on its thread.
+void add_change_to_range_sub(range_sub_t *sub,
+                             const uuid_u &server_uuid,
+                             uint64_t stamp,
+                             const msg_t::change_t &change,
+                             evaluated_ops_t *evaluated);
+
 class range_sub_t : public flat_sub_t {
 public:
     // Throws QL exceptions.
@@ -2170,8 +2435,11 @@ public:
                 feed_t *_feed,
                 configured_limits_t _limits,
                 const datum_t &_squash,
+                double _batch_interval,
                 bool _include_states,
                 bool _include_types,
+                bool _include_cursors,
+                optional<std::map<uuid_u, uint64_t> > _start_after,
                 env_t *outer_env,
                 keyspec_t::range_t _spec)
         // We don't turn on squashing until later for range subs.  (We need to
@@ -2182,9 +2450,12 @@ public:
                      _feed,
                      std::move(_limits),
                      _squash,
+                     _batch_interval,
                      _include_states,
                      _include_types),
           spec(std::move(_spec)),
+          include_cursors(_include_cursors),
+          start_after(std::move(_start_after)),
           state(state_t::READY),
           sent_state(state_t::NONE),
           artificial_include_initial(false) {
@@ -2192,10 +2463,29 @@ public:
         for (const auto &transform : spec.transforms) {
             ops.push_back(make_op(transform));
         }
+        if (has_ops()) {
+            // The transformations are deterministic, so this identifies their
+            // results, whichever query they came from.  The array size limit is
+            // the only other thing that can influence them.
+            write_message_t wm;
+            normalized_transform_visitor_t v(&wm, env->get_deterministic_time());
+            for (const auto &transform : spec.transforms) {
+                serialize<cluster_version_t::CLUSTER>(
+                    &wm, static_cast<int32_t>(transform.which()));
+                boost::apply_visitor(v, transform);
+            }
+            serialize<cluster_version_t::CLUSTER>(
+                &wm, static_cast<uint64_t>(limits.array_size_limit()));
+            string_stream_t stream;
+            int write_res = send_write_message(&stream, &wm);
+            guarantee(write_res == 0);
+            ops_key = stream.str();
+        }
         store_keys = spec.datumspec.primary_key_map();
         if (!store_keys.has_value()) {
             store_key_range.set(spec.datumspec.covering_range().to_primary_keyrange());
         }
+        route = make_range_sub_route(spec, store_keys);
         _feed->add_range_sub(this);
     }
     feed_type_t cfeed_type() const final { return feed_type_t::stream; }
@@ -2203,6 +2493,9 @@ public:
         destructor_cleanup(std::bind(&feed_t::del_range_sub, feed, this));
     }
     optional<std::string> sindex() const { return spec.sindex; }
+    const optional<range_sub_route_t> &get_route() const { return route; }
+    // Subscriptions with the same `ops_key` produce the same `apply_ops` results.
+    const std::string &get_ops_key() const { return ops_key; }
     size_t copies(const datum_t &sindex_key) const {
         guarantee(spec.sindex);
         if (spec.intersect_geometry) {
@@ -2279,10 +2572,12 @@ public:
                 vals_to_change(datum_t(), d, true),
                 change_type_t::INITIAL);
         }
-        return change_val_to_change(pop_change_val(),
-                                    false,
-                                    false,
-                                    include_types);
+        change_val_t cv = pop_change_val();
+        advance_cursor(cv);
+        return maybe_add_cursor(change_val_to_change(cv,
+                                                     false,
+                                                     false,
+                                                     include_types));
     }
     bool has_el() final {
         return (include_states && state != sent_state)
@@ -2290,6 +2585,15 @@ public:
             || has_change_val();
     }
 
+    // Has to be called for every change value we pop, see `cursor`.
+    void advance_cursor(const change_val_t &cv) {
+        // Changes from one server arrive in the order of their positions, and
+        // without squashing we hand them out in that order.
+        if (include_cursors && cv.log_position != 0) {
+            cursor[cv.source_stamp.first] = cv.log_position;
+        }
+    }
+
     void maybe_enable_squashing() {
         if (squash) {
             scoped_ptr_t<maybe_squashing_queue_t> old_queue = std::move(queue);
@@ -2311,11 +2615,14 @@ public:
         assert_thread();
         r_sanity_check(self.get() == this);
 
+        changefeed_stamp_t stamp_read(addr);
+        stamp_read.include_change_log = include_cursors;
+        stamp_read.resume_after = start_after;
         read_response_t read_resp;
         // Note that we use the `outer_env`'s interruptor for the read.
         nif->read(
             outer_env->get_user_context(),
-            read_t(changefeed_stamp_t(addr),
+            read_t(std::move(stamp_read),
                    profile_bool_t::DONT_PROFILE,
                    read_mode_t::SINGLE),
             &read_resp, order_token_t::ignore, outer_env->interruptor);
@@ -2341,6 +2648,9 @@ public:
         queue->purge_below(purge_stamps);
         rcheck_datum(orig_stamps.size() != 0, base_exc_t::RESUMABLE_OP_FAILED,
                      "Empty start stamps.  Did you just reshard?");
+        if (include_cursors) {
+            start_cursor(*resp->stamp_infos);
+        }
 
         if (maybe_src) {
             // Nothing can happen between constructing the new `scoped_ptr_t` and
@@ -2366,6 +2676,8 @@ public:
         assert_thread();
         r_sanity_check(self.get() == this);
 
+        rcheck_datum(!include_cursors, base_exc_t::LOGIC,
+                     "Cannot include cursors in changefeeds on system tables.");
         artificial_include_initial = include_initial;
 
         orig_stamps[uuid] = 0;
@@ -2388,6 +2700,62 @@ public:
     const std::map<uuid_u, uint64_t> &get_next_stamps() { return next_stamps; }
     const std::map<uuid_u, uint64_t> &get_orig_stamps() { return orig_stamps; }
 private:
+    // Sets up `cursor` after the stamp read.  If we're resuming, this also adds the
+    // changes the shards logged after `start_after` ahead of the ones we already
+    // have.
+    void start_cursor(const std::map<uuid_u, shard_stamp_info_t> &stamp_infos) {
+        if (!start_after) {
+            for (const auto &pair : stamp_infos) {
+                guarantee(pair.second.change_log);
+                cursor[pair.first] = pair.second.change_log->position;
+            }
+            return;
+        }
+        bool same_servers = start_after->size() == stamp_infos.size();
+        for (const auto &pair : stamp_infos) {
+            guarantee(pair.second.change_log);
+            same_servers &= start_after->count(pair.first) == 1;
+        }
+        rcheck_datum(same_servers, base_exc_t::OP_FAILED,
+                     "Cannot resume the changefeed from `start_after` because the "
+                     "table was resharded or one of its servers restarted since.");
+        for (const auto &pair : stamp_infos) {
+            rcheck_datum(pair.second.change_log->resumable, base_exc_t::OP_FAILED,
+                         "Cannot resume the changefeed from `start_after` because "
+                         "the changes since are no longer in the change log.");
+        }
+
+        cursor = *start_after;
+        scoped_ptr_t<maybe_squashing_queue_t> live_queue = std::move(queue);
+        queue = make_scoped<nonsquashing_queue_t>();
+        replaying_change_log = true;
+        for (const auto &pair : stamp_infos) {
+            for (const msg_t::change_t &change : pair.second.change_log->changes) {
+                evaluated_ops_t evaluated;
+                add_change_to_range_sub(this, pair.first, 0, change, &evaluated);
+            }
+        }
+        replaying_change_log = false;
+        while (live_queue->size() != 0) {
+            queue->add(live_queue->pop());
+        }
+    }
+
+    datum_t maybe_add_cursor(datum_t &&change) {
+        if (!include_cursors || !change.has()) {
+            return std::move(change);
+        }
+        datum_object_builder_t cursor_builder;
+        for (const auto &pair : cursor) {
+            cursor_builder.overwrite(
+                datum_string_t(uuid_to_str(pair.first)),
+                datum_t(static_cast<double>(pair.second)));
+        }
+        datum_object_builder_t builder(change);
+        builder.overwrite("cursor", std::move(cursor_builder).to_datum());
+        return std::move(builder).to_datum();
+    }
+
     scoped_ptr_t<env_t> make_env(env_t *outer_env) {
         // This is to support fake environments from the unit tests that don't
         // actually have a context.
@@ -2413,6 +2781,15 @@ private:
     keyspec_t::range_t spec;
     optional<std::map<store_key_t, uint64_t> > store_keys;
     optional<key_range_t> store_key_range;
+    optional<range_sub_route_t> route;
+    std::string ops_key;
+    // With `include_cursors`, every change we hand out after the initial values
+    // carries a `cursor`: the position in each `server_t`'s change log up to which
+    // the client has seen all of the changes.  A later feed can resume from it with
+    // `start_after`.
+    const bool include_cursors;
+    optional<std::map<uuid_u, uint64_t> > start_after;
+    std::map<uuid_u, uint64_t> cursor;
     state_t state, sent_state;
     std::vector<datum_t> artificial_initial_vals;
     bool artificial_include_initial;
@@ -2433,6 +2810,7 @@ public:
                 feed_t *_feed,
                 configured_limits_t _limits,
                 const datum_t &_squash,
+                double _batch_interval,
                 bool _include_offsets,
                 bool _include_states,
                 bool _include_types,
@@ -2442,6 +2820,7 @@ public:
                          _feed,
                          _limits,
                          _squash,
+                         _batch_interval,
                          _include_states,
                          _include_types),
           uuid(generate_uuid()),
@@ -2816,6 +3195,113 @@ void real_feed_t::stop_limit_sub(limit_sub_t *sub) {
     }
 }
 
+void add_change_to_range_sub(range_sub_t *sub,
+                             const uuid_u &server_uuid,
+                             uint64_t stamp,
+                             const msg_t::change_t &change,
+                             evaluated_ops_t *evaluated) {
+    datum_t null = datum_t::null();
+    datum_t new_val = null, old_val = null;
+    if (!sub->active()) return;
+    bool trivial = false;
+    if (sub->has_ops()) {
+        auto it = evaluated->find(sub->get_ops_key());
+        if (it != evaluated->end()) {
+            new_val = it->second.first;
+            old_val = it->second.second;
+        } else {
+            if (change.new_val.has()) {
+                if (optional<datum_t> d = sub->apply_ops(change.new_val)) {
+                    new_val = *d;
+                }
+            }
+            if (!sub->active()) return;
+            if (change.old_val.has()) {
+                if (optional<datum_t> d = sub->apply_ops(change.old_val)) {
+                    old_val = *d;
+                }
+            }
+            if (!sub->active()) return;
+            evaluated->insert(std::make_pair(sub->get_ops_key(),
+                                             std::make_pair(new_val, old_val)));
+        }
+        // Duplicate values are caught before being written to disk and
+        // don't generate a `mod_report`, but if we have transforms the
+        // values might have changed.
+        trivial = (new_val == old_val);
+    } else {
+        guarantee(change.old_val.has() || change.new_val.has());
+        if (change.new_val.has()) {
+            new_val = change.new_val;
+        }
+        if (change.old_val.has()) {
+            old_val = change.old_val;
+        }
+    }
+    ASSERT_NO_CORO_WAITING;
+    optional<std::string> sindex = sub->sindex();
+    if (sindex) {
+        std::vector<indexed_datum_t> old_idxs, new_idxs;
+        auto old_it = change.old_indexes.find(*sindex);
+        if (old_it != change.old_indexes.end()) {
+            for (const auto &idx : old_it->second) {
+                for (size_t i = 0; i < sub->copies(idx.first); ++i) {
+                    old_idxs.push_back(
+                        indexed_datum_t(old_val, make_optional(idx.second)));
+                }
+            }
+        }
+        auto new_it = change.new_indexes.find(*sindex);
+        if (new_it != change.new_indexes.end()) {
+            for (const auto &idx : new_it->second) {
+                for (size_t i = 0; i < sub->copies(idx.first); ++i) {
+                    new_idxs.push_back(
+                        indexed_datum_t(new_val, make_optional(idx.second)));
+                }
+            }
+        }
+        while (old_idxs.size() > 0 && new_idxs.size() > 0) {
+            if (!trivial) {
+                sub->add_el(server_uuid, stamp, change.pkey, change.log_position,
+                            sindex,
+                            make_optional(std::move(old_idxs.back())),
+                            make_optional(std::move(new_idxs.back())));
+            }
+            old_idxs.pop_back();
+            new_idxs.pop_back();
+        }
+        while (old_idxs.size() > 0) {
+            guarantee(new_idxs.size() == 0);
+            if (old_val != null) {
+                sub->add_el(server_uuid, stamp, change.pkey, change.log_position,
+                            sindex,
+                            make_optional(std::move(old_idxs.back())),
+                            r_nullopt);
+            }
+            old_idxs.pop_back();
+        }
+        while (new_idxs.size() > 0) {
+            guarantee(old_idxs.size() == 0);
+            if (new_val != null) {
+                sub->add_el(server_uuid, stamp, change.pkey, change.log_position,
+                            sindex,
+                            r_nullopt,
+                            make_optional(std::move(new_idxs.back())));
+            }
+            new_idxs.pop_back();
+        }
+    } else {
+        if (!trivial) {
+            for (size_t i = 0; i < sub->copies(change.pkey); ++i) {
+                sub->add_el(server_uuid, stamp, change.pkey, change.log_position,
+                            sindex,
+                            make_optional(indexed_datum_t(old_val, r_nullopt)),
+                            make_optional(indexed_datum_t(new_val, r_nullopt)));
+            }
+        }
+    }
+}
+
 class msg_visitor_t : public boost::static_visitor<void> {
 public:
     msg_visitor_t(feed_t *_feed, const auto_drainer_t::lock_t *_lock,
@@ -2843,97 +3329,17 @@ public:
             });
     }
     void operator()(const msg_t::change_t &change) const {
-        datum_t null = datum_t::null();
-
-        feed->each_range_sub(*lock, [&](range_sub_t *sub) {
-            datum_t new_val = null, old_val = null;
-            if (!sub->active()) return;
-            bool trivial = false;
-            if (sub->has_ops()) {
-                if (change.new_val.has()) {
-                    if (optional<datum_t> d = sub->apply_ops(change.new_val)) {
-                        new_val = *d;
-                    }
-                }
-                if (!sub->active()) return;
-                if (change.old_val.has()) {
-                    if (optional<datum_t> d = sub->apply_ops(change.old_val)) {
-                        old_val = *d;
-                    }
-                }
-                if (!sub->active()) return;
-                // Duplicate values are caught before being written to disk and
-                // don't generate a `mod_report`, but if we have transforms the
-                // values might have changed.
-                trivial = (new_val == old_val);
-            } else {
-                guarantee(change.old_val.has() || change.new_val.has());
-                if (change.new_val.has()) {
-                    new_val = change.new_val;
-                }
-                if (change.old_val.has()) {
-                    old_val = change.old_val;
-                }
-            }
-            ASSERT_NO_CORO_WAITING;
-            optional<std::string> sindex = sub->sindex();
-            if (sindex) {
-                std::vector<indexed_datum_t> old_idxs, new_idxs;
-                auto old_it = change.old_indexes.find(*sindex);
-                if (old_it != change.old_indexes.end()) {
-                    for (const auto &idx : old_it->second) {
-                        for (size_t i = 0; i < sub->copies(idx.first); ++i) {
-                            old_idxs.push_back(
-                                indexed_datum_t(old_val, make_optional(idx.second)));
-                        }
-                    }
-                }
-                auto new_it = change.new_indexes.find(*sindex);
-                if (new_it != change.new_indexes.end()) {
-                    for (const auto &idx : new_it->second) {
-                        for (size_t i = 0; i < sub->copies(idx.first); ++i) {
-                            new_idxs.push_back(
-                                indexed_datum_t(new_val, make_optional(idx.second)));
-                        }
-                    }
-                }
-                while (old_idxs.size() > 0 && new_idxs.size() > 0) {
-                    if (!trivial) {
-                        sub->add_el(server_uuid, stamp, change.pkey, sindex,
-                                    make_optional(std::move(old_idxs.back())),
-                                    make_optional(std::move(new_idxs.back())));
-                    }
-                    old_idxs.pop_back();
-                    new_idxs.pop_back();
-                }
-                while (old_idxs.size() > 0) {
-                    guarantee(new_idxs.size() == 0);
-                    if (old_val != null) {
-                        sub->add_el(server_uuid, stamp, change.pkey, sindex,
-                                    make_optional(std::move(old_idxs.back())),
-                                    r_nullopt);
-                    }
-                    old_idxs.pop_back();
-                }
-                while (new_idxs.size() > 0) {
-                    guarantee(old_idxs.size() == 0);
-                    if (new_val != null) {
-                        sub->add_el(server_uuid, stamp, change.pkey, sindex,
-                                    r_nullopt,
-                                    make_optional(std::move(new_idxs.back())));
-                    }
-                    new_idxs.pop_back();
-                }
-            } else {
-                if (!trivial) {
-                    for (size_t i = 0; i < sub->copies(change.pkey); ++i) {
-                        sub->add_el(server_uuid, stamp, change.pkey, sindex,
-                                    make_optional(indexed_datum_t(old_val, r_nullopt)),
-                                    make_optional(indexed_datum_t(new_val, r_nullopt)));
-                    }
+        feed->each_range_sub(
+            *lock, change, [&](const std::vector<range_sub_t *> &subs) {
+                // Dashboards and the like open the same feed many times over, so
+                // we evaluate the transformations once per distinct `ops_key`.
+                // The results stay on this thread.
+                evaluated_ops_t evaluated;
+                for (range_sub_t *sub : subs) {
+                    add_change_to_range_sub(
+                        sub, server_uuid, stamp, change, &evaluated);
                 }
-            }
-        });
+            });
         feed->on_point_sub(
             change.pkey,
             *lock,
@@ -2943,6 +3349,7 @@ public:
                 std::cref(server_uuid),
                 stamp,
                 change.pkey,
+                change.log_position,
                 r_nullopt,
                 change.old_val.has()
                     ? optional<indexed_datum_t>(
@@ -3053,6 +3460,9 @@ private:
             if (read_once) {
                 while (sub->has_change_val() && !batcher.should_send_batch()) {
                     change_val_t cv = sub->pop_change_val();
+                    // We don't add cursors while splicing, since resuming from
+                    // one wouldn't get the rest of the initial values.
+                    sub->advance_cursor(cv);
                     // Note that `discard` updates the `stamped_ranges`.
                     datum_t el = change_val_to_change(
                         cv,
@@ -3238,6 +3648,7 @@ subscription_t::subscription_t(
     feed_t *_feed,
     configured_limits_t _limits,
     const datum_t &_squash,
+    double _batch_interval,
     bool _include_states,
     bool _include_types)
     : skipped(0),
@@ -3247,7 +3658,9 @@ subscription_t::subscription_t(
       include_states(_include_states),
       include_types(_include_types),
       mid_batch(false),
-      min_interval(_squash.get_type() == datum_t::R_NUM ? _squash.as_num() : 0.0),
+      min_interval(std::max(
+          _squash.get_type() == datum_t::R_NUM ? _squash.as_num() : 0.0,
+          _batch_interval)),
       rdb_context(_rdb_context),
       user_context(_user_context),
       cond(NULL),
@@ -3271,8 +3684,8 @@ subscription_t::get_els(batcher_t *batcher,
 
     std::vector<datum_t> ret;
 
-    // We wait for data if we don't have any or if we're squashing and not
-    // in the middle of a logical batch.
+    // We wait for data if we don't have any or if we're squashing or batching and
+    // not in the middle of a logical batch.
     if (!exc && skipped == 0 && (!has_el() || (!mid_batch && min_interval > 0.0))) {
         scoped_ptr_t<signal_timer_t> batch_timer;
         if (batcher->get_batch_type() == batch_type_t::NORMAL_FIRST) {
@@ -3435,6 +3848,7 @@ RDB_MAKE_SERIALIZABLE_4_FOR_CLUSTER(
 RDB_MAKE_SERIALIZABLE_0_FOR_CLUSTER(keyspec_t::empty_t);
 RDB_MAKE_SERIALIZABLE_2_FOR_CLUSTER(keyspec_t::limit_t, range, limit);
 RDB_MAKE_SERIALIZABLE_1_FOR_CLUSTER(keyspec_t::point_t, key);
+RDB_MAKE_SERIALIZABLE_3_FOR_CLUSTER(change_log_info_t, position, resumable, changes);
 
 void feed_t::add_sub_with_lock(
     rwlock_t *rwlock, const std::function<void()> &f) THROWS_NOTHING {
@@ -3529,12 +3943,46 @@ void feed_t::add_range_sub(range_sub_t *sub) THROWS_NOTHING {
     add_sub_with_lock(&range_subs_lock, [this, sub]() {
             auto pair = range_subs[sub->home_thread().threadnum].insert(sub);
             guarantee(pair.second);
+
+            const optional<range_sub_route_t> &route = sub->get_route();
+            if (!route) {
+                auto unrouted_pair =
+                    unrouted_range_subs[sub->home_thread().threadnum].insert(sub);
+                guarantee(unrouted_pair.second);
+            } else if (route->kind == range_sub_route_t::kind_t::PRIMARY_KEY) {
+                for (const store_key_t &pkey : route->pkeys) {
+                    map_add_sub(&pkey_range_subs, pkey, sub);
+                }
+            } else {
+                auto *subs = &value_range_subs[std::make_pair(route->kind, route->name)];
+                for (const datum_t &value : route->values) {
+                    map_add_sub(subs, value, sub);
+                }
+            }
         });
 }
 
 // Can't throw because it's called in a destructor.
 void feed_t::del_range_sub(range_sub_t *sub) THROWS_NOTHING {
     del_sub_with_lock(&range_subs_lock, [this, sub]() {
+            const optional<range_sub_route_t> &route = sub->get_route();
+            if (!route) {
+                unrouted_range_subs[sub->home_thread().threadnum].erase(sub);
+            } else if (route->kind == range_sub_route_t::kind_t::PRIMARY_KEY) {
+                for (const store_key_t &pkey : route->pkeys) {
+                    map_del_sub(&pkey_range_subs, pkey, sub);
+                }
+            } else {
+                auto it = value_range_subs.find(std::make_pair(route->kind, route->name));
+                if (it != value_range_subs.end()) {
+                    for (const datum_t &value : route->values) {
+                        map_del_sub(&it->second, value, sub);
+                    }
+                    if (it->second.empty()) {
+                        value_range_subs.erase(it);
+                    }
+                }
+            }
             return range_subs[sub->home_thread().threadnum].erase(sub);
         });
 }
@@ -3597,10 +4045,52 @@ void feed_t::each_sub_in_vec(
 
 void feed_t::each_range_sub(
     const auto_drainer_t::lock_t &lock,
-    const std::function<void(range_sub_t *)> &f) THROWS_NOTHING {
+    const msg_t::change_t &change,
+    const std::function<void(const std::vector<range_sub_t *> &)> &f)
+    THROWS_NOTHING {
     assert_thread();
+    guarantee(lock.has_lock());
     rwlock_in_line_t spot(&range_subs_lock, access_t::read);
-    each_sub_in_vec(range_subs, &spot, lock, f);
+    spot.read_signal()->wait_lazily_unordered();
+
+    // A subscription can be reached through both the old and the new value, so we
+    // collect them in sets first.
+    std::vector<std::set<range_sub_t *> > routed(get_num_threads());
+    auto add_routed = [&routed](const std::vector<std::set<range_sub_t *> > &subs) {
+        for (size_t i = 0; i < subs.size(); ++i) {
+            routed[i].insert(subs[i].begin(), subs[i].end());
+        }
+    };
+    auto pkey_it = pkey_range_subs.find(change.pkey);
+    if (pkey_it != pkey_range_subs.end()) {
+        add_routed(pkey_it->second);
+    }
+    for (const auto &pair : value_range_subs) {
+        for (const datum_t &value : change_route_values(pair.first, change)) {
+            auto it = pair.second.find(value);
+            if (it != pair.second.end()) {
+                add_routed(it->second);
+            }
+        }
+    }
+
+    std::vector<int> subscription_threads;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        if (unrouted_range_subs[i].size() != 0 || routed[i].size() != 0) {
+            subscription_threads.push_back(i);
+        }
+    }
+    pmap(subscription_threads.size(),
+         [this, &f, &routed, &subscription_threads](int i) {
+             on_thread_t th((threadnum_t(subscription_threads[i])));
+             const std::set<range_sub_t *> &unrouted =
+                 unrouted_range_subs[subscription_threads[i]];
+             std::vector<range_sub_t *> subs(unrouted.begin(), unrouted.end());
+             subs.insert(subs.end(),
+                         routed[subscription_threads[i]].begin(),
+                         routed[subscription_threads[i]].end());
+             f(subs);
+         });
 }
 
 void feed_t::each_point_sub_cb(const std::function<void(point_sub_t *)> &f, int i) {
@@ -3698,6 +4188,11 @@ void feed_t::stop_subs(const auto_drainer_t::lock_t &lock) {
             num_subs -= set.size();
             set.clear();
         }
+        for (auto &&set : unrouted_range_subs) {
+            set.clear();
+        }
+        pkey_range_subs.clear();
+        value_range_subs.clear();
     }
     {
         rwlock_in_line_t spot(&empty_subs_lock, access_t::write);
@@ -3740,6 +4235,7 @@ feed_t::feed_t(
     num_subs(0),
     empty_subs(get_num_threads()),
     range_subs(get_num_threads()),
+    unrouted_range_subs(get_num_threads()),
     table_id(_table_id),
     name_resolver(_name_resolver) { }
 
@@ -3764,6 +4260,27 @@ client_t::client_t(
 }
 client_t::~client_t() { }
 
+// Cursors map the uuids of the `server_t`s to positions in their change logs.
+std::map<uuid_u, uint64_t> parse_cursor(const datum_t &cursor) {
+    bool valid = cursor.get_type() == datum_t::R_OBJECT && cursor.obj_size() != 0;
+    std::map<uuid_u, uint64_t> ret;
+    for (size_t i = 0; valid && i < cursor.obj_size(); ++i) {
+        std::pair<datum_string_t, datum_t> pair = cursor.get_pair(i);
+        uuid_u server_uuid;
+        valid = str_to_uuid(pair.first.to_std(), &server_uuid)
+            && pair.second.get_type() == datum_t::R_NUM
+            && pair.second.as_num() >= 0;
+        if (valid) {
+            // `as_int` rejects non-integers.
+            ret[server_uuid] = pair.second.as_int();
+        }
+    }
+    rcheck_datum(valid, base_exc_t::LOGIC,
+                 strprintf("Expected the `cursor` of a change for `start_after` "
+                           "but found %s.", cursor.print().c_str()));
+    return ret;
+}
+
 scoped_ptr_t<subscription_t> new_sub(
     env_t *env,
     feed_t *feed,
@@ -3774,36 +4291,53 @@ scoped_ptr_t<subscription_t> new_sub(
         subscription_t *operator()(const keyspec_t::range_t &range) const {
             rcheck_datum(!ss->include_offsets, base_exc_t::LOGIC,
                          "Cannot include offsets for range subs.");
+            // Squashing hands out the changes to different rows out of order.
+            rcheck_datum(!ss->include_cursors || !ss->squash.as_bool(),
+                         base_exc_t::LOGIC,
+                         "Cannot include cursors in squashed changefeeds.");
+            optional<std::map<uuid_u, uint64_t> > start_after;
+            if (ss->start_after) {
+                start_after.set(parse_cursor(*ss->start_after));
+            }
             return new range_sub_t(
                 env->get_rdb_ctx(),
                 env->get_user_context(),
                 feed,
                 ss->limits,
                 ss->squash,
+                ss->batch_interval,
                 ss->include_states,
                 ss->include_types,
+                ss->include_cursors,
+                std::move(start_after),
                 env,
                 range);
         }
         subscription_t *operator()(const keyspec_t::empty_t &) const {
             rcheck_datum(!ss->include_offsets, base_exc_t::LOGIC,
                          "Cannot include offsets for empty subs.");
+            rcheck_datum(!ss->include_cursors, base_exc_t::LOGIC,
+                         "Cannot include cursors for empty subs.");
             return new empty_sub_t(
                 env->get_rdb_ctx(),
                 env->get_user_context(),
                 feed,
                 ss->limits,
                 ss->squash,
+                ss->batch_interval,
                 ss->include_states,
                 ss->include_types);
         }
         subscription_t *operator()(const keyspec_t::limit_t &limit) const {
+            rcheck_datum(!ss->include_cursors, base_exc_t::LOGIC,
+                         "Cannot include cursors for limit subs.");
             return new limit_sub_t(
                 env->get_rdb_ctx(),
                 env->get_user_context(),
                 feed,
                 ss->limits,
                 ss->squash,
+                ss->batch_interval,
                 ss->include_offsets,
                 ss->include_states,
                 ss->include_types,
@@ -3812,12 +4346,15 @@ scoped_ptr_t<subscription_t> new_sub(
         subscription_t *operator()(const keyspec_t::point_t &point) const {
             rcheck_datum(!ss->include_offsets, base_exc_t::LOGIC,
                          "Cannot include offsets for point subs.");
+            rcheck_datum(!ss->include_cursors, base_exc_t::LOGIC,
+                         "Cannot include cursors for point subs.");
             return new point_sub_t(
                 env->get_rdb_ctx(),
                 env->get_user_context(),
                 feed,
                 ss->limits,
                 ss->squash,
+                ss->batch_interval,
                 ss->include_states,
                 ss->include_types,
                 point.key);
@@ -3835,16 +4372,22 @@ streamspec_t::streamspec_t(counted_t<datum_stream_t> _maybe_src,
                            bool _include_offsets,
                            bool _include_states,
                            bool _include_types,
+                           bool _include_cursors,
+                           optional<datum_t> _start_after,
                            configured_limits_t _limits,
                            datum_t _squash,
+                           double _batch_interval,
                            keyspec_t::spec_t _spec) :
     maybe_src(std::move(_maybe_src)),
     table_name(std::move(_table_name)),
     include_offsets(std::move(_include_offsets)),
     include_states(std::move(_include_states)),
     include_types(std::move(_include_types)),
+    include_cursors(_include_cursors),
+    start_after(std::move(_start_after)),
     limits(std::move(_limits)),
     squash(std::move(_squash)),
+    batch_interval(_batch_interval),
     spec(std::move(_spec)) { }
 
 counted_t<datum_stream_t> client_t::new_stream(
@@ -100,6 +100,9 @@ struct msg_t {
         /* For a newly-created row, `old_val` is an empty `datum_t`. For a deleted row,
         `new_val` is an empty `datum_t`. */
         datum_t old_val, new_val;
+        // The position of the change in the `server_t`'s change log, or 0 if the
+        // server isn't keeping one.
+        uint64_t log_position;
         RDB_DECLARE_ME_SERIALIZABLE(change_t);
     };
     struct stop_t {
@@ -182,16 +185,25 @@ public:
     bool include_offsets;
     bool include_states;
     bool include_types;
+    bool include_cursors;
+    // The `cursor` of the last change the client saw, if it's resuming a feed.
+    optional<datum_t> start_after;
     configured_limits_t limits;
     datum_t squash;
+    // How long to wait for more changes before sending a batch that isn't full, so
+    // that bursts of changes go out in a few large batches.
+    double batch_interval;
     keyspec_t::spec_t spec;
     streamspec_t(counted_t<datum_stream_t> _maybe_src,
                  std::string _table_name,
                  bool _include_offsets,
                  bool _include_states,
                  bool _include_types,
+                 bool _include_cursors,
+                 optional<datum_t> _start_after,
                  configured_limits_t _limits,
                  datum_t _squash,
+                 double _batch_interval,
                  keyspec_t::spec_t _spec);
 };
 
@@ -457,6 +469,18 @@ public:
     auto_drainer_t drainer;
 };
 
+// What a resumable changefeed (see `include_cursors`) learns about a `server_t`'s
+// change log when it reads its start stamp.
+struct change_log_info_t {
+    // The position of the last change logged so far.
+    uint64_t position;
+    // If the read asked to resume after some position, whether the log still holds
+    // all of the changes after it, and if so those changes.
+    bool resumable;
+    std::vector<msg_t::change_t> changes;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(change_log_info_t);
+
 // There is one `server_t` per `store_t`, and it is used to send changes that
 // occur on that `store_t` to any subscribed `real_feed_t`s contained in a
 // `client_t`.
@@ -491,8 +515,13 @@ public:
         const auto_drainer_t::lock_t &keepalive);
     addr_t get_stop_addr();
     limit_addr_t get_limit_stop_addr();
+    // If `log_info_out` is non-NULL and the client is subscribed, we start keeping
+    // the change log for it, if we weren't already, and fill it in.  It then holds
+    // the changes after `resume_after`, if that's set.
     optional<uint64_t> get_stamp(
         const client_t::addr_t &addr,
+        const optional<uint64_t> &resume_after,
+        change_log_info_t *log_info_out,
         const auto_drainer_t::lock_t &keepalive);
     uuid_u get_uuid();
     // `f` will be called with a read lock on `clients` and a write lock on the
@@ -521,6 +550,8 @@ private:
         signal_t *stopped,
         client_t::addr_t addr,
         auto_drainer_t::lock_t keepalive);
+    // Drops the change log if no remaining client wants it.
+    void maybe_drop_change_log();
 
     // The UUID of the server, used so that `real_feed_t`s can enforce on ordering on
     // changefeed messages on a per-server basis (and drop changefeed messages
@@ -536,6 +567,8 @@ private:
         std::map<optional<std::string>,
                  std::vector<scoped_ptr_t<limit_manager_t>>> limit_clients;
         scoped_ptr_t<rwlock_t> limit_clients_lock;
+        // Whether the client has asked for the change log.
+        bool wants_change_log;
     };
     std::map<client_t::addr_t, client_info_t> clients;
 
@@ -564,6 +597,21 @@ private:
     // We need access to the stamp lock that exists on the parent.
     store_t *parent;
 
+    // The most recent changes, up to about `CHANGE_LOG_MAX_BYTES` of them, which
+    // resumable changefeeds can pick up from after reconnecting.  We only keep the
+    // log while a client that asked for it is subscribed.  Positions are
+    // consecutive and start at 1, and keep counting up when the log is dropped and
+    // started again, so that cursors from before can't resume from the new log.
+    // These are protected by the parent's `cfeed_stamp_lock`, just like the stamps.
+    // The log lives in memory and goes away with the `server_t`, whose uuid then
+    // changes, so cursors from before a restart or a resharding can't be resumed
+    // from.
+    static const size_t CHANGE_LOG_MAX_BYTES = 16 * MEGABYTE;
+    bool keep_change_log;
+    uint64_t last_log_position;
+    std::deque<msg_t::change_t> change_log;
+    size_t change_log_bytes;
+
     auto_drainer_t drainer;
     // Clients send a message to this mailbox with their address when they want
     // to unsubscribe.  The callback of this mailbox acquires the drainer, so it
@@ -0,0 +1,415 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/compiled_expr.hpp"
+
+#include "math.hpp"
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+namespace {
+
+template <class pred_t>
+void apply_comparison(datum_t *stack, size_t *sp, pred_t pred) {
+    --*sp;
+    stack[*sp - 1] = datum_t::boolean(pred(stack[*sp - 1].cmp(stack[*sp])));
+    stack[*sp] = datum_t();
+}
+
+// Everything but numbers, like times and strings, is left to the term.  The same
+// goes for results that the term would reject.
+template <class op_t>
+MUST_USE bool apply_arithmetic(datum_t *stack, size_t *sp, op_t op) {
+    --*sp;
+    if (stack[*sp - 1].get_type() != datum_t::R_NUM
+        || stack[*sp].get_type() != datum_t::R_NUM) {
+        return false;
+    }
+    const double res = op(stack[*sp - 1].as_num(), stack[*sp].as_num());
+    if (!risfinite(res)) {
+        return false;
+    }
+    stack[*sp - 1] = datum_t(res);
+    stack[*sp] = datum_t();
+    return true;
+}
+
+// `pluck`, `without` and `get_field` on a sequence are turned into a function that
+// applies the term to each element with this optarg.  It doesn't matter on objects.
+bool has_only_no_recurse_optarg(const raw_term_t &term) {
+    switch (static_cast<int>(term.type())) {
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: // fallthru
+    case Term::PLUCK: // fallthru
+    case Term::WITHOUT:
+        return term.num_optargs() == 1
+            && static_cast<bool>(term.optarg("_NO_RECURSE_"));
+    default:
+        return false;
+    }
+}
+
+}  // namespace
+
+scoped_ptr_t<compiled_expr_t> compiled_expr_t::compile(
+        const raw_term_t &body, sym_t arg, bool implicit_is_arg) {
+    // `filter` treats objects returned by a literal body specially.
+    if (body.type() == Term::DATUM) {
+        return scoped_ptr_t<compiled_expr_t>();
+    }
+    scoped_ptr_t<compiled_expr_t> ret(new compiled_expr_t(arg, implicit_is_arg));
+    if (!ret->compile_term(body, 0)) {
+        return scoped_ptr_t<compiled_expr_t>();
+    }
+    return ret;
+}
+
+bool compiled_expr_t::compile_term(const raw_term_t &term, size_t depth) {
+    if (depth >= MAX_STACK_DEPTH
+        || (term.num_optargs() != 0 && !has_only_no_recurse_optarg(term))) {
+        return false;
+    }
+    switch (static_cast<int>(term.type())) {
+    case Term::DATUM:
+        constants.push_back(
+            term.datum(configured_limits_t::unlimited, reql_version_t::LATEST));
+        emit(opcode_t::PUSH_CONSTANT, constants.size() - 1);
+        return true;
+    case Term::VAR: {
+        // The term has already been compiled, so the variable name is valid.
+        if (term.arg(0).datum().as_int() != arg.value) {
+            return false;
+        }
+        emit(opcode_t::PUSH_ARG);
+        return true;
+    }
+    case Term::IMPLICIT_VAR:
+        if (!implicit_is_arg) {
+            return false;
+        }
+        emit(opcode_t::PUSH_ARG);
+        return true;
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (term.num_args() != 2 || term.arg(1).type() != Term::DATUM) {
+            return false;
+        }
+        datum_t field = term.arg(1).datum();
+        if (field.get_type() != datum_t::R_STR || !compile_term(term.arg(0), depth)) {
+            return false;
+        }
+        constants.push_back(field);
+        emit(opcode_t::GET_FIELD, constants.size() - 1);
+        return true;
+    }
+    case Term::EQ: // fallthru
+    case Term::NE: // fallthru
+    case Term::LT: // fallthru
+    case Term::LE: // fallthru
+    case Term::GT: // fallthru
+    case Term::GE: {
+        if (term.num_args() != 2
+            || !compile_term(term.arg(0), depth)
+            || !compile_term(term.arg(1), depth + 1)) {
+            return false;
+        }
+        switch (static_cast<int>(term.type())) {
+        case Term::EQ: emit(opcode_t::EQ); break;
+        case Term::NE: emit(opcode_t::NE); break;
+        case Term::LT: emit(opcode_t::LT); break;
+        case Term::LE: emit(opcode_t::LE); break;
+        case Term::GT: emit(opcode_t::GT); break;
+        case Term::GE: emit(opcode_t::GE); break;
+        default: unreachable();
+        }
+        return true;
+    }
+    case Term::NOT:
+        if (term.num_args() != 1 || !compile_term(term.arg(0), depth)) {
+            return false;
+        }
+        emit(opcode_t::NOT);
+        return true;
+    case Term::ADD: // fallthru
+    case Term::SUB: // fallthru
+    case Term::MUL: // fallthru
+    case Term::DIV: {
+        opcode_t opcode;
+        switch (static_cast<int>(term.type())) {
+        case Term::ADD: opcode = opcode_t::ADD; break;
+        case Term::SUB: opcode = opcode_t::SUB; break;
+        case Term::MUL: opcode = opcode_t::MUL; break;
+        case Term::DIV: opcode = opcode_t::DIV; break;
+        default: unreachable();
+        }
+        if (term.num_args() == 0 || !compile_term(term.arg(0), depth)) {
+            return false;
+        }
+        for (size_t i = 1; i < term.num_args(); ++i) {
+            if (!compile_term(term.arg(i), depth + 1)) {
+                return false;
+            }
+            emit(opcode);
+        }
+        return true;
+    }
+    case Term::PLUCK:
+        return compile_projection(term, depth, opcode_t::PLUCK);
+    case Term::WITHOUT:
+        return compile_projection(term, depth, opcode_t::WITHOUT);
+    case Term::MAKE_ARRAY: {
+        for (size_t i = 0; i < term.num_args(); ++i) {
+            if (!compile_term(term.arg(i), depth + i)) {
+                return false;
+            }
+        }
+        emit(opcode_t::MAKE_ARRAY, term.num_args());
+        return true;
+    }
+    case Term::DEFAULT: {
+        // Errors in the first argument, like missing fields, make us fall back to the
+        // term, so this only has to handle `null`.
+        if (term.num_args() != 2 || !compile_term(term.arg(0), depth)) {
+            return false;
+        }
+        const size_t jump = code.size();
+        emit(opcode_t::JUMP_IF_NOT_NULL);
+        emit(opcode_t::POP);
+        if (!compile_term(term.arg(1), depth)) {
+            return false;
+        }
+        code[jump].operand = code.size();
+        return true;
+    }
+    case Term::AND: // fallthru
+    case Term::OR: {
+        const bool is_and = term.type() == Term::AND;
+        if (term.num_args() == 0) {
+            constants.push_back(datum_t::boolean(is_and));
+            emit(opcode_t::PUSH_CONSTANT, constants.size() - 1);
+            return true;
+        }
+        // Like the term, this returns the first argument that decides the result,
+        // or the last one.
+        std::vector<size_t> jumps;
+        for (size_t i = 0; i < term.num_args(); ++i) {
+            if (i != 0) {
+                jumps.push_back(code.size());
+                emit(is_and ? opcode_t::JUMP_IF_FALSE : opcode_t::JUMP_IF_TRUE);
+                emit(opcode_t::POP);
+            }
+            if (!compile_term(term.arg(i), depth)) {
+                return false;
+            }
+        }
+        for (size_t jump : jumps) {
+            code[jump].operand = code.size();
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool compiled_expr_t::compile_projection(
+        const raw_term_t &term, size_t depth, opcode_t opcode) {
+    // Nested paths are left to the term.
+    std::vector<datum_string_t> fields;
+    for (size_t i = 1; i < term.num_args(); ++i) {
+        if (term.arg(i).type() != Term::DATUM) {
+            return false;
+        }
+        datum_t field = term.arg(i).datum();
+        if (field.get_type() != datum_t::R_STR) {
+            return false;
+        }
+        fields.push_back(field.as_str());
+    }
+    if (term.num_args() < 2 || !compile_term(term.arg(0), depth)) {
+        return false;
+    }
+    field_lists.push_back(std::move(fields));
+    emit(opcode, field_lists.size() - 1);
+    return true;
+}
+
+void compiled_expr_t::emit(opcode_t opcode, size_t operand) {
+    instruction_t instruction;
+    instruction.opcode = opcode;
+    instruction.operand = operand;
+    code.push_back(instruction);
+}
+
+bool compiled_expr_t::is_field_eq(datum_string_t *field_out,
+                                  datum_t *value_out) const {
+    if (code.size() != 4 || code[3].opcode != opcode_t::EQ) {
+        return false;
+    }
+    // Where the argument's field is looked up; the constant is in the other slot.
+    size_t field_pc;
+    size_t constant_pc;
+    if (code[0].opcode == opcode_t::PUSH_ARG) {
+        field_pc = 1;
+        constant_pc = 2;
+    } else {
+        field_pc = 2;
+        constant_pc = 0;
+    }
+    if (code[field_pc - 1].opcode != opcode_t::PUSH_ARG
+        || code[field_pc].opcode != opcode_t::GET_FIELD
+        || code[constant_pc].opcode != opcode_t::PUSH_CONSTANT) {
+        return false;
+    }
+    *field_out = constants[code[field_pc].operand].as_str();
+    *value_out = constants[code[constant_pc].operand];
+    return true;
+}
+
+bool compiled_expr_t::eval(const datum_t &arg_val,
+                           const configured_limits_t &limits,
+                           datum_t *out) const {
+    datum_t stack[MAX_STACK_DEPTH];
+    size_t sp = 0;
+    try {
+        size_t pc = 0;
+        while (pc < code.size()) {
+            const instruction_t &instruction = code[pc];
+            ++pc;
+            switch (instruction.opcode) {
+            case opcode_t::PUSH_ARG:
+                stack[sp++] = arg_val;
+                break;
+            case opcode_t::PUSH_CONSTANT:
+                stack[sp++] = constants[instruction.operand];
+                break;
+            case opcode_t::GET_FIELD: {
+                datum_t *top = &stack[sp - 1];
+                if (top->get_type() != datum_t::R_OBJECT || top->is_ptype()) {
+                    return false;
+                }
+                datum_t field =
+                    top->get_field(constants[instruction.operand].as_str(), NOTHROW);
+                if (!field.has()) {
+                    return false;
+                }
+                *top = std::move(field);
+                break;
+            }
+            case opcode_t::EQ:
+                apply_comparison(stack, &sp, [](int cmp) { return cmp == 0; });
+                break;
+            case opcode_t::NE:
+                apply_comparison(stack, &sp, [](int cmp) { return cmp != 0; });
+                break;
+            case opcode_t::LT:
+                apply_comparison(stack, &sp, [](int cmp) { return cmp < 0; });
+                break;
+            case opcode_t::LE:
+                apply_comparison(stack, &sp, [](int cmp) { return cmp <= 0; });
+                break;
+            case opcode_t::GT:
+                apply_comparison(stack, &sp, [](int cmp) { return cmp > 0; });
+                break;
+            case opcode_t::GE:
+                apply_comparison(stack, &sp, [](int cmp) { return cmp >= 0; });
+                break;
+            case opcode_t::NOT:
+                stack[sp - 1] = datum_t::boolean(!stack[sp - 1].as_bool());
+                break;
+            case opcode_t::ADD:
+                if (!apply_arithmetic(stack, &sp,
+                                      [](double l, double r) { return l + r; })) {
+                    return false;
+                }
+                break;
+            case opcode_t::SUB:
+                if (!apply_arithmetic(stack, &sp,
+                                      [](double l, double r) { return l - r; })) {
+                    return false;
+                }
+                break;
+            case opcode_t::MUL:
+                if (!apply_arithmetic(stack, &sp,
+                                      [](double l, double r) { return l * r; })) {
+                    return false;
+                }
+                break;
+            case opcode_t::DIV:
+                // Division by zero isn't finite either.
+                if (!apply_arithmetic(stack, &sp,
+                                      [](double l, double r) { return l / r; })) {
+                    return false;
+                }
+                break;
+            case opcode_t::PLUCK: {
+                datum_t *top = &stack[sp - 1];
+                if (top->get_type() != datum_t::R_OBJECT || top->is_ptype()) {
+                    return false;
+                }
+                datum_object_builder_t res;
+                for (const datum_string_t &field : field_lists[instruction.operand]) {
+                    datum_t val = top->get_field(field, NOTHROW);
+                    if (val.has()) {
+                        res.overwrite(field, std::move(val));
+                    }
+                }
+                *top = std::move(res).to_datum();
+                break;
+            }
+            case opcode_t::WITHOUT: {
+                datum_t *top = &stack[sp - 1];
+                if (top->get_type() != datum_t::R_OBJECT || top->is_ptype()) {
+                    return false;
+                }
+                datum_object_builder_t res(*top);
+                for (const datum_string_t &field : field_lists[instruction.operand]) {
+                    UNUSED bool key_was_deleted = res.delete_field(field);
+                }
+                *top = std::move(res).to_datum();
+                break;
+            }
+            case opcode_t::MAKE_ARRAY: {
+                const size_t n = instruction.operand;
+                std::vector<datum_t> items;
+                items.reserve(n);
+                for (size_t i = sp - n; i < sp; ++i) {
+                    items.push_back(std::move(stack[i]));
+                    stack[i] = datum_t();
+                }
+                sp -= n;
+                stack[sp++] = datum_t(std::move(items), limits);
+                break;
+            }
+            case opcode_t::JUMP_IF_NOT_NULL:
+                if (stack[sp - 1].get_type() != datum_t::R_NULL) {
+                    pc = instruction.operand;
+                }
+                break;
+            case opcode_t::JUMP_IF_FALSE:
+                if (!stack[sp - 1].as_bool()) {
+                    pc = instruction.operand;
+                }
+                break;
+            case opcode_t::JUMP_IF_TRUE:
+                if (stack[sp - 1].as_bool()) {
+                    pc = instruction.operand;
+                }
+                break;
+            case opcode_t::POP:
+                stack[--sp] = datum_t();
+                break;
+            default:
+                unreachable();
+            }
+        }
+    } catch (const base_exc_t &) {
+        // Comparing some pseudotypes fails.  The term will fail the same way.
+        return false;
+    }
+    r_sanity_check(sp == 1);
+    *out = std::move(stack[0]);
+    return true;
+}
+
+}  // namespace ql
@@ -0,0 +1,105 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_COMPILED_EXPR_HPP_
+#define RDB_PROTOCOL_COMPILED_EXPR_HPP_
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sym.hpp"
+#include "rdb_protocol/term_storage.hpp"
+
+namespace ql {
+
+/* `compiled_expr_t` evaluates the body of a one-argument function directly against
+datums, without going through the term tree.  It only handles a pure subset of ReQL:
+literals, the argument, `get_field`, comparisons, `and`, `or`, `not`, arithmetic on
+numbers, `pluck` and `without` of top-level fields, `make_array` and `default`.  That's
+what most `filter` predicates and the projections `pluck`, `without` and `get_field`
+turn into on a sequence consist of, and evaluating it doesn't allocate any `val_t`s or
+scopes.
+
+The body is compiled into code for a small stack machine.  Whenever evaluation runs
+into something that the term wouldn't handle as a plain value (a missing field, a
+pseudotype, a type mismatch, a division by zero, ...), `eval()` gives up and the caller
+has to evaluate the term tree instead, which then produces the proper result or error.
+That's safe because nothing in the subset has side effects. */
+class compiled_expr_t {
+public:
+    /* Returns an empty pointer if `body` isn't in the supported subset.  `arg` is the
+    name of the function's argument.  If `implicit_is_arg` is set, `r.row` refers to
+    the argument as well. */
+    static scoped_ptr_t<compiled_expr_t> compile(
+        const raw_term_t &body, sym_t arg, bool implicit_is_arg);
+
+    /* Returns `false` if the term tree has to be evaluated instead. */
+    MUST_USE bool eval(const datum_t &arg,
+                       const configured_limits_t &limits,
+                       datum_t *out) const;
+
+    /* Returns `true` if the expression is `arg(field).eq(value)` or
+    `r.expr(value).eq(arg(field))` for a constant `value`, which is then true exactly
+    for the objects whose field `field` is equal to `value`. */
+    MUST_USE bool is_field_eq(datum_string_t *field_out, datum_t *value_out) const;
+
+private:
+    enum class opcode_t {
+        PUSH_ARG,
+        PUSH_CONSTANT,  // Pushes `constants[operand]`.
+        GET_FIELD,      // Replaces the top by its field `constants[operand]`.
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+        NOT,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        // These replace the top by the object restricted to, or stripped of, the
+        // fields `field_lists[operand]`.
+        PLUCK,
+        WITHOUT,
+        MAKE_ARRAY,     // Replaces the top `operand` values by an array of them.
+        // These jump to `operand` if the top is false, true or not null, without
+        // popping it.
+        JUMP_IF_FALSE,
+        JUMP_IF_TRUE,
+        JUMP_IF_NOT_NULL,
+        POP
+    };
+
+    struct instruction_t {
+        opcode_t opcode;
+        size_t operand;
+    };
+
+    // Deeper expressions are left to the term tree.
+    static const size_t MAX_STACK_DEPTH = 16;
+
+    compiled_expr_t(sym_t _arg, bool _implicit_is_arg)
+        : arg(_arg), implicit_is_arg(_implicit_is_arg) { }
+
+    // Emits code that pushes the value of `term` onto a stack of depth `depth`.
+    MUST_USE bool compile_term(const raw_term_t &term, size_t depth);
+    // Compiles `pluck` and `without` with string arguments.
+    MUST_USE bool compile_projection(
+        const raw_term_t &term, size_t depth, opcode_t opcode);
+    void emit(opcode_t opcode, size_t operand = 0);
+
+    const sym_t arg;
+    const bool implicit_is_arg;
+
+    std::vector<instruction_t> code;
+    std::vector<datum_t> constants;
+    std::vector<std::vector<datum_string_t> > field_lists;
+
+    DISABLE_COPYING(compiled_expr_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_COMPILED_EXPR_HPP_
@@ -83,6 +83,7 @@ rdb_context_t::rdb_context_t()
       cluster_interface(nullptr),
       manager(nullptr),
       reql_http_proxy(),
+      io_backender(nullptr),
       stats(&get_global_perfmon_collection()) { }
 
 rdb_context_t::rdb_context_t(
@@ -94,6 +95,7 @@ rdb_context_t::rdb_context_t(
       cluster_interface(_cluster_interface),
       manager(nullptr),
       reql_http_proxy(),
+      io_backender(nullptr),
       stats(&get_global_perfmon_collection()) {
     init_auth_watchables(auth_semilattice_view);
 }
@@ -105,11 +107,15 @@ rdb_context_t::rdb_context_t(
         std::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t>>
             auth_semilattice_view,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy)
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
       manager(_mailbox_manager),
       reql_http_proxy(_reql_http_proxy),
+      io_backender(_io_backender),
+      base_path(_base_path),
       stats(global_stats) {
     init_auth_watchables(auth_semilattice_view);
 }
@@ -17,6 +17,7 @@
 #include "containers/optional.hpp"
 #include "containers/scoped.hpp"
 #include "containers/uuid.hpp"
+#include "paths.hpp"
 #include "perfmon/perfmon.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -457,6 +458,7 @@ protected:
     virtual ~reql_cluster_interface_t() { }   // silence compiler warnings
 };
 
+class io_backender_t;
 class mailbox_manager_t;
 
 class rdb_context_t {
@@ -477,7 +479,9 @@ public:
         std::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t>>
             auth_semilattice_view,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy);
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path);
 
     ~rdb_context_t();
 
@@ -488,6 +492,12 @@ public:
 
     const std::string reql_http_proxy;
 
+    /* Queries that don't fit into memory, such as large non-indexed `order_by`s, spill
+    to temporary files in `base_path`.  `io_backender` is `nullptr` if we can't do
+    that (in proxies and most unit tests). */
+    io_backender_t *const io_backender;
+    const base_path_t base_path;
+
     class stats_t {
     public:
         explicit stats_t(perfmon_collection_t *global_stats);
@@ -6,6 +6,7 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
 #include <cmath>
@@ -1494,19 +1495,26 @@ std::pair<datum_string_t, datum_t> datum_t::unchecked_get_pair(size_t index) con
     }
 }
 
-datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) const {
-    // Use binary search on top of unchecked_get_pair()
-    size_t range_beg = 0;
+datum_t datum_t::find_field(size_t key_size, const char *key_data) const {
     // The obj_size() also makes sure that this has the right type (R_OBJECT)
     size_t range_end = obj_size();
+    if (data.get_internal_type() == internal_type_t::BUF_R_OBJECT) {
+        // This only reads the keys along the way, not their values.
+        return datum_get_field_from_buf(data.buf_ref, key_size, key_data);
+    }
+
+    // Use binary search over the pairs, which are sorted by key
+    r_sanity_check(data.get_internal_type() == internal_type_t::R_OBJECT);
+    const std::vector<std::pair<datum_string_t, datum_t> > &pairs = *data.r_object;
+    size_t range_beg = 0;
     while (range_beg < range_end) {
         const size_t center = range_beg + ((range_end - range_beg) / 2);
-        auto center_pair = unchecked_get_pair(center);
-        const int cmp_res = key.compare(center_pair.first);
+        const auto &center_pair = pairs[center];
+        const int cmp_res = center_pair.first.compare(key_size, key_data);
         if (cmp_res == 0) {
             // Found it
             return center_pair.second;
-        } else if (cmp_res < 0) {
+        } else if (cmp_res > 0) {
             range_end = center;
         } else {
             range_beg = center + 1;
@@ -1515,15 +1523,25 @@ datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) c
     }
 
     // Didn't find it
-    if (throw_bool == THROW) {
+    return datum_t();
+}
+
+datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) const {
+    datum_t res = find_field(key.size(), key.data());
+    if (!res.has() && throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
               "No attribute `%s` in object:\n%s", key.to_std().c_str(), print().c_str());
     }
-    return datum_t();
+    return res;
 }
 
 datum_t datum_t::get_field(const char *key, throw_bool_t throw_bool) const {
-    return get_field(datum_string_t(key), throw_bool);
+    datum_t res = find_field(strlen(key), key);
+    if (!res.has() && throw_bool == THROW) {
+        rfail(base_exc_t::NON_EXISTENCE,
+              "No attribute `%s` in object:\n%s", key, print().c_str());
+    }
+    return res;
 }
 
 template <class json_writer_t>
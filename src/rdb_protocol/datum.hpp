@@ -369,6 +369,9 @@ private:
     // The key must already exist.
     void replace_field(const datum_string_t &key, datum_t val);
 
+    // Returns an empty datum if there's no field `key`.
+    datum_t find_field(size_t key_size, const char *key_data) const;
+
     static std::vector<std::pair<datum_string_t, datum_t> > to_sorted_vec(
             std::map<datum_string_t, datum_t> &&map);
 
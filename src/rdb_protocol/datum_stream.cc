@@ -2,14 +2,20 @@
 #include "rdb_protocol/datum_stream.hpp"
 
 #include <inttypes.h>
+#include <math.h>
 
 #include <map>
 
+#include "config/args.hpp"
+#include "containers/uuid.hpp"
 #include "math.hpp"
 #include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/datum_stream/aggregate_changes.hpp"
 #include "rdb_protocol/datum_stream/array.hpp"
 #include "rdb_protocol/datum_stream/eq_join.hpp"
+#include "rdb_protocol/datum_stream/external_sort.hpp"
 #include "rdb_protocol/datum_stream/fold.hpp"
+#include "rdb_protocol/datum_stream/hash_join.hpp"
 #include "rdb_protocol/datum_stream/indexed_sort.hpp"
 #include "rdb_protocol/datum_stream/lazy.hpp"
 #include "rdb_protocol/datum_stream/map.hpp"
@@ -35,6 +41,7 @@
 #include "rdb_protocol/geo/s2/s2polygon.h"
 #include "rdb_protocol/geo/s2/s2polyline.h"
 #include "rdb_protocol/math_utils.hpp"
+#include "rdb_protocol/response.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/val.hpp"
 #include "utils.hpp"
@@ -1620,6 +1627,167 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// EXTERNAL_SORT_DATUM_STREAM_T
+external_sort_datum_stream_t::external_sort_datum_stream_t(
+    io_backender_t *_io_backender,
+    const base_path_t &_base_path,
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const datum_t &,
+                       const datum_t &)> _lt_cmp,
+    backtrace_id_t bt)
+    : eager_datum_stream_t(bt),
+      io_backender(_io_backender),
+      base_path(_base_path),
+      lt_cmp(_lt_cmp),
+      merging(false) {
+    guarantee(io_backender != nullptr);
+}
+
+void external_sort_datum_stream_t::add_run(env_t *env, std::vector<datum_t> &&data) {
+    guarantee(!merging);
+    if (data.empty()) {
+        return;
+    }
+    profile::sampler_t sampler("Sorting on disk.", env->trace);
+    std::stable_sort(data.begin(), data.end(),
+                     std::bind(lt_cmp, env, &sampler, ph::_1, ph::_2));
+    scoped_ptr_t<run_t> run = make_run();
+    run->push(data);
+    runs.push_back(std::move(run));
+    levels.push_back(0);
+
+    // Merging runs of about the same size, rather than merging everything into the
+    // biggest run over and over, keeps the total amount of IO at O(n log n).
+    while (runs.size() >= EXTERNAL_SORT_MAX_RUNS) {
+        const size_t first = runs.size() - EXTERNAL_SORT_MAX_RUNS;
+        if (levels[first] != levels.back()) {
+            break;
+        }
+        merge_runs(env, &sampler, first);
+    }
+}
+
+bool external_sort_datum_stream_t::is_exhausted() const {
+    return merging ? heap.empty() : runs.empty();
+}
+
+feed_type_t external_sort_datum_stream_t::cfeed_type() const {
+    return feed_type_t::not_feed;
+}
+
+bool external_sort_datum_stream_t::is_infinite() const {
+    return false;
+}
+
+std::vector<datum_t>
+external_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    if (!merging) {
+        // There can be up to `EXTERNAL_SORT_MAX_RUNS - 1` runs on every level.  We
+        // merge the smallest ones first, until few enough are left.
+        while (runs.size() > EXTERNAL_SORT_MAX_RUNS) {
+            merge_runs(env, &sampler, std::max<size_t>(
+                runs.size() - EXTERNAL_SORT_MAX_RUNS, EXTERNAL_SORT_MAX_RUNS - 1));
+        }
+        start_merge(env, &sampler, 0);
+    }
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+    while (!heap.empty() && !batcher.should_send_batch()) {
+        datum_t d = next_merged(env, &sampler);
+        batcher.note_el(d);
+        ret.push_back(std::move(d));
+        sampler.new_sample();
+    }
+    if (heap.empty()) {
+        // Get rid of the temporary files as soon as we can.
+        runs.clear();
+        levels.clear();
+        heads.clear();
+    }
+    return ret;
+}
+
+scoped_ptr_t<external_sort_datum_stream_t::run_t>
+external_sort_datum_stream_t::make_run() {
+    return make_scoped<run_t>(
+        io_backender,
+        serializer_filepath_t(base_path, "sort_" + uuid_to_str(generate_uuid())),
+        &perfmon_collection);
+}
+
+void external_sort_datum_stream_t::merge_runs(env_t *env, profile::sampler_t *sampler,
+                                              size_t first) {
+    // The number of elements we write to the merged run in a single transaction.
+    const size_t merge_batch_size = 1000;
+    scoped_ptr_t<run_t> merged = make_run();
+    const size_t level = levels[first] + 1;
+    start_merge(env, sampler, first);
+    std::vector<datum_t> batch;
+    while (!heap.empty()) {
+        batch.push_back(next_merged(env, sampler));
+        if (batch.size() >= merge_batch_size) {
+            merged->push(batch);
+            batch.clear();
+        }
+    }
+    merged->push(batch);
+    merging = false;
+    heads.clear();
+    runs.resize(first);
+    levels.resize(first);
+    // The merged runs came after the ones before `first` and before any that are
+    // yet to be added, which keeps the sort stable.
+    runs.push_back(std::move(merged));
+    levels.push_back(level);
+}
+
+void external_sort_datum_stream_t::start_merge(env_t *env,
+                                               profile::sampler_t *sampler,
+                                               size_t first) {
+    guarantee(!merging);
+    merging = true;
+    heads.resize(runs.size());
+    heap.clear();
+    for (size_t i = first; i < runs.size(); ++i) {
+        if (!runs[i]->empty()) {
+            runs[i]->pop(&heads[i]);
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(),
+                   std::bind(&external_sort_datum_stream_t::merge_after, this,
+                             env, sampler, ph::_1, ph::_2));
+}
+
+datum_t external_sort_datum_stream_t::next_merged(env_t *env,
+                                                  profile::sampler_t *sampler) {
+    guarantee(merging && !heap.empty());
+    auto cmp = std::bind(&external_sort_datum_stream_t::merge_after, this,
+                         env, sampler, ph::_1, ph::_2);
+    std::pop_heap(heap.begin(), heap.end(), cmp);
+    const size_t run = heap.back();
+    heap.pop_back();
+    datum_t ret = std::move(heads[run]);
+    if (!runs[run]->empty()) {
+        runs[run]->pop(&heads[run]);
+        heap.push_back(run);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+    return ret;
+}
+
+bool external_sort_datum_stream_t::merge_after(env_t *env,
+                                               profile::sampler_t *sampler,
+                                               size_t a,
+                                               size_t b) const {
+    if (lt_cmp(env, sampler, heads[b], heads[a])) {
+        return true;
+    }
+    return !lt_cmp(env, sampler, heads[a], heads[b]) && a > b;
+}
+
 // ORDERED_DISTINCT_DATUM_STREAM_T
 ordered_distinct_datum_stream_t::ordered_distinct_datum_stream_t(
     counted_t<datum_stream_t> _source) : wrapper_datum_stream_t(_source) { }
@@ -2407,6 +2575,277 @@ bool eq_join_datum_stream_t::is_exhausted() const {
     return false;
 }
 
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+        counted_t<datum_stream_t> _stream,
+        counted_t<const func_t> _left_key,
+        counted_t<const func_t> _right_key,
+        std::vector<datum_t> &&_right_rows,
+        backtrace_id_t _bt)
+    : eager_datum_stream_t(_bt),
+      stream(std::move(_stream)),
+      left_key(std::move(_left_key)),
+      right_key(std::move(_right_key)),
+      right_rows(std::move(_right_rows)) { }
+
+void hash_join_datum_stream_t::build(env_t *env) {
+    build_side.init(new group_table_t<std::vector<datum_t> >());
+    const std::vector<datum_t> no_rows;
+    for (datum_t &row : right_rows) {
+        datum_t key = right_key->call(env, row)->as_datum();
+        bool inserted;
+        build_side->find_or_insert(key, no_rows, &inserted)->push_back(std::move(row));
+    }
+    right_rows.clear();
+    right_rows.shrink_to_fit();
+}
+
+std::vector<datum_t> hash_join_datum_stream_t::next_raw_batch(
+    env_t *env,
+    const batchspec_t &batchspec) {
+    batcher_t batcher = batchspec.to_batcher();
+
+    batchspec_t inner_batchspec = batchspec;
+    if (inner_batchspec.get_batch_type() == batch_type_t::TERMINAL) {
+        inner_batchspec = batchspec_t::default_for(batch_type_t::NORMAL);
+    }
+
+    std::vector<datum_t> res;
+    datum_string_t right("right");
+    datum_string_t left("left");
+    while (!stream->is_exhausted() && !batcher.should_send_batch()) {
+        std::vector<datum_t> stream_batch = stream->next_batch(env, inner_batchspec);
+        if (stream_batch.empty()) {
+            // The input stream is either exhausted or a changefeed.
+            break;
+        }
+        if (!build_side.has()) {
+            build(env);
+        }
+        if (build_side->size() == 0) {
+            // Nothing can match, and the nested loop wouldn't call the predicate.
+            continue;
+        }
+        for (const datum_t &row : stream_batch) {
+            datum_t key = left_key->call(env, row)->as_datum();
+            const std::vector<datum_t> *matches = build_side->find(key);
+            if (matches == nullptr) {
+                continue;
+            }
+            for (const datum_t &match : *matches) {
+                ql::datum_object_builder_t res_item;
+                bool conflict = true;
+                conflict &= res_item.add(right, match);
+                conflict &= res_item.add(left, row);
+                guarantee(!conflict);
+                datum_t res_datum = std::move(res_item).to_datum();
+                batcher.note_el(res_datum);
+                res.push_back(std::move(res_datum));
+            }
+        }
+    }
+    return res;
+}
+
+bool hash_join_datum_stream_t::is_exhausted() const {
+    return stream->is_exhausted() && batch_cache_exhausted();
+}
+
+grace_hash_join_datum_stream_t::grace_hash_join_datum_stream_t(
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path,
+        counted_t<datum_stream_t> _left,
+        counted_t<const func_t> _left_key,
+        std::vector<datum_t> &&_right_rows,
+        counted_t<datum_stream_t> _right,
+        counted_t<const func_t> _right_key,
+        backtrace_id_t bt)
+    : eager_datum_stream_t(bt),
+      io_backender(_io_backender),
+      base_path(_base_path),
+      left(std::move(_left)),
+      left_key(std::move(_left_key)),
+      right_rows(std::move(_right_rows)),
+      right(std::move(_right)),
+      right_key(std::move(_right_key)),
+      joined(false),
+      current(0) {
+    guarantee(io_backender != nullptr);
+}
+
+scoped_ptr_t<grace_hash_join_datum_stream_t::partition_t>
+grace_hash_join_datum_stream_t::make_partition() {
+    return make_scoped<partition_t>(
+        io_backender,
+        serializer_filepath_t(base_path, "join_" + uuid_to_str(generate_uuid())),
+        &perfmon_collection);
+}
+
+size_t grace_hash_join_datum_stream_t::partition(
+        env_t *env,
+        std::vector<datum_t> &&rows,
+        datum_stream_t *stream,
+        const counted_t<const func_t> &key,
+        bool with_positions,
+        std::vector<scoped_ptr_t<partition_t> > *parts_out) {
+    // The number of entries we write to a partition in a single transaction.
+    const size_t write_batch_size = 1000;
+    std::vector<std::vector<datum_t> > buffers(HASH_JOIN_PARTITIONS);
+    parts_out->resize(HASH_JOIN_PARTITIONS);
+    for (scoped_ptr_t<partition_t> &part : *parts_out) {
+        part = make_partition();
+    }
+    const batchspec_t batchspec = batchspec_t::default_for(batch_type_t::NORMAL);
+    size_t num_rows = 0;
+    do {
+        for (datum_t &row : rows) {
+            datum_t row_key = key->call(env, row)->as_datum();
+            // `group_table_t` goes by the low bits of the hash, so we use the high
+            // ones here.  Otherwise all keys of a partition would collide in there.
+            const size_t p = (hash_datum(row_key) >> 32) % HASH_JOIN_PARTITIONS;
+            std::vector<datum_t> entry{std::move(row_key), std::move(row)};
+            if (with_positions) {
+                entry.push_back(datum_t(static_cast<double>(num_rows)));
+            }
+            ++num_rows;
+            buffers[p].push_back(datum_t(std::move(entry), env->limits()));
+            if (buffers[p].size() >= write_batch_size) {
+                (*parts_out)[p]->push(buffers[p]);
+                buffers[p].clear();
+            }
+        }
+        rows = stream->next_batch(env, batchspec);
+    } while (!rows.empty());
+    for (size_t p = 0; p < HASH_JOIN_PARTITIONS; ++p) {
+        if (!buffers[p].empty()) {
+            (*parts_out)[p]->push(buffers[p]);
+        }
+    }
+    return num_rows;
+}
+
+void grace_hash_join_datum_stream_t::build_chunk(env_t *env) {
+    chunk.init(new group_table_t<std::vector<datum_t> >());
+    const std::vector<datum_t> no_rows;
+    partition_t *part = right_parts[current].get();
+    const size_t limit = env->limits().array_size_limit();
+    for (size_t i = 0; i < limit && !part->empty(); ++i) {
+        datum_t entry;
+        part->pop(&entry);
+        bool inserted;
+        chunk->find_or_insert(entry.get(0), no_rows, &inserted)->push_back(
+            entry.get(1));
+    }
+    if (!part->empty()) {
+        left_rest = make_partition();
+    }
+}
+
+void grace_hash_join_datum_stream_t::flush_left_rest() {
+    if (!left_rest_buffer.empty()) {
+        left_rest->push(left_rest_buffer);
+        left_rest_buffer.clear();
+    }
+}
+
+void grace_hash_join_datum_stream_t::join(env_t *env) {
+    // As in the nested loop, the right key isn't evaluated if the left side is
+    // empty.
+    if (partition(env, std::vector<datum_t>(), left.get(), left_key, true,
+                  &left_parts) == 0) {
+        left_parts.clear();
+    } else {
+        partition(env, std::move(right_rows), right.get(), right_key, false,
+                  &right_parts);
+    }
+    left.reset();
+    right.reset();
+
+    // A left row's matches come out in the order of the right side, chunk after
+    // chunk, and the sort is stable, so we only need to sort by the left positions.
+    sorted = make_counted<external_sort_datum_stream_t>(
+        io_backender,
+        base_path,
+        [](env_t *, profile::sampler_t *, const datum_t &a, const datum_t &b) {
+            return a.get(0).as_num() < b.get(0).as_num();
+        },
+        backtrace());
+
+    // The number of left rows we save for the next chunk in a single transaction.
+    const size_t left_rest_batch_size = 1000;
+    const size_t run_size = env->limits().array_size_limit();
+    std::vector<datum_t> run;
+    datum_string_t right_field("right");
+    datum_string_t left_field("left");
+    while (current < left_parts.size()) {
+        if (!chunk.has()) {
+            if (left_parts[current]->empty() || right_parts[current]->empty()) {
+                // Get rid of the temporary files as soon as we can.
+                left_parts[current].reset();
+                right_parts[current].reset();
+                ++current;
+                continue;
+            }
+            build_chunk(env);
+        }
+        if (left_parts[current]->empty()) {
+            // All left rows of the partition have been joined with this chunk.
+            chunk.reset();
+            if (left_rest.has()) {
+                flush_left_rest();
+                left_parts[current] = std::move(left_rest);
+            }
+            continue;
+        }
+        datum_t entry;
+        left_parts[current]->pop(&entry);
+        const std::vector<datum_t> *matches = chunk->find(entry.get(0));
+        if (matches != nullptr) {
+            datum_t row = entry.get(1);
+            for (const datum_t &match : *matches) {
+                ql::datum_object_builder_t res_item;
+                bool conflict = true;
+                conflict &= res_item.add(right_field, match);
+                conflict &= res_item.add(left_field, row);
+                guarantee(!conflict);
+                run.push_back(datum_t(
+                    std::vector<datum_t>{entry.get(2), std::move(res_item).to_datum()},
+                    env->limits()));
+                if (run.size() >= run_size) {
+                    sorted->add_run(env, std::move(run));
+                    run.clear();
+                }
+            }
+        }
+        if (left_rest.has()) {
+            left_rest_buffer.push_back(std::move(entry));
+            if (left_rest_buffer.size() >= left_rest_batch_size) {
+                flush_left_rest();
+            }
+        }
+    }
+    sorted->add_run(env, std::move(run));
+    left_parts.clear();
+    right_parts.clear();
+}
+
+std::vector<datum_t> grace_hash_join_datum_stream_t::next_raw_batch(
+    env_t *env,
+    const batchspec_t &batchspec) {
+    if (!joined) {
+        join(env);
+        joined = true;
+    }
+    std::vector<datum_t> res;
+    for (const datum_t &d : sorted->next_batch(env, batchspec)) {
+        res.push_back(d.get(1));
+    }
+    return res;
+}
+
+bool grace_hash_join_datum_stream_t::is_exhausted() const {
+    return joined && sorted->is_exhausted() && batch_cache_exhausted();
+}
+
 fold_datum_stream_t::fold_datum_stream_t(
     counted_t<datum_stream_t> &&_stream,
     datum_t _base,
@@ -2520,6 +2959,202 @@ bool fold_datum_stream_t::is_exhausted() const {
     return false;
 }
 
+// Adds `x` to `*sum` with Neumaier's variant of Kahan summation, keeping the rounding
+// error in `*error`.  Without it, adding and removing rows of very different
+// magnitudes would make the sum drift away from the sum of the rows left.
+static void add_to_sum(double x, double *sum, double *error) {
+    double t = *sum + x;
+    if (fabs(*sum) >= fabs(x)) {
+        *error += (*sum - t) + x;
+    } else {
+        *error += (x - t) + *sum;
+    }
+    *sum = t;
+}
+
+aggregate_changes_datum_stream_t::aggregate_changes_datum_stream_t(
+    counted_t<datum_stream_t> &&_source,
+    aggregate_kind_t _kind,
+    std::vector<counted_t<const func_t> > &&group_funcs,
+    counted_t<const func_t> &&_func,
+    bool _include_initial,
+    bool _include_states,
+    backtrace_id_t _bt)
+    : eager_datum_stream_t(_bt),
+      source(std::move(_source)),
+      kind(_kind),
+      func(std::move(_func)),
+      include_initial(_include_initial),
+      include_states(_include_states),
+      ready(false) {
+    if (!group_funcs.empty()) {
+        grouping = make_op(group_wire_func_t(std::move(group_funcs), false, false));
+    }
+}
+
+aggregate_changes_datum_stream_t::~aggregate_changes_datum_stream_t() { }
+
+void aggregate_changes_datum_stream_t::set_notes(response_t *res) const {
+    if (include_states) res->add_note(Response::INCLUDES_STATES);
+}
+
+std::vector<datum_t> aggregate_changes_datum_stream_t::next_raw_batch(
+        env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> batch;
+    while (batch.empty()) {
+        // The values of the groups that changed, from before this batch.
+        std::map<datum_t, datum_t> old_values;
+        for (const datum_t &d : source->next_batch(env, batchspec)) {
+            datum_t state = d.get_field("state", NOTHROW);
+            if (state.has()) {
+                if (state == datum_t("ready")) {
+                    ready = true;
+                    if (include_initial && grouping.has()) {
+                        for (const auto &pair : groups) {
+                            batch.push_back(make_change(
+                                pair.first, datum_t(), group_value(pair.first)));
+                        }
+                    } else if (include_initial) {
+                        batch.push_back(make_change(
+                            datum_t::null(), datum_t(), group_value(datum_t::null())));
+                    }
+                    if (include_states) batch.push_back(d);
+                } else if (include_initial && include_states) {
+                    batch.push_back(d);
+                }
+                continue;
+            }
+            datum_t error = d.get_field("error", NOTHROW);
+            rcheck(!error.has(), base_exc_t::OP_FAILED,
+                   strprintf("Cannot keep the aggregation up to date because the "
+                             "changefeed lost changes: %s",
+                             error.as_str().to_std().c_str()));
+            std::map<datum_t, datum_t> *old_values_out = ready ? &old_values : nullptr;
+            apply(env, d.get_field("old_val", NOTHROW), false, old_values_out);
+            apply(env, d.get_field("new_val", NOTHROW), true, old_values_out);
+        }
+        for (const auto &pair : old_values) {
+            datum_t new_val = group_value(pair.first);
+            if (pair.second.has() != new_val.has()
+                || (new_val.has() && new_val != pair.second)) {
+                batch.push_back(make_change(
+                    pair.first,
+                    pair.second.has() ? pair.second : datum_t::null(),
+                    new_val));
+            }
+        }
+        if (ok_to_return_empty_batch(env, true, batchspec.get_batch_type())) {
+            break;
+        }
+    }
+    return batch;
+}
+
+void aggregate_changes_datum_stream_t::apply(
+        env_t *env, const datum_t &row, bool add,
+        std::map<datum_t, datum_t> *old_values_out) {
+    if (!row.has() || row.get_type() == datum_t::R_NULL) {
+        return;
+    }
+    const bool sums = kind == aggregate_kind_t::SUM || kind == aggregate_kind_t::AVG;
+    datum_t val;
+    groups_t row_groups;
+    try {
+        if (kind == aggregate_kind_t::COUNT) {
+            if (func.has() && !func->filter_call(env, row, counted_t<const func_t>())) {
+                return;
+            }
+        } else {
+            val = func.has() ? func->call(env, row)->as_datum() : row;
+            if (sums && val.get_type() != datum_t::R_NUM) {
+                return;
+            }
+        }
+        if (grouping.has()) {
+            row_groups[datum_t()].push_back(row);
+            (*grouping)(env, &row_groups, []() { return datum_t(); });
+        } else {
+            row_groups[datum_t::null()].push_back(row);
+        }
+    } catch (const base_exc_t &) {
+        // The row doesn't count, like rows that the transformations of a
+        // changefeed fail on.  Since everything is deterministic, the same happens
+        // when the row is removed again.
+        return;
+    }
+
+    for (const auto &pair : row_groups) {
+        const datum_t &group = pair.first;
+        if (old_values_out != nullptr && old_values_out->count(group) == 0) {
+            (*old_values_out)[group] = group_value(group);
+        }
+        if (add) {
+            group_state_t *state = &groups[group];
+            state->count += 1;
+            if (sums) {
+                add_to_sum(val.as_num(), &state->sum, &state->sum_error);
+            } else if (kind != aggregate_kind_t::COUNT) {
+                state->values.insert(std::make_pair(val, row));
+                rcheck_array_size(state->values, env->limits());
+            }
+        } else {
+            auto it = groups.find(group);
+            rcheck(it != groups.end(), base_exc_t::OP_FAILED,
+                   "Cannot keep the aggregation up to date because the changefeed "
+                   "removed a row that wasn't in it.");
+            it->second.count -= 1;
+            if (it->second.count == 0) {
+                groups.erase(it);
+            } else if (sums) {
+                add_to_sum(-val.as_num(), &it->second.sum, &it->second.sum_error);
+            } else if (kind != aggregate_kind_t::COUNT) {
+                it->second.values.erase(std::make_pair(val, row));
+            }
+        }
+    }
+}
+
+datum_t aggregate_changes_datum_stream_t::group_value(const datum_t &group) const {
+    auto it = groups.find(group);
+    if (it == groups.end()) {
+        if (grouping.has()) {
+            return datum_t();
+        }
+        return kind == aggregate_kind_t::COUNT || kind == aggregate_kind_t::SUM
+            ? datum_t(0.0)
+            : datum_t::null();
+    }
+    const group_state_t &state = it->second;
+    switch (kind) {
+    case aggregate_kind_t::COUNT:
+        return datum_t(static_cast<double>(state.count));
+    case aggregate_kind_t::SUM:
+        return datum_t(state.sum + state.sum_error);
+    case aggregate_kind_t::AVG:
+        return datum_t((state.sum + state.sum_error) / state.count);
+    case aggregate_kind_t::MIN:
+        return state.values.begin()->second;
+    case aggregate_kind_t::MAX:
+        return state.values.rbegin()->second;
+    default:
+        unreachable();
+    }
+}
+
+datum_t aggregate_changes_datum_stream_t::make_change(const datum_t &group,
+                                                      const datum_t &old_val,
+                                                      const datum_t &new_val) const {
+    std::map<datum_string_t, datum_t> change;
+    if (grouping.has()) {
+        change[datum_string_t("group")] = group;
+    }
+    if (old_val.has()) {
+        change[datum_string_t("old_val")] = old_val;
+    }
+    change[datum_string_t("new_val")] = new_val.has() ? new_val : datum_t::null();
+    return datum_t(std::move(change));
+}
+
 vector_datum_stream_t::vector_datum_stream_t(
         backtrace_id_t _bt,
         std::vector<datum_t> &&_rows,
@@ -0,0 +1,82 @@
+#ifndef RDB_PROTOCOL_DATUM_STREAM_AGGREGATE_CHANGES_HPP_
+#define RDB_PROTOCOL_DATUM_STREAM_AGGREGATE_CHANGES_HPP_
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "rdb_protocol/datum_stream.hpp"
+
+namespace ql {
+
+class op_t;
+
+enum class aggregate_kind_t { COUNT, SUM, AVG, MIN, MAX };
+
+/* `aggregate_changes_datum_stream_t` is what `changes` on `count`, `sum`, `avg`, `min`
+or `max` (optionally after a `group`) turns into.  `source` has to be a changefeed on
+the underlying sequence with `include_initial` and `include_states`; we fold its
+initial values and changes into per-group state and emit a change for every group
+whose value changed with a batch.  Rows that `func` or the grouping fails on don't
+count, as with the transformations of other changefeeds. */
+class aggregate_changes_datum_stream_t : public eager_datum_stream_t {
+public:
+    aggregate_changes_datum_stream_t(counted_t<datum_stream_t> &&_source,
+                                     aggregate_kind_t _kind,
+                                     std::vector<counted_t<const func_t> > &&group_funcs,
+                                     counted_t<const func_t> &&_func,
+                                     bool _include_initial,
+                                     bool _include_states,
+                                     backtrace_id_t bt);
+    ~aggregate_changes_datum_stream_t();
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    void set_notes(response_t *res) const final;
+    bool is_array() const final { return false; }
+    bool is_exhausted() const final { return false; }
+    feed_type_t cfeed_type() const final { return source->cfeed_type(); }
+    bool is_infinite() const final { return true; }
+
+private:
+    struct group_state_t {
+        group_state_t() : count(0), sum(0.0), sum_error(0.0) { }
+        // The number of rows in the group, and the sum of their values for `sum` and
+        // `avg`.  The sum is compensated (see `add_to_sum()`), so that it doesn't
+        // drift away from the sum of the rows over many changes.
+        uint64_t count;
+        double sum;
+        double sum_error;
+        // The values and rows for `min` and `max`, so that we can take rows out again.
+        // Bounded by the array limit.
+        std::set<std::pair<datum_t, datum_t> > values;
+    };
+
+    // Adds or removes `row` from the groups it belongs to, noting the value of any
+    // group that wasn't in `*old_values_out` yet before changing it.
+    void apply(env_t *env, const datum_t &row, bool add,
+               std::map<datum_t, datum_t> *old_values_out);
+    // Returns an empty datum if the group has no value.
+    datum_t group_value(const datum_t &group) const;
+    datum_t make_change(const datum_t &group,
+                        const datum_t &old_val,
+                        const datum_t &new_val) const;
+
+    counted_t<datum_stream_t> source;
+    const aggregate_kind_t kind;
+    // Empty if there's no `group`.
+    scoped_ptr_t<op_t> grouping;
+    // The predicate for `count`, or what to aggregate for the others.  May be empty.
+    counted_t<const func_t> func;
+    const bool include_initial, include_states;
+
+    // Whether `source` is done sending the initial values.
+    bool ready;
+    std::map<datum_t, group_state_t> groups;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_STREAM_AGGREGATE_CHANGES_HPP_
@@ -0,0 +1,80 @@
+#ifndef RDB_PROTOCOL_DATUM_STREAM_EXTERNAL_SORT_HPP_
+#define RDB_PROTOCOL_DATUM_STREAM_EXTERNAL_SORT_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "containers/disk_backed_queue.hpp"
+#include "paths.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+
+namespace ql {
+
+/* Sorts sequences that are too large to be sorted in memory.  The input is handed
+over in runs, each of which gets sorted in memory and spilled to a temporary file.
+Reading from the stream merges the runs.  Equal elements come out in the order in
+which they were added, so the sort is stable like the in-memory one. */
+class external_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    external_sort_datum_stream_t(
+        io_backender_t *io_backender,
+        const base_path_t &base_path,
+        std::function<bool(env_t *,  // NOLINT(readability/casting)
+                           profile::sampler_t *,
+                           const datum_t &,
+                           const datum_t &)> lt_cmp,
+        backtrace_id_t bt);
+
+    /* All runs must be added before the stream is read from. */
+    void add_run(env_t *env, std::vector<datum_t> &&data);
+
+    virtual bool is_exhausted() const;
+    virtual feed_type_t cfeed_type() const;
+    virtual bool is_infinite() const;
+
+private:
+    typedef disk_backed_queue_t<datum_t> run_t;
+
+    virtual bool is_array() const { return false; }
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    scoped_ptr_t<run_t> make_run();
+    // Merges the runs in `runs` from `first` on into a single one.
+    void merge_runs(env_t *env, profile::sampler_t *sampler, size_t first);
+    // Starts merging the runs in `runs` from `first` on.
+    void start_merge(env_t *env, profile::sampler_t *sampler, size_t first);
+    // Removes the next element from the merge of all runs.
+    datum_t next_merged(env_t *env, profile::sampler_t *sampler);
+    /* The heap comparison for `heap`.  `std::push_heap()` and friends put the largest
+    element first, so this orders runs by their heads in reverse.  Ties go to the
+    earlier run. */
+    bool merge_after(env_t *env, profile::sampler_t *sampler, size_t a, size_t b) const;
+
+    io_backender_t *const io_backender;
+    const base_path_t base_path;
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const datum_t &,
+                       const datum_t &)> lt_cmp;
+
+    // The queues register themselves in here.  It's not part of any global stats.
+    perfmon_collection_t perfmon_collection;
+
+    std::vector<scoped_ptr_t<run_t> > runs;
+    /* `levels[i]` is the number of times the elements of `runs[i]` have been merged.
+    We only ever merge the last `EXTERNAL_SORT_MAX_RUNS` runs, once they are all on
+    the same level, so levels never increase along `runs` and the runs stay in the
+    order in which their elements were added. */
+    std::vector<size_t> levels;
+
+    /* While merging, `heads[i]` is the smallest element of `runs[i]` that hasn't been
+    returned yet, and `heap` holds the indices of the runs that aren't empty. */
+    bool merging;
+    std::vector<datum_t> heads;
+    std::vector<size_t> heap;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_STREAM_EXTERNAL_SORT_HPP_
@@ -0,0 +1,137 @@
+#ifndef RDB_PROTOCOL_DATUM_STREAM_HASH_JOIN_HPP_
+#define RDB_PROTOCOL_DATUM_STREAM_HASH_JOIN_HPP_
+
+#include <vector>
+
+#include "containers/disk_backed_queue.hpp"
+#include "paths.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/datum_stream/external_sort.hpp"
+#include "rdb_protocol/group_table.hpp"
+
+namespace ql {
+
+/* Evaluates an `inner_join` whose predicate is an equality between a function of the
+left row and a function of the right row.  The right rows have already been read
+into memory; on the first left batch they get hashed by `right_key`, and every left
+row then looks up its matches by `left_key`.  The output is the same as that of the
+nested loop: for each left row, the matching right rows in order.  As in the nested
+loop, the key functions are only evaluated if both sides are non-empty. */
+class hash_join_datum_stream_t : public eager_datum_stream_t {
+public:
+    hash_join_datum_stream_t(counted_t<datum_stream_t> _stream,
+                             counted_t<const func_t> _left_key,
+                             counted_t<const func_t> _right_key,
+                             std::vector<datum_t> &&_right_rows,
+                             backtrace_id_t bt);
+
+    bool is_array() const final {
+        return stream->is_array();
+    }
+    bool is_infinite() const final {
+        return stream->is_infinite();
+    }
+    bool is_exhausted() const final;
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    feed_type_t cfeed_type() const final {
+        return stream->cfeed_type();
+    }
+
+private:
+    void build(env_t *env);
+
+    counted_t<datum_stream_t> stream;
+    counted_t<const func_t> left_key;
+    counted_t<const func_t> right_key;
+
+    // The right rows are moved into `build_side` by `build()`.
+    std::vector<datum_t> right_rows;
+    scoped_ptr_t<group_table_t<std::vector<datum_t> > > build_side;
+};
+
+/* Evaluates the same kind of join as `hash_join_datum_stream_t` when the right side
+doesn't fit in memory.  On the first read, both sides get partitioned into temporary
+files by the hash of their keys, so that matching rows end up in the same partition.
+Then every partition is joined on its own: its right rows get hashed, at most an
+array's worth at a time in case the keys are skewed, and its left rows look up their
+matches in them.  Left rows carry their position in the left side through all of
+this, and the joined pairs get sorted by it on disk, so that the output is in the
+same order as that of the nested loop.  The left side must be finite. */
+class grace_hash_join_datum_stream_t : public eager_datum_stream_t {
+public:
+    /* `_right_rows` are the rows that have already been read from `_right`, which
+    holds the rest of the right side. */
+    grace_hash_join_datum_stream_t(io_backender_t *_io_backender,
+                                   const base_path_t &_base_path,
+                                   counted_t<datum_stream_t> _left,
+                                   counted_t<const func_t> _left_key,
+                                   std::vector<datum_t> &&_right_rows,
+                                   counted_t<datum_stream_t> _right,
+                                   counted_t<const func_t> _right_key,
+                                   backtrace_id_t bt);
+
+    bool is_array() const final { return false; }
+    bool is_infinite() const final { return false; }
+    bool is_exhausted() const final;
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    feed_type_t cfeed_type() const final { return feed_type_t::not_feed; }
+
+private:
+    /* Every entry of a partition is a `[key, row]` pair, or a `[key, row, position]`
+    triple for the left side. */
+    typedef disk_backed_queue_t<datum_t> partition_t;
+
+    scoped_ptr_t<partition_t> make_partition();
+    /* Reads `stream` (after `rows`) into a fresh set of partitions, keyed by `key`.
+    Adds the position of every row to its entry if `with_positions` is true.
+    Returns the number of rows. */
+    size_t partition(env_t *env,
+                     std::vector<datum_t> &&rows,
+                     datum_stream_t *stream,
+                     const counted_t<const func_t> &key,
+                     bool with_positions,
+                     std::vector<scoped_ptr_t<partition_t> > *parts_out);
+    // Hashes the next chunk of the right rows of partition `current`.
+    void build_chunk(env_t *env);
+    void flush_left_rest();
+    // Joins all partitions into `sorted`.
+    void join(env_t *env);
+
+    io_backender_t *const io_backender;
+    const base_path_t base_path;
+    // The partitions register themselves in here.  It's not part of any global stats.
+    perfmon_collection_t perfmon_collection;
+
+    counted_t<datum_stream_t> left;
+    counted_t<const func_t> left_key;
+    std::vector<datum_t> right_rows;
+    counted_t<datum_stream_t> right;
+    counted_t<const func_t> right_key;
+
+    // Whether `join()` has run.
+    bool joined;
+    std::vector<scoped_ptr_t<partition_t> > left_parts;
+    std::vector<scoped_ptr_t<partition_t> > right_parts;
+    // The partition that's being joined.
+    size_t current;
+    // The right rows of the current chunk of partition `current`, by key.
+    scoped_ptr_t<group_table_t<std::vector<datum_t> > > chunk;
+    /* If partition `current` has right rows left over for another chunk, the left
+    rows that have been joined with the current chunk get saved in here, to be joined
+    with the next one. */
+    scoped_ptr_t<partition_t> left_rest;
+    std::vector<datum_t> left_rest_buffer;
+
+    // The joined pairs as `[position, pair]`, sorted by the left row's position.
+    counted_t<external_sort_datum_stream_t> sorted;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_STREAM_HASH_JOIN_HPP_
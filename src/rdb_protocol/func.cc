@@ -5,6 +5,7 @@
 
 #include "pprint/js_pprint.hpp"
 #include "pprint/pprint.hpp"
+#include "rdb_protocol/compiled_expr.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
@@ -47,7 +48,9 @@ reql_func_t::reql_func_t(const var_scope_t &_captured_scope,
     : func_t(_body->backtrace()),
       captured_scope(_captured_scope),
       arg_names(std::move(_arg_names)),
-      body(std::move(_body)) { }
+      body(std::move(_body)) {
+    compile_body();
+}
 
 reql_func_t::reql_func_t(scoped_ptr_t<term_storage_t> &&_storage,
                          const var_scope_t &_captured_scope,
@@ -57,10 +60,82 @@ reql_func_t::reql_func_t(scoped_ptr_t<term_storage_t> &&_storage,
       captured_scope(_captured_scope),
       arg_names(std::move(_arg_names)),
       term_storage(std::move(_storage)),
-      body(std::move(_body)) { }
+      body(std::move(_body)) {
+    compile_body();
+}
 
 reql_func_t::~reql_func_t() { }
 
+void reql_func_t::compile_body() {
+    if (arg_names.size() == 1) {
+        // `r.row` refers to our argument unless it's captured from an enclosing function.
+        const bool implicit_is_arg = function_emits_implicit_variable(arg_names)
+            && captured_scope.compute_visibility().get_implicit_depth() == 0;
+        compiled_body = compiled_expr_t::compile(
+            body->get_src(), arg_names[0], implicit_is_arg);
+    }
+}
+
+bool reql_func_t::start_compiled_eval(env_t *env) const {
+    // The profiler wants to see every term, so we don't take the shortcut then.
+    if (!compiled_body.has() || env->profile() == profile_bool_t::PROFILE) {
+        return false;
+    }
+    // This stands in for the checks `runtime_term_t::eval` does for every term.
+    env->do_eval_callback();
+    if (env->interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+    env->maybe_yield();
+    return true;
+}
+
+bool reql_func_t::maybe_eval_compiled(env_t *env,
+                                      const datum_t &arg,
+                                      datum_t *out) const {
+    return start_compiled_eval(env) && compiled_body->eval(arg, env->limits(), out);
+}
+
+void reql_func_t::map_batch(env_t *env, std::vector<datum_t> *args) const {
+    if (!start_compiled_eval(env)) {
+        func_t::map_batch(env, args);
+        return;
+    }
+    const configured_limits_t limits = env->limits();
+    for (auto it = args->begin(); it != args->end(); ++it) {
+        datum_t res;
+        if (compiled_body->eval(*it, limits, &res)) {
+            *it = std::move(res);
+        } else {
+            *it = func_t::call(env, *it)->as_datum();
+        }
+    }
+}
+
+void reql_func_t::filter_batch(env_t *env,
+                               std::vector<datum_t> *args,
+                               counted_t<const func_t> default_filter_val) const {
+    if (!start_compiled_eval(env)) {
+        func_t::filter_batch(env, args, std::move(default_filter_val));
+        return;
+    }
+    const configured_limits_t limits = env->limits();
+    auto loc = args->begin();
+    for (auto it = args->begin(); it != args->end(); ++it) {
+        // The compiled body is never `MAKE_OBJ` or `DATUM`, so the result is simply
+        // converted to a bool, see `filter_helper`.
+        datum_t res;
+        const bool keep = compiled_body->eval(*it, limits, &res)
+            ? res.as_bool()
+            : filter_call(env, *it, default_filter_val);
+        if (keep) {
+            std::swap(*loc, *it);
+            ++loc;
+        }
+    }
+    args->erase(loc, args->end());
+}
+
 scoped_ptr_t<val_t> reql_func_t::call(env_t *env,
                                       const std::vector<datum_t> &args,
                                       eval_flags_t eval_flags) const {
@@ -77,6 +152,11 @@ scoped_ptr_t<val_t> reql_func_t::call(env_t *env,
                          arg_names.size(),
                          (arg_names.size() == 1 ? "" : "s")));
 
+        datum_t compiled_result;
+        if (args.size() == 1 && maybe_eval_compiled(env, args[0], &compiled_result)) {
+            return make_scoped<val_t>(std::move(compiled_result), backtrace());
+        }
+
         var_scope_t new_scope = arg_names.size() == 0
             ? captured_scope
             : captured_scope.with_func_arg_list(arg_names, args);
@@ -101,6 +181,10 @@ bool reql_func_t::is_simple_selector() const {
     return body->is_simple_selector();
 }
 
+bool reql_func_t::is_field_eq(datum_string_t *field_out, datum_t *value_out) const {
+    return compiled_body.has() && compiled_body->is_field_eq(field_out, value_out);
+}
+
 js_func_t::js_func_t(const std::string &_js_source,
                      uint64_t timeout_ms,
                      backtrace_id_t _backtrace)
@@ -263,6 +347,11 @@ bool filter_match(datum_t predicate, datum_t value,
 }
 
 bool reql_func_t::filter_helper(env_t *env, datum_t arg) const {
+    // The compiled body is never `MAKE_OBJ` or `DATUM`, so we can skip the `val_t`.
+    datum_t compiled_result;
+    if (maybe_eval_compiled(env, arg, &compiled_result)) {
+        return compiled_result.as_bool();
+    }
     datum_t d = call(env, make_vector(arg), NO_FLAGS)->as_datum();
     if (d.get_type() == datum_t::R_OBJECT &&
         (body->get_src().type() == Term::MAKE_OBJ ||
@@ -319,6 +408,25 @@ bool js_func_t::filter_helper(env_t *env, datum_t arg) const {
     return d.as_bool();
 }
 
+void func_t::map_batch(env_t *env, std::vector<datum_t> *args) const {
+    for (auto it = args->begin(); it != args->end(); ++it) {
+        *it = call(env, *it)->as_datum();
+    }
+}
+
+void func_t::filter_batch(env_t *env,
+                          std::vector<datum_t> *args,
+                          counted_t<const func_t> default_filter_val) const {
+    auto loc = args->begin();
+    for (auto it = args->begin(); it != args->end(); ++it) {
+        if (filter_call(env, *it, default_filter_val)) {
+            std::swap(*loc, *it);
+            ++loc;
+        }
+    }
+    args->erase(loc, args->end());
+}
+
 bool func_t::filter_call(env_t *env, datum_t arg, counted_t<const func_t> default_filter_val) const {
     // We have to catch every exception type and save it so we can rethrow it later
     // So we don't trigger a coroutine wait in a catch statement
@@ -24,6 +24,7 @@ class js_runner_t;
 
 namespace ql {
 
+class compiled_expr_t;
 class func_visitor_t;
 
 class func_t : public slow_atomic_countable_t<func_t>, public bt_rcheckable_t {
@@ -55,6 +56,15 @@ public:
                      datum_t arg,
                      counted_t<const func_t> default_filter_val) const;
 
+    // These do the same as `call` and `filter_call` on each element of `args`, but
+    // allow implementations to pay their per-call overhead only once per batch.
+    // `map_batch` replaces each element by the result, and `filter_batch` removes the
+    // elements that don't match.
+    virtual void map_batch(env_t *env, std::vector<datum_t> *args) const;
+    virtual void filter_batch(env_t *env,
+                              std::vector<datum_t> *args,
+                              counted_t<const func_t> default_filter_val) const;
+
     // These are simple, they call the vector version of call.
     scoped_ptr_t<val_t> call(env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
     scoped_ptr_t<val_t> call(env_t *env,
@@ -69,6 +79,13 @@ public:
         return false;
     }
 
+    // Returns `true` if this is a one-argument function that compares a field of its
+    // argument with a constant, like `r.row('field').eq(value)`.
+    virtual bool is_field_eq(UNUSED datum_string_t *field_out,
+                             UNUSED datum_t *value_out) const {
+        return false;
+    }
+
 protected:
     explicit func_t(backtrace_id_t bt);
 
@@ -108,11 +125,26 @@ public:
     void visit(func_visitor_t *visitor) const;
 
     bool is_simple_selector() const final;
+    bool is_field_eq(datum_string_t *field_out, datum_t *value_out) const final;
+
+    void map_batch(env_t *env, std::vector<datum_t> *args) const final;
+    void filter_batch(env_t *env,
+                      std::vector<datum_t> *args,
+                      counted_t<const func_t> default_filter_val) const final;
 
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
+    friend class normalized_func_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
 
+    void compile_body();
+    // Returns `false` if `compiled_body` can't be used.  Otherwise it does the checks
+    // that evaluating `body` would do, which cover any number of calls to
+    // `compiled_body->eval` that follow.
+    bool start_compiled_eval(env_t *env) const;
+    // Returns `false` if `body` has to be evaluated instead.
+    bool maybe_eval_compiled(env_t *env, const datum_t &arg, datum_t *out) const;
+
     // Only contains the parts of the scope that `body` uses.
     var_scope_t captured_scope;
 
@@ -126,6 +158,9 @@ private:
     // The body of the function, which gets ->eval(...) called when call(...) is called.
     counted_t<const term_t> body;
 
+    // Evaluates simple one-argument bodies without going through `body`, if possible.
+    scoped_ptr_t<compiled_expr_t> compiled_body;
+
     DISABLE_COPYING(reql_func_t);
 };
 
@@ -153,6 +188,7 @@ public:
 
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
+    friend class normalized_func_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
 
     std::string js_source;
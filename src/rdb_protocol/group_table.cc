@@ -0,0 +1,101 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/group_table.hpp"
+
+#include <string.h>
+
+#include <string>
+
+#include "containers/bloom_filter.hpp"
+#include "rdb_protocol/pseudo_geometry.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+
+namespace ql {
+
+// Below this depth we only hash the types of nested values.  That keeps the hash
+// consistent with equality while bounding the stack usage for deeply nested data.
+const int HASH_DATUM_MAX_DEPTH = 16;
+
+uint64_t hash_bytes(const char *data, size_t size) {
+    return bloom_filter_t::hash(data, size);
+}
+
+uint64_t hash_combine(uint64_t seed, uint64_t h) {
+    return hash_bytes(reinterpret_cast<const char *>(&h), sizeof(h)) ^
+        (seed * 0x9e3779b97f4a7c15ULL);
+}
+
+uint64_t hash_num(double d) {
+    // -0.0 and 0.0 compare equal.
+    if (d == 0) {
+        d = 0;
+    }
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return hash_combine(datum_t::R_NUM, bits);
+}
+
+uint64_t hash_datum_at_depth(const datum_t &d, int depth) {
+    // This has to mirror `datum_t::cmp_unchecked_stack()`, where geometry is the one
+    // pseudotype that compares like a regular object.
+    if (d.is_ptype() && !d.is_ptype(pseudo::geometry_string)) {
+        if (d.get_type() == datum_t::R_BINARY) {
+            const datum_string_t &data = d.as_binary();
+            return hash_combine(datum_t::R_BINARY, hash_bytes(data.data(), data.size()));
+        }
+        const std::string reql_type = d.get_reql_type();
+        const uint64_t type_hash = hash_bytes(reql_type.data(), reql_type.size());
+        if (reql_type == pseudo::time_string) {
+            // Times in different time zones are equal if they're the same instant.
+            return hash_combine(type_hash, hash_num(pseudo::time_to_epoch_time(d)));
+        }
+        // Other pseudotypes can't be compared at all.
+        return type_hash;
+    }
+
+    const datum_t::type_t type = d.get_type();
+    if (depth >= HASH_DATUM_MAX_DEPTH) {
+        return hash_combine(type, 0);
+    }
+    switch (type) {
+    case datum_t::MINVAL: // fallthru
+    case datum_t::MAXVAL: // fallthru
+    case datum_t::R_NULL:
+        return hash_combine(type, 0);
+    case datum_t::R_BOOL:
+        return hash_combine(type, d.as_bool());
+    case datum_t::R_NUM:
+        return hash_num(d.as_num());
+    case datum_t::R_STR:
+        return hash_combine(type, hash_bytes(d.as_str().data(), d.as_str().size()));
+    case datum_t::R_ARRAY: {
+        uint64_t h = hash_combine(type, d.arr_size());
+        for (size_t i = 0; i < d.arr_size(); ++i) {
+            h = hash_combine(h, hash_datum_at_depth(d.get(i), depth + 1));
+        }
+        return h;
+    }
+    case datum_t::R_OBJECT: {
+        // Objects keep their fields sorted, which is the order they're compared in.
+        uint64_t h = hash_combine(type, d.obj_size());
+        for (size_t i = 0; i < d.obj_size(); ++i) {
+            auto pair = d.get_pair(i);
+            h = hash_combine(h, hash_bytes(pair.first.data(), pair.first.size()));
+            h = hash_combine(h, hash_datum_at_depth(pair.second, depth + 1));
+        }
+        return h;
+    }
+    case datum_t::R_BINARY: // fallthru
+    case datum_t::UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+}
+
+uint64_t hash_datum(const datum_t &d) {
+    if (!d.has()) {
+        return 0;
+    }
+    return hash_datum_at_depth(d, 0);
+}
+
+}  // namespace ql
@@ -0,0 +1,135 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_GROUP_TABLE_HPP_
+#define RDB_PROTOCOL_GROUP_TABLE_HPP_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+/* Hashes `d` consistently with `datum_t::cmp()`: data that compare equal have the same
+hash.  The empty datum, which is the key of ungrouped data, is allowed. */
+uint64_t hash_datum(const datum_t &d);
+
+/* Lets unordered containers be keyed by data.  `datum_t::operator==` agrees with
+`datum_t::cmp()`, so it goes with this hash. */
+struct datum_hash_t {
+    size_t operator()(const datum_t &d) const {
+        return hash_datum(d);
+    }
+};
+
+/* `group_table_t` holds the per-group state of an aggregation, keyed by the group.
+It's an open-addressing hash table with linear probing, so finding the state of a
+group costs a hash and usually one comparison, instead of the O(log n) comparisons of
+a `grouped_t`.  That matters for groupings with many distinct groups, where nearly
+every element lands in a group we've already seen on an earlier batch.
+
+Iteration is in insertion order; callers that need the groups sorted move them into
+a `grouped_t` once they are done accumulating. */
+template<class T>
+class group_table_t {
+public:
+    typedef typename std::vector<std::pair<datum_t, T> >::iterator iterator;
+
+    group_table_t() { }
+
+    /* Returns the state of the group `key`, which starts out as a copy of
+    `default_val` if the group is new.  Sets `*inserted_out` to whether it was. */
+    T *find_or_insert(const datum_t &key, const T &default_val, bool *inserted_out) {
+        if (2 * (entries.size() + 1) > slots.size()) {
+            grow();
+        }
+        const uint64_t hash = hash_datum(key);
+        size_t slot = find_slot(key, hash);
+        if (slots[slot] != 0) {
+            *inserted_out = false;
+            return &entries[slots[slot] - 1].second;
+        }
+        entries.push_back(std::make_pair(key, default_val));
+        hashes.push_back(hash);
+        slots[slot] = entries.size();
+        *inserted_out = true;
+        return &entries.back().second;
+    }
+
+    /* Returns the state of the group `key`, or `nullptr` if there is no such group. */
+    T *find(const datum_t &key) {
+        if (entries.empty()) {
+            return nullptr;
+        }
+        size_t slot = find_slot(key, hash_datum(key));
+        return slots[slot] == 0 ? nullptr : &entries[slots[slot] - 1].second;
+    }
+
+    /* Removes the group that was inserted last.  Nothing that was inserted after it
+    can have probed past its slot, so it's safe to just empty the slot. */
+    void erase_last() {
+        guarantee(!entries.empty());
+        size_t slot = find_slot(entries.back().first, hashes.back());
+        guarantee(slots[slot] == entries.size());
+        slots[slot] = 0;
+        entries.pop_back();
+        hashes.pop_back();
+    }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    size_t size() const { return entries.size(); }
+
+    void clear() {
+        entries.clear();
+        hashes.clear();
+        slots.clear();
+    }
+
+private:
+    // Returns the slot that holds `key`, or the empty slot where it would go.
+    size_t find_slot(const datum_t &key, uint64_t hash) const {
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            const size_t index = slots[slot];
+            if (index == 0) {
+                return slot;
+            }
+            if (hashes[index - 1] == hash && keys_equal(entries[index - 1].first, key)) {
+                return slot;
+            }
+        }
+    }
+
+    static bool keys_equal(const datum_t &a, const datum_t &b) {
+        return a.has() ? (b.has() && a == b) : !b.has();
+    }
+
+    // Doubles the number of slots, keeping the table at most half full.
+    void grow() {
+        std::vector<size_t> new_slots(slots.empty() ? 16 : 2 * slots.size(), 0);
+        slots.swap(new_slots);
+        const size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            size_t slot = hashes[i] & mask;
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = i + 1;
+        }
+    }
+
+    std::vector<std::pair<datum_t, T> > entries;
+    // `hashes[i]` is the hash of `entries[i].first`.
+    std::vector<uint64_t> hashes;
+    // Each slot holds an index into `entries` plus one, or zero if it's empty.
+    std::vector<size_t> slots;
+
+    DISABLE_COPYING(group_table_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_GROUP_TABLE_HPP_
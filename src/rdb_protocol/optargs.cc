@@ -44,6 +44,7 @@ static const std::set<std::string> acceptable_optargs({
     "attempts",
     "auth",
     "base",
+    "batch_interval",
     "binary_format",
     "changefeed_queue_size",
     "conflict",
@@ -65,6 +66,7 @@ static const std::set<std::string> acceptable_optargs({
     "header",
     "identifier_format",
     "ignore_write_hook",
+    "include_cursors",
     "include_initial",
     "include_offsets",
     "include_states",
@@ -101,6 +103,7 @@ static const std::set<std::string> acceptable_optargs({
     "right_bound",
     "shards",
     "squash",
+    "start_after",
     "time_format",
     "timeout",
     "unit",
@@ -15,6 +15,7 @@
 namespace ql {
 
 enum order_direction_t { ASC, DESC };
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(order_direction_t, int8_t, ASC, DESC);
 
 class scope_env_t;
 class env_t;
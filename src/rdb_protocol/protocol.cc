@@ -1476,8 +1476,8 @@ RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_subscribe_response_t, server_uuids, addrs);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_limit_subscribe_response_t, shards, limit_addrs);
-RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
-    shard_stamp_info_t, stamp, shard_region, last_read_start);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
+    shard_stamp_info_t, stamp, shard_region, last_read_start, change_log);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(changefeed_stamp_response_t, stamp_infos);
 
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
@@ -1551,7 +1551,8 @@ RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
     serializable_env,
     region,
     current_shard);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_stamp_t, addr, region);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
+    changefeed_stamp_t, addr, region, include_change_log, resume_after);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_point_stamp_t, addr, key);
 
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(read_t, read, profile, read_mode);
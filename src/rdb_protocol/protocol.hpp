@@ -109,6 +109,8 @@ struct shard_stamp_info_t {
     region_t shard_region;
     // The starting points of the reads (assuming left to right traversal)
     store_key_t last_read_start;
+    // Only set for reads with `include_change_log`.
+    optional<ql::changefeed::change_log_info_t> change_log;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(shard_stamp_info_t);
 
@@ -285,11 +287,18 @@ struct sindex_rangespec_t {
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sindex_rangespec_t);
 
 struct changefeed_stamp_t {
-    changefeed_stamp_t() : region(region_t::universe()) { }
+    changefeed_stamp_t() : region(region_t::universe()), include_change_log(false) { }
     explicit changefeed_stamp_t(ql::changefeed::client_t::addr_t _addr)
-        : addr(std::move(_addr)), region(region_t::universe()) { }
+        : addr(std::move(_addr)),
+          region(region_t::universe()),
+          include_change_log(false) { }
     ql::changefeed::client_t::addr_t addr;
     region_t region;
+    // Set by resumable changefeeds.  If `resume_after` is set too, the response
+    // includes the logged changes after the given position for each changefeed
+    // `server_t` in it.
+    bool include_change_log;
+    optional<std::map<uuid_u, uint64_t> > resume_after;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_stamp_t);
 
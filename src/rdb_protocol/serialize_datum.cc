@@ -966,6 +966,30 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
     }
 }
 
+datum_t datum_get_field_from_buf(const shared_buf_ref_t<char> &object,
+                                 size_t key_size, const char *key_data) {
+    // The pairs are sorted by key, so we can use binary search over the offset
+    // table.  Each pair is a `datum_string_t` key followed by the value.
+    size_t range_beg = 0;
+    size_t range_end = datum_get_array_size(object);
+    while (range_beg < range_end) {
+        const size_t center = range_beg + ((range_end - range_beg) / 2);
+        const size_t offset = datum_get_element_offset(object, center);
+        datum_string_t center_key(object.make_child(offset));
+        const int cmp_res = center_key.compare(key_size, key_data);
+        if (cmp_res == 0) {
+            return datum_deserialize_from_buf(
+                object, offset + datum_serialized_size(center_key));
+        } else if (cmp_res > 0) {
+            range_end = center;
+        } else {
+            range_beg = center + 1;
+        }
+        rassert(range_beg <= range_end);
+    }
+    return datum_t();
+}
+
 size_t datum_serialized_size(const datum_string_t &s) {
     const size_t s_size = s.size();
     return varint_uint64_serialized_size(s_size) + s_size;
@@ -1,6 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <utility>
 
 #include "errors.hpp"
@@ -9,6 +12,8 @@
 #include "debug.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/group_table.hpp"
+#include "rdb_protocol/order_util.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/serialize_datum.hpp"
@@ -69,6 +74,16 @@ void dprint(const char *s, const datum_t &t) {
 }
 #endif // NDEBUG
 
+// Moves the groups in `table` into `out`, which sorts them.
+template<class T>
+void table_to_grouped(group_table_t<T> *table, grouped_t<T> *out) {
+    for (auto kv = table->begin(); kv != table->end(); ++kv) {
+        bool inserted = out->insert(std::move(*kv)).second;
+        r_sanity_check(inserted);
+    }
+    table->clear();
+}
+
 template<class T>
 class grouped_acc_t : public accumulator_t {
 protected:
@@ -78,7 +93,7 @@ protected:
 
     virtual void finish_impl(continue_bool_t, result_t *out) {
         *out = grouped_t<T>();
-        boost::get<grouped_t<T> >(*out).swap(acc);
+        table_to_grouped(&acc, boost::get<grouped_t<T> >(out));
         guarantee(acc.size() == 0);
     }
 private:
@@ -88,14 +103,14 @@ private:
             const store_key_t &key,
             const std::function<datum_t()> &lazy_sindex_val) {
         for (auto it = groups->begin(); it != groups->end(); ++it) {
-            auto pair = acc.insert(std::make_pair(it->first, default_val));
-            auto t_it = pair.first;
-            bool keep = !pair.second;
+            bool inserted;
+            T *t = acc.find_or_insert(it->first, default_val, &inserted);
+            bool keep = !inserted;
             for (auto el = it->second.begin(); el != it->second.end(); ++el) {
-                keep |= accumulate(env, *el, &t_it->second, key, lazy_sindex_val);
+                keep |= accumulate(env, *el, t, key, lazy_sindex_val);
             }
             if (!keep) {
-                acc.erase(t_it);
+                acc.erase_last();
             }
         }
         return should_send_batch() ? continue_bool_t::ABORT : continue_bool_t::CONTINUE;
@@ -110,29 +125,34 @@ private:
 
     virtual void unshard(env_t *env, const std::vector<result_t *> &results) {
         guarantee(acc.size() == 0);
-        std::map<datum_t, std::vector<T *>, optional_datum_less_t> vecs;
+        group_table_t<std::vector<T *> > vecs;
+        const std::vector<T *> no_vecs;
         r_sanity_check(results.size() != 0);
         for (auto res = results.begin(); res != results.end(); ++res) {
             guarantee(*res);
             grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
             guarantee(gres);
             for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
-                vecs[kv->first].push_back(&kv->second);
+                bool inserted;
+                vecs.find_or_insert(kv->first, no_vecs, &inserted)
+                    ->push_back(&kv->second);
             }
         }
         for (auto kv = vecs.begin(); kv != vecs.end(); ++kv) {
-            auto t_it = acc.insert(std::make_pair(kv->first, default_val)).first;
-            unshard_impl(env, &t_it->second, kv->second);
+            bool inserted;
+            T *t = acc.find_or_insert(kv->first, default_val, &inserted);
+            r_sanity_check(inserted);
+            unshard_impl(env, t, kv->second);
         }
     }
     virtual void unshard_impl(env_t *env, T *acc, const std::vector<T *> &ts) = 0;
 
 protected:
     const T *get_default_val() { return &default_val; }
-    grouped_t<T> *get_acc() { return &acc; }
+    group_table_t<T> *get_acc() { return &acc; }
 private:
     const T default_val;
-    grouped_t<T> acc;
+    group_table_t<T> acc;
 };
 
 class append_t : public grouped_acc_t<stream_t> {
@@ -513,17 +533,15 @@ protected:
     explicit terminal_t(T &&t) : grouped_acc_t<T>(std::move(t)) { }
 private:
     virtual void operator()(env_t *env, groups_t *groups) {
-        grouped_t<T> *_acc = grouped_acc_t<T>::get_acc();
+        group_table_t<T> *_acc = grouped_acc_t<T>::get_acc();
         const T *_default_val = grouped_acc_t<T>::get_default_val();
         for (auto it = groups->begin(); it != groups->end(); ++it) {
-            auto pair = _acc->insert(std::make_pair(it->first, *_default_val));
-            auto t_it = pair.first;
-            bool keep = !pair.second;
-            for (auto el = it->second.begin(); el != it->second.end(); ++el) {
-                keep |= accumulate(env, *el, &t_it->second);
-            }
+            bool inserted;
+            T *t = _acc->find_or_insert(it->first, *_default_val, &inserted);
+            bool keep = !inserted;
+            keep |= accumulate_batch(env, it->second, t);
             if (!keep) {
-                _acc->erase(t_it);
+                _acc->erase_last();
             }
         }
         groups->clear();
@@ -533,7 +551,7 @@ private:
                                              bool is_grouped,
                                              UNUSED const configured_limits_t &limits) {
         accumulator_t::mark_finished();
-        grouped_t<T> *_acc = grouped_acc_t<T>::get_acc();
+        group_table_t<T> *_acc = grouped_acc_t<T>::get_acc();
         const T *_default_val = grouped_acc_t<T>::get_default_val();
         scoped_ptr_t<val_t> retval;
         if (is_grouped) {
@@ -558,22 +576,24 @@ private:
     virtual datum_t unpack(T *t) = 0;
 
     virtual void add_res(env_t *env, result_t *res, sorting_t) {
-        grouped_t<T> *_acc = grouped_acc_t<T>::get_acc();
+        group_table_t<T> *_acc = grouped_acc_t<T>::get_acc();
         const T *_default_val = grouped_acc_t<T>::get_default_val();
         if (auto e = boost::get<exc_t>(res)) {
             throw *e;
         }
         grouped_t<T> *gres = boost::get<grouped_t<T> >(res);
         r_sanity_check(gres);
-        if (_acc->size() == 0) {
-            _acc->swap(*gres);
-        } else {
-            // Order in fact does NOT matter here.  The reason is, each `kv->first`
-            // value is different, which means each operation works on a different
-            // key/value pair of `acc`.
-            for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
-                auto t_it = _acc->insert(std::make_pair(kv->first, *_default_val)).first;
-                unshard_impl(env, &t_it->second, &kv->second);
+        const bool first_res = _acc->size() == 0;
+        // Order in fact does NOT matter here.  The reason is, each `kv->first`
+        // value is different, which means each operation works on a different
+        // key/value pair of `acc`.
+        for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
+            bool inserted;
+            T *t = _acc->find_or_insert(kv->first, *_default_val, &inserted);
+            if (first_res) {
+                *t = std::move(kv->second);
+            } else {
+                unshard_impl(env, t, &kv->second);
             }
         }
     }
@@ -588,6 +608,14 @@ private:
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             T *t) = 0;
+    // Used when accumulating eagerly, so that terminals can finish up each batch.
+    virtual bool accumulate_batch(env_t *env, const datums_t &els, T *t) {
+        bool keep = false;
+        for (auto el = els.begin(); el != els.end(); ++el) {
+            keep |= accumulate(env, *el, t);
+        }
+        return keep;
+    }
 
     virtual void unshard_impl(
         env_t *env, T *out, const std::vector<T *> &ts) {
@@ -605,6 +633,7 @@ public:
         : terminal_t<uint64_t>(0) { }
 private:
     virtual bool uses_val() { return false; }
+    virtual bool can_batch_rows() { return true; }
     virtual bool accumulate(env_t *,
                             const datum_t &,
                             uint64_t *out) {
@@ -636,6 +665,9 @@ protected:
         : terminal_t<T>(std::move(t)),
           f(wf.compile_wire_func_or_null()),
           bt(wf.bt) { }
+    // `sum`, `avg`, `min` and `max` fold every row into the result on its own, in the
+    // order in which the rows arrive, so batches don't change their results.
+    virtual bool can_batch_rows() { return true; }
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             T *out) {
@@ -807,6 +839,80 @@ private:
     counted_t<const func_t> f;
 };
 
+/* Keeps the `k` smallest elements of each group.  The shards buffer up to `2 * k`
+elements in the order in which they come across them, and only sort the buffer to
+throw away the larger half once it's full.  Whenever we have an `env_t` at the end of
+a batch (when unsharding, or when accumulating eagerly), the buffer is left sorted and
+trimmed to `k` elements, which is what `unpack()` relies on.  Equal elements keep the
+order in which they were accumulated, like they do in a stable sort. */
+class top_k_terminal_t : public terminal_t<datums_t> {
+public:
+    explicit top_k_terminal_t(const top_k_wire_func_t &f)
+        : terminal_t<datums_t>(datums_t()),
+          k(f.k),
+          lt_cmp(f.compile_comparisons()),
+          bt(f.bt) { }
+private:
+    virtual bool accumulate(env_t *env,
+                            const datum_t &el,
+                            datums_t *out) {
+        if (k != 0) {
+            out->push_back(el);
+            if (out->size() >= 2 * k) {
+                sort_and_trim(env, out, 0);
+            }
+        }
+        return true;
+    }
+    virtual bool accumulate_batch(env_t *env, const datums_t &els, datums_t *out) {
+        const size_t old_size = out->size();
+        for (auto el = els.begin(); el != els.end(); ++el) {
+            accumulate(env, *el, out);
+        }
+        // If the buffer filled up along the way, it got sorted and trimmed to `k`
+        // elements, so at least this many of them are still sorted.
+        sort_and_trim(env, out, std::min(old_size, out->size()));
+        return true;
+    }
+    virtual datum_t unpack(datums_t *ds) {
+        return datum_t(std::move(*ds), datum_t::no_array_size_limit_check_t());
+    }
+    virtual void unshard_impl(env_t *env,
+                              datums_t *out,
+                              const std::vector<datums_t *> &ts) {
+        // The shards' buffers aren't sorted.
+        for (auto it = ts.begin(); it != ts.end(); ++it) {
+            std::move((*it)->begin(), (*it)->end(), std::back_inserter(*out));
+        }
+        sort_and_trim(env, out, 0);
+    }
+    virtual void unshard_impl(env_t *env, datums_t *out, datums_t *el) {
+        // Both `out` and `el` come out of `unshard_impl` above, so they are sorted.
+        const size_t num_sorted = out->size();
+        std::move(el->begin(), el->end(), std::back_inserter(*out));
+        sort_and_trim(env, out, num_sorted);
+    }
+
+    // Sorts `ds`, of which the first `num_sorted` elements are already sorted, and
+    // drops everything past the first `k` elements.
+    void sort_and_trim(env_t *env, datums_t *ds, size_t num_sorted) {
+        try {
+            auto fn = std::bind(lt_cmp, env, nullptr, ph::_1, ph::_2);
+            std::stable_sort(ds->begin() + num_sorted, ds->end(), fn);
+            std::inplace_merge(ds->begin(), ds->begin() + num_sorted, ds->end(), fn);
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, bt);
+        }
+        if (ds->size() > k) {
+            ds->resize(k);
+        }
+    }
+
+    const size_t k;
+    const lt_cmp_t lt_cmp;
+    const backtrace_id_t bt;
+};
+
 template<class T>
 class terminal_visitor_t : public boost::static_visitor<T *> {
 public:
@@ -837,6 +943,9 @@ public:
             lr.sorting,
             lr.ops);
     }
+    T *operator()(const top_k_wire_func_t &f) const {
+        return new top_k_terminal_t(f);
+    }
 };
 
 scoped_ptr_t<accumulator_t> make_terminal(const terminal_variant_t &t) {
@@ -989,9 +1098,7 @@ private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const std::function<datum_t()> &) {
         try {
-            for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
-            }
+            f->map_batch(env, lst);
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace(), 1);
         }
@@ -1041,19 +1148,11 @@ public:
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const std::function<datum_t()> &) {
-        auto it = lst->begin();
-        auto loc = it;
         try {
-            for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
-                    std::swap(*loc, *it);
-                    ++loc;
-                }
-            }
+            f->filter_batch(env, lst, default_val);
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace(), 1);
         }
-        lst->erase(loc, lst->end());
     }
     counted_t<const func_t> f, default_val;
 };
@@ -346,7 +346,8 @@ typedef boost::variant<
     grouped_t<ql::datum_t>, // Reduce (may be NULL)
     grouped_t<optimizer_t>, // min, max
     grouped_t<stream_t>, // No terminal.
-    exc_t // Don't re-order (we don't want this to initialize to an error.)
+    exc_t, // Don't re-order (we don't want this to initialize to an error.)
+    grouped_t<datums_t> // Top-K.
     > result_t;
 
 typedef boost::variant<map_wire_func_t,
@@ -385,7 +386,8 @@ typedef boost::variant<count_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
                        reduce_wire_func_t,
-                       limit_read_t
+                       limit_read_t,
+                       top_k_wire_func_t
                        > terminal_variant_t;
 
 class accumulator_t {
@@ -396,6 +398,11 @@ public:
     virtual bool uses_val() { return true; }
     virtual void stop_at_boundary(store_key_t &&) { }
     virtual bool should_send_batch() = 0;
+    // Whether the rows of several keys may be passed to `operator()` at once.  Only
+    // accumulators that ignore the key and the secondary index value and never stop
+    // the traversal early can allow that.  Accumulators have to opt in, which
+    // currently only the `count`, `sum`, `avg`, `min` and `max` terminals do.
+    virtual bool can_batch_rows() { return false; }
     virtual continue_bool_t operator()(
             env_t *env,
             groups_t *groups,
@@ -404,14 +404,27 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
         auto cserver = store->changefeed_server(s.region);
         if (cserver.first != nullptr) {
-            if (optional<uint64_t> stamp
-                    = cserver.first->get_stamp(s.addr, cserver.second)) {
+            const uuid_u server_uuid = cserver.first->get_uuid();
+            optional<uint64_t> resume_after;
+            if (s.resume_after) {
+                auto it = s.resume_after->find(server_uuid);
+                if (it != s.resume_after->end()) {
+                    resume_after.set(it->second);
+                }
+            }
+            ql::changefeed::change_log_info_t log_info;
+            if (optional<uint64_t> stamp = cserver.first->get_stamp(
+                    s.addr,
+                    resume_after,
+                    s.include_change_log ? &log_info : nullptr,
+                    cserver.second)) {
+                shard_stamp_info_t info{*stamp, current_shard, read_start, r_nullopt};
+                if (s.include_change_log) {
+                    info.change_log.set(std::move(log_info));
+                }
                 changefeed_stamp_response_t out;
                 out.stamp_infos.set(std::map<uuid_u, shard_stamp_info_t>());
-                (*out.stamp_infos)[cserver.first->get_uuid()] = shard_stamp_info_t{
-                    *stamp,
-                    current_shard,
-                    read_start};
+                (*out.stamp_infos)[server_uuid] = std::move(info);
                 return out;
             }
         }
@@ -433,8 +446,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         if (cserver.first != nullptr) {
             res->resp.set(changefeed_point_stamp_response_t::valid_response_t());
             auto *vres = &*res->resp;
-            if (optional<uint64_t> stamp
-                    = cserver.first->get_stamp(s.addr, cserver.second)) {
+            if (optional<uint64_t> stamp = cserver.first->get_stamp(
+                    s.addr, r_nullopt, nullptr, cserver.second)) {
                 vres->stamp = std::make_pair(cserver.first->get_uuid(), *stamp);
             } else {
                 // The client was removed, so no future messages are coming.
@@ -350,6 +350,11 @@ private:
     // deleted indexes.  Also migrates the secondary index block to the current version.
     void help_construct_bring_sindexes_up_to_date();
 
+    // Starts rebuilding the primary B-tree's key filter in the background, if it
+    // doesn't have one yet or the one it has is too full or stale.
+    void maybe_rebuild_key_filter();
+    void rebuild_key_filter(auto_drainer_t::lock_t store_keepalive) THROWS_NOTHING;
+
     MUST_USE bool mark_secondary_index_deleted(
             buf_lock_t *sindex_block,
             const sindex_name_t &name);
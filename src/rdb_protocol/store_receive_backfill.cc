@@ -516,6 +516,12 @@ continue_bool_t store_t::receive_backfill(
     called repeatedly. */
     flush_cache(general_cache_conn.get(), interruptor);
 
+    /* The backfill may have deleted lots of keys, which are still in the key filter.
+    Once it's done, the next point read will start rebuilding the filter. */
+    if (result == continue_bool_t::CONTINUE) {
+        btree->key_filter.request_rebuild();
+    }
+
     return result;
 }
 
@@ -70,6 +70,9 @@ public:
 protected:
     // Union term is a friend so we can steal arguments from an array in an optarg.
     friend class union_term_t;
+    // Changes term is a friend so it can evaluate the arguments of an aggregation
+    // instead of the aggregation itself.
+    friend class changes_term_t;
     virtual const std::vector<counted_t<const term_t> > &get_original_args() const {
         rfail(base_exc_t::INTERNAL,
                "This is in term_t to allow stealing args from an"
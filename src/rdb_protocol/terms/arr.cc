@@ -7,6 +7,7 @@
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/terms/terms.hpp"
 #include "stl_utils.hpp"
 
 #include "debug.hpp"
@@ -695,6 +696,9 @@ counted_t<term_t> make_slice_term(
 
 counted_t<term_t> make_limit_term(
     compile_env_t *env, const raw_term_t &term) {
+    if (counted_t<term_t> orderby_limit = make_orderby_limit_term(env, term)) {
+        return orderby_limit;
+    }
     return make_counted<limit_term_t>(env, term);
 }
 
@@ -1,9 +1,15 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <iterator>
+#include <set>
 #include <string>
+#include <vector>
 
+#include "rdb_protocol/datum_stream/hash_join.hpp"
+#include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term_walker.hpp"
@@ -39,44 +45,257 @@ private:
         return real->is_deterministic();
     }
 
+protected:
     virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t) const {
         return real->eval(env);
     }
 
+private:
     raw_term_t rewrite_src;
     counted_t<const term_t> real;
 };
 
+// Collects the variables that `term` refers to.  Sets `*implicit_out` if it uses the
+// implicit variable.
+void collect_vars(const raw_term_t &term, std::set<int64_t> *vars_out,
+                  bool *implicit_out) {
+    switch (static_cast<int>(term.type())) {
+    case Term::DATUM:
+        return;
+    case Term::VAR:
+        vars_out->insert(term.arg(0).datum().as_int());
+        return;
+    case Term::IMPLICIT_VAR:
+        *implicit_out = true;
+        return;
+    default:
+        break;
+    }
+    for (size_t i = 0; i < term.num_args(); ++i) {
+        collect_vars(term.arg(i), vars_out, implicit_out);
+    }
+    term.each_optarg([&](const raw_term_t &optarg, const std::string &) {
+            collect_vars(optarg, vars_out, implicit_out);
+        });
+}
+
+// Returns the parameters of the `FUNC` term `func`, which has already been compiled.
+std::vector<int64_t> func_params(const raw_term_t &func) {
+    raw_term_t vars = func.arg(0);
+    std::vector<int64_t> params;
+    if (vars.type() == Term::DATUM) {
+        datum_t d = vars.datum();
+        for (size_t i = 0; i < d.arr_size(); ++i) {
+            params.push_back(d.get(i).as_int());
+        }
+    } else {
+        for (size_t i = 0; i < vars.num_args(); ++i) {
+            params.push_back(vars.arg(i).datum().as_int());
+        }
+    }
+    return params;
+}
+
 class inner_join_term_t : public rewrite_term_t {
 public:
     inner_join_term_t(compile_env_t *env, const raw_term_t &term)
-        : rewrite_term_t(env, term, argspec_t(3), rewrite) { }
+        : rewrite_term_t(env, term, argspec_t(3), rewrite) {
+        maybe_compile_hash_join(env, term);
+    }
 
     static minidriver_t::reql_t rewrite(const raw_term_t &in) {
         minidriver_t r(in.bt());
 
         raw_term_t left = in.arg(0);
+
+        minidriver_t::reql_t term = r.expr(left).concat_map(join_row(&r, in));
+
+        term.copy_optargs_from_term(in);
+        return term;
+    }
+
+    virtual const char *name() const { return "inner_join"; }
+
+private:
+    // The function that the nested loop maps over the left side: it joins a single
+    // left row with all of the right side.
+    static minidriver_t::reql_t join_row(minidriver_t *r, const raw_term_t &in) {
         raw_term_t right = in.arg(1);
         raw_term_t func = in.arg(2);
         auto n = minidriver_t::dummy_var_t::INNERJOIN_N;
         auto m = minidriver_t::dummy_var_t::INNERJOIN_M;
 
-        minidriver_t::reql_t term =
-            r.expr(left).concat_map(
-                r.fun(n,
-                    r.expr(right).concat_map(
-                        r.fun(m,
-                            r.branch(
-                                r.expr(func)(r.var(n), r.var(m)),
-                                r.array(r.object(r.optarg("left", n),
-                                                 r.optarg("right", m))),
-                                r.array())))));
+        return r->fun(n,
+                   r->expr(right).concat_map(
+                       r->fun(m,
+                           r->branch(
+                               r->expr(func)(r->var(n), r->var(m)),
+                               r->array(r->object(r->optarg("left", n),
+                                                  r->optarg("right", m))),
+                               r->array()))));
+    }
 
-        term.copy_optargs_from_term(in);
-        return term;
+    /* If the predicate has the form `function(l, r) { return f(l).eq(g(r)); }`, where
+    `f` doesn't use `r` and `g` doesn't use `l`, we can evaluate the join by hashing
+    the right side by `g` instead of running the nested loop.  This compiles `f` and
+    `g` as functions of their own. */
+    void maybe_compile_hash_join(compile_env_t *env, const raw_term_t &in) {
+        raw_term_t func = in.arg(2);
+        if (in.num_optargs() != 0 || func.type() != Term::FUNC) {
+            return;
+        }
+        std::vector<int64_t> params = func_params(func);
+        raw_term_t body = func.arg(1);
+        if (params.size() != 2
+            || body.type() != Term::EQ
+            || body.num_args() != 2
+            || body.num_optargs() != 0) {
+            return;
+        }
+
+        std::set<int64_t> vars[2];
+        bool implicit = false;
+        collect_vars(body.arg(0), &vars[0], &implicit);
+        collect_vars(body.arg(1), &vars[1], &implicit);
+        if (implicit) {
+            return;
+        }
+        const int64_t l = params[0];
+        const int64_t r = params[1];
+        size_t left_side;
+        if (vars[0].count(r) == 0 && vars[1].count(l) == 0) {
+            left_side = 0;
+        } else if (vars[1].count(r) == 0 && vars[0].count(l) == 0) {
+            left_side = 1;
+        } else {
+            return;
+        }
+
+        minidriver_t md(in.bt());
+        left_key_src.set(
+            md.array(static_cast<double>(l))
+                .call(Term::FUNC, md.expr(body.arg(left_side))).root_term());
+        right_key_src.set(
+            md.array(static_cast<double>(r))
+                .call(Term::FUNC, md.expr(body.arg(1 - left_side))).root_term());
+        counted_t<const term_t> compiled_left_key =
+            compile_term(env, *left_key_src);
+        counted_t<const term_t> compiled_right_key =
+            compile_term(env, *right_key_src);
+        // The hash join evaluates the keys once per row rather than once per pair.
+        if (!compiled_left_key->is_deterministic().join(
+                compiled_right_key->is_deterministic()).test(
+                    single_server_t::yes, constant_now_t::yes)) {
+            return;
+        }
+        join_row_src.set(join_row(&md, in).root_term());
+        nested_loop_row = compile_term(env, *join_row_src);
+        left = compile_term(env, in.arg(0));
+        right = compile_term(env, in.arg(1));
+        left_key = std::move(compiled_left_key);
+        right_key = std::move(compiled_right_key);
     }
 
-    virtual const char *name() const { return "inner_join"; }
+    /* Runs the nested loop over `left_stream`, which is what `left` evaluated to, so
+    that we don't have to evaluate it again.  Like in the rewritten term, the right
+    side gets evaluated once per left row. */
+    scoped_ptr_t<val_t> nested_loop(scope_env_t *env,
+                                    counted_t<datum_stream_t> left_stream) const {
+        left_stream->add_transformation(
+            concatmap_wire_func_t(result_hint_t::NO_HINT,
+                                  nested_loop_row->eval(env)->as_func()),
+            backtrace());
+        return new_val(env->env, std::move(left_stream));
+    }
+
+    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t flags) const {
+        if (!left_key.has()) {
+            return rewrite_term_t::term_eval(env, flags);
+        }
+        scoped_ptr_t<val_t> left_val = left->eval(env);
+        counted_t<grouped_data_t> left_groups = left_val->maybe_as_grouped_data();
+        if (left_groups.has()) {
+            counted_t<grouped_data_t> out(new grouped_data_t());
+            for (auto kv = left_groups->begin(); kv != left_groups->end(); ++kv) {
+                scoped_ptr_t<val_t> group =
+                    make_scoped<val_t>(kv->second, backtrace());
+                (*out)[kv->first] =
+                    nested_loop(env, group->as_seq(env->env))->as_datum();
+            }
+            return make_scoped<val_t>(out, backtrace());
+        }
+        counted_t<datum_stream_t> left_stream = left_val->as_seq(env->env);
+        if (left_stream->is_grouped()) {
+            return nested_loop(env, std::move(left_stream));
+        }
+
+        // The nested loop evaluates the right side once for every left row, so having
+        // evaluated it here to look at it costs nothing extra, as long as we haven't
+        // read from it yet.
+        scoped_ptr_t<val_t> right_val = right->eval(env);
+        if (right_val->maybe_as_grouped_data().has()) {
+            return nested_loop(env, std::move(left_stream));
+        }
+        counted_t<datum_stream_t> right_stream = right_val->as_seq(env->env);
+        if (right_stream->is_grouped()
+            || right_stream->is_infinite()
+            || right_stream->cfeed_type() != feed_type_t::not_feed) {
+            return nested_loop(env, std::move(left_stream));
+        }
+
+        std::vector<datum_t> right_rows;
+        const size_t limit = env->env->limits().array_size_limit();
+        while (right_rows.size() <= limit) {
+            std::vector<datum_t> batch =
+                right_stream->next_batch(
+                    env->env, batchspec_t::default_for(batch_type_t::NORMAL));
+            if (batch.empty()) {
+                counted_t<datum_stream_t> joined =
+                    make_counted<hash_join_datum_stream_t>(
+                        std::move(left_stream),
+                        left_key->eval(env)->as_func(),
+                        right_key->eval(env)->as_func(),
+                        std::move(right_rows),
+                        backtrace());
+                return new_val(env->env, std::move(joined));
+            }
+            std::move(batch.begin(), batch.end(), std::back_inserter(right_rows));
+        }
+
+        // The right side doesn't fit in memory, so we spill both sides to disk.
+        rdb_context_t *rdb_ctx = env->env->get_rdb_ctx();
+        if (rdb_ctx != nullptr
+            && rdb_ctx->io_backender != nullptr
+            && !left_stream->is_infinite()
+            && left_stream->cfeed_type() == feed_type_t::not_feed) {
+            counted_t<datum_stream_t> joined =
+                make_counted<grace_hash_join_datum_stream_t>(
+                    rdb_ctx->io_backender,
+                    rdb_ctx->base_path,
+                    std::move(left_stream),
+                    left_key->eval(env)->as_func(),
+                    std::move(right_rows),
+                    std::move(right_stream),
+                    right_key->eval(env)->as_func(),
+                    backtrace());
+            return new_val(env->env, std::move(joined));
+        }
+        // We can't read all of the left side before producing output, or have nowhere
+        // to put it.  The right rows that we've read go to waste, but the nested loop
+        // reads the whole right side once per left row anyway.
+        return nested_loop(env, std::move(left_stream));
+    }
+
+    // These are only set if the join can be evaluated as a hash join.  They're all
+    // part of the rewritten term, so `rewrite_term_t` accounts for their captures.
+    optional<raw_term_t> left_key_src;
+    optional<raw_term_t> right_key_src;
+    optional<raw_term_t> join_row_src;
+    counted_t<const term_t> nested_loop_row;
+    counted_t<const term_t> left;
+    counted_t<const term_t> right;
+    counted_t<const term_t> left_key;
+    counted_t<const term_t> right_key;
 };
 
 class outer_join_term_t : public rewrite_term_t {
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "parsing/utf8.hpp"
+#include "rdb_protocol/datum_stream/aggregate_changes.hpp"
 #include "rdb_protocol/datum_stream/eq_join.hpp"
 #include "rdb_protocol/datum_stream/fold.hpp"
 #include "rdb_protocol/datum_stream/map.hpp"
@@ -535,12 +536,144 @@ public:
         : op_term_t(
             env, term, argspec_t(1),
             optargspec_t({"squash",
+                          "batch_interval",
                           "changefeed_queue_size",
                           "include_initial",
                           "include_offsets",
                           "include_states",
-                          "include_types"})) { }
+                          "include_types",
+                          "include_cursors",
+                          "start_after"})) { }
 private:
+    // `changes` on these is maintained incrementally from a changefeed on the
+    // sequence they aggregate, see `aggregate_changes_datum_stream_t`.
+    static optional<aggregate_kind_t> aggregate_kind(const raw_term_t &term) {
+        switch (static_cast<int>(term.type())) {
+        case Term::COUNT: return make_optional(aggregate_kind_t::COUNT);
+        case Term::SUM: return make_optional(aggregate_kind_t::SUM);
+        case Term::AVG: return make_optional(aggregate_kind_t::AVG);
+        case Term::MIN: return make_optional(aggregate_kind_t::MIN);
+        case Term::MAX: return make_optional(aggregate_kind_t::MAX);
+        default: return r_nullopt;
+        }
+    }
+
+    // Evaluating the aggregation would read the whole table, so we don't.
+    virtual bool can_be_grouped() const {
+        return !aggregate_kind(get_src().arg(0)).has_value();
+    }
+
+    // Evaluates the arguments of the aggregation, and of the `group` before it,
+    // instead of the aggregation itself.
+    scoped_ptr_t<val_t> eval_aggregate(scope_env_t *env,
+                                       aggregate_kind_t kind,
+                                       const datum_t &squash,
+                                       double batch_interval,
+                                       bool include_initial,
+                                       bool include_states,
+                                       const configured_limits_t &limits) const {
+        counted_t<const term_t> agg_term = get_original_args()[0];
+        const char *agg_name = agg_term->name();
+        auto check_args = [&](const counted_t<const term_t> &term, const char *name) {
+            rcheck_src(term->get_src().bt(),
+                       term->get_src().num_optargs() == 0,
+                       base_exc_t::LOGIC,
+                       strprintf("Cannot call `changes` on `%s` with optional "
+                                 "arguments.", name));
+            for (const auto &arg : term->get_original_args()) {
+                rcheck_src(arg->get_src().bt(),
+                           arg->get_src().type() != Term::ARGS,
+                           base_exc_t::LOGIC,
+                           strprintf("Cannot call `changes` on `%s` with `r.args`.",
+                                     name));
+            }
+            return term->get_original_args();
+        };
+
+        const std::vector<counted_t<const term_t> > &agg_args =
+            check_args(agg_term, agg_name);
+        counted_t<const func_t> func;
+        if (agg_args.size() == 2) {
+            scoped_ptr_t<val_t> v = agg_args[1]->eval(env);
+            if (kind != aggregate_kind_t::COUNT) {
+                func = v->as_func(GET_FIELD_SHORTCUT);
+            } else if (v->get_type().is_convertible(val_t::type_t::FUNC)) {
+                func = v->as_func();
+            } else {
+                func = new_eq_comparison_func(v->as_datum(), backtrace());
+            }
+        }
+        counted_t<const term_t> source = agg_args[0];
+        std::vector<counted_t<const func_t> > group_funcs;
+        if (source->get_src().type() == Term::GROUP) {
+            // Only grouping by fields or functions of the rows is supported.
+            for (const char *optarg : {"index", "multi"}) {
+                rcheck_src(source->get_src().bt(),
+                           !source->get_src().optarg(optarg).has_value(),
+                           base_exc_t::LOGIC,
+                           strprintf("Cannot call `changes` on `group` with `%s`.",
+                                     optarg));
+            }
+            const std::vector<counted_t<const term_t> > &group_args =
+                check_args(source, "group");
+            for (size_t i = 1; i < group_args.size(); ++i) {
+                group_funcs.push_back(
+                    group_args[i]->eval(env)->as_func(GET_FIELD_SHORTCUT));
+            }
+            rcheck_src(source->get_src().bt(), !group_funcs.empty(),
+                       base_exc_t::LOGIC, "Cannot group by nothing.");
+            source = group_args[0];
+        }
+        // Rows are taken out of their groups again by evaluating the same functions
+        // on their old values.
+        for (const auto &f : group_funcs) {
+            rcheck(f->is_deterministic().test(single_server_t::yes,
+                                              constant_now_t::yes),
+                   base_exc_t::LOGIC,
+                   "Cannot call `changes` after a non-deterministic function.");
+        }
+        rcheck(!func.has() || func->is_deterministic().test(single_server_t::yes,
+                                                            constant_now_t::yes),
+               base_exc_t::LOGIC,
+               "Cannot call `changes` after a non-deterministic function.");
+
+        counted_t<datum_stream_t> seq = source->eval(env)->as_seq(env->env);
+        std::vector<changespec_t> changespecs = seq->get_changespecs();
+        rcheck(changespecs.size() == 1, base_exc_t::LOGIC,
+               strprintf("Cannot call `changes` on `%s` of several streams.", agg_name));
+        changespec_t &changespec = changespecs[0];
+        r_sanity_check(changespec.stream.has());
+        boost::apply_visitor(rcheck_spec_visitor_t(env->env, backtrace()),
+                             changespec.keyspec.spec);
+        // We always need the initial values, and the states tell us when we have
+        // all of them.
+        counted_t<datum_stream_t> feed = changespec.keyspec.table->read_changes(
+            env->env,
+            changefeed::streamspec_t(
+                std::move(changespec.stream),
+                changespec.keyspec.table_name,
+                false,
+                true,
+                false,
+                false,
+                r_nullopt,
+                limits,
+                squash,
+                batch_interval,
+                std::move(changespec.keyspec.spec)),
+            backtrace());
+        return new_val(
+            env->env,
+            make_counted<aggregate_changes_datum_stream_t>(
+                std::move(feed),
+                kind,
+                std::move(group_funcs),
+                std::move(func),
+                include_initial,
+                include_states,
+                backtrace()));
+    }
+
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
 
@@ -556,6 +689,13 @@ private:
                          squash.get_type_name().c_str());
         }
 
+        double batch_interval = 0.0;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "batch_interval")) {
+            batch_interval = v->as_num();
+            rcheck_target(v, batch_interval >= 0.0, base_exc_t::LOGIC,
+                          "Expected a non-negative NUMBER for `batch_interval`.");
+        }
+
         bool include_states = false;
         if (scoped_ptr_t<val_t> v = args->optarg(env, "include_states")) {
             include_states = v->as_bool();
@@ -576,14 +716,39 @@ private:
             include_offsets = v->as_bool();
         }
 
-        scoped_ptr_t<val_t> v = args->arg(env, 0);
+        // Resuming implies that the client wants cursors to resume from again.
+        optional<datum_t> start_after;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "start_after")) {
+            start_after.set(v->as_datum());
+            rcheck_target(v, !include_initial, base_exc_t::LOGIC,
+                          "Cannot use `start_after` together with `include_initial`.");
+        }
+        bool include_cursors = start_after.has_value();
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "include_cursors")) {
+            include_cursors |= v->as_bool();
+        }
+
         configured_limits_t limits = env->env->limits_with_changefeed_queue_size(
                 args->optarg(env, "changefeed_queue_size"));
+        if (optional<aggregate_kind_t> kind = aggregate_kind(get_src().arg(0))) {
+            rcheck(!include_offsets, base_exc_t::LOGIC,
+                   "Cannot include offsets in changefeeds on aggregations.");
+            rcheck(!include_types, base_exc_t::LOGIC,
+                   "Cannot include types in changefeeds on aggregations.");
+            rcheck(!include_cursors, base_exc_t::LOGIC,
+                   "Cannot include cursors in changefeeds on aggregations.");
+            return eval_aggregate(
+                env, *kind, squash, batch_interval, include_initial, include_states,
+                limits);
+        }
+        scoped_ptr_t<val_t> v = args->arg(env, 0);
         if (v->get_type().is_convertible(val_t::type_t::SEQUENCE)) {
             counted_t<datum_stream_t> seq = v->as_seq(env->env);
             std::vector<counted_t<datum_stream_t> > streams;
             std::vector<changespec_t> changespecs = seq->get_changespecs();
             r_sanity_check(changespecs.size() >= 1);
+            rcheck(!include_cursors || changespecs.size() == 1, base_exc_t::LOGIC,
+                   "Cannot include cursors in a changefeed on several streams.");
             for (auto &&changespec : changespecs) {
                 if (include_initial) {
                     r_sanity_check(changespec.stream.has());
@@ -601,8 +766,11 @@ private:
                             include_offsets,
                             include_states,
                             include_types,
+                            include_cursors,
+                            start_after,
                             limits,
                             squash,
+                            batch_interval,
                             std::move(changespec.keyspec.spec)),
                         backtrace()));
             }
@@ -635,8 +803,11 @@ private:
                         include_offsets,
                         include_states,
                         include_types,
+                        include_cursors,
+                        start_after,
                         limits,
                         squash,
+                        batch_interval,
                         sel->get_spec()),
                     sel->get_bt()));
         }
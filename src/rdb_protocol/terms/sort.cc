@@ -6,7 +6,9 @@
 
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/datum_stream/array.hpp"
+#include "rdb_protocol/datum_stream/external_sort.hpp"
 #include "rdb_protocol/datum_stream/indexed_sort.hpp"
+#include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -46,6 +48,54 @@ private:
     virtual const char *name() const { return "desc"; }
 };
 
+// Sorts `seq` without the help of an index, for `target`.
+counted_t<datum_stream_t> sort_unindexed(const term_t *target,
+                                         env_t *env,
+                                         const counted_t<datum_stream_t> &seq,
+                                         const lt_cmp_t &lt_cmp) {
+    // If the sequence doesn't fit into an array, we spill it to disk in
+    // array-sized runs, provided that we have somewhere to put them.
+    rdb_context_t *rdb_ctx = env->get_rdb_ctx();
+    const bool can_spill =
+        rdb_ctx != nullptr && rdb_ctx->io_backender != nullptr;
+    counted_t<external_sort_datum_stream_t> external_sort;
+    std::vector<datum_t> to_sort;
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<datum_t> data
+            = seq->next_batch(env, batchspec);
+        if (data.size() == 0) {
+            break;
+        }
+        std::move(data.begin(), data.end(), std::back_inserter(to_sort));
+        if (can_spill
+            && to_sort.size() > env->limits().array_size_limit()) {
+            if (!external_sort.has()) {
+                external_sort = make_counted<external_sort_datum_stream_t>(
+                    rdb_ctx->io_backender, rdb_ctx->base_path, lt_cmp,
+                    target->backtrace());
+            }
+            external_sort->add_run(env, std::move(to_sort));
+            to_sort.clear();
+        } else {
+            const size_t array_size_limit = env->limits().array_size_limit();
+            rcheck_target(target, to_sort.size() <= array_size_limit,
+                          base_exc_t::RESOURCE,
+                          format_array_size_error(array_size_limit));
+        }
+    }
+    if (external_sort.has()) {
+        external_sort->add_run(env, std::move(to_sort));
+        return external_sort;
+    } else {
+        profile::sampler_t sampler("Sorting in-memory.", env->trace);
+        auto fn = std::bind(lt_cmp, env, &sampler, ph::_1, ph::_2);
+        std::stable_sort(to_sort.begin(), to_sort.end(), fn);
+        return make_counted<array_datum_stream_t>(
+            datum_t(std::move(to_sort), env->limits()), target->backtrace());
+    }
+}
+
 class orderby_term_t : public op_term_t {
 public:
     orderby_term_t(compile_env_t *env, const raw_term_t &term)
@@ -105,23 +155,7 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::LOGIC,
                    "Must specify something to order by.");
-            std::vector<datum_t> to_sort;
-            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<datum_t> data
-                    = seq->next_batch(env->env, batchspec);
-                if (data.size() == 0) {
-                    break;
-                }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck_array_size(to_sort, env->env->limits());
-            }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = std::bind(lt_cmp, env->env, &sampler, ph::_1, ph::_2);
-            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                datum_t(std::move(to_sort), env->env->limits()),
-                backtrace());
+            seq = sort_unindexed(this, env->env, seq, lt_cmp);
         }
         return tbl_slice.has()
             ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
@@ -131,6 +165,73 @@ private:
     virtual const char *name() const { return "orderby"; }
 };
 
+/* `order_by(...).limit(n)` without an index.  Instead of sorting the whole sequence
+and then throwing most of it away, this keeps only the `n` smallest elements, which
+tables do on each shard.  The term is compiled from the `order_by` term, plus the
+`limit` term's second argument.  Grouped sequences and limits that don't fit into an
+array still get sorted in full. */
+class orderby_limit_term_t : public op_term_t {
+public:
+    orderby_limit_term_t(compile_env_t *env, const raw_term_t &limit_term)
+        : op_term_t(env, limit_term.arg(0), argspec_t(1, -1)),
+          limit_bt(limit_term.bt()),
+          limit_arg(compile_term(env, limit_term.arg(1))) { }
+private:
+    virtual scoped_ptr_t<val_t>
+    eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        std::vector<std::pair<order_direction_t, counted_t<const func_t> > > comparisons
+            = build_comparisons_from_raw_term(this, env, args, get_src());
+
+        counted_t<table_t> tbl;
+        counted_t<datum_stream_t> seq;
+        scoped_ptr_t<val_t> v0 = args->arg(env, 0);
+        if (v0->get_type().is_convertible(val_t::type_t::TABLE_SLICE)) {
+            counted_t<table_slice_t> tbl_slice = v0->as_table_slice();
+            tbl = tbl_slice->get_tbl();
+            seq = tbl_slice->as_seq(env->env, backtrace());
+        } else if (v0->get_type().is_convertible(val_t::type_t::SELECTION)) {
+            auto selection = v0->as_selection(env->env);
+            tbl = selection->table;
+            seq = selection->seq;
+        } else {
+            seq = v0->as_seq(env->env);
+        }
+        rcheck(!comparisons.empty(), base_exc_t::LOGIC,
+               "Must specify something to order by.");
+
+        int32_t n = limit_arg->eval(env)->as_int<int32_t>();
+        rcheck_src(limit_bt, n >= 0, base_exc_t::LOGIC,
+                   strprintf("LIMIT takes a non-negative argument (got %d)", n));
+
+        if (seq->is_grouped()
+            || static_cast<size_t>(n) > env->env->limits().array_size_limit()) {
+            seq = sort_unindexed(this, env->env, seq, lt_cmp_t(comparisons))
+                ->slice(0, n);
+        } else {
+            datum_t top = seq->run_terminal(
+                env->env,
+                top_k_wire_func_t(n, std::move(comparisons), backtrace()))->as_datum();
+            seq = make_counted<array_datum_stream_t>(top, backtrace());
+        }
+        return tbl.has()
+            ? new_val(make_counted<selection_t>(tbl, seq))
+            : new_val(env->env, seq);
+    }
+
+    virtual void accumulate_captures(var_captures_t *captures) const {
+        op_term_t::accumulate_captures(captures);
+        limit_arg->accumulate_captures(captures);
+    }
+    virtual deterministic_t is_deterministic() const {
+        return op_term_t::is_deterministic().join(limit_arg->is_deterministic());
+    }
+
+    virtual const char *name() const { return "orderby"; }
+
+    const backtrace_id_t limit_bt;
+    const counted_t<const term_t> limit_arg;
+};
+
 class distinct_term_t : public op_term_t {
 public:
     distinct_term_t(compile_env_t *env, const raw_term_t &term)
@@ -192,6 +293,26 @@ counted_t<term_t> make_orderby_term(
         compile_env_t *env, const raw_term_t &term) {
     return make_counted<orderby_term_t>(env, term);
 }
+counted_t<term_t> make_orderby_limit_term(
+        compile_env_t *env, const raw_term_t &term) {
+    if (term.num_args() != 2 || term.num_optargs() != 0) {
+        return counted_t<term_t>();
+    }
+    raw_term_t orderby = term.arg(0);
+    if (orderby.type() != Term::ORDER_BY || orderby.optarg("index")) {
+        return counted_t<term_t>();
+    }
+    // We can't tell what `r.args` expands to until we evaluate it.
+    if (term.arg(1).type() == Term::ARGS) {
+        return counted_t<term_t>();
+    }
+    for (size_t i = 0; i < orderby.num_args(); ++i) {
+        if (orderby.arg(i).type() == Term::ARGS) {
+            return counted_t<term_t>();
+        }
+    }
+    return make_counted<orderby_limit_term_t>(env, term);
+}
 counted_t<term_t> make_distinct_term(
         compile_env_t *env, const raw_term_t &term) {
     return make_counted<distinct_term_t>(env, term);
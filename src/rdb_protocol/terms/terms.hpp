@@ -307,6 +307,9 @@ counted_t<term_t> make_sindex_rename_term(
 // sort.cc
 counted_t<term_t> make_orderby_term(
     compile_env_t *env, const raw_term_t &term);
+// Returns an empty pointer unless `term` is an unindexed `order_by(...).limit(n)`.
+counted_t<term_t> make_orderby_limit_term(
+    compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_distinct_term(
     compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_asc_term(
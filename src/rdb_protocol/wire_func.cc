@@ -1,6 +1,9 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/wire_func.hpp"
 
+#include <map>
+
+#include "arch/runtime/coroutines.hpp"
 #include "containers/archive/optional.hpp"
 #include "containers/archive/stl_types.hpp"
 #include "containers/archive/archive.hpp"
@@ -95,6 +98,132 @@ void serialize(write_message_t *wm, const wire_func_t &wf) {
 
 INSTANTIATE_SERIALIZE_FOR_CLUSTER_AND_DISK(wire_func_t);
 
+// Term trees can be deep, like in `serialize_term_tree`.
+const size_t MIN_NORMALIZE_STACK_SPACE = 16 * KILOBYTE;
+
+class normalized_func_visitor_t : public func_visitor_t {
+public:
+    normalized_func_visitor_t(write_message_t *_wm,
+                              const datum_t &_deterministic_time)
+        : wm(_wm),
+          deterministic_time(_deterministic_time),
+          scope(nullptr),
+          implicit_is_arg(false),
+          next_var(0) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        serialize<cluster_version_t::CLUSTER>(wm, wire_func_type_t::REQL);
+        scope = &reql_func->captured_scope;
+        implicit_is_arg = function_emits_implicit_variable(reql_func->arg_names);
+        bind_vars(reql_func->arg_names);
+        write_term(reql_func->body->get_src());
+    }
+
+    void on_js_func(const js_func_t *js_func) {
+        serialize<cluster_version_t::CLUSTER>(wm, wire_func_type_t::JS);
+        serialize<cluster_version_t::CLUSTER>(wm, js_func->js_source);
+        serialize<cluster_version_t::CLUSTER>(wm, js_func->js_timeout_ms);
+    }
+
+private:
+    // Numbers `vars` in the order in which they're bound, rather than by the ids
+    // that the client happened to give them.
+    void bind_vars(const std::vector<sym_t> &vars) {
+        serialize<cluster_version_t::CLUSTER>(wm, static_cast<uint64_t>(vars.size()));
+        for (const sym_t &var : vars) {
+            bound_vars[var.value] = next_var++;
+        }
+    }
+
+    static std::vector<sym_t> func_term_vars(const raw_term_t &vars) {
+        // `func_term_t` has already checked that this is an array of numbers.
+        std::vector<sym_t> res;
+        if (vars.type() == Term::DATUM) {
+            datum_t d = vars.datum();
+            for (size_t i = 0; i < d.arr_size(); ++i) {
+                res.push_back(sym_t(d.get(i).as_int()));
+            }
+        } else {
+            r_sanity_check(vars.type() == Term::MAKE_ARRAY);
+            for (size_t i = 0; i < vars.num_args(); ++i) {
+                res.push_back(sym_t(vars.arg(i).datum().as_int()));
+            }
+        }
+        return res;
+    }
+
+    void write_term(const raw_term_t &term) {
+        const Term::TermType type = term.type();
+        serialize<cluster_version_t::CLUSTER>(wm, static_cast<int32_t>(type));
+        if (type == Term::DATUM) {
+            serialize<cluster_version_t::CLUSTER>(wm, term.datum());
+        } else if (type == Term::VAR) {
+            sym_t var(term.arg(0).datum().as_int());
+            auto it = bound_vars.find(var.value);
+            const bool is_bound = it != bound_vars.end();
+            serialize<cluster_version_t::CLUSTER>(wm, is_bound);
+            if (is_bound) {
+                serialize<cluster_version_t::CLUSTER>(wm, it->second);
+            } else {
+                // Captured from an enclosing scope, so what matters is its value.
+                serialize<cluster_version_t::CLUSTER>(wm, scope->lookup_var(var));
+            }
+        } else if (type == Term::IMPLICIT_VAR) {
+            // `r.row` can only refer to the function's own argument or to the
+            // captured one, because it isn't allowed in nested functions.
+            if (!implicit_is_arg) {
+                serialize<cluster_version_t::CLUSTER>(wm, scope->lookup_implicit());
+            }
+        } else if (type == Term::NOW) {
+            const bool has_time = deterministic_time.has();
+            serialize<cluster_version_t::CLUSTER>(wm, has_time);
+            if (has_time) {
+                serialize<cluster_version_t::CLUSTER>(wm, deterministic_time);
+            }
+        } else if (type == Term::FUNC) {
+            std::map<int64_t, int64_t> outer_vars = bound_vars;
+            bind_vars(func_term_vars(term.arg(0)));
+            write_subterm(term.arg(1));
+            bound_vars = std::move(outer_vars);
+        } else {
+            serialize<cluster_version_t::CLUSTER>(
+                wm, static_cast<uint64_t>(term.num_args()));
+            for (size_t i = 0; i < term.num_args(); ++i) {
+                write_subterm(term.arg(i));
+            }
+            serialize<cluster_version_t::CLUSTER>(
+                wm, static_cast<uint64_t>(term.num_optargs()));
+            term.each_optarg([&](const raw_term_t &optarg, const std::string &name) {
+                serialize<cluster_version_t::CLUSTER>(wm, name);
+                write_subterm(optarg);
+            });
+        }
+    }
+
+    void write_subterm(const raw_term_t &term) {
+        call_with_enough_stack([&]() {
+            write_term(term);
+        }, MIN_NORMALIZE_STACK_SPACE);
+    }
+
+    write_message_t *wm;
+    const datum_t deterministic_time;
+    const var_scope_t *scope;
+    bool implicit_is_arg;
+    // Maps the ids of the variables that are bound at this point to their numbers.
+    std::map<int64_t, int64_t> bound_vars;
+    int64_t next_var;
+
+    DISABLE_COPYING(normalized_func_visitor_t);
+};
+
+void serialize_normalized(write_message_t *wm,
+                          const wire_func_t &wf,
+                          const datum_t &deterministic_time) {
+    normalized_func_visitor_t v(wm, deterministic_time);
+    wf.compile_wire_func()->visit(&v);
+}
+
 // deserialize function for 2.0 and before
 template <cluster_version_t W>
 archive_result_t deserialize(read_stream_t *s, wire_func_t *wf) {
@@ -237,9 +366,15 @@ archive_result_t deserialize<cluster_version_t::v2_3>(
 }
 
 template <>
-archive_result_t deserialize<cluster_version_t::v2_4_is_latest>(
+archive_result_t deserialize<cluster_version_t::v2_4>(
+        read_stream_t *s, wire_func_t *wf) {
+    return deserialize_wire_func<cluster_version_t::v2_4>(s, wf);
+}
+
+template <>
+archive_result_t deserialize<cluster_version_t::v2_5_is_latest>(
         read_stream_t *s, wire_func_t *wf) {
-    return deserialize_wire_func<cluster_version_t::v2_4_is_latest>(s, wf);
+    return deserialize_wire_func<cluster_version_t::v2_5_is_latest>(s, wf);
 }
 
 template <cluster_version_t W>
@@ -304,6 +439,28 @@ backtrace_id_t group_wire_func_t::get_bt() const {
     return bt;
 }
 
+top_k_wire_func_t::top_k_wire_func_t(
+        uint64_t _k,
+        std::vector<std::pair<order_direction_t, counted_t<const func_t> > > &&_comparisons,
+        backtrace_id_t _bt)
+    : k(_k), bt(_bt) {
+    comparisons.reserve(_comparisons.size());
+    for (auto &&pair : _comparisons) {
+        comparisons.push_back(
+            std::make_pair(pair.first, wire_func_t(std::move(pair.second))));
+    }
+}
+
+std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
+top_k_wire_func_t::compile_comparisons() const {
+    std::vector<std::pair<order_direction_t, counted_t<const func_t> > > ret;
+    ret.reserve(comparisons.size());
+    for (const auto &pair : comparisons) {
+        ret.push_back(std::make_pair(pair.first, pair.second.compile_wire_func()));
+    }
+    return ret;
+}
+
 bool wire_func_t::is_simple_selector() const {
     return func->is_simple_selector();
 }
@@ -318,4 +475,6 @@ RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(filter_wire_func_t, filter_func, default_fil
 
 RDB_MAKE_SERIALIZABLE_1_FOR_CLUSTER(distinct_wire_func_t, use_index);
 
+RDB_MAKE_SERIALIZABLE_3_FOR_CLUSTER(top_k_wire_func_t, k, comparisons, bt);
+
 }  // namespace ql
@@ -2,16 +2,19 @@
 #ifndef RDB_PROTOCOL_WIRE_FUNC_HPP_
 #define RDB_PROTOCOL_WIRE_FUNC_HPP_
 
+#include <utility>
 #include <vector>
 
 #include "containers/counted.hpp"
 #include "containers/optional.hpp"
 #include "rdb_protocol/sym.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/order_util.hpp"
 #include "rpc/serialize_macros.hpp"
 #include "version.hpp"
 
 namespace ql {
+class datum_t;
 class raw_term_t;
 class func_t;
 class env_t;
@@ -48,6 +51,15 @@ private:
     counted_t<const func_t> func;
 };
 
+// Writes out `wf` the same way for any two functions that compute the same thing
+// the same way: variables are numbered in the order in which they're bound, the
+// values of captured variables are written in their place, `deterministic_time` is
+// written in place of `r.now()`, and backtraces are left out.  This can't be
+// deserialized; it's for telling whether two functions can share their results.
+void serialize_normalized(write_message_t *wm,
+                          const wire_func_t &wf,
+                          const datum_t &deterministic_time);
+
 class maybe_wire_func_t {
 protected:
     template<class... Args>
@@ -141,6 +153,25 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distinct_wire_func_t);
 
+// The `k` smallest elements of a stream according to `comparisons`, which are the
+// same as `order_by`'s.  This is what `order_by(...).limit(k)` turns into when there's
+// no index to order by.
+class top_k_wire_func_t {
+public:
+    top_k_wire_func_t() : k(0), bt(backtrace_id_t::empty()) { }
+    top_k_wire_func_t(
+        uint64_t _k,
+        std::vector<std::pair<order_direction_t, counted_t<const func_t> > > &&_comparisons,
+        backtrace_id_t _bt);
+    std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
+    compile_comparisons() const;
+
+    uint64_t k;
+    std::vector<std::pair<order_direction_t, wire_func_t> > comparisons;
+    backtrace_id_t bt;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(top_k_wire_func_t);
+
 template <class T>
 class skip_terminal_t;
 
@@ -0,0 +1,116 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/block_compression.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+
+// We write raw deflate streams.  The block's size is known from the LBA, so the
+// zlib header and trailer would only take up space.
+const int BLOCK_COMPRESSION_WINDOW_BITS = -15;
+const int BLOCK_COMPRESSION_MEM_LEVEL = 8;
+
+block_compressor_t::block_compressor_t(block_compression_t _compression)
+    : compression(_compression),
+      deflate_initialized(false),
+      inflate_initialized(false) {
+    memset(&deflate_stream, 0, sizeof(deflate_stream));
+    memset(&inflate_stream, 0, sizeof(inflate_stream));
+}
+
+block_compressor_t::~block_compressor_t() {
+    if (deflate_initialized) {
+        deflateEnd(&deflate_stream);
+    }
+    if (inflate_initialized) {
+        inflateEnd(&inflate_stream);
+    }
+}
+
+buf_ptr_t block_compressor_t::compress(const ser_buffer_t *buf,
+                                       block_size_t block_size) {
+    if (compression == block_compression_t::none) {
+        return buf_ptr_t();
+    }
+    guarantee(compression == block_compression_t::zlib);
+
+    // The compressed block has to save at least one device block to be worth it.
+    const uint32_t aligned_size = buf_ptr_t::compute_aligned_block_size(block_size);
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return buf_ptr_t();
+    }
+    const uint32_t max_compressed_ser_size = aligned_size - DEVICE_BLOCK_SIZE;
+    if (max_compressed_ser_size <= sizeof(ls_buf_data_t)) {
+        return buf_ptr_t();
+    }
+    const uint32_t max_compressed_size
+        = max_compressed_ser_size - sizeof(ls_buf_data_t);
+
+    if (!deflate_initialized) {
+        int res = deflateInit2(&deflate_stream, Z_BEST_SPEED, Z_DEFLATED,
+                               BLOCK_COMPRESSION_WINDOW_BITS,
+                               BLOCK_COMPRESSION_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        guarantee(res == Z_OK, "Could not initialize zlib for block compression.");
+        deflate_initialized = true;
+    } else {
+        int res = deflateReset(&deflate_stream);
+        guarantee(res == Z_OK);
+    }
+
+    if (!scratch.has() || scratch.size() < max_compressed_size) {
+        scratch.reset();
+        scratch.init(max_compressed_size);
+    }
+
+    deflate_stream.next_in
+        = reinterpret_cast<Bytef *>(const_cast<char *>(buf->cache_data));
+    deflate_stream.avail_in = block_size.value();
+    deflate_stream.next_out = reinterpret_cast<Bytef *>(scratch.data());
+    deflate_stream.avail_out = max_compressed_size;
+
+    int res = deflate(&deflate_stream, Z_FINISH);
+    if (res != Z_STREAM_END) {
+        // The block didn't compress well enough to fit.
+        guarantee(res == Z_OK || res == Z_BUF_ERROR);
+        return buf_ptr_t();
+    }
+
+    const uint32_t compressed_size = deflate_stream.total_out;
+    buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(
+        block_size_t::unsafe_make(sizeof(ls_buf_data_t) + compressed_size));
+    ret.ser_buffer()->ser_header = buf->ser_header;
+    memcpy(ret.cache_data(), scratch.data(), compressed_size);
+    ret.fill_padding_zero();
+    return ret;
+}
+
+buf_ptr_t block_compressor_t::decompress(const ser_buffer_t *buf,
+                                         block_size_t disk_block_size,
+                                         block_size_t block_size) {
+    if (!inflate_initialized) {
+        int res = inflateInit2(&inflate_stream, BLOCK_COMPRESSION_WINDOW_BITS);
+        guarantee(res == Z_OK, "Could not initialize zlib for block decompression.");
+        inflate_initialized = true;
+    } else {
+        int res = inflateReset(&inflate_stream);
+        guarantee(res == Z_OK);
+    }
+
+    buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
+    ret.ser_buffer()->ser_header = buf->ser_header;
+
+    inflate_stream.next_in
+        = reinterpret_cast<Bytef *>(const_cast<char *>(buf->cache_data));
+    inflate_stream.avail_in = disk_block_size.value();
+    inflate_stream.next_out = reinterpret_cast<Bytef *>(ret.cache_data());
+    inflate_stream.avail_out = block_size.value();
+
+    int res = inflate(&inflate_stream, Z_FINISH);
+    guarantee(res == Z_STREAM_END && inflate_stream.total_out == block_size.value(),
+              "Compressed block %" PRIu64 " is corrupted (zlib error %d).",
+              buf->ser_header.block_id, res);
+    ret.fill_padding_zero();
+    return ret;
+}
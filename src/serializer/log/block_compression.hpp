@@ -0,0 +1,51 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+#define SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+
+#include <zlib.h>
+
+#include "containers/scoped.hpp"
+#include "serializer/buf_ptr.hpp"
+#include "serializer/log/config.hpp"
+#include "serializer/types.hpp"
+
+/* Compresses blocks on their way to disk and decompresses them on their way back.
+
+A compressed block keeps its `ls_buf_data_t` header as is (the read-ahead code and
+the GC need to find the block id there), followed by the compressed contents of the
+rest of the block.  The size of the block before compression is recorded in the
+LBA, so nothing else on disk needs to change.
+
+Blocks take up a multiple of `DEVICE_BLOCK_SIZE` on disk, so `compress()` only
+bothers if the compressed block takes up fewer device blocks than the original.
+
+The zlib streams are reused from block to block, so a `block_compressor_t` must
+only be used from one thread. */
+class block_compressor_t {
+public:
+    explicit block_compressor_t(block_compression_t compression);
+    ~block_compressor_t();
+
+    /* Returns an empty `buf_ptr_t` if the block isn't worth compressing. */
+    buf_ptr_t compress(const ser_buffer_t *buf, block_size_t block_size);
+
+    /* `buf` holds `disk_block_size` bytes of a block that was compressed by
+    `compress()` and was `block_size` big before that. */
+    buf_ptr_t decompress(const ser_buffer_t *buf, block_size_t disk_block_size,
+                         block_size_t block_size);
+
+private:
+    const block_compression_t compression;
+
+    bool deflate_initialized;
+    z_stream deflate_stream;
+    bool inflate_initialized;
+    z_stream inflate_stream;
+
+    // Compressed data goes here first, until we know how big it is.
+    scoped_array_t<char> scratch;
+
+    DISABLE_COPYING(block_compressor_t);
+};
+
+#endif  // SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
@@ -9,12 +9,22 @@
 #include "serializer/types.hpp"
 #include "rpc/serialize_macros.hpp"
 
+/* How the serializer compresses blocks before writing them to disk.  Blocks are
+only ever stored compressed if that makes them take up fewer device blocks, and
+compressed and uncompressed blocks can be mixed freely in the same file, so this
+can be changed from run to run. */
+enum class block_compression_t {
+    none,
+    zlib
+};
+
 /* Configuration for the serializer that can change from run to run */
 
 struct log_serializer_dynamic_config_t {
     log_serializer_dynamic_config_t() {
         read_ahead = true;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        block_compression = block_compression_t::none;
     }
 
     /* The (minimal) batch size of i/o requests being taken from a single i/o account.
@@ -24,6 +34,9 @@ struct log_serializer_dynamic_config_t {
 
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
+
+    /* Compress blocks on their way to disk. */
+    block_compression_t block_compression;
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
@@ -15,6 +15,7 @@
 #include "errors.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
@@ -53,6 +54,33 @@ const size_t GC_YOUNG_EXTENT_MAX_SIZE = 50;
 // What's the definition of a "young" extent in microseconds?
 const microtime_t GC_YOUNG_EXTENT_TIMELIMIT_MICROS = 50000;
 
+// GC candidates are ranked by the cost-benefit formula from LFS.  Every extent's age
+// counts as at least this much, so that the amount of garbage still matters when
+// comparing extents that were all written recently.
+const microtime_t GC_MIN_EXTENT_AGE_MICROS = 1000000;
+// Extent ages keep changing while the extents sit in the GC priority queue, so we
+// periodically re-sort the queue.  In between, ages are measured relative to the
+// time of the last re-sort.
+const microtime_t GC_REPRIORITIZE_INTERVAL_MICROS = 10000000;
+
+
+namespace data_block_manager {
+
+// This is the LFS cost-benefit ratio: the free space we'd reclaim, weighted by how long
+// the extent's data has been left alone, divided by the cost of reading the extent and
+// writing its live blocks back out.  Data that hasn't changed in a while is unlikely to
+// change soon, so an old extent is worth cleaning at a lower garbage ratio than one
+// whose live blocks are about to become garbage anyway.
+double gc_cost_benefit(int64_t extent_size, int64_t garbage_bytes,
+                       microtime_t data_timestamp, microtime_t reference_time) {
+    const double size = extent_size;
+    const double garbage = garbage_bytes;
+    const microtime_t age = GC_MIN_EXTENT_AGE_MICROS
+        + (reference_time > data_timestamp ? reference_time - data_timestamp : 0);
+    return garbage * static_cast<double>(age) / (size + (size - garbage));
+}
+
+}  // namespace data_block_manager
 
 // Identifies an extent, the time we started writing to the
 // extent, whether it's the extent we're currently writing to, and
@@ -72,6 +100,7 @@ public:
         : parent(_parent),
           extent_ref(parent->extent_manager->gen_extent()),
           timestamp(current_microtime()),
+          data_timestamp(timestamp),
           was_written(false),
           state(state_active),
           garbage_bytes_stat(_parent->static_config->extent_size()),
@@ -86,6 +115,7 @@ public:
         : parent(_parent),
           extent_ref(parent->extent_manager->reserve_extent(_offset)),
           timestamp(current_microtime()),
+          data_timestamp(timestamp),
           was_written(false),
           state(state_reconstructing),
           garbage_bytes_stat(_parent->static_config->extent_size()),
@@ -197,6 +227,13 @@ public:
         return garbage_bytes_stat;
     }
 
+    // How much we gain per byte of i/o by GCing this extent.
+    double gc_benefit() const {
+        return data_block_manager::gc_cost_benefit(
+            parent->static_config->extent_size(), garbage_bytes(), data_timestamp,
+            parent->gc_reference_time);
+    }
+
     bool block_is_garbage(unsigned int _block_index) const {
         guarantee(state != state_reconstructing);
         guarantee(_block_index < block_infos.size());
@@ -351,6 +388,11 @@ public:
     // When we started writing to the extent (this time).
     const microtime_t timestamp;
 
+    // When the newest data in the extent was written by someone other than the GC.
+    // For extents that receive blocks moved by the GC, this is the `data_timestamp`
+    // of the newest extent they were moved from.
+    microtime_t data_timestamp;
+
     // The PQ entry pointing to us.
     priority_queue_t<gc_entry_t *, gc_entry_less_t>::entry_t *our_pq_entry;
 
@@ -393,6 +435,9 @@ data_block_manager_t::data_block_manager_t(
     : stats(_stats), shutdown_callback(nullptr), state(state_unstarted),
       gc_enabled(true), static_config(_static_config), extent_manager(em),
       serializer(_serializer),
+      active_extent(nullptr),
+      active_gc_extent(nullptr),
+      gc_reference_time(current_microtime()),
       gc_index_write_pumper(std::bind(
           &data_block_manager_t::flush_gc_index_writes, this, std::placeholders::_1)),
       /* The capacity of the gc_index_write_semaphore will be scaled
@@ -470,6 +515,10 @@ void data_block_manager_t::start_existing(file_t *file,
         active_extent = nullptr;
     }
 
+    /* We don't remember the extent that GC-moved blocks were going to, so they
+    start over in a new one. */
+    active_gc_extent = nullptr;
+
     /* Convert any extents that we found live blocks in, but that are not active
     extents, into old extents */
     while (gc_entry_t *entry = reconstructed_extents.head()) {
@@ -652,15 +701,26 @@ public:
                     continue;
                 }
 
-                const block_size_t block_size = block_size_t::unsafe_make(info.ser_block_size);
-                buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(block_size);
-                memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
-                buf.fill_padding_zero();
+                const block_size_t disk_block_size
+                    = block_size_t::unsafe_make(info.ser_block_size);
+                const block_size_t block_size
+                    = block_size_t::unsafe_make(info.logical_ser_block_size());
                 guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                buf_ptr_t buf;
+                if (disk_block_size != block_size) {
+                    buf = parent->serializer->block_compressor->decompress(
+                        reinterpret_cast<const ser_buffer_t *>(current_buf),
+                        disk_block_size, block_size);
+                } else {
+                    buf = buf_ptr_t::alloc_uninitialized(block_size);
+                    memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
+                    buf.fill_padding_zero();
+                }
 
                 counted_t<ls_block_token_pointee_t> ls_token
                     = parent->serializer->generate_block_token(current_offset,
-                                                               block_size);
+                                                               block_size,
+                                                               disk_block_size);
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, std::move(ls_token));
@@ -731,10 +791,20 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
+    return write_to_extents(&active_extent, current_microtime(),
+                            writes, io_account, cb);
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_to_extents(gc_entry_t **extent_slot,
+                                       microtime_t data_timestamp,
+                                       const std::vector<buf_write_info_t> &writes,
+                                       file_account_t *io_account,
+                                       iocallback_t *cb) {
     // These tokens are grouped by extent.  You can do a contiguous write in each
     // extent.
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
+        = gimme_some_new_offsets(extent_slot, data_timestamp, writes);
 
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         it->buf->ser_header.block_id = it->block_id;
@@ -765,7 +835,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->disk_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -778,7 +848,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->disk_block_size();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
             total_aligned_size += j_aligned_size;
@@ -1028,6 +1098,12 @@ void data_block_manager_t::run_gc(gc_state_t *gc_state) {
     active_gcs.remove(gc_state);
     gc_index_write_semaphore.set_capacity(std::max<int64_t>(1, active_gcs.size()));
     delete gc_state;
+
+    // We might have been spawned but not have started running before `shutdown()`
+    // got called, in which case it's waiting for us.
+    if (state == state_shutting_down && active_gcs.empty()) {
+        actually_shutdown();
+    }
 }
 
 void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
@@ -1064,6 +1140,10 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
 
         ++stats->pm_serializer_data_extents_gced;
 
+        if (current_microtime() - gc_reference_time > GC_REPRIORITIZE_INTERVAL_MICROS) {
+            reprioritize_gc_candidates();
+        }
+
         /* grab the entry */
         guarantee (!gc_pq.empty());
         guarantee(gc_state->current_entry == nullptr);
@@ -1240,7 +1320,10 @@ void data_block_manager_t::write_gcs(
         std::vector<buf_write_info_t> the_writes;
         the_writes.reserve(writes.size());
         for (size_t i = 0; i < writes.size(); ++i) {
+            // These tokens are never read from, so it doesn't matter that they
+            // don't know the uncompressed size of compressed blocks.
             old_block_tokens.push_back(serializer->generate_block_token(writes[i].old_offset,
+                                                                        writes[i].block_size,
                                                                         writes[i].block_size));
 
             the_writes.push_back(buf_write_info_t(writes[i].buf,
@@ -1248,8 +1331,13 @@ void data_block_manager_t::write_gcs(
                                                   writes[i].buf->ser_header.block_id));
         }
 
-        new_block_tokens = many_writes(the_writes, choose_gc_io_account(),
-                                       &block_write_cond);
+        // The blocks that survived until GC are likely to stay around for a while
+        // longer.  We keep them apart from freshly written blocks, so that they
+        // don't get copied again when the fresh blocks around them become garbage.
+        new_block_tokens = write_to_extents(&active_gc_extent,
+                                            gc_state->current_entry->data_timestamp,
+                                            the_writes, choose_gc_io_account(),
+                                            &block_write_cond);
 
         guarantee(new_block_tokens.size() == writes.size());
     }
@@ -1313,6 +1401,16 @@ void data_block_manager_t::flush_gc_index_writes(signal_t *) {
                 if (iw.gc_state->current_entry->block_referenced_by_index(block_index)) {
                     block_id_t block_id = write.buf->ser_header.block_id;
 
+                    // We copied the block verbatim, so if it's stored compressed,
+                    // the new token has to learn its uncompressed size from the
+                    // index entry that we're replacing.
+                    const index_block_info_t info
+                        = serializer->lba_index->get_block_info(block_id);
+                    guarantee(info.offset.has_value()
+                              && info.offset.get_value() == write.old_offset);
+                    iw.new_block_tokens[i]->block_size_
+                        = block_size_t::unsafe_make(info.logical_ser_block_size());
+
                     index_write_ops.push_back(
                         index_write_op_t(block_id,
                             make_optional(to_standard_block_token(
@@ -1403,6 +1501,12 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = nullptr;
     }
 
+    if (active_gc_extent != nullptr) {
+        UNUSED int64_t extent = active_gc_extent->extent_ref.release();
+        delete active_gc_extent;
+        active_gc_extent = nullptr;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1421,17 +1525,22 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(gc_entry_t **extent_slot,
+                                             microtime_t data_timestamp,
+                                             const std::vector<buf_write_info_t> &writes) {
     ASSERT_NO_CORO_WAITING;
 
+    // The extent we're writing to.  We replace it when it fills up.
+    gc_entry_t *&extent = *extent_slot;
+
     // Start a new extent if necessary.
-    if (active_extent == nullptr) {
-        active_extent = new gc_entry_t(this);
+    if (extent == nullptr) {
+        extent = new gc_entry_t(this);
+        extent->data_timestamp = data_timestamp;
         ++stats->pm_serializer_data_extents_allocated;
     }
 
-
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee(extent->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1439,25 +1548,25 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        if (!extent->new_offset(it->block_size, &relative_offset, &block_index)) {
+            // Move the full gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
+            if (extent->num_live_blocks() == 0) {
+                gc_entry_t *old_active_extent = extent;
+                extent = new gc_entry_t(this);
                 destroy_entry(old_active_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                extent->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(extent);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                extent = new gc_entry_t(this);
             }
+            extent->data_timestamp = data_timestamp;
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = extent->new_offset(it->block_size,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1467,11 +1576,13 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = extent->extent_ref.offset() + relative_offset;
+        extent->was_written = true;
+        extent->data_timestamp = std::max(extent->data_timestamp, data_timestamp);
+        extent->mark_live_tokenwise(block_index);
 
-        tokens.push_back(serializer->generate_block_token(offset, it->block_size));
+        tokens.push_back(serializer->generate_block_token(offset, it->block_size,
+                                                          it->block_size));
     }
 
     if (!tokens.empty()) {
@@ -1539,7 +1650,23 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_benefit() < y->gc_benefit();
+}
+
+// Re-sorts `gc_pq` according to the extents' current ages.
+void data_block_manager_t::reprioritize_gc_candidates() {
+    ASSERT_NO_CORO_WAITING;
+    std::vector<gc_entry_t *> candidates;
+    candidates.reserve(gc_pq.size());
+    while (!gc_pq.empty()) {
+        candidates.push_back(gc_pq.pop());
+    }
+
+    gc_reference_time = current_microtime();
+
+    for (gc_entry_t *entry : candidates) {
+        entry->our_pq_entry = gc_pq.push(entry);
+    }
 }
 
 /****************
@@ -15,6 +15,7 @@
 #include "serializer/log/config.hpp"
 #include "serializer/log/extent_manager.hpp"
 #include "serializer/types.hpp"
+#include "time.hpp"
 
 class buf_ptr_t;
 class log_serializer_t;
@@ -28,6 +29,11 @@ struct gc_entry_less_t {
 namespace data_block_manager {
 struct shutdown_callback_t;  // see log_serializer.hpp.
 struct metablock_mixin_t;  // see log_serializer.hpp.
+
+// How much we gain per byte of i/o by GCing an extent whose data was last written to
+// by a client at `data_timestamp`.  The GC picks the extent for which this is highest.
+double gc_cost_benefit(int64_t extent_size, int64_t garbage_bytes,
+                       microtime_t data_timestamp, microtime_t reference_time);
 }  // namespace data_block_manager
 
 class data_block_manager_t {
@@ -86,9 +92,6 @@ public:
                 file_account_t *io_account,
                 iocallback_t *cb);
 
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
-
     bool is_gc_active() const;
 
 private:
@@ -130,6 +133,25 @@ private:
 
     void flush_gc_index_writes(signal_t *);
 
+    // Writes the blocks into `*extent_slot`, which is either `active_extent` or
+    // `active_gc_extent`, and starts new extents there as they fill up.
+    // `data_timestamp` is the time the blocks' contents were last written by a
+    // client.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_to_extents(gc_entry_t **extent_slot,
+                     microtime_t data_timestamp,
+                     const std::vector<buf_write_info_t> &writes,
+                     file_account_t *io_account,
+                     iocallback_t *cb);
+
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
+    gimme_some_new_offsets(gc_entry_t **extent_slot,
+                           microtime_t data_timestamp,
+                           const std::vector<buf_write_info_t> &writes);
+
+    // Re-sorts `gc_pq` after the extents' ages have changed.
+    void reprioritize_gc_candidates();
+
     // Determine how many GC processes should run concurrently at the moment.
     // Returns a number between 1 and MAX_CONCURRENT_GCS
     size_t compute_gc_concurrency() const;
@@ -191,8 +213,11 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* The extents in the gc_entry_t::state_active state.  New blocks go into
+    `active_extent`.  Blocks moved by the GC go into `active_gc_extent`, so that
+    long-lived blocks end up in extents of their own. */
     gc_entry_t *active_extent;
+    gc_entry_t *active_gc_extent;
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
@@ -200,6 +225,10 @@ private:
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The time against which the ages of the extents in `gc_pq` are measured.
+    Updated whenever we re-sort `gc_pq`. */
+    microtime_t gc_reference_time;
+
     /* \brief structure to keep track of global stats about the data blocks
      */
     class gc_stat_t {
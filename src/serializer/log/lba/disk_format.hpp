@@ -64,9 +64,11 @@ ATTR_PACKED(struct lba_entry_t {
     // (It probably assumes that sizeof(lba_entry_t) evenly divides
     // DEVICE_BLOCK_SIZE).
 
-    // Put the zero-padding at the beginning of the LBA entry.  We could use this, or
-    // the first 16 bits, perhaps, as a version flag.
-    uint32_t zero_reserved;
+    // If the block was stored compressed, this is the size of the block before
+    // compression, and `ser_block_size` is the number of bytes it takes on disk.
+    // Zero means that the block is stored uncompressed.  (This field used to be
+    // unused zero-padding, so older files read back as uncompressed.)
+    uint32_t uncompressed_ser_block_size;
 
     // This could be a uint16_t if you wanted it to be, as long as block sizes are
     // all less than or equal to 4K (which is less than 64K).
@@ -80,10 +82,11 @@ ATTR_PACKED(struct lba_entry_t {
     flagged_off64_t offset;
 
     static lba_entry_t make(block_id_t block_id, repli_timestamp_t recency,
-                            flagged_off64_t offset, uint32_t ser_block_size) {
+                            flagged_off64_t offset, uint32_t ser_block_size,
+                            uint32_t uncompressed_ser_block_size) {
         guarantee(ser_block_size != 0 || !offset.has_value());
         lba_entry_t entry;
-        entry.zero_reserved = 0;
+        entry.uncompressed_ser_block_size = uncompressed_ser_block_size;
         entry.ser_block_size = ser_block_size;
         entry.block_id = block_id;
         entry.recency = recency;
@@ -96,7 +99,7 @@ ATTR_PACKED(struct lba_entry_t {
     }
 
     static lba_entry_t make_padding_entry() {
-        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0);
+        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0, 0);
     }
 });
 
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <vector>
 
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "math.hpp"
 
@@ -73,6 +74,7 @@ void lba_disk_structure_t::on_extent_read() {
 
 void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t recency,
                                      flagged_off64_t offset, uint32_t ser_block_size,
+                                     uint32_t uncompressed_ser_block_size,
                                      file_account_t *io_account, extent_transaction_t *txn) {
     if (last_extent && last_extent->full()) {
         /* We have filled up an extent. Transfer it to the superblock. */
@@ -91,7 +93,9 @@ void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t rece
 
     rassert(!last_extent->full());
 
-    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size), io_account);
+    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size,
+                                             uncompressed_ser_block_size),
+                           io_account);
 }
 
 std::set<lba_disk_extent_t *> lba_disk_structure_t::get_inactive_extents() const {
@@ -200,9 +204,8 @@ void lba_disk_structure_t::sync(file_account_t *io_account, sync_callback_t *cb)
 
 struct reader_t
 {
-    lba_disk_structure_t *ds;   // The disk structure we are reading from
     in_memory_index_t *index;   // The in-memory-index we are reading into
-    lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when we finish
+    lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when a shard is done
 
     /* extent_reader_t takes care of reading a single extent. */
     struct extent_reader_t :
@@ -210,6 +213,7 @@ struct reader_t
     {
         reader_t *parent;   // Our reader_t that we were created by
         int index;   // parent->readers[index] = this
+        int shard;   // The index of the shard that the extent belongs to
         lba_disk_extent_t *extent;   // The extent we are supposed to read
         lba_disk_extent_t::read_info_t read_info;   // Opaque data used by extent_t::read()
         bool have_read;   // true if our extent has been loaded from disk
@@ -220,8 +224,8 @@ struct reader_t
         and the LBA would be corrupted. */
         bool prev_done;
 
-        extent_reader_t(reader_t *p, lba_disk_extent_t *e)
-            : parent(p), extent(e), have_read(false)
+        extent_reader_t(reader_t *p, int _shard, lba_disk_extent_t *e)
+            : parent(p), shard(_shard), extent(e), have_read(false)
         {
             index = parent->readers.size();
             parent->readers.push_back(this);
@@ -251,12 +255,20 @@ struct reader_t
             extent->read_step_2(&read_info, parent->index);
             parent->active_readers--;
             parent->start_more_readers();
-            if (index == static_cast<int>(parent->readers.size()) - 1) {
-                parent->done();
-            } else {
-                parent->readers[index+1]->on_prev_done();
+            reader_t *p = parent;
+            const bool is_last = index == static_cast<int>(p->readers.size()) - 1;
+            extent_reader_t *next = is_last ? nullptr : p->readers[index + 1];
+            if (is_last || next->shard != shard) {
+                // That was the last extent of our shard (and maybe of some empty
+                // shards after it).
+                p->finish_shards_before(is_last ? p->num_shards : next->shard);
             }
             delete this;
+            if (is_last) {
+                p->done();
+            } else {
+                next->on_prev_done();
+            }
         }
     };
     std::vector< extent_reader_t* > readers;
@@ -266,44 +278,67 @@ struct reader_t
     // The number of readers that have done start_reading() but not done(). Used to throttle the
     // reading process so that we stay under LBA_READ_BUFFER_SIZE.
     int active_readers;
+    int max_active_readers;
 
-    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index, lba_disk_structure_t::read_callback_t *cb)
-        : ds(_ds), index(_index), rcb(cb)
+    // Shards before this one have been fully applied to the index.
+    int num_shards;
+    int next_shard_to_finish;
+
+    reader_t(const std::vector<lba_disk_structure_t *> &shards, in_memory_index_t *_index,
+             lba_disk_structure_t::read_callback_t *cb)
+        : index(_index), rcb(cb), next_reader(0), active_readers(0),
+          num_shards(shards.size()), next_shard_to_finish(0)
     {
-        for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
-             e != nullptr; e = ds->extents_in_superblock.next(e)) {
-            new extent_reader_t(this, e);
+        guarantee(!shards.empty());
+        for (int i = 0; i < num_shards; ++i) {
+            lba_disk_structure_t *ds = shards[i];
+            for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
+                 e != nullptr; e = ds->extents_in_superblock.next(e)) {
+                new extent_reader_t(this, i, e);
+            }
+            if (ds->last_extent) new extent_reader_t(this, i, ds->last_extent);
         }
-        if (ds->last_extent) new extent_reader_t(this, ds->last_extent);
 
         /* The constructor for extent_reader_t pushed them onto our 'readers' vector. So now we
         have a vector with an extent_reader_t object for each extent we need to read, but none
-        of them have been started yet. */
+        of them have been started yet.  Their order is the order in which they must be
+        applied to the index, but we read ahead across shard boundaries so that the disk
+        stays busy while we wait for the last extents of a shard. */
+
+        max_active_readers = std::max<int>(LBA_READ_BUFFER_SIZE / shards[0]->em->extent_size, 1);
 
         if (readers.empty()) {
+            finish_shards_before(num_shards);
             done();
         } else {
-            next_reader = 0;
-            active_readers = 0;
+            // Shards in front of the first one that has any extents are empty.
+            finish_shards_before(readers[0]->shard);
             start_more_readers();
         }
     }
 
     void start_more_readers() {
-        int limit = std::max<int>(LBA_READ_BUFFER_SIZE / ds->em->extent_size / LBA_SHARD_FACTOR, 1);
-        while (next_reader != static_cast<int>(readers.size()) && active_readers < limit) {
+        while (next_reader != static_cast<int>(readers.size())
+               && active_readers < max_active_readers) {
             readers[next_reader++]->start_reading();
         }
     }
 
+    void finish_shards_before(int shard) {
+        while (next_shard_to_finish < shard) {
+            rcb->on_lba_shard_read(next_shard_to_finish++);
+        }
+    }
+
     void done() {
-        rcb->on_lba_extents_read();
+        rassert(next_shard_to_finish == num_shards);
         delete this;
     }
 };
 
-void lba_disk_structure_t::read(in_memory_index_t *index, read_callback_t *cb) {
-    new reader_t(this, index, cb);
+void lba_disk_structure_t::read_shards(const std::vector<lba_disk_structure_t *> &shards,
+                                       in_memory_index_t *index, read_callback_t *cb) {
+    new reader_t(shards, index, cb);
 }
 
 void lba_disk_structure_t::prepare_metablock(lba_shard_metablock_t *mb_out) {
@@ -3,6 +3,7 @@
 #define SERIALIZER_LOG_LBA_DISK_STRUCTURE_HPP_
 
 #include <set>
+#include <vector>
 
 #include "arch/types.hpp"
 #include "serializer/log/extent_manager.hpp"
@@ -33,6 +34,7 @@ public:
     // Put entries in an LBA and then call sync() to write to disk
     void add_entry(block_id_t block_id, repli_timestamp_t recency,
                    flagged_off64_t offset, uint32_t ser_block_size,
+                   uint32_t uncompressed_ser_block_size,
                    file_account_t *io_account,
                    extent_transaction_t *txn);
     struct sync_callback_t {
@@ -53,13 +55,17 @@ public:
     void destroy_extents(const std::set<lba_disk_extent_t *> &extents,
                          file_account_t *io_account, extent_transaction_t *txn);
 
-    // If you call read(), then the in_memory_index_t will be populated and then the read_callback_t
-    // will be called when it is done.
+    // read_shards() populates the in_memory_index_t from the extents of the given LBA
+    // shards.  The shards are applied one after the other, but we read ahead across
+    // shard boundaries, keeping up to LBA_READ_BUFFER_SIZE worth of extents in flight.
+    // The read_callback_t is called for each shard, in order, as soon as the shard
+    // has been applied.
     struct read_callback_t {
-        virtual void on_lba_extents_read() = 0;
+        virtual void on_lba_shard_read(int shard) = 0;
         virtual ~read_callback_t() {}
     };
-    void read(in_memory_index_t *index, read_callback_t *cb);
+    static void read_shards(const std::vector<lba_disk_structure_t *> &shards,
+                            in_memory_index_t *index, read_callback_t *cb);
 
     void prepare_metablock(lba_shard_metablock_t *mb_out);
 
@@ -3,8 +3,65 @@
 
 #include <inttypes.h>
 
+#include "math.hpp"
 #include "serializer/log/lba/disk_format.hpp"
 
+const int PACKED_OFFSET_BITS = 40;
+const uint64_t PACKED_OFFSET_MASK = (uint64_t(1) << PACKED_OFFSET_BITS) - 1;
+const int PACKED_SER_BLOCK_SIZE_SHIFT = PACKED_OFFSET_BITS;
+const int PACKED_SIZE_LOW_SHIFT = PACKED_SER_BLOCK_SIZE_SHIFT + 16;
+const int PACKED_RECENCY_BITS = 56;
+const uint64_t PACKED_RECENCY_MASK = (uint64_t(1) << PACKED_RECENCY_BITS) - 1;
+
+packed_location_t pack_location(flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t uncompressed_ser_block_size) {
+    uint64_t offset_field = 0;
+    if (offset.has_value()) {
+        const int64_t value = offset.get_value();
+        guarantee(divides(DEVICE_BLOCK_SIZE, value),
+                  "Block offset %" PRIi64 " is not aligned.", value);
+        offset_field = value / DEVICE_BLOCK_SIZE + 1;
+        guarantee(offset_field <= PACKED_OFFSET_MASK,
+                  "Block offset %" PRIi64 " is too large.", value);
+    }
+    return offset_field
+        | (static_cast<uint64_t>(ser_block_size) << PACKED_SER_BLOCK_SIZE_SHIFT)
+        | (static_cast<uint64_t>(uncompressed_ser_block_size & 0xff)
+           << PACKED_SIZE_LOW_SHIFT);
+}
+
+flagged_off64_t unpack_offset(packed_location_t location) {
+    const uint64_t offset_field = location & PACKED_OFFSET_MASK;
+    return offset_field == 0
+        ? flagged_off64_t::unused()
+        : flagged_off64_t::make((offset_field - 1) * DEVICE_BLOCK_SIZE);
+}
+
+uint16_t unpack_ser_block_size(packed_location_t location) {
+    return static_cast<uint16_t>(location >> PACKED_SER_BLOCK_SIZE_SHIFT);
+}
+
+uint16_t unpack_uncompressed_ser_block_size(packed_location_t location,
+                                            uint8_t size_high) {
+    return static_cast<uint16_t>(location >> PACKED_SIZE_LOW_SHIFT)
+        | static_cast<uint16_t>(size_high) << 8;
+}
+
+// We store the recency plus one, so that `invalid` (which is all ones) becomes
+// zero, and a zeroed `packed_block_info_t` is the same as `index_block_info_t()`.
+uint64_t pack_recency(repli_timestamp_t recency) {
+    const uint64_t recency_field = recency.longtime + 1;
+    guarantee(recency_field <= PACKED_RECENCY_MASK,
+              "Recency %" PRIu64 " is too large.", recency.longtime);
+    return recency_field;
+}
+
+repli_timestamp_t unpack_recency(uint64_t recency_and_size) {
+    repli_timestamp_t ret;
+    ret.longtime = (recency_and_size & PACKED_RECENCY_MASK) - 1;
+    return ret;
+}
+
 in_memory_index_t::in_memory_index_t()
     : end_block_id_(0), end_aux_block_id_(FIRST_AUX_BLOCK_ID) { }
 
@@ -18,17 +75,29 @@ block_id_t in_memory_index_t::end_aux_block_id() {
 
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
     if (is_aux_block_id(id)) {
-        index_aux_block_info_t aux_info = aux_infos_.get(make_aux_block_id_relative(id));
-        return index_block_info_t(aux_info.offset,
-                                  repli_timestamp_t::invalid,
-                                  aux_info.ser_block_size);
+        packed_aux_block_info_t aux_info
+            = aux_infos_.get(make_aux_block_id_relative(id));
+        return index_block_info_t(
+            unpack_offset(aux_info.location),
+            repli_timestamp_t::invalid,
+            unpack_ser_block_size(aux_info.location),
+            unpack_uncompressed_ser_block_size(aux_info.location,
+                                               aux_info.size_high));
     } else {
-        return infos_.get(id);
+        packed_block_info_t info = infos_.get(id);
+        return index_block_info_t(
+            unpack_offset(info.location),
+            unpack_recency(info.recency_and_size),
+            unpack_ser_block_size(info.location),
+            unpack_uncompressed_ser_block_size(
+                info.location,
+                static_cast<uint8_t>(info.recency_and_size >> PACKED_RECENCY_BITS)));
     }
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
-                                       flagged_off64_t offset, uint16_t ser_block_size) {
+                                       flagged_off64_t offset, uint16_t ser_block_size,
+                                       uint16_t uncompressed_ser_block_size) {
     if (is_aux_block_id(id)) {
         if (id >= end_aux_block_id_) {
             end_aux_block_id_ = id + 1;
@@ -37,14 +106,21 @@ void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
         // other than `invalid`, you might be doing something wrong. It will be
         // discarded anyway.
         rassert(recency == repli_timestamp_t::invalid);
-        index_aux_block_info_t info(offset, ser_block_size);
+        packed_aux_block_info_t info;
+        info.location = pack_location(offset, ser_block_size,
+                                      uncompressed_ser_block_size);
+        info.size_high = static_cast<uint8_t>(uncompressed_ser_block_size >> 8);
         aux_infos_.set(make_aux_block_id_relative(id), info);
     } else {
         if (id >= end_block_id_) {
             end_block_id_ = id + 1;
         }
-        index_block_info_t info(offset, recency, ser_block_size);
+        packed_block_info_t info;
+        info.location = pack_location(offset, ser_block_size,
+                                      uncompressed_ser_block_size);
+        info.recency_and_size = pack_recency(recency)
+            | (static_cast<uint64_t>(uncompressed_ser_block_size >> 8)
+               << PACKED_RECENCY_BITS);
         infos_.set(id, info);
     }
 }
-
@@ -12,56 +12,87 @@ ATTR_PACKED(struct index_block_info_t {
     index_block_info_t()
         : offset(flagged_off64_t::unused()),
           recency(repli_timestamp_t::invalid),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          uncompressed_ser_block_size(0) { }
 
     index_block_info_t(flagged_off64_t _offset,
                        repli_timestamp_t _recency,
-                       uint16_t _ser_block_size)
+                       uint16_t _ser_block_size,
+                       uint16_t _uncompressed_ser_block_size)
         : offset(_offset),
           recency(_recency),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          uncompressed_ser_block_size(_uncompressed_ser_block_size) { }
 
-    // For two_level_array_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            uncompressed_ser_block_size == other.uncompressed_ser_block_size;
+    }
+
+    // The size of the block as the cache sees it.
+    uint16_t logical_ser_block_size() const {
+        return uncompressed_ser_block_size != 0
+            ? uncompressed_ser_block_size
+            : ser_block_size;
     }
 
     flagged_off64_t offset;
     repli_timestamp_t recency;
+    // The number of bytes the block takes up on disk.
     uint16_t ser_block_size;
+    // Zero unless the block is stored compressed, see `lba_entry_t`.
+    uint16_t uncompressed_ser_block_size;
 });
 
-/* This is a reduced-size block info for auxiliary blocks (currently
-blob blocks used for large values). It doesn't store a replication
-timestamp, because we don't need it for those blocks. */
-ATTR_PACKED(struct index_aux_block_info_t {
-    index_aux_block_info_t()
-        : offset(flagged_off64_t::unused()),
-          ser_block_size(0) { }
+/* `in_memory_index_t` doesn't store `index_block_info_t` directly.  With
+hundreds of millions of blocks per table, every byte per block counts, so the index
+bit-packs it into the representations below.  Offsets are stored in units of
+DEVICE_BLOCK_SIZE (data blocks are always aligned to it), plus one so that zero
+means "unused" and chunks of unused block ids can be freed by
+`two_level_array_t`.  That leaves 40 bits for the offset (files of up to 512 TB)
+and 56 bits for the recency, which is a counter (stored plus one, so that a
+zeroed entry is the same as `index_block_info_t()`).  Auxiliary blocks (currently
+blob blocks used for large values) don't store a recency, because we don't need
+it for those blocks.
 
-    index_aux_block_info_t(flagged_off64_t _offset,
-                           uint16_t _ser_block_size)
-        : offset(_offset),
-          ser_block_size(_ser_block_size) { }
+`packed_location_t` holds the offset in its low 40 bits, then `ser_block_size`,
+then the low 8 bits of `uncompressed_ser_block_size`. */
+typedef uint64_t packed_location_t;
+
+struct packed_block_info_t {
+    packed_block_info_t() : location(0), recency_and_size(0) { }
 
     // For two_level_array_t.
-    bool operator==(const index_aux_block_info_t &other) const {
-        return offset == other.offset &&
-            ser_block_size == other.ser_block_size;
+    bool operator==(const packed_block_info_t &other) const {
+        return location == other.location
+            && recency_and_size == other.recency_and_size;
     }
 
-    flagged_off64_t offset;
-    uint16_t ser_block_size;
-});
+    packed_location_t location;
+    // The recency in the low 56 bits, and the high 8 bits of
+    // `uncompressed_ser_block_size`.
+    uint64_t recency_and_size;
+};
 
+ATTR_PACKED(struct packed_aux_block_info_t {
+    packed_aux_block_info_t() : location(0), size_high(0) { }
 
+    // For two_level_array_t.
+    bool operator==(const packed_aux_block_info_t &other) const {
+        return location == other.location && size_high == other.size_high;
+    }
+
+    packed_location_t location;
+    // The high 8 bits of `uncompressed_ser_block_size`.
+    uint8_t size_high;
+});
 
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
+    two_level_array_t<packed_block_info_t> infos_;
     block_id_t end_block_id_;
-    two_level_array_t<index_aux_block_info_t> aux_infos_;
+    two_level_array_t<packed_aux_block_info_t> aux_infos_;
     block_id_t end_aux_block_id_;
 
 public:
@@ -73,7 +104,8 @@ public:
 
     index_block_info_t get_block_info(block_id_t id);
     void set_block_info(block_id_t id, repli_timestamp_t recency,
-                        flagged_off64_t offset, uint16_t ser_block_size);
+                        flagged_off64_t offset, uint16_t ser_block_size,
+                        uint16_t uncompressed_ser_block_size);
 
 };
 
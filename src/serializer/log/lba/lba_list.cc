@@ -3,6 +3,8 @@
 
 #include <string.h>
 
+#include <vector>
+
 #include "utils.hpp"
 #include "serializer/log/lba/disk_format.hpp"
 #include "arch/arch.hpp"
@@ -59,10 +61,14 @@ class lba_start_fsm_t :
 public:
     int cbs_out;
     lba_list_t *owner;
+    // Gets told about every shard as soon as it has been read.
+    lba_list_t::ready_callback_t *shard_callback;
+    // Gets told when we're done, unless we finish before `start_existing()` returns.
     lba_list_t::ready_callback_t *callback;
 
-    lba_start_fsm_t(lba_list_t *l, lba_list_t::metablock_mixin_t *last_metablock)
-        : owner(l), callback(nullptr)
+    lba_start_fsm_t(lba_list_t *l, lba_list_t::metablock_mixin_t *last_metablock,
+                    lba_list_t::ready_callback_t *cb)
+        : owner(l), shard_callback(cb), callback(nullptr)
     {
         rassert(owner->state == lba_list_t::state_unstarted);
         owner->state = lba_list_t::state_starting_up;
@@ -87,33 +93,38 @@ public:
         rassert(cbs_out > 0);
         cbs_out--;
         if (cbs_out == 0) {
-            cbs_out = LBA_SHARD_FACTOR;
-            for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
-            }
+            std::vector<lba_disk_structure_t *> shards(
+                owner->disk_structures, owner->disk_structures + LBA_SHARD_FACTOR);
+            lba_disk_structure_t::read_shards(shards, &owner->in_memory_index, this);
         }
     }
 
-    void on_lba_extents_read() {
-        rassert(cbs_out > 0);
-        cbs_out--;
-        if (cbs_out == 0) {
-            // All LBA entries from the LBA extents have been read.
-            // Now we can load the (more recent) inlined entries from
-            // the metablock into the index:
-            for (int32_t i = 0; i < owner->inline_lba_entries_count; ++i) {
-                lba_entry_t *e = &owner->inline_lba_entries[i];
-                // The on-disk format still stores 32 bit block sizes.
-                // We've never actually used them, and we now use 16 bit block sizes
-                // for the in-memory index to save a few bytes.
-                guarantee(e->ser_block_size <= std::numeric_limits<uint16_t>::max());
-                owner->in_memory_index.set_block_info(
-                        e->block_id,
-                        e->recency,
-                        e->offset,
-                        static_cast<uint16_t>(e->ser_block_size));
+    void on_lba_shard_read(int shard) {
+        // All LBA entries of the shard have been read from its LBA extents.
+        // Now we can load the (more recent) inlined entries that belong to the
+        // shard from the metablock into the index:
+        for (int32_t i = 0; i < owner->inline_lba_entries_count; ++i) {
+            lba_entry_t *e = &owner->inline_lba_entries[i];
+            if (static_cast<int>(e->block_id % LBA_SHARD_FACTOR) != shard) {
+                continue;
             }
+            // The on-disk format still stores 32 bit block sizes.
+            // We've never actually used them, and we now use 16 bit block sizes
+            // for the in-memory index to save a few bytes.
+            guarantee(e->ser_block_size <= std::numeric_limits<uint16_t>::max());
+            guarantee(e->uncompressed_ser_block_size
+                      <= std::numeric_limits<uint16_t>::max());
+            owner->in_memory_index.set_block_info(
+                    e->block_id,
+                    e->recency,
+                    e->offset,
+                    static_cast<uint16_t>(e->ser_block_size),
+                    static_cast<uint16_t>(e->uncompressed_ser_block_size));
+        }
+
+        shard_callback->on_lba_shard_ready(shard);
 
+        if (shard == LBA_SHARD_FACTOR - 1) {
             owner->state = lba_list_t::state_ready;
             if (callback) callback->on_lba_ready();
             delete this;
@@ -128,7 +139,7 @@ bool lba_list_t::start_existing(file_t *file, metablock_mixin_t *last_metablock,
     dbfile = file;
     gc_io_account.init(new file_account_t(dbfile, LBA_GC_IO_PRIORITY));
 
-    lba_start_fsm_t *starter = new lba_start_fsm_t(this, last_metablock);
+    lba_start_fsm_t *starter = new lba_start_fsm_t(this, last_metablock, cb);
     if (state == state_ready) {
         return true;
     } else {
@@ -194,13 +205,18 @@ segmented_vector_t<repli_timestamp_t> lba_list_t::get_block_recencies(block_id_t
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t uncompressed_ser_block_size,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
     guarantee(ser_block_size <= std::numeric_limits<uint16_t>::max());
     uint16_t ser_block_size_16 = static_cast<uint16_t>(ser_block_size);
+    guarantee(uncompressed_ser_block_size <= std::numeric_limits<uint16_t>::max());
+    uint16_t uncompressed_ser_block_size_16
+        = static_cast<uint16_t>(uncompressed_ser_block_size);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size_16);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size_16,
+                                   uncompressed_ser_block_size_16);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -209,7 +225,8 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size_16);
+    add_inline_entry(block, recency, offset, ser_block_size_16,
+                     uncompressed_ser_block_size_16);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -247,6 +264,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.uncompressed_ser_block_size,
                 io_account,
                 txn);
     }
@@ -255,11 +273,13 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint16_t ser_block_size) {
+                                flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t uncompressed_ser_block_size) {
 
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size,
+                              uncompressed_ser_block_size);
 }
 
 class lba_syncer_t :
@@ -350,11 +370,12 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
 
         flagged_off64_t off = get_block_offset(id);
         if (off.has_value()) {
-            uint32_t ser_block_size = get_ser_block_size(id);
+            const index_block_info_t info = get_block_info(id);
             disk_structures[lba_shard]->add_entry(id,
-                                                  get_block_recency(id),
+                                                  info.recency,
                                                   off,
-                                                  ser_block_size,
+                                                  info.ser_block_size,
+                                                  info.uncompressed_ser_block_size,
                                                   gc_io_account.get(),
                                                   txns.back().get());
         }
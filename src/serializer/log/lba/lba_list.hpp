@@ -33,7 +33,13 @@ public:
     static void prepare_initial_metablock(metablock_mixin_t *mb_out);
     void prepare_metablock(metablock_mixin_t *mb_out);
 
+    // `on_lba_shard_ready()` is called once for each LBA shard as soon as the index
+    // entries of all blocks in the shard (the blocks whose ids are congruent to
+    // `shard` modulo LBA_SHARD_FACTOR) are final, even if `start_existing()` ends up
+    // returning true.  `on_lba_ready()` is called when all of them are, unless
+    // `start_existing()` returns true.
     struct ready_callback_t {
+        virtual void on_lba_shard_ready(int shard) = 0;
         virtual void on_lba_ready() = 0;
         virtual ~ready_callback_t() {}
     };
@@ -63,6 +69,7 @@ public:
 
     void set_block_info(block_id_t block, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t uncompressed_ser_block_size,
                         file_account_t *io_account,
                         extent_transaction_t *txn);
 
@@ -117,7 +124,8 @@ private:
     bool check_inline_lba_full() const;
     void move_inline_entries_to_extents(file_account_t *io_account, extent_transaction_t *txn);
     void add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint16_t ser_block_size);
+                                flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t uncompressed_ser_block_size);
 
     lba_disk_structure_t *disk_structures[LBA_SHARD_FACTOR];
 
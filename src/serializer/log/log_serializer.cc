@@ -10,6 +10,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <deque>
 #include <functional>
 
 #include "arch/io/disk.hpp"
@@ -20,6 +21,7 @@
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/data_block_manager.hpp"
 
 filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
@@ -284,34 +286,47 @@ struct ls_start_existing_fsm_t :
             guarantee(metablock_found, "Could not find any valid metablock.");
 
             // STATE H
+            // The LBA tells us about each of its shards as soon as the shard has
+            // been read, and we reconstruct the data block manager's view of the
+            // shard's blocks while the remaining shards are still being read.
+            ser->data_block_manager->start_reconstruct();
+            start_existing_state = state_reconstruct;
+            lba_ready = false;
+            reconstruction_scheduled = false;
+            shard_being_reconstructed = -1;
             if (ser->lba_index->start_existing(ser->dbfile, &metablock_buffer.lba_index_part, this)) {
-                start_existing_state = state_reconstruct;
-                // STATE J
-            } else {
-                // STATE H
-                start_existing_state = state_waiting_for_lba;
-                // STATE I
-                return false;
+                lba_ready = true;
             }
         }
 
         if (start_existing_state == state_reconstruct) {
-            ser->data_block_manager->start_reconstruct();
-            start_existing_state = state_reconstruct_ongoing;
-            next_block_to_reconstruct = 0;
-            // Fall through into state_reconstruct_ongoing
-        }
+            if (reconstruction_scheduled) {
+                // `on_thread_switch()` will get us back here.
+                return false;
+            }
 
-        if (start_existing_state == state_reconstruct_ongoing) {
             int batch = 0;
             while (true) {
-                // Once we are done with the normal blocks, switch over to the aux blocks.
+                if (shard_being_reconstructed == -1) {
+                    if (shards_to_reconstruct.empty()) {
+                        break;
+                    }
+                    shard_being_reconstructed = shards_to_reconstruct.front();
+                    shards_to_reconstruct.pop_front();
+                    next_block_to_reconstruct = shard_being_reconstructed;
+                }
+
+                // Once we are done with the shard's normal blocks, switch over to its
+                // aux blocks.
+                CT_ASSERT(FIRST_AUX_BLOCK_ID % LBA_SHARD_FACTOR == 0);
                 if (!is_aux_block_id(next_block_to_reconstruct)
                     && next_block_to_reconstruct >= ser->lba_index->end_block_id()) {
-                    next_block_to_reconstruct = FIRST_AUX_BLOCK_ID;
+                    next_block_to_reconstruct
+                        = FIRST_AUX_BLOCK_ID + shard_being_reconstructed;
                 }
                 if (next_block_to_reconstruct >= ser->lba_index->end_aux_block_id()) {
-                    break;
+                    shard_being_reconstructed = -1;
+                    continue;
                 }
 
                 flagged_off64_t offset =
@@ -321,13 +336,21 @@ struct ls_start_existing_fsm_t :
                         ser->lba_index->get_block_size(next_block_to_reconstruct));
                 }
 
-                ++next_block_to_reconstruct;
+                next_block_to_reconstruct += LBA_SHARD_FACTOR;
                 ++batch;
                 if (batch >= LBA_RECONSTRUCTION_BATCH_SIZE) {
-                    call_later_on_this_thread(this);
+                    schedule_reconstruction();
                     return false;
                 }
             }
+
+            if (!lba_ready) {
+                // STATE I
+                // Wait for more shards.
+                return false;
+            }
+
+            // STATE J
             ser->data_block_manager->end_reconstruct();
             ser->data_block_manager->start_existing(ser->dbfile, &metablock_buffer.data_block_manager_part);
 
@@ -366,15 +389,33 @@ struct ls_start_existing_fsm_t :
         next_starting_up_step();
     }
 
+    void on_lba_shard_ready(int shard) {
+        rassert(start_existing_state == state_reconstruct);
+        shards_to_reconstruct.push_back(shard);
+        schedule_reconstruction();
+    }
+
     void on_lba_ready() {
-        rassert(start_existing_state == state_waiting_for_lba);
-        start_existing_state = state_reconstruct;
-        next_starting_up_step();
+        rassert(start_existing_state == state_reconstruct);
+        lba_ready = true;
+        schedule_reconstruction();
+    }
+
+    // We don't continue the reconstruction right away, because the LBA calls us
+    // from within `lba_list_t::start_existing()`, and because we want to give other
+    // things on the thread a chance to run in between batches.
+    void schedule_reconstruction() {
+        if (!reconstruction_scheduled) {
+            reconstruction_scheduled = true;
+            call_later_on_this_thread(this);
+        }
     }
 
     void on_thread_switch() {
         // Continue a previously started LBA reconstruction
-        rassert(start_existing_state == state_reconstruct_ongoing);
+        rassert(start_existing_state == state_reconstruct);
+        rassert(reconstruction_scheduled);
+        reconstruction_scheduled = false;
         next_starting_up_step();
     }
 
@@ -388,15 +429,19 @@ struct ls_start_existing_fsm_t :
         state_find_metablock,
         state_waiting_for_metablock,
         state_start_lba,
-        state_waiting_for_lba,
         state_reconstruct,
-        state_reconstruct_ongoing,
         state_finish,
         state_done
     } start_existing_state;
 
-    // When in state_reconstruct_ongoing, we keep track of how many blocks we
-    // already have reconstructed.
+    // When in state_reconstruct, we keep track of the LBA shards that are ready to
+    // be reconstructed, and of how far we got with the current one.  Each shard
+    // holds the blocks whose ids are congruent to the shard modulo
+    // LBA_SHARD_FACTOR.
+    bool lba_ready;
+    bool reconstruction_scheduled;
+    std::deque<int> shards_to_reconstruct;
+    int shard_being_reconstructed;
     block_id_t next_block_to_reconstruct;
 
     bool metablock_found;
@@ -414,6 +459,7 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
       expecting_no_more_tokens(false),
 #endif
       dynamic_config(_dynamic_config),
+      block_compressor(new block_compressor_t(_dynamic_config.block_compression)),
       shutdown_callback(nullptr),
       shutdown_state(shutdown_not_started),
       state(state_unstarted),
@@ -458,8 +504,12 @@ buf_ptr_t log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t>
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
 
-    buf_ptr_t ret = data_block_manager->read(token->offset_, token->block_size(),
+    buf_ptr_t ret = data_block_manager->read(token->offset_, token->disk_block_size(),
                                            io_account);
+    if (token->is_compressed()) {
+        ret = block_compressor->decompress(ret.ser_buffer(), ret.block_size(),
+                                           token->block_size());
+    }
 
     stats->pm_serializer_block_reads.end(&pm_time);
     return ret;
@@ -506,6 +556,8 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
             const index_write_op_t &op = *write_op_it;
             flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
             uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            uint32_t uncompressed_ser_block_size
+                = lba_index->get_block_info(op.block_id).uncompressed_ser_block_size;
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -520,13 +572,18 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->disk_block_size().ser_value();
+                    uncompressed_ser_block_size = token->is_compressed()
+                        ? token->block_size().ser_value()
+                        : 0;
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(),
+                                                  token->disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    uncompressed_ser_block_size = 0;
                 }
             }
 
@@ -535,6 +592,7 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
 
             lba_index->set_block_info(op.block_id, recency,
                                       offset, ser_block_size,
+                                      uncompressed_ser_block_size,
                                       index_writes_io_account.get(), &txn);
         }
     }
@@ -545,7 +603,9 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
     // Before we fully commit the write to disk, we must migrate the static header
     // if necessary.
     // Note that this is early enough for upgrading from the 1.13 serializer
-    // version to 2.2, since only the format of the LBA changed.
+    // version to 2.2, since only the format of the LBA changed.  The same goes for
+    // 2.2 to 2.5: compressed blocks and btree nodes with key prefixes, which older
+    // versions can't read, only become reachable through this index write.
     // Future serializer format changes might require this step to happen earlier.
     {
         new_mutex_acq_t acq(&static_header_migration_mutex);
@@ -662,9 +722,11 @@ void log_serializer_t::write_metablock_sans_pipelining(const signal_t *safe_to_w
 }
 
 counted_t<ls_block_token_pointee_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t disk_block_size) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(
+        new ls_block_token_pointee_t(this, offset, block_size, disk_block_size));
     return ret;
 }
 
@@ -674,9 +736,57 @@ log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
     assert_thread();
     stats->pm_serializer_block_writes += write_infos.size();
 
+    if (dynamic_config.block_compression == block_compression_t::none) {
+        std::vector<counted_t<ls_block_token_pointee_t> > result
+            = data_block_manager->many_writes(write_infos, io_account, cb);
+        guarantee(result.size() == write_infos.size());
+        return result;
+    }
+
+    // The compressed copies of the blocks have to stay around until they have been
+    // written, so they belong to the callback.
+    struct compressed_writes_cb_t : public iocallback_t {
+        void on_io_complete() {
+            iocallback_t *local_cb = cb;
+            delete this;
+            local_cb->on_io_complete();
+        }
+
+        std::vector<buf_ptr_t> compressed_bufs;
+        iocallback_t *cb;
+    };
+
+    compressed_writes_cb_t *const compressed_cb = new compressed_writes_cb_t;
+    compressed_cb->cb = cb;
+
+    std::vector<buf_write_info_t> disk_write_infos;
+    disk_write_infos.reserve(write_infos.size());
+    for (const buf_write_info_t &info : write_infos) {
+        // `many_writes` does this for the buffers it actually writes, but the
+        // caller might rely on it for the uncompressed buffer too.
+        info.buf->ser_header.block_id = info.block_id;
+        buf_ptr_t compressed = block_compressor->compress(info.buf, info.block_size);
+        if (compressed.has()) {
+            disk_write_infos.push_back(buf_write_info_t(compressed.ser_buffer(),
+                                                        compressed.block_size(),
+                                                        info.block_id));
+            compressed_cb->compressed_bufs.push_back(std::move(compressed));
+        } else {
+            disk_write_infos.push_back(info);
+        }
+    }
+
     std::vector<counted_t<ls_block_token_pointee_t> > result
-        = data_block_manager->many_writes(write_infos, io_account, cb);
+        = data_block_manager->many_writes(disk_write_infos, io_account, compressed_cb);
     guarantee(result.size() == write_infos.size());
+
+    // The tokens describe what was written to disk.  Tell them how big the blocks
+    // really are.
+    for (size_t i = 0; i < result.size(); ++i) {
+        if (disk_write_infos[i].block_size != write_infos[i].block_size) {
+            result[i]->block_size_ = write_infos[i].block_size;
+        }
+    }
     return result;
 }
 
@@ -808,7 +918,10 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token(
+            info.offset.get_value(),
+            block_size_t::unsafe_make(info.logical_ser_block_size()),
+            block_size_t::unsafe_make(info.ser_block_size));
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -1002,9 +1115,11 @@ bool log_serializer_t::should_perform_read_ahead() {
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_disk_block_size)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size), disk_block_size_(initial_disk_block_size),
+      offset_(initial_offset) {
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
@@ -1019,8 +1134,9 @@ void ls_block_token_pointee_t::do_destroy() {
 void debug_print(printf_buffer_t *buf,
                  const counted_t<ls_block_token_pointee_t> &token) {
     if (token.has()) {
-        buf->appendf("ls_block_token{%" PRIi64 ", +%" PRIu32 "}",
-                     token->offset(), token->block_size().ser_value());
+        buf->appendf("ls_block_token{%" PRIi64 ", +%" PRIu32 " (%" PRIu32 " on disk)}",
+                     token->offset(), token->block_size().ser_value(),
+                     token->disk_block_size().ser_value());
     } else {
         buf->appendf("nil");
     }
@@ -102,6 +102,7 @@ private:
 
 // Used internally
 struct ls_start_existing_fsm_t;
+class block_compressor_t;
 
 class log_serializer_t :
 #ifndef SEMANTIC_SERIALIZER_CHECK
@@ -170,7 +171,8 @@ private:
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+                                                             block_size_t block_size,
+                                                             block_size_t disk_block_size);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
@@ -232,6 +234,8 @@ private:
     const dynamic_config_t dynamic_config;
     static_config_t static_config;
 
+    scoped_ptr_t<block_compressor_t> block_compressor;
+
     cond_t *shutdown_callback;
 
     enum shutdown_state_t {
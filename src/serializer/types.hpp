@@ -136,9 +136,14 @@ class ls_block_token_pointee_t {
 public:
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
+    block_size_t disk_block_size() const { return disk_block_size_; }
+    bool is_compressed() const {
+        return block_size_ != disk_block_size_;
+    }
 
 private:
     friend class log_serializer_t;
+    friend class data_block_manager_t;  // For fixing up tokens of compressed blocks.
     friend class dbm_read_ahead_fsm_t;  // For read-ahead tokens.
 
     friend void counted_add_ref(ls_block_token_pointee_t *p);
@@ -146,14 +151,19 @@ private:
 
     ls_block_token_pointee_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_ser_block_size);
+                             block_size_t initial_block_size,
+                             block_size_t initial_disk_block_size);
 
     log_serializer_t *serializer_;
     std::atomic<intptr_t> ref_count_;
 
-    // The block's size.
+    // The block's size, as seen by the cache.
     block_size_t block_size_;
 
+    // The number of bytes the block takes up on disk.  This is smaller than
+    // `block_size_` if the block has been stored compressed.
+    block_size_t disk_block_size_;
+
     // The block's offset on disk.
     int64_t offset_;
 
@@ -0,0 +1,99 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "btree/key_filter.hpp"
+#include "containers/bloom_filter.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+uint64_t hash_of(const std::string &s) {
+    return bloom_filter_t::hash(s.data(), s.size());
+}
+
+TEST(BloomFilterTest, FalsePositiveRate) {
+    const int num_items = 100000;
+    bloom_filter_t filter(num_items);
+    for (int i = 0; i < num_items; ++i) {
+        filter.insert(hash_of(strprintf("item %d", i)));
+    }
+    for (int i = 0; i < num_items; ++i) {
+        ASSERT_TRUE(filter.may_contain(hash_of(strprintf("item %d", i))));
+    }
+    EXPECT_GT(filter.fill_ratio(), 0.4);
+    EXPECT_LT(filter.fill_ratio(), 0.6);
+
+    int false_positives = 0;
+    for (int i = 0; i < num_items; ++i) {
+        if (filter.may_contain(hash_of(strprintf("other item %d", i)))) {
+            ++false_positives;
+        }
+    }
+    // We aim for about 1%.
+    EXPECT_LT(false_positives, num_items / 50);
+}
+
+TEST(BloomFilterTest, KeyFilterRebuild) {
+    const size_t budget = KEY_FILTER_MAX_SIZE;
+    btree_key_filter_t filter;
+    store_key_t old_key("old"), written_key("written"), missing_key("missing");
+
+    // Without a filter, every key may be present.
+    EXPECT_FALSE(filter.is_active());
+    EXPECT_TRUE(filter.needs_rebuild(budget));
+    EXPECT_TRUE(filter.may_contain(missing_key.btree_key()));
+
+    // Keys written while the rebuild is in progress must end up in the filter, even
+    // before the filter has been sized.
+    filter.start_rebuild();
+    EXPECT_FALSE(filter.needs_rebuild(budget));
+    filter.note_key_written(written_key.btree_key());
+    ASSERT_TRUE(filter.set_rebuild_size(1, budget));
+    filter.add_existing_key(old_key.btree_key());
+    EXPECT_FALSE(filter.is_active());
+    filter.finish_rebuild();
+
+    EXPECT_TRUE(filter.is_active());
+    EXPECT_FALSE(filter.needs_rebuild(budget));
+    EXPECT_EQ(bloom_filter_t::memory_usage(KEY_FILTER_MIN_KEYS), filter.memory_usage());
+    EXPECT_TRUE(filter.may_contain(old_key.btree_key()));
+    EXPECT_TRUE(filter.may_contain(written_key.btree_key()));
+    EXPECT_FALSE(filter.may_contain(missing_key.btree_key()));
+
+    // The old filter stays in use until its replacement is complete.
+    filter.request_rebuild();
+    EXPECT_TRUE(filter.needs_rebuild(budget));
+    filter.start_rebuild();
+    ASSERT_TRUE(filter.set_rebuild_size(1, budget));
+    EXPECT_EQ(2 * bloom_filter_t::memory_usage(KEY_FILTER_MIN_KEYS),
+              filter.memory_usage());
+    filter.abort_rebuild();
+    EXPECT_TRUE(filter.may_contain(old_key.btree_key()));
+    EXPECT_FALSE(filter.may_contain(missing_key.btree_key()));
+
+    // A filter that no longer fits into its budget gets dropped.
+    const size_t small_budget = bloom_filter_t::memory_usage(KEY_FILTER_MIN_KEYS) - 1;
+    EXPECT_FALSE(filter.needs_rebuild(budget));
+    EXPECT_TRUE(filter.needs_rebuild(small_budget));
+    filter.start_rebuild();
+    EXPECT_FALSE(filter.set_rebuild_size(1, small_budget));
+    filter.finish_rebuild();
+    EXPECT_FALSE(filter.is_active());
+    EXPECT_EQ(0u, filter.memory_usage());
+    EXPECT_FALSE(filter.needs_rebuild(small_budget));
+    EXPECT_TRUE(filter.may_contain(missing_key.btree_key()));
+
+    // Once the budget grows again, the filter gets another try.
+    EXPECT_TRUE(filter.needs_rebuild(budget));
+
+    // Tables that are too large don't get a filter, no matter the budget.
+    filter.start_rebuild();
+    EXPECT_FALSE(filter.set_rebuild_size(KEY_FILTER_MAX_SIZE, 2 * budget));
+    filter.finish_rebuild();
+    EXPECT_FALSE(filter.is_active());
+    EXPECT_FALSE(filter.needs_rebuild(2 * budget));
+    EXPECT_TRUE(filter.may_contain(missing_key.btree_key()));
+}
+
+}  // namespace unittest
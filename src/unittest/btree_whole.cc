@@ -504,4 +504,31 @@ TPTEST(BTree, RemoveRandomOrder) {
     ctx.verify();
 }
 
+// Long keys with a long common prefix, so that the internal nodes store keys after
+// a prefix, and some without it, so that they also store some keys in full.
+TPTEST(BTree, RemoveWithSharedPrefixes) {
+    BTreeTestContext ctx;
+    rng_t rng;
+
+    const std::string prefix(200, 'p');
+    for (int i = 0; i < 3000; i++) {
+        std::string key = rng.randint(10) == 0
+            ? random_letter_string(&rng, 1, 250)
+            : prefix + random_letter_string(&rng, 1, 50);
+        ctx.set(store_key_t(key), random_letter_string(&rng, 0, 10));
+    }
+
+    ctx.verify();
+
+    while (!ctx.is_empty()) {
+        ctx.remove(ctx.pick_random_key(&rng));
+
+        if (rng.randint(200) == 0) {
+            ctx.verify();
+        }
+    }
+
+    ctx.verify();
+}
+
 } // namespace unittest
@@ -0,0 +1,127 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/compiled_expr.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/val.hpp"
+#include "rdb_protocol/wire_func.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Formats the result of `fn`, or the error it throws, for comparing.
+template <class fn_t>
+std::string result_or_error(fn_t &&fn) {
+    try {
+        return "value: " + fn().print();
+    } catch (const ql::base_exc_t &e) {
+        return std::string("error: ") + e.what();
+    }
+}
+
+/* Checks that `body`, a function of `x`, gives the same result for `arg` through the
+compiled code as through the term tree.  `compiled` says whether the compiled code
+evaluates `arg` itself, or gives up and leaves it to the term tree. */
+void check_compiled_expr(ql::env_t *env,
+                         const ql::raw_term_t &body,
+                         ql::sym_t x,
+                         const ql::datum_t &arg,
+                         bool compiled) {
+    SCOPED_TRACE(arg.print());
+    const std::vector<ql::sym_t> arg_names{x};
+
+    scoped_ptr_t<ql::compiled_expr_t> expr =
+        ql::compiled_expr_t::compile(body, x, false);
+    ASSERT_TRUE(expr.has());
+    ql::datum_t compiled_res;
+    ASSERT_EQ(compiled, expr->eval(arg, env->limits(), &compiled_res));
+
+    ql::compile_env_t compile_env(
+        ql::var_visibility_t().with_func_arg_name_list(arg_names));
+    counted_t<const ql::term_t> term = ql::compile_term(&compile_env, body);
+    const std::string term_res = result_or_error([&]() {
+        ql::scope_env_t scope_env(
+            env,
+            ql::var_scope_t().with_func_arg_list(
+                arg_names, std::vector<ql::datum_t>{arg}));
+        return term->eval(&scope_env)->as_datum();
+    });
+    if (compiled) {
+        EXPECT_EQ("value: " + compiled_res.print(), term_res);
+    }
+
+    // The function takes the compiled code when it can and falls back to the term
+    // tree otherwise, which must not make any difference.
+    counted_t<const ql::func_t> func =
+        ql::wire_func_t(body, arg_names).compile_wire_func();
+    EXPECT_EQ(term_res, result_or_error([&]() {
+        return func->call(env, arg)->as_datum();
+    }));
+}
+
+ql::datum_t object_with(const char *field, ql::datum_t value) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite(field, std::move(value));
+    return std::move(builder).to_datum();
+}
+
+TPTEST(CompiledExprTest, FallsBackLikeTheTermTree) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::NO,
+                  reql_version_t::LATEST);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    const ql::sym_t x(1);
+
+    ql::minidriver_t::reql_t plus_one = r.var(x)["a"] + 1.0;
+    ql::minidriver_t::reql_t plus_b = r.var(x)["a"] + r.var(x)["b"];
+    ql::minidriver_t::reql_t times_big = r.var(x)["a"].call(Term::MUL, 1e300);
+    ql::minidriver_t::reql_t over_zero = r.var(x)["a"] / 0.0;
+    ql::minidriver_t::reql_t less = r.var(x)["a"] < 5.0;
+    ql::minidriver_t::reql_t with_default = (r.var(x)["a"] + 1.0).default_(0.0);
+
+    // Plain numbers are handled by the compiled code.
+    const ql::datum_t one = object_with("a", ql::datum_t(1.0));
+    check_compiled_expr(&env, plus_one.root_term(), x, one, true);
+    check_compiled_expr(&env, less.root_term(), x, one, true);
+    check_compiled_expr(&env, with_default.root_term(), x, one, true);
+
+    // Missing fields.
+    const ql::datum_t empty = ql::datum_t::empty_object();
+    check_compiled_expr(&env, plus_one.root_term(), x, empty, false);
+    check_compiled_expr(&env, less.root_term(), x, empty, false);
+    check_compiled_expr(&env, with_default.root_term(), x, empty, false);
+    check_compiled_expr(&env, plus_one.root_term(), x, ql::datum_t(1.0), false);
+
+    // Pseudotypes.
+    const ql::datum_t time =
+        object_with("a", ql::pseudo::make_time(1000, "+00:00"));
+    check_compiled_expr(&env, plus_one.root_term(), x, time, false);
+    check_compiled_expr(&env, plus_one.root_term(), x,
+                        ql::pseudo::make_time(1000, "+00:00"), false);
+
+    // Non-numbers in arithmetic.
+    ql::datum_object_builder_t strings;
+    strings.overwrite("a", ql::datum_t("a"));
+    strings.overwrite("b", ql::datum_t("b"));
+    check_compiled_expr(&env, plus_b.root_term(), x,
+                        std::move(strings).to_datum(), false);
+    const ql::datum_t str = object_with("a", ql::datum_t("a"));
+    check_compiled_expr(&env, plus_one.root_term(), x, str, false);
+    check_compiled_expr(&env, with_default.root_term(), x, str, false);
+
+    // Non-finite results.
+    const ql::datum_t big = object_with("a", ql::datum_t(1e300));
+    check_compiled_expr(&env, times_big.root_term(), x, big, false);
+    check_compiled_expr(&env, over_zero.root_term(), x, one, false);
+    check_compiled_expr(&env, over_zero.root_term(), x,
+                        object_with("a", ql::datum_t(0.0)), false);
+}
+
+}  // namespace unittest
@@ -146,6 +146,37 @@ TEST(DatumTest, ObjectSerialization) {
     }
 }
 
+TEST(DatumTest, BufferFieldLookup) {
+    std::map<datum_string_t, ql::datum_t> fields;
+    for (int i = 0; i < 100; ++i) {
+        fields[datum_string_t(strprintf("f%d", i))] = ql::datum_t(static_cast<double>(i));
+    }
+    fields[datum_string_t("f")] = ql::datum_t(datum_string_t("short"));
+    fields[datum_string_t("nested")] = ql::datum_t(std::map<datum_string_t, ql::datum_t>
+        {std::make_pair(datum_string_t("a"), ql::datum_t::null())});
+    ql::datum_t test_object(std::move(fields));
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, test_object);
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    ql::datum_t buf_object;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::LATEST_OVERALL>(&read_stream, &buf_object));
+    ASSERT_TRUE(buf_object.get_buf_ref() != nullptr);
+
+    for (size_t i = 0; i < test_object.obj_size(); ++i) {
+        auto pair = test_object.get_pair(i);
+        ASSERT_EQ(pair.second, buf_object.get_field(pair.first));
+        ASSERT_EQ(pair.second, buf_object.get_field(pair.first.to_std().c_str()));
+    }
+    ASSERT_FALSE(buf_object.get_field("", ql::NOTHROW).has());
+    ASSERT_FALSE(buf_object.get_field("f100", ql::NOTHROW).has());
+    ASSERT_FALSE(buf_object.get_field("zzz", ql::NOTHROW).has());
+    ASSERT_FALSE(test_object.get_field("f1000", ql::NOTHROW).has());
+}
+
 TEST(DatumTest, ArraySerialization) {
     {
         ql::datum_t test_array(
@@ -1,7 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdio.h>
+
+#include <functional>
 #include <queue>
 
 #include "arch/io/disk.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/queue/disk_backed_queue_wrapper.hpp"
@@ -46,9 +50,13 @@ TEST(DiskBackedQueue, ManyInts) {
     unittest::run_in_thread_pool(&run_many_ints_test, 2);
 }
 
-void run_big_values_test() {
+void run_big_values_test(file_io_backend_t io_backend) {
     static const int NUM_BIG_ELTS_IN_QUEUE = 100;
-    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                                io_backend);
+    ASSERT_EQ(io_backend == file_io_backend_t::io_uring_desired,
+              io_backender.uses_io_uring());
 
     const serializer_filepath_t serializer_path = dbq_serializer_path();
 
@@ -72,7 +80,24 @@ void run_big_values_test() {
 }
 
 TEST(DiskBackedQueue, BigVals) {
-    unittest::run_in_thread_pool(&run_big_values_test, 2);
+    unittest::run_in_thread_pool(
+        std::bind(&run_big_values_test, file_io_backend_t::pool), 2);
+}
+
+TEST(DiskBackedQueue, BigValsIoUring) {
+#if USE_IO_URING
+    if (!uring_diskmgr_t::is_supported()) {
+        // Our version of gtest can't mark tests as skipped.
+        fprintf(stderr, "SKIPPED: DiskBackedQueue.BigValsIoUring, because this kernel "
+                "doesn't support io_uring.\n");
+        return;
+    }
+    unittest::run_in_thread_pool(
+        std::bind(&run_big_values_test, file_io_backend_t::io_uring_desired), 2);
+#else
+    fprintf(stderr, "SKIPPED: DiskBackedQueue.BigValsIoUring, because io_uring isn't "
+            "available on this platform.\n");
+#endif
 }
 
 static void randomly_delay(int, signal_t *) {
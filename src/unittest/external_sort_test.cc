@@ -0,0 +1,120 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <functional>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/datum_stream/external_sort.hpp"
+#include "rdb_protocol/env.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Orders `[key, sequence number]` pairs by their key only.
+bool key_lt(ql::env_t *, profile::sampler_t *,
+            const ql::datum_t &l, const ql::datum_t &r) {
+    return l.get(0).as_num() < r.get(0).as_num();
+}
+
+ql::datum_t keyed_datum(int key, int seq) {
+    return ql::datum_t(
+        std::vector<ql::datum_t>{
+            ql::datum_t(static_cast<double>(key)),
+            ql::datum_t(static_cast<double>(seq))},
+        ql::configured_limits_t::unlimited);
+}
+
+void run_external_sort_test(const std::vector<int> &run_sizes) {
+    recreate_temporary_directory(base_path_t("."));
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::NO,
+                  reql_version_t::LATEST);
+
+    const int num_keys = 17;
+    counted_t<ql::external_sort_datum_stream_t> stream =
+        make_counted<ql::external_sort_datum_stream_t>(
+            &io_backender, base_path_t("."), &key_lt, ql::backtrace_id_t::empty());
+    int seq = 0;
+    for (int run_size : run_sizes) {
+        std::vector<ql::datum_t> run;
+        for (int j = 0; j < run_size; ++j, ++seq) {
+            run.push_back(keyed_datum((seq * 7) % num_keys, seq));
+        }
+        stream->add_run(&env, std::move(run));
+    }
+    ASSERT_EQ(seq == 0, stream->is_exhausted());
+
+    std::vector<ql::datum_t> out;
+    for (;;) {
+        std::vector<ql::datum_t> batch = stream->next_batch(
+            &env, ql::batchspec_t::default_for(ql::batch_type_t::NORMAL));
+        if (batch.empty()) {
+            break;
+        }
+        std::move(batch.begin(), batch.end(), std::back_inserter(out));
+    }
+    EXPECT_TRUE(stream->is_exhausted());
+
+    ASSERT_EQ(static_cast<size_t>(seq), out.size());
+    // Every element comes out exactly once.
+    std::vector<bool> seen(seq, false);
+    for (const ql::datum_t &d : out) {
+        const int s = static_cast<int>(d.get(1).as_num());
+        ASSERT_FALSE(seen[s]);
+        seen[s] = true;
+    }
+    for (size_t i = 1; i < out.size(); ++i) {
+        const double prev_key = out[i - 1].get(0).as_num();
+        const double key = out[i].get(0).as_num();
+        ASSERT_LE(prev_key, key);
+        if (prev_key == key) {
+            // The sort must be stable.
+            ASSERT_LT(out[i - 1].get(1).as_num(), out[i].get(1).as_num());
+        }
+    }
+}
+
+std::vector<int> equal_runs(int num_runs) {
+    return std::vector<int>(num_runs, 50);
+}
+
+TEST(ExternalSortTest, SortsStably) {
+    // Enough runs that some of them have to be merged before the final merge.
+    run_in_thread_pool(std::bind(&run_external_sort_test,
+                                 equal_runs(2 * EXTERNAL_SORT_MAX_RUNS + 3)));
+}
+
+TEST(ExternalSortTest, SortsStablyAcrossLevels) {
+    // Enough runs that merged runs get merged again, and that there are runs on
+    // several levels left for the final merge.
+    run_in_thread_pool(std::bind(
+        &run_external_sort_test,
+        equal_runs(EXTERNAL_SORT_MAX_RUNS * EXTERNAL_SORT_MAX_RUNS
+                   + 3 * EXTERNAL_SORT_MAX_RUNS + 5)));
+}
+
+TEST(ExternalSortTest, MergesFewRuns) {
+    // Nothing is merged before the stream is read.
+    run_in_thread_pool(std::bind(&run_external_sort_test, equal_runs(0)));
+    run_in_thread_pool(std::bind(&run_external_sort_test, equal_runs(1)));
+    run_in_thread_pool(std::bind(&run_external_sort_test,
+                                 equal_runs(EXTERNAL_SORT_MAX_RUNS - 1)));
+    // The runs get merged once as the last one is added.
+    run_in_thread_pool(std::bind(&run_external_sort_test,
+                                 equal_runs(EXTERNAL_SORT_MAX_RUNS)));
+}
+
+TEST(ExternalSortTest, MergesUnevenRuns) {
+    // Runs of different sizes, some of them empty or much longer than a batch, which
+    // exercises the merge as heads run out at different times.
+    std::vector<int> run_sizes;
+    for (size_t i = 0; i < 3 * EXTERNAL_SORT_MAX_RUNS + 1; ++i) {
+        run_sizes.push_back((i * 37) % 11 == 0 ? 0 : static_cast<int>((i * 389) % 2000));
+    }
+    run_in_thread_pool(std::bind(&run_external_sort_test, run_sizes));
+}
+
+}  // namespace unittest
@@ -0,0 +1,67 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/datum_utils.hpp"
+#include "rdb_protocol/group_table.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(GroupTableTest, HashMatchesEquality) {
+    EXPECT_EQ(ql::hash_datum(ql::datum_t(0.0)), ql::hash_datum(ql::datum_t(-0.0)));
+    EXPECT_NE(ql::hash_datum(ql::datum_t(1.0)), ql::hash_datum(ql::datum_t(2.0)));
+    EXPECT_NE(ql::hash_datum(ql::datum_t(1.0)), ql::hash_datum(ql::datum_t("1")));
+
+    // Times are equal if they're the same instant, whatever their time zone.
+    ql::datum_t utc = ql::pseudo::make_time(1000, "+00:00");
+    ql::datum_t pst = ql::pseudo::make_time(1000, "-08:00");
+    ASSERT_EQ(utc, pst);
+    EXPECT_EQ(ql::hash_datum(utc), ql::hash_datum(pst));
+
+    ql::datum_object_builder_t a, b;
+    a.overwrite("x", ql::datum_t(1.0));
+    a.overwrite("y", ql::datum_t(0.0));
+    b.overwrite("y", ql::datum_t(-0.0));
+    b.overwrite("x", ql::datum_t(1.0));
+    EXPECT_EQ(ql::hash_datum(std::move(a).to_datum()),
+              ql::hash_datum(std::move(b).to_datum()));
+}
+
+TEST(GroupTableTest, InsertAndErase) {
+    ql::group_table_t<int> table;
+    std::map<ql::datum_t, int, optional_datum_less_t> expected;
+    const int num_groups = 1000;
+    for (int i = 0; i < 3 * num_groups; ++i) {
+        ql::datum_t key(static_cast<double>(i % num_groups));
+        bool inserted;
+        int *count = table.find_or_insert(key, 0, &inserted);
+        EXPECT_EQ(i < num_groups, inserted);
+        ++*count;
+        ++expected[key];
+    }
+
+    // The ungrouped key is distinct from every datum.
+    bool inserted;
+    *table.find_or_insert(ql::datum_t(), 0, &inserted) = -1;
+    EXPECT_TRUE(inserted);
+    expected[ql::datum_t()] = -1;
+
+    // Erasing the last insertion leaves the other groups reachable.
+    table.find_or_insert(ql::datum_t("gone"), 0, &inserted);
+    EXPECT_TRUE(inserted);
+    table.erase_last();
+
+    ASSERT_EQ(expected.size(), table.size());
+    for (auto &&kv : expected) {
+        EXPECT_EQ(kv.second, *table.find_or_insert(kv.first, 0, &inserted));
+        EXPECT_FALSE(inserted);
+    }
+    table.find_or_insert(ql::datum_t("gone"), 0, &inserted);
+    EXPECT_TRUE(inserted);
+}
+
+}  // namespace unittest
@@ -1,5 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include <algorithm>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "unittest/gtest.hpp"
@@ -48,7 +50,7 @@ void verify(block_size_t block_size, const internal_node_t *buf) {
         const btree_key_t *next_key = &pair->key;
 
         if (last_key != nullptr) {
-            EXPECT_LT(internal_key_comp::compare(last_key, next_key), 0);
+            EXPECT_LT(btree_key_cmp(last_key, next_key), 0);
         }
 
         last_key = next_key;
@@ -70,6 +72,111 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+// Checks that `node`'s keys are `keys`, in order, and that searches find them.  Unlike
+// `verify()`, this works on nodes with a key prefix, whose pairs might only store
+// the rest of their keys.
+void verify_keys(const internal_node_t *node, const std::set<store_key_t> &keys) {
+    EXPECT_TRUE(node->magic == internal_node_t::expected_magic
+                || node->magic == internal_node_t::key_prefix_magic);
+    ASSERT_EQ(static_cast<int>(keys.size()) + 1, node->npairs);
+    int i = 0;
+    for (const store_key_t &key : keys) {
+        EXPECT_EQ(key, internal_node::get_key_by_index(node, i));
+        EXPECT_EQ(i, internal_node::get_offset_index(node, key.btree_key()));
+        store_key_t after = key;
+        after.increment();
+        EXPECT_EQ(i + 1, internal_node::get_offset_index(node, after.btree_key()));
+        ++i;
+    }
+    for (const std::string &probe : { std::string(), std::string("a"),
+                                      std::string("table/"), std::string("table0"),
+                                      std::string("z") }) {
+        store_key_t key(probe);
+        int expected = std::distance(keys.begin(), keys.lower_bound(key));
+        EXPECT_EQ(expected, internal_node::get_offset_index(node, key.btree_key()));
+    }
+}
+
+store_key_t prefixed_key(int i) {
+    return store_key_t(strprintf("table/0123456789abcdef0123456789abcdef/%06d", i));
+}
+
+TEST(InternalNodeTest, KeyPrefix) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    internal_node::init(bs, node.get());
+
+    // Without a prefix, only about 70 of these keys would fit into a node.
+    std::set<store_key_t> keys;
+    block_id_t next_block = 1;
+    for (int i = 0; i < 150; ++i) {
+        store_key_t key = prefixed_key(i * 7 % 1000);
+        ASSERT_TRUE(internal_node::insert(bs, node.get(), key.btree_key(), next_block,
+                                          next_block + 1));
+        next_block += 2;
+        keys.insert(key);
+    }
+    EXPECT_TRUE(node->magic == internal_node_t::key_prefix_magic);
+    verify_keys(node.get(), keys);
+
+    // Keys that don't start with the prefix get stored in full.
+    for (const char *s : { "a", "table/", "z" }) {
+        store_key_t key(s);
+        ASSERT_TRUE(internal_node::insert(bs, node.get(), key.btree_key(), next_block,
+                                          next_block + 1));
+        next_block += 2;
+        keys.insert(key);
+        verify_keys(node.get(), keys);
+    }
+
+    scoped_malloc_t<internal_node_t> rnode(bs.value());
+    store_key_t median;
+    internal_node::split(bs, node.get(), rnode.get(), median.btree_key());
+    std::set<store_key_t> left_keys(keys.begin(), keys.upper_bound(median));
+    left_keys.erase(median);
+    std::set<store_key_t> right_keys(keys.upper_bound(median), keys.end());
+    verify_keys(node.get(), left_keys);
+    verify_keys(rnode.get(), right_keys);
+
+    store_key_t replaced = *left_keys.rbegin();
+    store_key_t replacement = replaced;
+    replacement.increment();
+    internal_node::update_key(bs, node.get(), replaced.btree_key(),
+                              replacement.btree_key());
+    left_keys.erase(replaced);
+    left_keys.insert(replacement);
+    verify_keys(node.get(), left_keys);
+
+    internal_node::remove(bs, rnode.get(), right_keys.begin()->btree_key());
+    right_keys.erase(right_keys.begin());
+    verify_keys(rnode.get(), right_keys);
+}
+
+// Nodes whose keys don't share a prefix keep the old layout.
+TEST(InternalNodeTest, NoKeyPrefix) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    internal_node::init(bs, node.get());
+
+    std::set<store_key_t> keys;
+    block_id_t next_block = 1;
+    for (int i = 0; i < 26; ++i) {
+        store_key_t key(std::string(1, 'a' + i) + strprintf("%03d", i));
+        ASSERT_TRUE(internal_node::insert(bs, node.get(), key.btree_key(), next_block,
+                                          next_block + 1));
+        next_block += 2;
+        keys.insert(key);
+        verify(bs, node.get());
+    }
+    verify_keys(node.get(), keys);
+
+    scoped_malloc_t<internal_node_t> rnode(bs.value());
+    store_key_t median;
+    internal_node::split(bs, node.get(), rnode.get(), median.btree_key());
+    verify(bs, node.get());
+    verify(bs, rnode.get());
+}
+
 
 }  // namespace unittest
 
@@ -0,0 +1,198 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree/internal_node.hpp"
+#include "btree/keys.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "random.hpp"
+#include "time.hpp"
+#include "unittest/btree_utils.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Keys made of few distinct characters, so that comparisons often have to look
+// past the first eight bytes and at the zero padding of `key_head`.
+store_key_t random_search_key(rng_t *rng) {
+    static const uint8_t chars[] = { 0, 1, 'a', 255 };
+    int size = rng->randint(14);
+    std::string s;
+    for (int i = 0; i < size; ++i) {
+        s.push_back(chars[rng->randint(sizeof(chars))]);
+    }
+    return store_key_t(s);
+}
+
+// Keys that look like the primary keys of a typical table.
+store_key_t random_document_key(rng_t *rng) {
+    return store_key_t(strprintf("S%08x-%04x-%04x",
+                                 rng->randint(1 << 30), rng->randint(1 << 16),
+                                 rng->randint(1 << 16)));
+}
+
+int sign(int x) {
+    return x < 0 ? -1 : (x > 0 ? 1 : 0);
+}
+
+TEST(KeySearchTest, HeadComparison) {
+    rng_t rng(0);
+    for (int i = 0; i < 100000; ++i) {
+        store_key_t a = random_search_key(&rng);
+        store_key_t b = random_search_key(&rng);
+        uint64_t head_a = key_head(a.contents(), a.size());
+        uint64_t head_b = key_head(b.contents(), b.size());
+        int expected = sign(sized_strcmp(a.contents(), a.size(),
+                                         b.contents(), b.size()));
+        ASSERT_EQ(expected, sign(sized_strcmp_with_head(
+            head_a, a.contents(), a.size(), b.contents(), b.size())));
+        if (head_a != head_b) {
+            ASSERT_EQ(expected, head_a < head_b ? -1 : 1);
+        }
+    }
+}
+
+void fill_internal_node(block_size_t bs, internal_node_t *node,
+                        store_key_t (*make_key)(rng_t *), rng_t *rng,
+                        std::set<store_key_t> *keys_out) {
+    internal_node::init(bs, node);
+    block_id_t next_block = 1;
+    for (;;) {
+        store_key_t key = make_key(rng);
+        if (key.size() == 0 || keys_out->count(key) != 0) {
+            continue;
+        }
+        if (!internal_node::insert(bs, node, key.btree_key(), next_block,
+                                   next_block + 1)) {
+            break;
+        }
+        next_block += 2;
+        keys_out->insert(key);
+    }
+}
+
+TEST(KeySearchTest, InternalNodeOffsetIndex) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    rng_t rng(0);
+    std::set<store_key_t> keys;
+    fill_internal_node(bs, node.get(), &random_search_key, &rng, &keys);
+    ASSERT_EQ(static_cast<int>(keys.size()) + 1, node->npairs);
+
+    for (int i = 0; i < 10000; ++i) {
+        store_key_t key = random_search_key(&rng);
+        int expected = std::distance(keys.begin(), keys.lower_bound(key));
+        ASSERT_EQ(expected, internal_node::get_offset_index(node.get(),
+                                                            key.btree_key()));
+    }
+}
+
+// These are not really unit tests, but micro benchmarks comparing node searches
+// against a plain binary search that calls `memcmp` on every probe.  No need to
+// run them in debug mode.
+#ifdef NDEBUG
+const int NUM_SEARCHES = 2000000;
+
+TEST(KeySearchTest, InternalNodeBenchmark) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    rng_t rng(0);
+    std::set<store_key_t> keys;
+    fill_internal_node(bs, node.get(), &random_document_key, &rng, &keys);
+
+    std::vector<store_key_t> probes;
+    for (int i = 0; i < 1024; ++i) {
+        probes.push_back(random_document_key(&rng));
+    }
+    // The node might store its keys after a prefix, so the plain search runs on
+    // a copy of them.
+    std::vector<store_key_t> node_keys(keys.begin(), keys.end());
+
+    int sum = 0;
+    ticks_t start_ticks = get_ticks();
+    for (int i = 0; i < NUM_SEARCHES; ++i) {
+        const btree_key_t *key = probes[i % probes.size()].btree_key();
+        int beg = 0;
+        int end = node->npairs - 1;
+        while (beg < end) {
+            int test_point = beg + (end - beg) / 2;
+            if (btree_key_cmp(key, node_keys[test_point].btree_key()) > 0) {
+                beg = test_point + 1;
+            } else {
+                end = test_point;
+            }
+        }
+        sum += beg;
+    }
+    double dur_base = ticks_to_secs(get_ticks() - start_ticks);
+
+    int head_sum = 0;
+    start_ticks = get_ticks();
+    for (int i = 0; i < NUM_SEARCHES; ++i) {
+        const btree_key_t *key = probes[i % probes.size()].btree_key();
+        head_sum += internal_node::get_offset_index(node.get(), key);
+    }
+    double dur = ticks_to_secs(get_ticks() - start_ticks);
+    EXPECT_EQ(sum, head_sum);
+
+    printf("Internal node with %d keys: %f ns per search, %f ns with memcmp\n",
+           node->npairs, dur / NUM_SEARCHES * 1e9, dur_base / NUM_SEARCHES * 1e9);
+}
+
+TEST(KeySearchTest, LeafNodeBenchmark) {
+    max_block_size_t bs = max_block_size_t::unsafe_make(4096);
+    short_value_sizer_t sizer(bs);
+    scoped_malloc_t<leaf_node_t> node(bs.value());
+    leaf::init(&sizer, node.get());
+    rng_t rng(0);
+    std::vector<store_key_t> keys;
+    short_value_buffer_t value(std::string("v"));
+    for (;;) {
+        store_key_t key = random_document_key(&rng);
+        if (leaf::is_full(&sizer, node.get(), key.btree_key(), value.data())) {
+            break;
+        }
+        leaf::insert(&sizer, node.get(), key.btree_key(), value.data(),
+                     repli_timestamp_t::distant_past, repli_timestamp_t::distant_past);
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<store_key_t> probes;
+    for (int i = 0; i < 1024; ++i) {
+        probes.push_back(rng.randint(2) == 0
+                         ? keys[rng.randint(keys.size())]
+                         : random_document_key(&rng));
+    }
+
+    int found = 0;
+    ticks_t start_ticks = get_ticks();
+    for (int i = 0; i < NUM_SEARCHES; ++i) {
+        const store_key_t &key = probes[i % probes.size()];
+        found += std::binary_search(keys.begin(), keys.end(), key) ? 1 : 0;
+    }
+    double dur_base = ticks_to_secs(get_ticks() - start_ticks);
+
+    int leaf_found = 0;
+    short_value_buffer_t value_out(std::string(""));
+    start_ticks = get_ticks();
+    for (int i = 0; i < NUM_SEARCHES; ++i) {
+        const store_key_t &key = probes[i % probes.size()];
+        leaf_found += leaf::lookup(&sizer, node.get(), key.btree_key(),
+                                   value_out.data()) ? 1 : 0;
+    }
+    double dur = ticks_to_secs(get_ticks() - start_ticks);
+    EXPECT_EQ(found, leaf_found);
+
+    printf("Leaf node with %zu keys: %f ns per lookup, %f ns with memcmp over "
+           "a sorted array\n",
+           keys.size(), dur / NUM_SEARCHES * 1e9, dur_base / NUM_SEARCHES * 1e9);
+}
+#endif  // NDEBUG
+
+}  // namespace unittest
@@ -0,0 +1,58 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/lba/in_memory_index.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+void check_info(const index_block_info_t &expected, const index_block_info_t &actual) {
+    EXPECT_EQ(expected.offset.the_value_, actual.offset.the_value_);
+    EXPECT_EQ(expected.recency.longtime, actual.recency.longtime);
+    EXPECT_EQ(expected.ser_block_size, actual.ser_block_size);
+    EXPECT_EQ(expected.uncompressed_ser_block_size, actual.uncompressed_ser_block_size);
+}
+
+TEST(LbaIndexTest, PackedSizes) {
+    EXPECT_EQ(16u, sizeof(packed_block_info_t));
+    EXPECT_EQ(9u, sizeof(packed_aux_block_info_t));
+}
+
+TEST(LbaIndexTest, RoundTrip) {
+    in_memory_index_t index;
+    repli_timestamp_t recency;
+    recency.longtime = (uint64_t(1) << 55) + 12345;
+
+    std::vector<index_block_info_t> infos;
+    infos.push_back(index_block_info_t());
+    infos.push_back(index_block_info_t(flagged_off64_t::make(0),
+                                       repli_timestamp_t::distant_past, 4104, 0));
+    infos.push_back(index_block_info_t(flagged_off64_t::make(DEVICE_BLOCK_SIZE * 12345),
+                                       recency, 1234, 65535));
+    infos.push_back(index_block_info_t(flagged_off64_t::make(int64_t(1) << 48),
+                                       repli_timestamp_t::invalid, 65535, 0x1234));
+    infos.push_back(index_block_info_t(flagged_off64_t::unused(),
+                                       repli_timestamp_t::distant_past, 0, 0));
+
+    for (size_t i = 0; i < infos.size(); ++i) {
+        index.set_block_info(i, infos[i].recency, infos[i].offset,
+                             infos[i].ser_block_size,
+                             infos[i].uncompressed_ser_block_size);
+        index.set_block_info(FIRST_AUX_BLOCK_ID + i, repli_timestamp_t::invalid,
+                             infos[i].offset, infos[i].ser_block_size,
+                             infos[i].uncompressed_ser_block_size);
+    }
+    EXPECT_EQ(infos.size(), index.end_block_id());
+    EXPECT_EQ(FIRST_AUX_BLOCK_ID + infos.size(), index.end_aux_block_id());
+
+    for (size_t i = 0; i < infos.size(); ++i) {
+        check_info(infos[i], index.get_block_info(i));
+        index_block_info_t aux_info = infos[i];
+        aux_info.recency = repli_timestamp_t::invalid;
+        check_info(aux_info, index.get_block_info(FIRST_AUX_BLOCK_ID + i));
+    }
+
+    // Blocks that were never set look unused.
+    check_info(index_block_info_t(), index.get_block_info(1000000));
+    check_info(index_block_info_t(), index.get_block_info(FIRST_AUX_BLOCK_ID + 1000000));
+}
+
+}  // namespace unittest
@@ -165,23 +165,27 @@ public:
         sibling->Verify();
     }
 
-    void Split(LeafNodeTracker *right) {
-        ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
+    // Splits the node to make room for `key_to_insert`, if given.  Returns
+    // the median key.
+    store_key_t Split(LeafNodeTracker *right,
+                      const store_key_t *key_to_insert = nullptr) {
+        EXPECT_EQ(bs_.ser_value(), right->bs_.ser_value());
 
-        ASSERT_TRUE(leaf::is_empty(right->node()));
+        EXPECT_TRUE(leaf::is_empty(right->node()));
 
         store_key_t median;
-        leaf::split(&sizer_, node(), right->node(), median.btree_key());
+        leaf::split(&sizer_, node(), right->node(), median.btree_key(),
+                    key_to_insert == nullptr ? nullptr : key_to_insert->btree_key());
 
-        std::map<store_key_t, std::string>::iterator p = kv_.end();
-        --p;
-        while (p->first > median && p != kv_.begin()) {
+        std::map<store_key_t, std::string>::iterator p = kv_.upper_bound(median);
+        while (p != kv_.end()) {
             right->kv_[p->first] = p->second;
-            kv_.erase(p--);
+            kv_.erase(p++);
         }
 
         Verify();
         right->Verify();
+        return median;
     }
 
     bool IsFull(const store_key_t& key, const std::string& value) {
@@ -263,7 +267,6 @@ TEST(LeafNodeTest, Offsets) {
     ASSERT_EQ(6u, offsetof(leaf_node_t, live_size));
     ASSERT_EQ(8u, offsetof(leaf_node_t, frontmost));
     ASSERT_EQ(10u, offsetof(leaf_node_t, tstamp_cutpoint));
-    ASSERT_EQ(12u, offsetof(leaf_node_t, pair_offsets));
     ASSERT_EQ(12u, sizeof(leaf_node_t));
 }
 
@@ -401,11 +404,11 @@ void make_node_underfull(LeafNodeTracker *tracker, rng_t *rng) {
     while (!tracker->IsUnderfull() ||
            (node->num_pairs > 0 && rng->randint(2) == 0)) {
         int chosen = rng->randint(node->num_pairs);
-        auto pair = *leaf_node_t::iterator(node, chosen);
+        store_key_t key((*leaf_node_t::iterator(node, chosen)).first);
 
         // We might hit a removal entry; skip those.
-        if (tracker->ShouldHave(store_key_t(pair.first))) {
-            tracker->Remove(store_key_t(pair.first));
+        if (tracker->ShouldHave(key)) {
+            tracker->Remove(key);
         }
     }
 }
@@ -710,4 +713,126 @@ TEST(LeafNodeTest, Fullness) {
     ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
 }
 
+TEST(LeafNodeTest, KeyPrefixes) {
+    // Keys that share a long prefix, like secondary index keys often do.
+    const std::string prefix(100, 'p');
+
+    LeafNodeTracker left;
+    int i = 0;
+    store_key_t key;
+    for (;; ++i) {
+        key = store_key_t(prefix + strprintf("%04d", i));
+        if (!left.Insert(key, "v")) {
+            break;
+        }
+    }
+
+    // A new node doesn't have a key prefix yet.  Splitting gives both
+    // halves the prefix their keys share.
+    ASSERT_EQ(0, leaf::key_prefix_size(left.node()));
+    LeafNodeTracker right;
+    store_key_t median = left.Split(&right, &key);
+    ASSERT_LT(median, key);
+    ASSERT_LE(100, leaf::key_prefix_size(left.node()));
+    ASSERT_LE(100, leaf::key_prefix_size(right.node()));
+
+    // Now a lot more of these keys fit than would fit in full.
+    int num_right = right.node()->num_pairs;
+    for (++i; right.Insert(store_key_t(prefix + strprintf("%04d", i)), "v"); ++i) {
+        ++num_right;
+    }
+    ASSERT_GT(num_right, 4096 / 100);
+
+    // A key without the prefix can't be added to `right` without making
+    // every other key longer, so it gets a node of its own.
+    store_key_t short_key("a");
+    ASSERT_TRUE(right.IsFull(short_key, "v"));
+    LeafNodeTracker right_right;
+    median = right.Split(&right_right, &short_key);
+    ASSERT_EQ(short_key, median);
+    ASSERT_TRUE(right.Insert(short_key, "v"));
+
+    // In a node with few keys, the prefix gets shorter instead.
+    LeafNodeTracker merged;
+    merged.Insert(store_key_t(prefix + "xa"), "v");
+    merged.Insert(store_key_t(prefix + "xb"), "v");
+    LeafNodeTracker empty;
+    merged.Merge(&empty);
+    ASSERT_EQ(101, leaf::key_prefix_size(merged.node()));
+    ASSERT_TRUE(merged.Insert(store_key_t(prefix + "y"), "v"));
+    ASSERT_EQ(100, leaf::key_prefix_size(merged.node()));
+    ASSERT_TRUE(merged.Insert(short_key, "v"));
+    ASSERT_EQ(0, leaf::key_prefix_size(merged.node()));
+    merged.Remove(short_key);
+}
+
+std::string random_prefixed_key(rng_t *rng) {
+    static const std::string prefixes[] = {
+        std::string(100, 'a'), std::string(100, 'a') + "b", std::string(60, 'c'), "" };
+    return prefixes[rng->randint(4)] + random_letter_string(rng, 0, 10);
+}
+
+// Fills `left` with random keys, splits it into `right` and keeps changing both
+// halves within their key ranges.
+void split_random_prefixed_node(rng_t *rng, LeafNodeTracker *left,
+                                LeafNodeTracker *right) {
+    store_key_t key;
+    std::string value;
+    for (;;) {
+        key = store_key_t(random_prefixed_key(rng));
+        value = random_letter_string(rng, 0, 20);
+        if (left->IsFull(key, value)) {
+            break;
+        }
+        left->Insert(key, value);
+    }
+
+    store_key_t median = left->Split(right, &key);
+    ASSERT_TRUE((key <= median ? left : right)->Insert(key, value));
+
+    for (int i = 0; i < 500; ++i) {
+        key = store_key_t(random_prefixed_key(rng));
+        LeafNodeTracker *half = key <= median ? left : right;
+        if (half->ShouldHave(key) && rng->randint(2) == 0) {
+            half->Remove(key);
+        } else {
+            half->Insert(key, random_letter_string(rng, 0, 20));
+        }
+    }
+}
+
+TEST(LeafNodeTest, RandomKeyPrefixes) {
+    rng_t rng;
+
+    for (int try_num = 0; try_num < 50; ++try_num) {
+        LeafNodeTracker left;
+        LeafNodeTracker right;
+        split_random_prefixed_node(&rng, &left, &right);
+
+        make_node_underfull(&left, &rng);
+        if (right.IsUnderfull()) {
+            right.Merge(&left);
+        } else {
+            bool could_level;
+            left.Level(-1, &right, &could_level);
+        }
+    }
+}
+
+// Like `RandomKeyPrefixes`, but always merges the halves, so that merges of nodes
+// with different key prefixes get exercised as well.
+TEST(LeafNodeTest, RandomKeyPrefixesMerge) {
+    rng_t rng;
+
+    for (int try_num = 0; try_num < 50; ++try_num) {
+        LeafNodeTracker left;
+        LeafNodeTracker right;
+        split_random_prefixed_node(&rng, &left, &right);
+
+        make_node_underfull(&left, &rng);
+        make_node_underfull(&right, &rng);
+        right.Merge(&left);
+    }
+}
+
 }  // namespace unittest
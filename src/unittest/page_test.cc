@@ -1,4 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
 #include "buffer_cache/page_cache.hpp"
@@ -101,6 +105,10 @@ public:
         return current_page_acq_t::current_page_for_read(
                 page_cache()->default_reads_account());
     }
+
+    page_t *current_page_for_read(cache_account_t *account) {
+        return current_page_acq_t::current_page_for_read(account);
+    }
 };
 
 class test_acq_t : public page_acq_t {
@@ -110,6 +118,10 @@ public:
         page_acq_t::init(page, _page_cache, _page_cache->default_reads_account());
     }
 
+    void init(page_t *page, page_cache_t *_page_cache, cache_account_t *account) {
+        page_acq_t::init(page, _page_cache, account);
+    }
+
     void *get_buf_write() {
         return page_acq_t::get_buf_write(page_cache()->max_block_size());
     }
@@ -314,6 +326,184 @@ TPTEST(PageTest, WriteWaitForFlush, 4) {
     pmap(2, std::bind(&WriteWaitForFlush_cases, &s, &page_cache, ph::_1));
 }
 
+// Creates `count` blocks in a cache of their own, so that a cache created afterwards
+// starts out with none of them loaded.
+std::vector<block_id_t> create_blocks(mock_ser_t *mock, int count) {
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock->ser.get(), &balancer, mock->throttler.get());
+    auto txn = make_scoped<test_txn_t>(&page_cache);
+    std::vector<block_id_t> block_ids;
+    for (int i = 0; i < count; ++i) {
+        current_test_acq_t acq(txn.get(), alt_create_t::create);
+        block_ids.push_back(acq.block_id());
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_write(), &page_cache);
+        memset(page_acq.get_buf_write(), i % 256,
+               page_cache.max_block_size().value());
+    }
+    page_cache.flush(std::move(txn));
+    return block_ids;
+}
+
+// Reads a block through `account`.  The returned page is only good until the cache
+// gets used again.
+page_t *read_block(test_cache_t *page_cache, block_id_t block_id,
+                   cache_account_t *account) {
+    current_test_acq_t acq(page_cache, block_id, read_access_t::read);
+    page_t *page = acq.current_page_for_read(account);
+    test_acq_t page_acq;
+    page_acq.init(page, page_cache, account);
+    page_acq.buf_ready_signal()->wait();
+    return page;
+}
+
+// Lets the cache hold about `num_pages` pages, like `page`.
+void limit_to_pages(test_cache_t *page_cache, page_t *page, uint64_t num_pages) {
+    page_cache->evicter().update_memory_limit(
+        num_pages * page->hypothetical_memory_usage(page_cache), 0, 0, false);
+}
+
+TPTEST(PageTest, EvicterPromotesReusedPages, 4) {
+    mock_ser_t mock;
+    std::vector<block_id_t> block_ids = create_blocks(&mock, 2);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    cache_account_t scan_account = page_cache.create_cache_account(
+        100, cache_access_pattern_t::sequential);
+    alt::evicter_t *evicter = &page_cache.evicter();
+
+    page_t *page = read_block(&page_cache, block_ids[0],
+                              page_cache.default_reads_account());
+    EXPECT_TRUE(evicter->page_is_in_probationary_segment(page));
+    page = read_block(&page_cache, block_ids[0], page_cache.default_reads_account());
+    EXPECT_TRUE(evicter->page_is_in_protected_segment(page));
+
+    // Scans don't count as accesses.
+    page = read_block(&page_cache, block_ids[1], &scan_account);
+    EXPECT_TRUE(evicter->page_is_in_probationary_segment(page));
+    page = read_block(&page_cache, block_ids[1], &scan_account);
+    EXPECT_TRUE(evicter->page_is_in_probationary_segment(page));
+    page = read_block(&page_cache, block_ids[1], page_cache.default_reads_account());
+    EXPECT_TRUE(evicter->page_is_in_probationary_segment(page));
+}
+
+TPTEST(PageTest, EvicterRemembersEvictedPages, 4) {
+    mock_ser_t mock;
+    std::vector<block_id_t> block_ids = create_blocks(&mock, 1000);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    cache_account_t scan_account = page_cache.create_cache_account(
+        100, cache_access_pattern_t::sequential);
+    alt::evicter_t *evicter = &page_cache.evicter();
+
+    // The cache remembers as many evicted blocks as would fill half of it.
+    const uint64_t num_pages = 32;
+    page_t *page = read_block(&page_cache, block_ids[0], &scan_account);
+    const size_t ghost_capacity = num_pages
+        * page->hypothetical_memory_usage(&page_cache) / 2
+        / page_cache.max_block_size().ser_value();
+    limit_to_pages(&page_cache, page, num_pages);
+
+    // Pages that only ever got scanned aren't remembered.
+    for (size_t i = 1; i < 200; ++i) {
+        read_block(&page_cache, block_ids[i], &scan_account);
+    }
+    EXPECT_FALSE(evicter->block_is_recently_evicted(block_ids[0]));
+    EXPECT_EQ(0u, evicter->recently_evicted_count());
+
+    // A page that gets loaded again soon after its eviction goes straight to the
+    // protected segment.
+    read_block(&page_cache, block_ids[200], page_cache.default_reads_account());
+    size_t next = 201;
+    while (!evicter->block_is_recently_evicted(block_ids[200])) {
+        ASSERT_LT(next, block_ids.size());
+        read_block(&page_cache, block_ids[next], page_cache.default_reads_account());
+        ++next;
+    }
+    page = read_block(&page_cache, block_ids[200], page_cache.default_reads_account());
+    EXPECT_TRUE(evicter->page_is_in_protected_segment(page));
+    EXPECT_FALSE(evicter->block_is_recently_evicted(block_ids[200]));
+
+    // The cache only remembers so many evicted blocks.
+    for (; next < block_ids.size(); ++next) {
+        read_block(&page_cache, block_ids[next], page_cache.default_reads_account());
+        ASSERT_LE(evicter->recently_evicted_count(), ghost_capacity);
+    }
+    EXPECT_EQ(ghost_capacity, evicter->recently_evicted_count());
+}
+
+TPTEST(PageTest, EvicterBoundsScans, 4) {
+    mock_ser_t mock;
+    std::vector<block_id_t> block_ids = create_blocks(&mock, 500);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    cache_account_t scan_account = page_cache.create_cache_account(
+        100, cache_access_pattern_t::sequential);
+    alt::evicter_t *evicter = &page_cache.evicter();
+
+    const uint64_t num_pages = 32;
+    const size_t num_hot = 16;
+    page_t *page = nullptr;
+    for (size_t i = 0; i < num_hot; ++i) {
+        read_block(&page_cache, block_ids[i], page_cache.default_reads_account());
+        page = read_block(&page_cache, block_ids[i],
+                          page_cache.default_reads_account());
+        ASSERT_TRUE(evicter->page_is_in_protected_segment(page));
+    }
+    const uint64_t page_size = page->hypothetical_memory_usage(&page_cache);
+    limit_to_pages(&page_cache, page, num_pages);
+    const uint64_t protected_size = evicter->protected_segment_size();
+    EXPECT_EQ(num_hot * page_size, protected_size);
+
+    // A scan of many more pages than fit into the cache only ever displaces pages
+    // from the probationary segment.
+    for (size_t i = num_hot; i < block_ids.size(); ++i) {
+        read_block(&page_cache, block_ids[i], &scan_account);
+        ASSERT_LE(evicter->in_memory_size(), num_pages * page_size);
+        ASSERT_EQ(protected_size, evicter->protected_segment_size());
+    }
+    EXPECT_LE(evicter->probationary_segment_size(),
+              num_pages * page_size - protected_size);
+
+    // Now that the probationary segment is bigger than its share, it's also where
+    // random accesses evict pages from.
+    for (size_t i = num_hot; i < num_hot + num_pages; ++i) {
+        read_block(&page_cache, block_ids[i], page_cache.default_reads_account());
+        ASSERT_EQ(protected_size, evicter->protected_segment_size());
+    }
+    for (size_t i = 0; i < num_hot; ++i) {
+        page = read_block(&page_cache, block_ids[i],
+                          page_cache.default_reads_account());
+        EXPECT_TRUE(evicter->page_is_in_protected_segment(page));
+    }
+}
+
+TPTEST(PageTest, EvicterCountsExtraMemory, 4) {
+    mock_ser_t mock;
+    std::vector<block_id_t> block_ids = create_blocks(&mock, 32);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    alt::evicter_t *evicter = &page_cache.evicter();
+
+    const uint64_t num_pages = 32;
+    page_t *page = nullptr;
+    for (block_id_t block_id : block_ids) {
+        page = read_block(&page_cache, block_id, page_cache.default_reads_account());
+    }
+    const uint64_t page_size = page->hypothetical_memory_usage(&page_cache);
+    limit_to_pages(&page_cache, page, num_pages);
+    EXPECT_EQ(num_pages * page_size, evicter->in_memory_size());
+
+    // Pages get evicted to make room for memory that's used outside of them.
+    evicter->set_extra_memory_usage(num_pages / 4 * page_size);
+    EXPECT_LE(evicter->in_memory_size(), num_pages * page_size);
+    EXPECT_EQ(num_pages / 4 * page_size * 3,
+              evicter->probationary_segment_size() + evicter->protected_segment_size());
+
+    evicter->set_extra_memory_usage(0);
+    EXPECT_EQ(num_pages / 4 * page_size * 3, evicter->in_memory_size());
+}
+
 class bigger_test_t {
 public:
     explicit bigger_test_t(uint64_t _memory_limit)
@@ -920,8 +920,11 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
                               false,
                               false,
                               false,
+                              false,
+                              r_nullopt,
                               ql::configured_limits_t(),
                               ql::datum_t::boolean(false),
+                              0.0,
                               keyspec_t::point_t{ql::datum_t(0.0)}),
                           "id",
                           std::vector<ql::datum_t>(),
@@ -935,8 +938,11 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
                                false,
                                false,
                                false,
+                               false,
+                               r_nullopt,
                                ql::configured_limits_t(),
                                ql::datum_t::boolean(false),
+                               0.0,
                                keyspec_t::point_t{ql::datum_t(10.0)}),
                            "id",
                            std::vector<ql::datum_t>(),
@@ -950,8 +956,11 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
                             false,
                             false,
                             false,
+                            false,
+                            r_nullopt,
                             ql::configured_limits_t(),
                             ql::datum_t::boolean(false),
+                            0.0,
                             keyspec_t::range_t{
                                 std::vector<ql::transform_variant_t>(),
                                     optional<std::string>(),
@@ -981,7 +990,8 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
             index_vals_t(),
             store_key_t(ql::datum_t(static_cast<double>(i)).print_primary()),
             ql::datum_t(-static_cast<double>(i)),
-            ql::datum_t(static_cast<double>(i))}));
+            ql::datum_t(static_cast<double>(i)),
+            0}));
     }
     for (const auto &pair : bundles) {
         ql::batchspec_t bs(ql::batchspec_t::all()
@@ -1010,4 +1020,115 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
     }
 }
 
+// Makes a transformation that turns the row into a string, so that the result of
+// every evaluation lives in its own buffer.
+std::vector<ql::transform_variant_t> make_to_string_transforms(
+        int64_t var_id, uint32_t bt_id) {
+    ql::minidriver_t r((ql::backtrace_id_t(bt_id)));
+    ql::sym_t x(var_id);
+    ql::wire_func_t f(r.var(x).coerce_to("STRING").root_term(),
+                      std::vector<ql::sym_t>{x});
+    return std::vector<ql::transform_variant_t>{ql::map_wire_func_t(f)};
+}
+
+TPTEST(RDBProtocol, ArtificialChangefeedsShareTransformations) {
+    using ql::changefeed::artificial_t;
+    using ql::changefeed::keyspec_t;
+    using ql::changefeed::msg_t;
+
+    extproc_pool_t extproc_pool(2);
+    dummy_semilattice_controller_t<auth_semilattice_metadata_t> auth_manager;
+    rdb_context_t rdb_context(&extproc_pool, nullptr, auth_manager.get_view());
+    artificial_reql_cluster_interface_t artificial_reql_cluster_interface(
+        auth_manager.get_view(),
+        &rdb_context);
+    dummy_semilattice_controller_t<cluster_semilattice_metadata_t> cluster_manager;
+    name_resolver_t name_resolver(
+        cluster_manager.get_view(),
+        nullptr,
+        make_lifetime(artificial_reql_cluster_interface));
+
+    class dummy_artificial_t : public artificial_t {
+    public:
+        explicit dummy_artificial_t(lifetime_t<name_resolver_t const &> name_resolver_)
+            : artificial_t(generate_uuid(), name_resolver_) { }
+        void maybe_remove() { }
+    };
+    dummy_artificial_t artificial_cfeed(make_lifetime(name_resolver));
+
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::YES,
+                  reql_version_t::LATEST);
+    ql::backtrace_id_t bt = ql::backtrace_id_t::empty();
+    auto subscribe = [&](std::vector<ql::transform_variant_t> &&transforms,
+                         const ql::configured_limits_t &limits) {
+        return artificial_cfeed.subscribe(
+            &env,
+            ql::changefeed::streamspec_t(
+                make_counted<ql::vector_datum_stream_t>(
+                    bt, std::vector<ql::datum_t>(), r_nullopt),
+                "test",
+                false,
+                false,
+                false,
+                false,
+                r_nullopt,
+                limits,
+                ql::datum_t::boolean(false),
+                0.0,
+                keyspec_t::range_t{
+                    std::move(transforms),
+                    optional<std::string>(),
+                    sorting_t::UNORDERED,
+                    ql::datumspec_t(
+                        ql::datum_range_t(
+                            ql::datum_t(0.0),
+                            key_range_t::closed,
+                            ql::datum_t(10.0),
+                            key_range_t::open)),
+                    r_nullopt}),
+            "id",
+            std::vector<ql::datum_t>(),
+            bt);
+    };
+
+    // The same function, as two different queries would send it: with different
+    // variable ids and backtraces.
+    counted_t<ql::datum_stream_t> first = subscribe(
+        make_to_string_transforms(1, 1), ql::configured_limits_t());
+    counted_t<ql::datum_stream_t> second = subscribe(
+        make_to_string_transforms(7, 5), ql::configured_limits_t());
+    // The array size limit can change the results, so this one can't share them.
+    counted_t<ql::datum_stream_t> other_limits = subscribe(
+        make_to_string_transforms(1, 1),
+        ql::configured_limits_t(ql::configured_limits_t::default_changefeed_queue_size,
+                                ql::configured_limits_t::default_array_size_limit + 1));
+
+    artificial_cfeed.send_all(msg_t(msg_t::change_t{
+        index_vals_t(),
+        index_vals_t(),
+        store_key_t(ql::datum_t(1.0).print_primary()),
+        ql::datum_t(),
+        ql::datum_t(1.0),
+        0}));
+
+    ql::batchspec_t bs(ql::batchspec_t::all()
+                       .with_new_batch_type(ql::batch_type_t::NORMAL)
+                       .with_max_dur(1000));
+    auto get_new_val = [&](const counted_t<ql::datum_stream_t> &stream) {
+        std::vector<ql::datum_t> batch = stream->next_batch(&env, bs);
+        guarantee(batch.size() == 1);
+        ql::datum_t new_val = batch[0].get_field("new_val");
+        guarantee(new_val.as_str() == datum_string_t("1"));
+        return new_val;
+    };
+    ql::datum_t first_val = get_new_val(first);
+    ql::datum_t second_val = get_new_val(second);
+    ql::datum_t other_limits_val = get_new_val(other_limits);
+    // Results that were evaluated once are the same string, not just equal ones.
+    ASSERT_EQ(first_val.as_str().data(), second_val.as_str().data());
+    ASSERT_NE(first_val.as_str().data(), other_limits_val.as_str().data());
+}
+
 }   /* namespace unittest */
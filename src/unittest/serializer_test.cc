@@ -1,8 +1,12 @@
+#include <string.h>
+
 #include <functional>
 
 #include "arch/runtime/starter.hpp"
+#include "config/args.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/data_block_manager.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "unittest/mock_file.hpp"
 #include "unittest/gtest.hpp"
@@ -90,5 +94,245 @@ TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
     run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
 }
 
+void fill_block(const buf_ptr_t &buf, bool compressible, uint32_t seed) {
+    char *data = static_cast<char *>(buf.cache_data());
+    uint32_t state = seed;
+    for (uint32_t i = 0; i < buf.block_size().value(); ++i) {
+        if (compressible) {
+            data[i] = 'a' + (i / 64 + seed) % 4;
+        } else {
+            state = state * 1103515245 + 12345;
+            data[i] = static_cast<char>(state >> 16);
+        }
+    }
+}
+
+void check_block(log_serializer_t *ser, block_id_t block_id, bool compressible,
+                 file_account_t *account) {
+    counted_t<standard_block_token_t> token = ser->index_read(block_id);
+    ASSERT_TRUE(token.has());
+    ASSERT_EQ(ser->max_block_size().ser_value(), token->block_size().ser_value());
+    EXPECT_EQ(compressible, token->is_compressed());
+
+    buf_ptr_t expected = buf_ptr_t::alloc_zeroed(ser->max_block_size());
+    fill_block(expected, compressible, block_id);
+    buf_ptr_t actual = ser->block_read(token, account);
+    ASSERT_EQ(expected.block_size().ser_value(), actual.block_size().ser_value());
+    EXPECT_EQ(block_id, actual.ser_buffer()->ser_header.block_id);
+    EXPECT_EQ(0, memcmp(expected.cache_data(), actual.cache_data(),
+                        expected.block_size().value()));
+}
+
+void run_CompressedBlocks() {
+    const block_id_t num_blocks = 64;
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+
+    {
+        log_serializer_t::dynamic_config_t config;
+        config.block_compression = block_compression_t::zlib;
+        log_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        // Every other block is incompressible and has to be stored as is.
+        std::vector<buf_ptr_t> bufs;
+        std::vector<buf_write_info_t> infos;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            bufs.push_back(buf_ptr_t::alloc_zeroed(ser.max_block_size()));
+            fill_block(bufs.back(), i % 2 == 0, i);
+            infos.push_back(buf_write_info_t(bufs.back().ser_buffer(),
+                                             bufs.back().block_size(), i));
+        }
+
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        std::vector<index_write_op_t> write_ops;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            ASSERT_EQ(i % 2 == 0, tokens[i]->is_compressed());
+            ASSERT_EQ(ser.max_block_size().ser_value(), tokens[i]->block_size().ser_value());
+            write_ops.push_back(index_write_op_t(i, make_optional(tokens[i]),
+                make_optional(repli_timestamp_t::distant_past)));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, write_ops);
+        tokens.clear();
+
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            check_block(&ser, i, i % 2 == 0, account.get());
+        }
+    }
+
+    // Compressed blocks must stay readable when compression is turned off.
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+                             &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            check_block(&ser, i, i % 2 == 0, account.get());
+        }
+    }
+}
+
+TEST(SerializerTest, CompressedBlocks) {
+    run_in_thread_pool(run_CompressedBlocks, 4);
+}
+
+void write_blocks_and_index(log_serializer_t *ser, block_id_t first, block_id_t end,
+                            file_account_t *account) {
+    std::vector<buf_ptr_t> bufs;
+    std::vector<buf_write_info_t> infos;
+    for (block_id_t i = first; i < end; ++i) {
+        bufs.push_back(buf_ptr_t::alloc_zeroed(ser->max_block_size()));
+        fill_block(bufs.back(), false, i);
+        infos.push_back(buf_write_info_t(bufs.back().ser_buffer(),
+                                         bufs.back().block_size(), i));
+    }
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser->block_writes(infos, account, &cb);
+    cb.wait();
+
+    std::vector<index_write_op_t> write_ops;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        write_ops.push_back(index_write_op_t(first + i, make_optional(tokens[i]),
+            make_optional(repli_timestamp_t::distant_past)));
+    }
+    new_mutex_in_line_t dummy_acq;
+    ser->index_write(&dummy_acq, []{ }, write_ops);
+}
+
+void delete_blocks(log_serializer_t *ser, const std::vector<block_id_t> &block_ids) {
+    std::vector<index_write_op_t> write_ops;
+    for (block_id_t block_id : block_ids) {
+        write_ops.push_back(index_write_op_t(block_id,
+            make_optional(counted_t<standard_block_token_t>())));
+    }
+    new_mutex_in_line_t dummy_acq;
+    ser->index_write(&dummy_acq, []{ }, write_ops);
+}
+
+// Writes enough blocks to spill the LBA into the extents of every LBA shard, and
+// checks that the serializer reconstructs its state from them when it's reopened.
+void run_ReopenWithLbaExtents() {
+    const block_id_t num_blocks = 2000;
+    const block_id_t batch_size = 100;
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+
+    std::vector<block_id_t> deleted;
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+                             &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        for (block_id_t i = 0; i < num_blocks; i += batch_size) {
+            write_blocks_and_index(&ser, i, i + batch_size, account.get());
+        }
+        // Overwrite some blocks so that the LBA has stale entries for them, and
+        // delete some others.
+        write_blocks_and_index(&ser, num_blocks / 2, num_blocks / 2 + batch_size,
+                               account.get());
+        for (block_id_t i = 0; i < num_blocks; i += 7) {
+            deleted.push_back(i);
+        }
+        delete_blocks(&ser, deleted);
+    }
+
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+                             &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        std::vector<block_id_t> live;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            if (i % 7 == 0) {
+                EXPECT_FALSE(ser.index_read(i).has());
+            } else {
+                check_block(&ser, i, false, account.get());
+                live.push_back(i);
+            }
+        }
+
+        // The data block manager insists that only live blocks get deleted, so this
+        // also checks that it has learned about every one of them.
+        delete_blocks(&ser, live);
+    }
+}
+
+TEST(SerializerTest, ReopenWithLbaExtents) {
+    run_in_thread_pool(run_ReopenWithLbaExtents, 4);
+}
+
+void run_LargeBlocks() {
+    const block_id_t num_blocks = 200;
+    mock_file_opener_t file_opener;
+    log_serializer_t::static_config_t static_config;
+    static_config.block_size_ = MAX_BTREE_BLOCK_SIZE;
+    log_serializer_t::create(&file_opener, static_config);
+
+    {
+        log_serializer_t::dynamic_config_t config;
+        config.block_compression = block_compression_t::zlib;
+        log_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+        ASSERT_EQ(static_cast<uint32_t>(MAX_BTREE_BLOCK_SIZE),
+                  ser.max_block_size().ser_value());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        write_blocks_and_index(&ser, 0, num_blocks, account.get());
+    }
+
+    // The block size comes from the file, not from the configuration.
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+                             &file_opener,
+                             &get_global_perfmon_collection());
+        ASSERT_EQ(static_cast<uint32_t>(MAX_BTREE_BLOCK_SIZE),
+                  ser.max_block_size().ser_value());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            check_block(&ser, i, false, account.get());
+        }
+    }
+}
+
+TEST(SerializerTest, LargeBlocks) {
+    run_in_thread_pool(run_LargeBlocks, 4);
+}
+
+TEST(SerializerTest, GcCostBenefit) {
+    using data_block_manager::gc_cost_benefit;
+    const int64_t extent_size = DEFAULT_EXTENT_SIZE;
+    const microtime_t now = 1000 * BILLION;
+    const microtime_t minute = 60 * MILLION;
+
+    // Of two extents of the same age, the one with more garbage gets collected.
+    EXPECT_GT(gc_cost_benefit(extent_size, extent_size / 2, now - minute, now),
+              gc_cost_benefit(extent_size, extent_size / 4, now - minute, now));
+
+    // An extent whose data has been left alone for a long time is worth collecting
+    // at a lower garbage ratio than one that was just written.
+    EXPECT_GT(gc_cost_benefit(extent_size, extent_size / 4, now - 60 * minute, now),
+              gc_cost_benefit(extent_size, extent_size / 2, now - minute, now));
+
+    // Extents written after the reference time, or just before it, are still ranked
+    // by their garbage.
+    EXPECT_GT(gc_cost_benefit(extent_size, extent_size / 2, now + minute, now),
+              gc_cost_benefit(extent_size, extent_size / 4, now, now));
+    EXPECT_EQ(0.0, gc_cost_benefit(extent_size, 0, now - 60 * minute, now));
+}
 
 }  // namespace unittest
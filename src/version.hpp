@@ -21,18 +21,19 @@ enum class cluster_version_t {
     v2_2 = 7,
     v2_3 = 8,
     v2_4 = 9,
+    v2_5 = 10,
 
     // This is used in places where _something_ needs to change when a new cluster
     // version is created.  (Template instantiations, switches on version number,
     // etc.)
-    v2_4_is_latest = v2_4,
+    v2_5_is_latest = v2_5,
 
     // Like the *_is_latest version, but for code that's only concerned with disk
     // serialization. Must be changed whenever LATEST_DISK gets changed.
     v2_4_is_latest_disk = v2_4,
 
     // The latest version, max of CLUSTER and LATEST_DISK
-    LATEST_OVERALL = v2_4_is_latest,
+    LATEST_OVERALL = v2_5_is_latest,
 
     // The latest version for disk serialization can sometimes be different from the
     // version we use for cluster serialization.  This is also the latest version of
@@ -47,7 +48,9 @@ enum class cluster_version_t {
 // Uncomment this if cluster_version_t::LATEST_DISK != cluster_version_t::CLUSTER.
 // Comment it otherwise. This macro is used to avoid instantiating the same version
 // twice in the `INSTANTIATE_SERIALIZE_FOR_CLUSTER_AND_DISK` macro.
-#define CLUSTER_AND_DISK_VERSIONS_ARE_SAME
+// v2_5 only changed cluster messages (the changefeed log positions and stamps), so
+// the disk format is still v2_4.
+// #define CLUSTER_AND_DISK_VERSIONS_ARE_SAME
 
 #ifdef CLUSTER_AND_DISK_VERSIONS_ARE_SAME
 static_assert(cluster_version_t::CLUSTER == cluster_version_t::LATEST_DISK,
@@ -0,0 +1,137 @@
+#!/usr/bin/env python
+# Copyright 2010-2016 RethinkDB, all rights reserved.
+
+'''Reference decoder for the binary result format.
+
+Clients that set `result_format` to "binary" in the handshake get the payload of each
+response (everything after the token and the size) as one datum in the format written
+by `datum_serialize()` in `src/rdb_protocol/serialize_datum.cc`. All integers are
+little-endian.
+
+    datum     := type:u8 body
+    R_BOOL       (2)   u8, 0 or 1
+    R_NULL       (3)   nothing
+    DOUBLE       (4)   IEEE 754 double, 8 bytes
+    R_STR        (6)   string
+    INT_NEGATIVE (7)   varint, the number is minus its value
+    INT_POSITIVE (8)   varint
+    R_BINARY     (9)   string, the raw bytes
+    BUF_R_ARRAY  (10)  varint inner_size, varint count, offset table, count datums
+    BUF_R_OBJECT (11)  varint inner_size, varint count, offset table,
+                       count times (key:string value:datum), sorted by key
+    R_ARRAY      (1)   varint count, count datums (not written any more)
+    R_OBJECT     (5)   varint count, count times (key:string value:datum) (likewise)
+
+    string    := varint size, size bytes of UTF-8 (or raw bytes for R_BINARY)
+    varint    := 7 bits per byte, least significant first, high bit set on all
+                 but the last byte
+
+The offset table holds the offsets of the second through last elements relative to the
+first one, so a decoder can skip to an element without decoding the ones before it.
+Each offset is 1, 2, 4 or 8 bytes wide: the smallest width that can hold
+`inner_size`, which counts everything after the varint holding it.
+
+Times and other pseudotypes are objects with a `$reql_type$` field, exactly as in
+JSON, since that's how the server represents them. The response object has the same
+fields as in JSON: `t`, `r` and optionally `e`, `b`, `p` and `n`.'''
+
+import struct
+
+R_ARRAY, R_BOOL, R_NULL, DOUBLE, R_OBJECT, R_STR, INT_NEGATIVE, INT_POSITIVE, \
+    R_BINARY, BUF_R_ARRAY, BUF_R_OBJECT = range(1, 12)
+
+class DecodeError(Exception):
+    pass
+
+class _Reader(object):
+    def __init__(self, data):
+        self.data = bytearray(data)
+        self.pos = 0
+
+    def bytes(self, count):
+        if self.pos + count > len(self.data):
+            raise DecodeError('Unexpected end of data at offset %d' % self.pos)
+        result = self.data[self.pos:self.pos + count]
+        self.pos += count
+        return result
+
+    def byte(self):
+        return self.bytes(1)[0]
+
+    def varint(self):
+        result = 0
+        shift = 0
+        while True:
+            byte = self.byte()
+            result |= (byte & 0x7f) << shift
+            if byte & 0x80 == 0:
+                return result
+            shift += 7
+            if shift >= 64:
+                raise DecodeError('Varint too long at offset %d' % self.pos)
+
+    def string(self):
+        return bytes(self.bytes(self.varint()))
+
+def _offset_width(inner_size):
+    for width, limit in ((1, 0xff), (2, 0xffff), (4, 0xffffffff)):
+        if inner_size <= limit:
+            return width
+    return 8
+
+def _decode_elements(reader, is_object):
+    inner_size = reader.varint()
+    end = reader.pos + inner_size
+    count = reader.varint()
+    reader.bytes(max(count - 1, 0) * _offset_width(inner_size))
+    if is_object:
+        result = {}
+        for _ in range(count):
+            key = reader.string().decode('utf-8')
+            result[key] = _decode(reader)
+    else:
+        result = [_decode(reader) for _ in range(count)]
+    if reader.pos != end:
+        raise DecodeError('Size mismatch at offset %d' % reader.pos)
+    return result
+
+def _decode(reader):
+    datum_type = reader.byte()
+    if datum_type == R_NULL:
+        return None
+    elif datum_type == R_BOOL:
+        return reader.byte() != 0
+    elif datum_type == DOUBLE:
+        return struct.unpack('<d', bytes(reader.bytes(8)))[0]
+    elif datum_type == INT_POSITIVE:
+        return reader.varint()
+    elif datum_type == INT_NEGATIVE:
+        value = reader.varint()
+        # The server sends -0.0 this way
+        return -value if value != 0 else -0.0
+    elif datum_type == R_STR:
+        return reader.string().decode('utf-8')
+    elif datum_type == R_BINARY:
+        return reader.string()
+    elif datum_type == BUF_R_ARRAY:
+        return _decode_elements(reader, False)
+    elif datum_type == BUF_R_OBJECT:
+        return _decode_elements(reader, True)
+    elif datum_type == R_ARRAY:
+        return [_decode(reader) for _ in range(reader.varint())]
+    elif datum_type == R_OBJECT:
+        result = {}
+        for _ in range(reader.varint()):
+            key = reader.string().decode('utf-8')
+            result[key] = _decode(reader)
+        return result
+    else:
+        raise DecodeError('Unknown datum type %d at offset %d' % (datum_type, reader.pos - 1))
+
+def decode(data):
+    '''Decodes one datum that takes up all of `data`. Binary values become `bytes`.'''
+    reader = _Reader(data)
+    result = _decode(reader)
+    if reader.pos != len(reader.data):
+        raise DecodeError('%d bytes left after the datum' % (len(reader.data) - reader.pos))
+    return result
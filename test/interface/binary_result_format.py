@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+# Copyright 2010-2016 RethinkDB, all rights reserved.
+
+'''Checks that clients which ask for the binary result format in the handshake get
+responses that decode with the reference decoder in `test/common/binary_datum.py`.'''
+
+import base64, hashlib, hmac, json, os, socket, struct, sys
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import binary_datum, driver, scenario_common, utils, vcoptparse
+
+op = vcoptparse.OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+_, command_prefix, serve_options = scenario_common.parse_mode_flags(op.parse(sys.argv))
+
+V1_0 = 0x34c2bdc3
+START, CONTINUE = 1, 2
+SUCCESS_ATOM, SUCCESS_SEQUENCE, SUCCESS_PARTIAL, RUNTIME_ERROR = 1, 2, 3, 18
+MAKE_ARRAY, ERROR, RANGE = 2, 12, 173
+
+class Connection(object):
+    '''A bare connection that logs in as `admin` without a password.'''
+
+    def __init__(self, host, port, result_format):
+        self.sock = socket.create_connection((host, port))
+        self.sock.sendall(struct.pack('<I', V1_0))
+        assert self.read_message()['success']
+
+        nonce = base64.standard_b64encode(os.urandom(18)).decode('ascii')
+        client_first = 'n=admin,r=' + nonce
+        self.send_message({
+            'protocol_version': 0,
+            'authentication_method': 'SCRAM-SHA-256',
+            'authentication': 'n,,' + client_first,
+            'result_format': result_format})
+        reply = self.read_message()
+        if not reply['success']:
+            self.error_code = reply['error_code']
+            return
+        server_first = reply['authentication']
+        fields = dict(item.split('=', 1) for item in server_first.split(','))
+
+        salted = hashlib.pbkdf2_hmac('sha256', b'', base64.standard_b64decode(fields['s']), int(fields['i']))
+        client_key = hmac.new(salted, b'Client Key', hashlib.sha256).digest()
+        stored_key = hashlib.sha256(client_key).digest()
+        client_final = 'c=biws,r=' + fields['r']
+        auth_message = ','.join([client_first, server_first, client_final]).encode('utf-8')
+        signature = hmac.new(stored_key, auth_message, hashlib.sha256).digest()
+        proof = bytes(bytearray(a ^ b for a, b in zip(bytearray(client_key), bytearray(signature))))
+        self.send_message({'authentication': client_final + ',p=' + base64.standard_b64encode(proof).decode('ascii')})
+        assert self.read_message()['success']
+        self.error_code = None
+
+    def send_message(self, message):
+        self.sock.sendall(json.dumps(message).encode('utf-8') + b'\0')
+
+    def read_message(self):
+        data = b''
+        while not data.endswith(b'\0'):
+            data += self.sock.recv(1)
+        return json.loads(data[:-1].decode('utf-8'))
+
+    def recv_exactly(self, size):
+        data = b''
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            assert chunk, 'Connection closed'
+            data += chunk
+        return data
+
+    def query(self, token, query):
+        payload = json.dumps(query).encode('utf-8')
+        self.sock.sendall(struct.pack('<qI', token, len(payload)) + payload)
+        response_token, size = struct.unpack('<qI', self.recv_exactly(12))
+        assert response_token == token, (response_token, token)
+        return binary_datum.decode(self.recv_exactly(size))
+
+utils.print_with_time("Spinning up a server")
+with driver.Process(name='.', command_prefix=command_prefix, extra_options=serve_options) as server:
+    server.check()
+
+    utils.print_with_time("Checking the handshake")
+    conn = Connection(server.host, server.driver_port, 'xml')
+    assert conn.error_code == 24, conn.error_code
+    conn = Connection(server.host, server.driver_port, 'binary')
+    assert conn.error_code is None
+
+    utils.print_with_time("Checking an atom")
+    response = conn.query(1, [START, [MAKE_ARRAY, [
+        1, -2, 1.5, 'x', None, True,
+        {'$reql_type$': 'BINARY', 'data': 'AAE='},
+        {'a': [MAKE_ARRAY, [1, 2]]}]], {}])
+    assert response == {'t': SUCCESS_ATOM, 'r': [[1, -2, 1.5, 'x', None, True, b'\x00\x01', {'a': [1, 2]}]]}, response
+
+    utils.print_with_time("Checking a sequence")
+    rows = []
+    response = conn.query(2, [START, [RANGE, [3000]], {}])
+    rows.extend(response['r'])
+    while response['t'] == SUCCESS_PARTIAL:
+        response = conn.query(2, [CONTINUE])
+        rows.extend(response['r'])
+    assert response['t'] == SUCCESS_SEQUENCE, response
+    assert rows == list(range(3000))
+
+    utils.print_with_time("Checking an error")
+    response = conn.query(3, [START, [ERROR, ['boom']], {}])
+    assert response['t'] == RUNTIME_ERROR and response['r'] == ['boom'], response
+
+    utils.print_with_time("Cleaning up")
+utils.print_with_time("Done.")
@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+# Copyright 2010-2016 RethinkDB, all rights reserved.
+
+'''Checks that responses with more rows than the server encodes in one window arrive
+intact.  Such responses are encoded a window of rows at a time on several threads, and
+the windows are spliced together on their way to the connection.'''
+
+import os, sys
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import driver, scenario_common, utils, vcoptparse
+
+op = vcoptparse.OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+_, command_prefix, serve_options = scenario_common.parse_mode_flags(op.parse(sys.argv))
+
+r = utils.import_python_driver()
+
+# A window has at most 16 * 1000 rows.
+num_rows = 40000
+batch_options = {
+    'max_batch_rows': num_rows,
+    'max_batch_bytes': 256 * 1024 * 1024,
+    'max_batch_seconds': 60,
+    'first_batch_scaledown_factor': 1}
+
+utils.print_with_time("Spinning up a server")
+with driver.Process(name='.', command_prefix=command_prefix, extra_options=serve_options) as server:
+    server.check()
+    conn = r.connect(host=server.host, port=server.driver_port)
+
+    utils.print_with_time("Checking a sequence of numbers")
+    cursor = r.range(num_rows).run(conn, **batch_options)
+    assert len(cursor.items) == num_rows, len(cursor.items)
+    rows = list(cursor)
+    assert rows == list(range(num_rows))
+
+    utils.print_with_time("Checking a sequence of objects")
+    query = r.range(num_rows).map(lambda i: {'id': i, 'name': r.expr(u'row "\u00e9" ').add(i.coerce_to('string'))})
+    cursor = query.run(conn, **batch_options)
+    assert len(cursor.items) == num_rows, len(cursor.items)
+    rows = list(cursor)
+    assert len(rows) == num_rows, len(rows)
+    for i, row in enumerate(rows):
+        assert row == {'id': i, 'name': u'row "\u00e9" %d' % i}, (i, row)
+
+    utils.print_with_time("Cleaning up")
+utils.print_with_time("Done.")